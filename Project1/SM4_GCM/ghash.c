@@ -1,4 +1,5 @@
 #include "ghash.h"
+#include "../sm4_trace.h"
 #include <string.h>
 
 // GF(2^128) 乘法函数
@@ -41,6 +42,7 @@ void ghash_reset(GHASH_CTX *ctx) { memset(ctx->Y, 0, 16); }
 
 // 输入数据（任意长度）
 void ghash_update(GHASH_CTX *ctx, const uint8_t *data, size_t len) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GHASH, len, (len + 15) / 16);
   uint8_t block[16];
   while (len > 0) {
     size_t block_len = len < 16 ? len : 16;
@@ -57,6 +59,7 @@ void ghash_update(GHASH_CTX *ctx, const uint8_t *data, size_t len) {
     data += block_len;
     len -= block_len;
   }
+  SM4_TRACE_END();
 }
 
 // 计算最终 GHASH 值
@@ -0,0 +1,138 @@
+#include "ghash_lanes.h"
+#include "ghash.h"
+
+#include <immintrin.h>
+#include <pthread.h>
+#include <string.h>
+
+// 需要 -mpclmul -mssse3（makefile 只对本文件开启），运行时按 cpuid 决定是否使用
+
+static void len_block(const GHASH_LANE *l, uint8_t out[16]) {
+  uint64_t aad_bits = (uint64_t)l->aad_len * 8;
+  uint64_t ct_bits = (uint64_t)l->ct_len * 8;
+  for (int i = 0; i < 8; i++) {
+    out[i] = (uint8_t)(aad_bits >> (56 - 8 * i));
+    out[i + 8] = (uint8_t)(ct_bits >> (56 - 8 * i));
+  }
+}
+
+static size_t lane_blocks(const GHASH_LANE *l) {
+  return (l->aad_len + 15) / 16 + (l->ct_len + 15) / 16 + 1;
+}
+
+// 第 i 块：先 AAD 后密文，不足一块的尾部补零，最后是长度块
+static void lane_block(const GHASH_LANE *l, size_t i, uint8_t out[16]) {
+  size_t na = (l->aad_len + 15) / 16, nc = (l->ct_len + 15) / 16;
+  const uint8_t *p;
+  size_t len;
+  if (i < na) {
+    p = l->aad + 16 * i;
+    len = l->aad_len - 16 * i;
+  } else if (i < na + nc) {
+    p = l->ct + 16 * (i - na);
+    len = l->ct_len - 16 * (i - na);
+  } else {
+    len_block(l, out);
+    return;
+  }
+  if (len >= 16) {
+    memcpy(out, p, 16);
+  } else {
+    memset(out, 0, 16);
+    memcpy(out, p, len);
+  }
+}
+
+static __m128i rev(void) {
+  return _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+}
+
+static __m128i load(const uint8_t *p) {
+  return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), rev());
+}
+
+// 与 sm4_gcm.hpp 的 ghash_clmul::mul 相同：字节反转后按整数做无进位乘法，
+// 乘积左移一位再模 x^128 + x^7 + x^2 + x + 1 约化
+static inline __m128i gf_mul_clmul(__m128i a, __m128i b) {
+  __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                              _mm_clmulepi64_si128(a, b, 0x01));
+  __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+  __m128i lo_c = _mm_srli_epi32(lo, 31), hi_c = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  hi = _mm_or_si128(hi, _mm_srli_si128(lo_c, 12));
+  hi = _mm_or_si128(hi, _mm_slli_si128(hi_c, 4));
+  lo = _mm_or_si128(lo, _mm_slli_si128(lo_c, 4));
+
+  __m128i t = _mm_xor_si128(
+      _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+      _mm_slli_epi32(lo, 25));
+  __m128i carry = _mm_srli_si128(t, 4);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+  __m128i u = _mm_xor_si128(
+      _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+      _mm_srli_epi32(lo, 7));
+  u = _mm_xor_si128(u, carry);
+  return _mm_xor_si128(hi, _mm_xor_si128(lo, u));
+}
+
+// 每 4 条消息一组，按块交错；组内较短的消息先结束
+static void lanes_clmul(GHASH_LANE *lanes, size_t n) {
+  for (size_t g = 0; g < n; g += 4) {
+    size_t m = n - g < 4 ? n - g : 4, most = 0;
+    __m128i acc[4], h[4];
+    size_t nb[4];
+    for (size_t k = 0; k < m; k++) {
+      acc[k] = _mm_setzero_si128();
+      h[k] = load(lanes[g + k].H);
+      nb[k] = lane_blocks(&lanes[g + k]);
+      most = nb[k] > most ? nb[k] : most;
+    }
+    for (size_t i = 0; i < most; i++) {
+      for (size_t k = 0; k < m; k++) {
+        if (i < nb[k]) {
+          uint8_t block[16];
+          lane_block(&lanes[g + k], i, block);
+          acc[k] = gf_mul_clmul(_mm_xor_si128(acc[k], load(block)), h[k]);
+        }
+      }
+    }
+    for (size_t k = 0; k < m; k++) {
+      _mm_storeu_si128((__m128i *)lanes[g + k].S,
+                       _mm_shuffle_epi8(acc[k], rev()));
+    }
+  }
+}
+
+// 多个线程（sm4_async 的工作线程）会同时进入 ghash_lanes，
+// 检测结果由 pthread_once 只写一次
+static int clmul;
+static pthread_once_t clmul_once = PTHREAD_ONCE_INIT;
+
+static void detect_clmul(void) {
+  clmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+void ghash_lanes(GHASH_LANE *lanes, size_t n) {
+  pthread_once(&clmul_once, detect_clmul);
+  if (clmul) {
+    lanes_clmul(lanes, n);
+    return;
+  }
+
+  // ghash_update 会把不足一块的尾部补零
+  GHASH_CTX ctx;
+  for (size_t i = 0; i < n; i++) {
+    uint8_t lens[16];
+    len_block(&lanes[i], lens);
+    ghash_init(&ctx, lanes[i].H);
+    ghash_update(&ctx, lanes[i].aad, lanes[i].aad_len);
+    ghash_update(&ctx, lanes[i].ct, lanes[i].ct_len);
+    ghash_update(&ctx, lens, 16);
+    ghash_final(&ctx, lanes[i].S);
+  }
+}
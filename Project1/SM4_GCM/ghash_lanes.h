@@ -0,0 +1,22 @@
+#ifndef GHASH_LANES_H
+#define GHASH_LANES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 一条消息的完整 GHASH：AAD 与密文各自补零到整块，最后是长度块
+typedef struct {
+  uint8_t H[16];
+  const uint8_t *aad;
+  size_t aad_len;
+  const uint8_t *ct;
+  size_t ct_len;
+  uint8_t S[16]; // 输出
+} GHASH_LANE;
+
+// 多条消息（各自的 H）的 GHASH 一起计算。CPU 支持 PCLMULQDQ 时 4 条消息
+// 交错，4 条乘法依赖链互不相关，可以填满乘法器的流水线；否则逐条用
+// ghash_update。结果与 gcm_sm4_tag 中的 GHASH 相同
+void ghash_lanes(GHASH_LANE *lanes, size_t n);
+
+#endif // GHASH_LANES_H
@@ -1,4 +1,5 @@
 #include "ghash_table.h"
+#include "../sm4_trace.h"
 #include <string.h>
 
 static int Rev[256] = {
@@ -116,6 +117,7 @@ void ghash_table_reset(GHASH_CTX *ctx) { memset(ctx->Y, 0, 16); }
 
 // 输入数据（任意长度）
 void ghash_table_update(GHASH_CTX *ctx, const uint8_t *data, size_t len) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GHASH_TABLE, len, (len + 15) / 16);
   uint8_t block[16];
   while (len > 0) {
     size_t block_len = len < 16 ? len : 16;
@@ -132,6 +134,7 @@ void ghash_table_update(GHASH_CTX *ctx, const uint8_t *data, size_t len) {
     data += block_len;
     len -= block_len;
   }
+  SM4_TRACE_END();
 }
 
 // 计算最终 GHASH 值
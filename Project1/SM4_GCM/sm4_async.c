@@ -0,0 +1,542 @@
+#include "sm4_async.h"
+#include "../sm4_ctr.h"
+#include "../sm4_engine.h"
+#include "sm4_gcm.h"
+#include "sm4_offload.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define ASYNC_BATCH SM4_OFFLOAD_BATCH // 工作线程每次最多取走的任务数
+#define ASYNC_SMALL_BLOCKS 16 // 不超过此块数的 ECB/CTR 任务参与合批
+#define ASYNC_BLOCKS (ASYNC_BATCH * ASYNC_SMALL_BLOCKS)
+#define ASYNC_MAX_THREADS 64
+
+static const GHASH_METHOD GHASH_TBL = {.init = ghash_table_init,
+                                       .update = ghash_table_update,
+                                       .final = ghash_table_final,
+                                       .reset = ghash_table_reset};
+
+// 有界多生产者多消费者队列（Vyukov）：每个格子带序号，序号等于下标时
+// 可写，等于下标加一时可读，读走后加上容量留给下一轮
+typedef struct {
+  size_t seq;
+  SM4_ASYNC_JOB *job;
+} ASYNC_CELL;
+
+typedef struct {
+  ASYNC_CELL *cells;
+  size_t mask;
+  size_t head __attribute__((aligned(64))); // 下一个读位置
+  size_t tail __attribute__((aligned(64))); // 下一个写位置
+} ASYNC_QUEUE;
+
+static int queue_init(ASYNC_QUEUE *q, size_t depth) {
+  size_t cap = 1;
+  while (cap < depth) {
+    cap <<= 1;
+  }
+  q->cells = malloc(cap * sizeof(ASYNC_CELL));
+  if (!q->cells) {
+    return -1;
+  }
+  for (size_t i = 0; i < cap; i++) {
+    q->cells[i].seq = i;
+  }
+  q->mask = cap - 1;
+  q->head = q->tail = 0;
+  return 0;
+}
+
+static int queue_push(ASYNC_QUEUE *q, SM4_ASYNC_JOB *job) {
+  size_t pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+  for (;;) {
+    ASYNC_CELL *c = &q->cells[pos & q->mask];
+    size_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+    intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+    if (dif == 0) {
+      if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        c->job = job;
+        __atomic_store_n(&c->seq, pos + 1, __ATOMIC_RELEASE);
+        return 1;
+      }
+    } else if (dif < 0) {
+      return 0; // 满
+    } else {
+      pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+static SM4_ASYNC_JOB *queue_pop(ASYNC_QUEUE *q) {
+  size_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+  for (;;) {
+    ASYNC_CELL *c = &q->cells[pos & q->mask];
+    size_t seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+    intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (dif == 0) {
+      if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        SM4_ASYNC_JOB *job = c->job;
+        __atomic_store_n(&c->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+        return job;
+      }
+    } else if (dif < 0) {
+      return NULL; // 空
+    } else {
+      pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// 睡眠前的检查：与对方的“先写队列、再读标志”配对，都用 seq_cst
+static int queue_ready(ASYNC_QUEUE *q) {
+  size_t pos = __atomic_load_n(&q->head, __ATOMIC_SEQ_CST);
+  ASYNC_CELL *c = &q->cells[pos & q->mask];
+  return __atomic_load_n(&c->seq, __ATOMIC_SEQ_CST) == pos + 1;
+}
+
+struct SM4_ASYNC_CQ {
+  ASYNC_QUEUE q; // 工作线程写，所有者读
+  size_t depth;
+  size_t inflight; // 只由所有者访问
+  int efd;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  unsigned waiting; // 所有者将要阻塞（未使用 eventfd 时）
+  unsigned busy;    // 正在向本队列放入任务并通知的工作线程数
+};
+
+typedef struct {
+  SM4_ASYNC *a;
+  pthread_t thread;
+  SM4_OFFLOAD_WORK *gcm;
+  SM4_OFFLOAD_DESC desc[ASYNC_BATCH];
+  SM4_ASYNC_JOB *gcm_job[ASYNC_BATCH]; // 与 desc 一一对应
+  SM4_ASYNC_JOB *job[ASYNC_BATCH];
+  SM4_ASYNC_JOB *small[ASYNC_BATCH];
+  SM4_ASYNC_CQ *notify[ASYNC_BATCH];
+  uint8_t *in;  // ASYNC_BLOCKS 块
+  uint8_t *out; // ASYNC_BLOCKS 块
+  const SM4_Key **key_of;
+} ASYNC_WORKER;
+
+struct SM4_ASYNC {
+  ASYNC_QUEUE sq;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  unsigned sleepers; // 正在或将要睡眠的工作线程数
+  int stop;
+  unsigned nthreads;
+  ASYNC_WORKER *workers;
+  uint64_t jobs;
+  uint64_t batches;
+};
+
+static void store_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static uint32_t load_be32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         p[3];
+}
+
+static int job_valid(const SM4_ASYNC_JOB *j) {
+  if (j->len > 0 && (!j->in || !j->out)) {
+    return 0;
+  }
+  switch (j->op) {
+  case SM4_ASYNC_ECB_ENC:
+  case SM4_ASYNC_ECB_DEC:
+    return j->key && j->len % 16 == 0;
+  case SM4_ASYNC_CTR:
+    return j->key != NULL;
+  case SM4_ASYNC_GCM_SEAL:
+  case SM4_ASYNC_GCM_OPEN:
+    return j->gcm_key && (j->aad_len == 0 || j->aad);
+  default:
+    return 0;
+  }
+}
+
+// 单独执行一个大任务
+static void run_one(SM4_ASYNC_JOB *j) {
+  GCM_SM4_CTX ctx;
+  switch (j->op) {
+  case SM4_ASYNC_ECB_ENC:
+    sm4_engine_encrypt_blocks(j->in, j->out, j->len / 16, j->key);
+    break;
+  case SM4_ASYNC_ECB_DEC:
+    sm4_engine_decrypt_blocks(j->in, j->out, j->len / 16, j->key);
+    break;
+  case SM4_ASYNC_CTR:
+    sm4_ctr_range(j->key, j->iv, 32, 0, j->in, j->out, j->len);
+    break;
+  case SM4_ASYNC_GCM_SEAL:
+    gcm_sm4_init(&ctx, j->gcm_key, j->iv, 12, &GHASH_TBL);
+    gcm_sm4_aad(&ctx, j->aad, j->aad_len);
+    gcm_sm4_encrypt(&ctx, j->in, j->len, j->out);
+    gcm_sm4_tag(&ctx, j->tag);
+    memset(&ctx, 0, sizeof(ctx));
+    break;
+  case SM4_ASYNC_GCM_OPEN:
+    if (sm4_gcm_decrypt(j->gcm_key, j->iv, 12, j->aad, j->aad_len, j->in,
+                        j->len, j->tag, j->out, &GHASH_TBL) != 0) {
+      j->status = SM4_ASYNC_BAD_TAG;
+      return;
+    }
+    break;
+  }
+  j->status = SM4_ASYNC_OK;
+}
+
+// 小的 ECB/CTR 任务排成一列做一次多密钥调用：ECB 加密与 CTR 共用一次
+// 加密（CTR 放入计数器块），ECB 解密另做一次
+static void run_small(ASYNC_WORKER *w, SM4_ASYNC_JOB **jobs, size_t n,
+                      int dec) {
+  size_t nb = 0;
+  for (size_t k = 0; k < n; k++) {
+    SM4_ASYNC_JOB *j = jobs[k];
+    size_t blocks = (j->len + 15) / 16;
+    uint8_t *p = w->in + 16 * nb;
+    if (j->op == SM4_ASYNC_CTR) {
+      uint32_t c0 = load_be32(j->iv + 12);
+      for (size_t b = 0; b < blocks; b++) {
+        memcpy(p + 16 * b, j->iv, 12);
+        store_be32(p + 16 * b + 12, c0 + (uint32_t)b);
+      }
+    } else {
+      memcpy(p, j->in, j->len);
+    }
+    for (size_t b = 0; b < blocks; b++) {
+      w->key_of[nb + b] = j->key;
+    }
+    nb += blocks;
+  }
+  if (nb == 0) {
+    return;
+  }
+  // 同一会话的任务常用同一个密钥，这时走单密钥的多块接口，比多密钥快
+  int same = 1;
+  for (size_t k = 1; k < n && same; k++) {
+    same = jobs[k]->key == jobs[0]->key;
+  }
+  if (same && dec) {
+    sm4_engine_decrypt_blocks(w->in, w->out, nb, jobs[0]->key);
+  } else if (same) {
+    sm4_engine_encrypt_blocks(w->in, w->out, nb, jobs[0]->key);
+  } else if (dec) {
+    sm4_engine_decrypt_multikey(w->in, w->out, nb, w->key_of);
+  } else {
+    sm4_engine_encrypt_multikey(w->in, w->out, nb, w->key_of);
+  }
+  nb = 0;
+  for (size_t k = 0; k < n; k++) {
+    SM4_ASYNC_JOB *j = jobs[k];
+    const uint8_t *ks = w->out + 16 * nb;
+    if (j->op == SM4_ASYNC_CTR) {
+      size_t i = 0;
+      for (; i + 8 <= j->len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, j->in + i, 8);
+        memcpy(&b, ks + i, 8);
+        a ^= b;
+        memcpy(j->out + i, &a, 8);
+      }
+      for (; i < j->len; i++) {
+        j->out[i] = j->in[i] ^ ks[i];
+      }
+    } else {
+      memcpy(j->out, ks, j->len);
+    }
+    j->status = SM4_ASYNC_OK;
+    nb += (j->len + 15) / 16;
+  }
+}
+
+static void notify(SM4_ASYNC_CQ *cq) {
+  if (cq->efd >= 0) {
+    uint64_t one = 1;
+    ssize_t r = write(cq->efd, &one, sizeof(one));
+    (void)r;
+    return;
+  }
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&cq->waiting, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&cq->lock);
+    pthread_cond_broadcast(&cq->cond);
+    pthread_mutex_unlock(&cq->lock);
+  }
+}
+
+static void run_batch(ASYNC_WORKER *w, size_t n) {
+  size_t ngcm = 0, nenc = 0, ndec = 0, nnotify = 0;
+  SM4_ASYNC_JOB **job = w->job;
+
+  // GCM 与小的 ECB 加密/CTR 各自合批，小的 ECB 解密从 small 的尾部往前放
+  for (size_t i = 0; i < n; i++) {
+    SM4_ASYNC_JOB *j = job[i];
+    if (!job_valid(j)) {
+      j->status = SM4_ASYNC_INVALID;
+    } else if ((j->op == SM4_ASYNC_GCM_SEAL || j->op == SM4_ASYNC_GCM_OPEN) &&
+               j->len <= SM4_OFFLOAD_MAX_DATA) {
+      SM4_OFFLOAD_DESC *d = &w->desc[ngcm];
+      w->gcm_job[ngcm++] = j;
+      d->op = j->op == SM4_ASYNC_GCM_SEAL ? SM4_OFFLOAD_SEAL : SM4_OFFLOAD_OPEN;
+      d->key = j->gcm_key;
+      d->iv = j->iv;
+      d->aad = j->aad;
+      d->aad_len = j->aad_len;
+      d->in = j->in;
+      d->out = j->out;
+      d->len = j->len;
+      d->tag = j->tag;
+    } else if (j->len <= 16 * ASYNC_SMALL_BLOCKS &&
+               j->op != SM4_ASYNC_GCM_SEAL && j->op != SM4_ASYNC_GCM_OPEN) {
+      if (j->op == SM4_ASYNC_ECB_DEC) {
+        w->small[n - 1 - ndec++] = j;
+      } else {
+        w->small[nenc++] = j;
+      }
+    } else {
+      run_one(j);
+    }
+  }
+  sm4_offload_run(w->gcm, w->desc, ngcm);
+  run_small(w, w->small, nenc, 0);
+  run_small(w, w->small + n - ndec, ndec, 1);
+
+  for (size_t k = 0; k < ngcm; k++) {
+    w->gcm_job[k]->status = w->desc[k].status;
+  }
+
+  __atomic_fetch_add(&w->a->jobs, n, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&w->a->batches, 1, __ATOMIC_RELAXED);
+
+  // 先把整批放进各自的完成队列，再对每个完成队列通知一次。所有者取走最后
+  // 一个任务后可能立即释放队列，busy 让 sm4_async_cq_destroy 等通知结束
+  for (size_t i = 0; i < n; i++) {
+    SM4_ASYNC_CQ *cq = job[i]->cq;
+    size_t m = 0;
+    while (m < nnotify && w->notify[m] != cq) {
+      m++;
+    }
+    if (m == nnotify) {
+      w->notify[nnotify++] = cq;
+      __atomic_fetch_add(&cq->busy, 1, __ATOMIC_ACQ_REL);
+    }
+    queue_push(&cq->q, job[i]); // 在途数不超过容量，不会满
+  }
+  for (size_t m = 0; m < nnotify; m++) {
+    notify(w->notify[m]);
+    __atomic_fetch_sub(&w->notify[m]->busy, 1, __ATOMIC_RELEASE);
+  }
+}
+
+static void *worker_main(void *arg) {
+  ASYNC_WORKER *w = arg;
+  SM4_ASYNC *a = w->a;
+  for (;;) {
+    size_t n = 0;
+    while (n < ASYNC_BATCH && (w->job[n] = queue_pop(&a->sq)) != NULL) {
+      n++;
+    }
+    if (n > 0) {
+      run_batch(w, n);
+      continue;
+    }
+    // 先登记为睡眠者再检查队列，提交方先入队再读 sleepers，不会都错过
+    pthread_mutex_lock(&a->lock);
+    __atomic_fetch_add(&a->sleepers, 1, __ATOMIC_SEQ_CST);
+    int stop = 0;
+    if (!queue_ready(&a->sq)) {
+      if (a->stop) {
+        stop = 1;
+      } else {
+        pthread_cond_wait(&a->cond, &a->lock);
+      }
+    }
+    __atomic_fetch_sub(&a->sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&a->lock);
+    if (stop) {
+      return NULL;
+    }
+  }
+}
+
+static void worker_free(ASYNC_WORKER *w) {
+  sm4_offload_work_free(w->gcm);
+  free(w->in);
+  free(w->out);
+  free(w->key_of);
+}
+
+void sm4_async_destroy(SM4_ASYNC *a) {
+  if (!a) {
+    return;
+  }
+  pthread_mutex_lock(&a->lock);
+  a->stop = 1;
+  pthread_cond_broadcast(&a->cond);
+  pthread_mutex_unlock(&a->lock);
+  for (unsigned i = 0; i < a->nthreads; i++) {
+    pthread_join(a->workers[i].thread, NULL);
+  }
+  if (a->workers) {
+    for (unsigned i = 0; i < ASYNC_MAX_THREADS && a->workers[i].a; i++) {
+      worker_free(&a->workers[i]);
+    }
+  }
+  pthread_mutex_destroy(&a->lock);
+  pthread_cond_destroy(&a->cond);
+  free(a->workers);
+  free(a->sq.cells);
+  free(a);
+}
+
+SM4_ASYNC *sm4_async_create(unsigned threads, size_t queue_depth) {
+  if (threads == 0) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = n > 0 ? (unsigned)n : 1;
+  }
+  if (threads > ASYNC_MAX_THREADS) {
+    threads = ASYNC_MAX_THREADS;
+  }
+  SM4_ASYNC *a = calloc(1, sizeof(SM4_ASYNC));
+  if (!a) {
+    return NULL;
+  }
+  pthread_mutex_init(&a->lock, NULL);
+  pthread_cond_init(&a->cond, NULL);
+  a->workers = calloc(ASYNC_MAX_THREADS, sizeof(ASYNC_WORKER));
+  if (!a->workers || queue_init(&a->sq, queue_depth ? queue_depth : 1024)) {
+    sm4_async_destroy(a);
+    return NULL;
+  }
+  for (unsigned i = 0; i < threads; i++) {
+    ASYNC_WORKER *w = &a->workers[i];
+    w->a = a;
+    w->gcm = sm4_offload_work_new();
+    w->in = malloc(16 * ASYNC_BLOCKS);
+    w->out = malloc(16 * ASYNC_BLOCKS);
+    w->key_of = malloc(ASYNC_BLOCKS * sizeof(const SM4_Key *));
+    if (!w->gcm || !w->in || !w->out || !w->key_of ||
+        pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+      sm4_async_destroy(a);
+      return NULL;
+    }
+    a->nthreads++;
+  }
+  return a;
+}
+
+void sm4_async_stats(SM4_ASYNC *a, SM4_ASYNC_STATS *st) {
+  st->jobs = __atomic_load_n(&a->jobs, __ATOMIC_RELAXED);
+  st->batches = __atomic_load_n(&a->batches, __ATOMIC_RELAXED);
+}
+
+SM4_ASYNC_CQ *sm4_async_cq_create(size_t depth, int flags) {
+  SM4_ASYNC_CQ *cq = calloc(1, sizeof(SM4_ASYNC_CQ));
+  if (!cq) {
+    return NULL;
+  }
+  cq->depth = depth ? depth : 1;
+  cq->efd = -1;
+  if (queue_init(&cq->q, cq->depth)) {
+    free(cq);
+    return NULL;
+  }
+  if (flags & SM4_ASYNC_CQ_EVENTFD) {
+    cq->efd = eventfd(0, EFD_CLOEXEC);
+    if (cq->efd < 0) {
+      free(cq->q.cells);
+      free(cq);
+      return NULL;
+    }
+  }
+  pthread_mutex_init(&cq->lock, NULL);
+  pthread_cond_init(&cq->cond, NULL);
+  return cq;
+}
+
+int sm4_async_cq_fd(const SM4_ASYNC_CQ *cq) { return cq->efd; }
+
+void sm4_async_cq_destroy(SM4_ASYNC_CQ *cq) {
+  if (!cq) {
+    return;
+  }
+  while (__atomic_load_n(&cq->busy, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+  if (cq->efd >= 0) {
+    close(cq->efd);
+  }
+  pthread_mutex_destroy(&cq->lock);
+  pthread_cond_destroy(&cq->cond);
+  free(cq->q.cells);
+  free(cq);
+}
+
+size_t sm4_async_inflight(const SM4_ASYNC_CQ *cq) { return cq->inflight; }
+
+int sm4_async_submit(SM4_ASYNC *a, SM4_ASYNC_CQ *cq, SM4_ASYNC_JOB *job) {
+  if (cq->inflight >= cq->depth) {
+    errno = EAGAIN;
+    return -1;
+  }
+  job->cq = cq;
+  if (!queue_push(&a->sq, job)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  cq->inflight++;
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&a->sleepers, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&a->lock);
+    pthread_cond_signal(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+  }
+  return 0;
+}
+
+size_t sm4_async_poll(SM4_ASYNC_CQ *cq, SM4_ASYNC_JOB **done, size_t max) {
+  size_t n = 0;
+  while (n < max && (done[n] = queue_pop(&cq->q)) != NULL) {
+    n++;
+  }
+  cq->inflight -= n;
+  return n;
+}
+
+size_t sm4_async_wait(SM4_ASYNC_CQ *cq, SM4_ASYNC_JOB **done, size_t max) {
+  for (;;) {
+    size_t n = sm4_async_poll(cq, done, max);
+    if (n > 0 || cq->inflight == 0 || max == 0) {
+      return n;
+    }
+    if (cq->efd >= 0) {
+      // 工作线程先入队再写 eventfd，读到之后队列里一定有任务
+      uint64_t v;
+      ssize_t r = read(cq->efd, &v, sizeof(v));
+      (void)r;
+      continue;
+    }
+    pthread_mutex_lock(&cq->lock);
+    __atomic_store_n(&cq->waiting, 1, __ATOMIC_SEQ_CST);
+    if (!queue_ready(&cq->q)) {
+      pthread_cond_wait(&cq->cond, &cq->lock);
+    }
+    __atomic_store_n(&cq->waiting, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&cq->lock);
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef SM4_ASYNC_H
+#define SM4_ASYNC_H
+
+// 进程内异步任务接口：sm4_async_submit 把任务放进无锁的多生产者多消费者
+// 队列后立即返回，工作线程每次取走一批，把能合并的小任务合成一次多密钥
+// 调用（与 sm4d 的合批相同：GCM 走 sm4_offload_run，ECB/CTR 的块排成一列
+// 走 sm4_engine_encrypt_multikey），大任务单独执行。完成的任务放进提交时
+// 指定的完成队列，由提交方用 sm4_async_poll/sm4_async_wait 取回。
+//
+// 完成队列归一个线程所有（提交与取回都在该线程），不同线程各用各的完成
+// 队列，共用同一个 SM4_ASYNC。任务结构体由调用方分配，取回之前不能修改
+// 或释放，in/out/aad/key 指向的内存也要保持有效
+
+#include "../sm4.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  SM4_ASYNC_ECB_ENC = 1,
+  SM4_ASYNC_ECB_DEC,
+  SM4_ASYNC_CTR,      // iv 为初始计数器块，只在最后 4 字节内递增
+  SM4_ASYNC_GCM_SEAL, // iv 的前 12 字节为 GCM 的 IV
+  SM4_ASYNC_GCM_OPEN,
+} SM4_ASYNC_OP;
+
+// 任务状态，与 sm4_offload 相同
+#define SM4_ASYNC_OK 0
+#define SM4_ASYNC_BAD_TAG -1 // GCM 解密时标签不符，out 已清零
+#define SM4_ASYNC_INVALID -2 // 操作码、长度或密钥不合法
+
+typedef struct SM4_ASYNC_CQ SM4_ASYNC_CQ;
+
+typedef struct {
+  uint32_t op;            // SM4_ASYNC_OP
+  const SM4_Key *key;     // ECB/CTR：已扩展的轮密钥
+  const uint8_t *gcm_key; // GCM：16 字节原始密钥，合批时一起扩展
+  uint8_t iv[16];
+  const uint8_t *aad; // GCM
+  size_t aad_len;
+  const uint8_t *in;
+  uint8_t *out; // 可以等于 in；ECB 的长度须为 16 的倍数
+  size_t len;
+  uint8_t tag[16]; // GCM：seal 输出，open 输入
+  int status;      // 完成时写入
+  void *user;      // 调用方自定义，原样保留
+  SM4_ASYNC_CQ *cq; // 内部使用
+} SM4_ASYNC_JOB;
+
+typedef struct SM4_ASYNC SM4_ASYNC;
+
+// 创建 threads 个工作线程（0 表示在线 CPU 数），提交队列容量为
+// queue_depth（0 表示 1024，向上取 2 的幂）。失败返回 NULL
+SM4_ASYNC *sm4_async_create(unsigned threads, size_t queue_depth);
+
+// 执行完已提交的任务后停止并回收工作线程。调用前各完成队列应已取回全部任务
+void sm4_async_destroy(SM4_ASYNC *a);
+
+typedef struct {
+  uint64_t jobs;
+  uint64_t batches; // jobs / batches 为平均每批的任务数
+} SM4_ASYNC_STATS;
+
+void sm4_async_stats(SM4_ASYNC *a, SM4_ASYNC_STATS *st);
+
+// 完成队列通知方式
+#define SM4_ASYNC_CQ_EVENTFD 1 // 用 eventfd，可放进调用方的 epoll
+
+// 创建完成队列，最多 depth 个在途任务。失败返回 NULL
+SM4_ASYNC_CQ *sm4_async_cq_create(size_t depth, int flags);
+
+// 有任务完成时变为可读的 eventfd，未使用 SM4_ASYNC_CQ_EVENTFD 时为 -1。
+// 可读后读一次（清零），再反复 sm4_async_poll 直到返回 0
+int sm4_async_cq_fd(const SM4_ASYNC_CQ *cq);
+
+// 释放完成队列，调用前应已取回全部任务
+void sm4_async_cq_destroy(SM4_ASYNC_CQ *cq);
+
+// 提交一个任务并立即返回 0。完成队列的在途任务已满或提交队列已满时
+// 返回 -1，errno 为 EAGAIN，应先取回一些已完成的任务
+int sm4_async_submit(SM4_ASYNC *a, SM4_ASYNC_CQ *cq, SM4_ASYNC_JOB *job);
+
+// 取回至多 max 个已完成的任务，不阻塞，返回取回的个数
+size_t sm4_async_poll(SM4_ASYNC_CQ *cq, SM4_ASYNC_JOB **done, size_t max);
+
+// 同上，但没有已完成的任务时阻塞等待；没有在途任务时返回 0
+size_t sm4_async_wait(SM4_ASYNC_CQ *cq, SM4_ASYNC_JOB **done, size_t max);
+
+// 在途（已提交、未取回）的任务数
+size_t sm4_async_inflight(const SM4_ASYNC_CQ *cq);
+
+#endif // SM4_ASYNC_H
@@ -16,28 +16,29 @@ static void inc32(uint8_t counter[16]) {
   }
 }
 
+// GCTR：完整分组整批走 SIMD 计数器模式，最后不足一块的部分补齐后处理
 void gctr_encrypt(const uint8_t *in, uint8_t *out, size_t len,
                   uint8_t counter[16], const SM4_Key *key) {
-  uint8_t stream[16], tmp[16];
-  size_t i;
-
-  while (len > 0) {
-    sm4_encrypt(counter, key, stream);
-    size_t block = len < 16 ? len : 16;
-    for (i = 0; i < block; i++) {
-      out[i] = in[i] ^ stream[i];
-    }
-    out += block;
-    in += block;
-    len -= block;
-    inc32(counter);
+  SM4_TRACE_BEGIN(SM4_TRACE_GCTR, len, (len + 15) / 16);
+  size_t nblocks = len / 16;
+  size_t rem = len % 16;
+
+  sm4_ctr32_blocks_cached(in, out, nblocks, counter, key);
+
+  if (rem > 0) {
+    uint8_t block[16] = {0};
+    memcpy(block, in + 16 * nblocks, rem);
+    sm4_ctr32_blocks_cached(block, block, 1, counter, key);
+    memcpy(out + 16 * nblocks, block, rem);
   }
+  SM4_TRACE_END();
 }
 
 void gcm_sm4_init(GCM_SM4_CTX *ctx, const uint8_t *key, const uint8_t *iv,
                   size_t iv_len, const GHASH_METHOD *ghash_impl) {
 
   static const uint8_t ZERO[16] = {0};
+  SM4_TRACE_BEGIN(SM4_TRACE_GCM_INIT, iv_len, 0);
 
   ctx->ghash = ghash_impl;
 
@@ -52,10 +53,8 @@ void gcm_sm4_init(GCM_SM4_CTX *ctx, const uint8_t *key, const uint8_t *iv,
     ctx->counter0[14] = 0;
     ctx->counter0[15] = 1;
   } else {
+    // update 内部已把不足一块的尾部补零
     ctx->ghash->update(&ctx->ghash_ctx, iv, iv_len);
-    size_t pad = (16 - (iv_len % 16)) % 16;
-    uint8_t zero_pad[16] = {0};
-    ctx->ghash->update(&ctx->ghash_ctx, zero_pad, pad);
 
     uint8_t len_block[16];
     store64_be(len_block, 0);
@@ -65,40 +64,51 @@ void gcm_sm4_init(GCM_SM4_CTX *ctx, const uint8_t *key, const uint8_t *iv,
     ctx->ghash->reset(&ctx->ghash_ctx);
   }
 
+  // 数据从 inc32(J0) 开始加密，J0 留给标签
   memcpy(ctx->counter, ctx->counter0, 16);
+  inc32(ctx->counter);
   ctx->aad_len = 0;
   ctx->ct_len = 0;
+  SM4_TRACE_END();
 }
 
 void gcm_sm4_aad(GCM_SM4_CTX *ctx, const uint8_t *aad, size_t aad_len) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GCM_AAD, aad_len, (aad_len + 15) / 16);
   ctx->ghash->update(&ctx->ghash_ctx, aad, aad_len);
-  size_t pad = (16 - (aad_len % 16)) % 16;
-  uint8_t zero_pad[16] = {0};
-  ctx->ghash->update(&ctx->ghash_ctx, zero_pad, pad);
   ctx->aad_len = aad_len;
+  SM4_TRACE_END();
 }
 
 void gcm_sm4_encrypt(GCM_SM4_CTX *ctx, const uint8_t *plaintext, size_t len,
                      uint8_t *ciphertext) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GCM_ENCRYPT, len, (len + 15) / 16);
   gctr_encrypt(plaintext, ciphertext, len, ctx->counter, &ctx->sm4_key);
   ctx->ghash->update(&ctx->ghash_ctx, ciphertext, len);
-  size_t pad = (16 - (len % 16)) % 16;
-  uint8_t zero_pad[16] = {0};
-  ctx->ghash->update(&ctx->ghash_ctx, zero_pad, pad);
   ctx->ct_len = len;
+  SM4_TRACE_END();
 }
 
 void gcm_sm4_decrypt(GCM_SM4_CTX *ctx, const uint8_t *ciphertext, size_t len,
                      uint8_t *plaintext) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GCM_DECRYPT, len, (len + 15) / 16);
   ctx->ghash->update(&ctx->ghash_ctx, ciphertext, len);
-  size_t pad = (16 - (len % 16)) % 16;
-  uint8_t zero_pad[16] = {0};
-  ctx->ghash->update(&ctx->ghash_ctx, zero_pad, pad);
   ctx->ct_len = len;
   gctr_encrypt(ciphertext, plaintext, len, ctx->counter, &ctx->sm4_key);
+  SM4_TRACE_END();
+}
+
+void gcm_sm4_decrypt_range(const GCM_SM4_CTX *ctx, uint64_t offset,
+                           const uint8_t *ciphertext, size_t len,
+                           uint8_t *plaintext) {
+  // 第 0 块数据使用 inc32(J0)
+  uint8_t base[16];
+  memcpy(base, ctx->counter0, 16);
+  inc32(base);
+  sm4_ctr_range(&ctx->sm4_key, base, 32, offset, ciphertext, plaintext, len);
 }
 
 void gcm_sm4_tag(GCM_SM4_CTX *ctx, uint8_t tag[16]) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GCM_TAG, 16, 1);
   uint8_t len_block[16];
   store64_be(len_block, ctx->aad_len * 8);
   store64_be(len_block + 8, ctx->ct_len * 8);
@@ -111,6 +121,7 @@ void gcm_sm4_tag(GCM_SM4_CTX *ctx, uint8_t tag[16]) {
   for (int i = 0; i < 16; i++) {
     tag[i] ^= S[i];
   }
+  SM4_TRACE_END();
 }
 
 int sm4_gcm_decrypt(const uint8_t *key, const uint8_t *iv, size_t iv_len,
@@ -143,4 +154,69 @@ int sm4_gcm_decrypt(const uint8_t *key, const uint8_t *iv, size_t iv_len,
   }
 
   return 0; // 解密和认证成功
-}
\ No newline at end of file
+}
+static void gcm_sm4_pool_set_h(GCM_SM4_POOL_CTX *ctx) {
+  static const uint8_t ZERO[16] = {0};
+  uint8_t H[16];
+  sm4_encrypt(ZERO, &ctx->pool->key, H);
+  ctx->ghash->init(&ctx->ghash_ctx, H);
+}
+
+void gcm_sm4_pool_init(GCM_SM4_POOL_CTX *ctx, SM4_KSPOOL *pool,
+                       const GHASH_METHOD *ghash_impl) {
+  ctx->pool = pool;
+  ctx->ghash = ghash_impl;
+  gcm_sm4_pool_set_h(ctx);
+}
+
+void gcm_sm4_pool_rekey(GCM_SM4_POOL_CTX *ctx, const uint8_t key[16],
+                        const uint8_t iv[12]) {
+  sm4_kspool_rekey(ctx->pool, key, iv);
+  gcm_sm4_pool_set_h(ctx);
+}
+
+// S = GHASH(aad || ct || len)，标签为 E_K(J0) ^ S
+static void gcm_sm4_pool_ghash(GCM_SM4_POOL_CTX *ctx, const uint8_t *aad,
+                               size_t aad_len, const uint8_t *ciphertext,
+                               size_t len, uint8_t S[16]) {
+  uint8_t len_block[16];
+  ctx->ghash->reset(&ctx->ghash_ctx);
+  if (aad_len > 0) {
+    ctx->ghash->update(&ctx->ghash_ctx, aad, aad_len);
+  }
+  ctx->ghash->update(&ctx->ghash_ctx, ciphertext, len);
+  store64_be(len_block, (uint64_t)aad_len * 8);
+  store64_be(len_block + 8, (uint64_t)len * 8);
+  ctx->ghash->update(&ctx->ghash_ctx, len_block, 16);
+  ctx->ghash->final(&ctx->ghash_ctx, S);
+}
+
+void gcm_sm4_pool_seal(GCM_SM4_POOL_CTX *ctx, uint64_t seq,
+                       const uint8_t *aad, size_t aad_len,
+                       const uint8_t *plaintext, size_t len,
+                       uint8_t *ciphertext, uint8_t tag[16]) {
+  uint8_t ek0[16];
+  sm4_kspool_xor(ctx->pool, seq, ek0, plaintext, ciphertext, len);
+  gcm_sm4_pool_ghash(ctx, aad, aad_len, ciphertext, len, tag);
+  for (int i = 0; i < 16; i++) {
+    tag[i] ^= ek0[i];
+  }
+}
+
+int gcm_sm4_pool_open(GCM_SM4_POOL_CTX *ctx, uint64_t seq, const uint8_t *aad,
+                      size_t aad_len, const uint8_t *ciphertext, size_t len,
+                      const uint8_t tag[16], uint8_t *plaintext) {
+  uint8_t ek0[16], S[16];
+  uint8_t diff = 0;
+  // 先对密文做 GHASH 再解密，明文可以与密文共用缓冲区
+  gcm_sm4_pool_ghash(ctx, aad, aad_len, ciphertext, len, S);
+  sm4_kspool_xor(ctx->pool, seq, ek0, ciphertext, plaintext, len);
+  for (int i = 0; i < 16; i++) {
+    diff |= (uint8_t)(S[i] ^ ek0[i] ^ tag[i]);
+  }
+  if (diff != 0) {
+    memset(plaintext, 0, len);
+    return -1;
+  }
+  return 0;
+}
@@ -7,6 +7,9 @@
 #include <string.h>
 
 #include "../sm4.h"
+#include "../sm4_ctr.h"
+#include "../sm4_kspool.h"
+#include "../sm4_trace.h"
 #include "ghash.h"
 #include "ghash_table.h"
 
@@ -47,9 +50,43 @@ void gcm_sm4_encrypt(GCM_SM4_CTX *ctx, const uint8_t *plaintext, size_t len,
 void gcm_sm4_decrypt(GCM_SM4_CTX *ctx, const uint8_t *ciphertext, size_t len,
                      uint8_t *plaintext);
 
+// 区间解密：解密密文中 [offset, offset + len) 这一段，ciphertext/plaintext
+// 只包含该区间。不更新 GHASH、不校验标签，调用方需事先对整个对象验证过标签
+void gcm_sm4_decrypt_range(const GCM_SM4_CTX *ctx, uint64_t offset,
+                           const uint8_t *ciphertext, size_t len,
+                           uint8_t *plaintext);
+
 // 生成 GMAC 标签
 void gcm_sm4_tag(GCM_SM4_CTX *ctx, uint8_t tag[16]);
 
+// 使用密钥流预生成池的 GCM（RPC 小消息）：H 与 GHASH 表在建立时计算一次，
+// 每条消息的 GCTR 在命中时只是异或。第 seq 条消息的 nonce 由
+// sm4_kspool_nonce 给出，收发双方用相同的密钥、静态 IV 和序号
+typedef struct {
+  SM4_KSPOOL *pool;
+  const GHASH_METHOD *ghash;
+  GHASH_CTX ghash_ctx; // 已用 H 初始化，每条消息只重置累加器
+} GCM_SM4_POOL_CTX;
+
+// 绑定已创建的池
+void gcm_sm4_pool_init(GCM_SM4_POOL_CTX *ctx, SM4_KSPOOL *pool,
+                       const GHASH_METHOD *ghash_impl);
+
+// 更换密钥：刷新池中预生成的密钥流并重新计算 H
+void gcm_sm4_pool_rekey(GCM_SM4_POOL_CTX *ctx, const uint8_t key[16],
+                        const uint8_t iv[12]);
+
+// 加密第 seq 条消息并输出标签
+void gcm_sm4_pool_seal(GCM_SM4_POOL_CTX *ctx, uint64_t seq,
+                       const uint8_t *aad, size_t aad_len,
+                       const uint8_t *plaintext, size_t len,
+                       uint8_t *ciphertext, uint8_t tag[16]);
+
+// 解密第 seq 条消息，标签不符时清零明文并返回 -1
+int gcm_sm4_pool_open(GCM_SM4_POOL_CTX *ctx, uint64_t seq, const uint8_t *aad,
+                      size_t aad_len, const uint8_t *ciphertext, size_t len,
+                      const uint8_t tag[16], uint8_t *plaintext);
+
 // GCM 解密实现
 int sm4_gcm_decrypt(const uint8_t *key, const uint8_t *iv, size_t iv_len,
                     const uint8_t *aad, size_t aad_len,
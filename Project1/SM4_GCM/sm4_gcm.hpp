@@ -0,0 +1,304 @@
+#ifndef SM4_GCM_HPP
+#define SM4_GCM_HPP
+
+// SM4-GCM 的 C++ 头文件前端：分组密码（sm4::cipher<Backend>）与 GHASH 实现
+// 都是模板参数，GCTR 与 GHASH 在调用处内联，不经过 GHASH_METHOD 的函数指针。
+// 结果与 sm4_gcm.c 相同（RFC 8998）。ghash_clmul 需要 -mpclmul -mssse3
+
+#include "../sm4.hpp"
+
+#if defined(__PCLMUL__) && defined(__SSSE3__)
+#include <wmmintrin.h>
+#endif
+
+namespace sm4 {
+
+namespace detail {
+
+inline uint64_t load_be64(const uint8_t *p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return __builtin_bswap64(v);
+}
+
+inline void store_be64(uint8_t *p, uint64_t v) {
+  v = __builtin_bswap64(v);
+  std::memcpy(p, &v, 8);
+}
+
+// 右移 8 位时移出的字节 b 对应的约化值（同 ghash_table.c 的 ReduceTable）
+constexpr std::array<uint16_t, 256> make_reduce() {
+  std::array<uint16_t, 256> t{};
+  for (int b = 0; b < 256; b++) {
+    for (int j = 0; j < 8; j++) {
+      if (b >> j & 1) {
+        t[b] ^= (uint16_t)(0xE100 >> (7 - j));
+      }
+    }
+  }
+  return t;
+}
+
+inline constexpr auto REDUCE = make_reduce();
+static_assert(REDUCE[1] == 0x01c2 && REDUCE[255] == 0xbebe);
+
+} // namespace detail
+
+// GHASH 约定：由 H 构造（只读，可多线程共用），update(y, data, nblocks)
+// 对 nblocks 个完整分组计算 y = (y ^ X_i) * H
+
+// 逐位乘法，对应 ghash.c，只作参考
+class ghash_bitwise {
+public:
+  static constexpr const char *name = "bitwise";
+
+  static bool available() noexcept { return true; }
+
+  explicit ghash_bitwise(std::span<const uint8_t, 16> h) noexcept
+      : hh_(detail::load_be64(h.data())),
+        hl_(detail::load_be64(h.data() + 8)) {}
+
+  void update(uint8_t y[16], const uint8_t *data,
+              size_t nblocks) const noexcept {
+    uint64_t yh = detail::load_be64(y), yl = detail::load_be64(y + 8);
+    for (; nblocks > 0; nblocks--, data += 16) {
+      uint64_t xh = yh ^ detail::load_be64(data);
+      uint64_t xl = yl ^ detail::load_be64(data + 8);
+      uint64_t vh = hh_, vl = hl_;
+      yh = yl = 0;
+      for (int i = 0; i < 128; i++) {
+        uint64_t bit = i < 64 ? xh >> (63 - i) : xl >> (127 - i);
+        uint64_t m = 0 - (bit & 1);
+        yh ^= vh & m;
+        yl ^= vl & m;
+        uint64_t r = 0 - (vl & 1);
+        vl = (vl >> 1) | (vh << 63);
+        vh = (vh >> 1) ^ (0xE100000000000000ULL & r);
+      }
+    }
+    detail::store_be64(y, yh);
+    detail::store_be64(y + 8, yl);
+  }
+
+private:
+  uint64_t hh_, hl_;
+};
+
+// 8 位查表（Shoup），对应 ghash_table.c：table_[b] = b * H，4 KB
+class ghash_table {
+public:
+  static constexpr const char *name = "table";
+
+  static bool available() noexcept { return true; }
+
+  explicit ghash_table(std::span<const uint8_t, 16> h) noexcept {
+    // 下标按比特序：0x80 对应 H，右移一位即乘 x
+    table_[0] = {0, 0};
+    table_[0x80] = {detail::load_be64(h.data()),
+                    detail::load_be64(h.data() + 8)};
+    for (int i = 0x40; i > 0; i >>= 1) {
+      const auto &m = table_[i << 1];
+      table_[i] = {(m[0] >> 1) ^ (m[1] & 1 ? 0xE100000000000000ULL : 0),
+                   (m[0] << 63) | (m[1] >> 1)};
+    }
+    for (int i = 2; i < 256; i <<= 1) {
+      for (int j = 1; j < i; j++) {
+        table_[i + j] = {table_[i][0] ^ table_[j][0],
+                         table_[i][1] ^ table_[j][1]};
+      }
+    }
+  }
+
+  void update(uint8_t y[16], const uint8_t *data,
+              size_t nblocks) const noexcept {
+    uint8_t x[16];
+    std::memcpy(x, y, 16);
+    for (; nblocks > 0; nblocks--, data += 16) {
+      for (int i = 0; i < 16; i++) {
+        x[i] ^= data[i];
+      }
+      uint64_t rh = table_[x[15]][0], rl = table_[x[15]][1];
+      for (int i = 14; i >= 0; i--) {
+        uint8_t rem = rl & 0xFF;
+        rl = (rh << 56) | (rl >> 8);
+        rh = (rh >> 8) ^ ((uint64_t)detail::REDUCE[rem] << 48);
+        rh ^= table_[x[i]][0];
+        rl ^= table_[x[i]][1];
+      }
+      detail::store_be64(x, rh);
+      detail::store_be64(x + 8, rl);
+    }
+    std::memcpy(y, x, 16);
+  }
+
+private:
+  std::array<std::array<uint64_t, 2>, 256> table_;
+};
+
+#if defined(__PCLMUL__) && defined(__SSSE3__)
+// PCLMULQDQ 无进位乘法：字节反转后按整数乘，结果左移一位再约化
+class ghash_clmul {
+public:
+  static constexpr const char *name = "clmul";
+
+  static bool available() noexcept {
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+  }
+
+  explicit ghash_clmul(std::span<const uint8_t, 16> h) noexcept
+      : h_(load(h.data())) {}
+
+  void update(uint8_t y[16], const uint8_t *data,
+              size_t nblocks) const noexcept {
+    __m128i acc = load(y);
+    for (; nblocks > 0; nblocks--, data += 16) {
+      acc = mul(_mm_xor_si128(acc, load(data)), h_);
+    }
+    _mm_storeu_si128((__m128i *)y, _mm_shuffle_epi8(acc, rev()));
+  }
+
+private:
+  static __m128i rev() {
+    return _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  }
+
+  static __m128i load(const uint8_t *p) {
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), rev());
+  }
+
+  static __m128i mul(__m128i a, __m128i b) {
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                                _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    // 比特序反转的乘积整体左移一位
+    __m128i lo_c = _mm_srli_epi32(lo, 31), hi_c = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    hi = _mm_or_si128(hi, _mm_srli_si128(lo_c, 12));
+    hi = _mm_or_si128(hi, _mm_slli_si128(hi_c, 4));
+    lo = _mm_or_si128(lo, _mm_slli_si128(lo_c, 4));
+
+    // 模 x^128 + x^7 + x^2 + x + 1 约化
+    __m128i t = _mm_xor_si128(
+        _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+        _mm_slli_epi32(lo, 25));
+    __m128i carry = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+    __m128i u = _mm_xor_si128(
+        _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+        _mm_srli_epi32(lo, 7));
+    u = _mm_xor_si128(u, carry);
+    return _mm_xor_si128(hi, _mm_xor_si128(lo, u));
+  }
+
+  __m128i h_;
+};
+#endif
+
+// SM4-GCM：Cipher 为 sm4::cipher<Backend>，Ghash 为上面的某个 GHASH 实现。
+// 对象只保存轮密钥与 H 的预计算结果，seal / open 不修改对象，可多线程共用
+template <class Cipher, class Ghash> class gcm {
+public:
+  explicit gcm(std::span<const uint8_t, 16> key) noexcept
+      : cipher_(key), ghash_(hash_key(cipher_)) {}
+
+  // 加密 pt 写入 ct（长度相同，可以原地）并输出 16 字节标签
+  void seal(std::span<const uint8_t> iv, std::span<const uint8_t> aad,
+            std::span<const uint8_t> pt, std::span<uint8_t> ct,
+            std::span<uint8_t, 16> tag) const noexcept {
+    uint8_t j0[16], ctr[16];
+    derive_j0(iv, j0);
+    next_counter(j0, ctr);
+    cipher_.ctr32(pt, ct.first(pt.size()), ctr);
+    compute_tag(j0, aad, ct.first(pt.size()), tag.data());
+  }
+
+  // 先校验标签再解密（可以原地）；标签不符时 pt 清零并返回 false
+  bool open(std::span<const uint8_t> iv, std::span<const uint8_t> aad,
+            std::span<const uint8_t> ct, std::span<const uint8_t, 16> tag,
+            std::span<uint8_t> pt) const noexcept {
+    uint8_t j0[16], ctr[16], expect[16];
+    uint8_t diff = 0;
+    derive_j0(iv, j0);
+    compute_tag(j0, aad, ct, expect);
+    for (int i = 0; i < 16; i++) {
+      diff |= expect[i] ^ tag[i];
+    }
+    if (diff != 0) {
+      std::memset(pt.data(), 0, ct.size());
+      return false;
+    }
+    next_counter(j0, ctr);
+    cipher_.ctr32(ct, pt.first(ct.size()), ctr);
+    return true;
+  }
+
+  const Cipher &block_cipher() const noexcept { return cipher_; }
+
+private:
+  static std::array<uint8_t, 16> hash_key(const Cipher &c) noexcept {
+    std::array<uint8_t, 16> zero{}, h;
+    c.encrypt_block(zero, h);
+    return h;
+  }
+
+  // 完整分组直接处理，最后不足一块的部分补零
+  void absorb(uint8_t y[16], std::span<const uint8_t> data) const noexcept {
+    size_t full = data.size() / 16, rem = data.size() % 16;
+    ghash_.update(y, data.data(), full);
+    if (rem > 0) {
+      uint8_t block[16] = {0};
+      std::memcpy(block, data.data() + 16 * full, rem);
+      ghash_.update(y, block, 1);
+    }
+  }
+
+  void absorb_lengths(uint8_t y[16], uint64_t a, uint64_t c) const noexcept {
+    uint8_t len_block[16];
+    detail::store_be64(len_block, a * 8);
+    detail::store_be64(len_block + 8, c * 8);
+    ghash_.update(y, len_block, 1);
+  }
+
+  // 12 字节 IV 时 J0 = IV || 1，否则 J0 = GHASH(IV || 补零 || len(IV))
+  void derive_j0(std::span<const uint8_t> iv, uint8_t j0[16]) const noexcept {
+    if (iv.size() == 12) {
+      std::memcpy(j0, iv.data(), 12);
+      detail::store_be32(j0 + 12, 1);
+      return;
+    }
+    std::memset(j0, 0, 16);
+    absorb(j0, iv);
+    absorb_lengths(j0, 0, iv.size());
+  }
+
+  static void next_counter(const uint8_t j0[16], uint8_t ctr[16]) noexcept {
+    std::memcpy(ctr, j0, 12);
+    detail::store_be32(ctr + 12, detail::load_be32(j0 + 12) + 1);
+  }
+
+  void compute_tag(const uint8_t j0[16], std::span<const uint8_t> aad,
+                   std::span<const uint8_t> ct,
+                   uint8_t tag[16]) const noexcept {
+    uint8_t s[16] = {0}, ek0[16];
+    absorb(s, aad);
+    absorb(s, ct);
+    absorb_lengths(s, aad.size(), ct.size());
+    cipher_.encrypt_block(std::span<const uint8_t, 16>(j0, 16),
+                          std::span<uint8_t, 16>(ek0, 16));
+    for (int i = 0; i < 16; i++) {
+      tag[i] = s[i] ^ ek0[i];
+    }
+  }
+
+  Cipher cipher_;
+  Ghash ghash_;
+};
+
+} // namespace sm4
+
+#endif
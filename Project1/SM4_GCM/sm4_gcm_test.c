@@ -3,7 +3,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../sm4_engine.h"
+#include "sm4_async.h"
 #include "sm4_gcm.h"
+#include "sm4_offload.h"
 
 extern const GHASH_METHOD GHASH_COMMAN = {.init = ghash_init,
                                           .update = ghash_update,
@@ -80,15 +87,445 @@ void test(const GHASH_METHOD *ghash_impl) {
   }
 }
 
+// RFC 8998 附录 A.1 的 SM4-GCM 测试向量
+void test_rfc8998(const GHASH_METHOD *ghash_impl) {
+  static const uint8_t key[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB,
+                                  0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98,
+                                  0x76, 0x54, 0x32, 0x10};
+  static const uint8_t iv[12] = {0x00, 0x00, 0x12, 0x34, 0x56, 0x78,
+                                 0x00, 0x00, 0x00, 0x00, 0xAB, 0xCD};
+  static const uint8_t aad[20] = {0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE,
+                                  0xEF, 0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD,
+                                  0xBE, 0xEF, 0xAB, 0xAD, 0xDA, 0xD2};
+  static const uint8_t expected_ct[64] = {
+      0x17, 0xF3, 0x99, 0xF0, 0x8C, 0x67, 0xD5, 0xEE, 0x19, 0xD0, 0xDC,
+      0x99, 0x69, 0xC4, 0xBB, 0x7D, 0x5F, 0xD4, 0x6F, 0xD3, 0x75, 0x64,
+      0x89, 0x06, 0x91, 0x57, 0xB2, 0x82, 0xBB, 0x20, 0x07, 0x35, 0xD8,
+      0x27, 0x10, 0xCA, 0x5C, 0x22, 0xF0, 0xCC, 0xFA, 0x7C, 0xBF, 0x93,
+      0xD4, 0x96, 0xAC, 0x15, 0xA5, 0x68, 0x34, 0xCB, 0xCF, 0x98, 0xC3,
+      0x97, 0xB4, 0x02, 0x4A, 0x26, 0x91, 0x23, 0x3B, 0x8D};
+  static const uint8_t expected_tag[16] = {0x83, 0xDE, 0x35, 0x41, 0xE4, 0xC2,
+                                           0xB5, 0x81, 0x77, 0xE0, 0x65, 0xA9,
+                                           0xBF, 0x7B, 0x62, 0xEC};
+  static const uint8_t rows[8] = {0xAA, 0xBB, 0xCC, 0xDD,
+                                  0xEE, 0xFF, 0xEE, 0xAA};
+  uint8_t plaintext[64], ciphertext[64], tag[16];
+
+  for (int i = 0; i < 64; i++) {
+    plaintext[i] = rows[i / 8];
+  }
+
+  GCM_SM4_CTX ctx;
+  gcm_sm4_init(&ctx, key, iv, sizeof(iv), ghash_impl);
+  gcm_sm4_aad(&ctx, aad, sizeof(aad));
+  gcm_sm4_encrypt(&ctx, plaintext, sizeof(plaintext), ciphertext);
+  gcm_sm4_tag(&ctx, tag);
+
+  if (memcmp(ciphertext, expected_ct, 64) == 0 &&
+      memcmp(tag, expected_tag, 16) == 0) {
+    printf("[✓] RFC 8998 test vector matches.\n");
+  } else {
+    printf("[✗] RFC 8998 test vector does NOT match!\n");
+  }
+
+  // 区间解密：起点不对齐，跨越多个分组
+  uint8_t part[64];
+  gcm_sm4_decrypt_range(&ctx, 5, expected_ct + 5, 41, part);
+  if (memcmp(part, plaintext + 5, 41) == 0) {
+    printf("[✓] Range decryption matches plaintext.\n");
+  } else {
+    printf("[✗] Range decryption does NOT match plaintext!\n");
+  }
+}
+
+// 密钥流池：结果与逐条 gcm_sm4_* 相同，收方用后台线程填充的池解密
+void test_pool(const GHASH_METHOD *ghash_impl) {
+  static const uint8_t key[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB,
+                                  0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98,
+                                  0x76, 0x54, 0x32, 0x10};
+  static const uint8_t iv[12] = {0x00, 0x00, 0x12, 0x34, 0x56, 0x78,
+                                 0x00, 0x00, 0x00, 0x00, 0xAB, 0xCD};
+  static const uint8_t aad[13] = "rpc-header-01";
+  enum { MSGS = 12, MAX_LEN = 512 };
+  static uint8_t pt[MSGS][MAX_LEN + 64], ct[MSGS][MAX_LEN + 64];
+  uint8_t tags[MSGS][16], ref_ct[MAX_LEN + 64], ref_tag[16], nonce[12];
+  size_t lens[MSGS];
+
+  SM4_KSPOOL tx, rx;
+  GCM_SM4_POOL_CTX seal, open;
+  sm4_kspool_init(&tx, key, iv, MAX_LEN, 8, 0);
+  sm4_kspool_init(&rx, key, iv, MAX_LEN, 8, 1);
+  gcm_sm4_pool_init(&seal, &tx, ghash_impl);
+  gcm_sm4_pool_init(&open, &rx, ghash_impl);
+  sm4_kspool_fill(&tx, 8);
+
+  // 长度覆盖 0、不足一块、整块和超过 max_len（未命中）的情况
+  int same = 1;
+  for (int m = 0; m < MSGS; m++) {
+    lens[m] = m == 5 ? MAX_LEN + 50 : (size_t)(m * 47) % (MAX_LEN + 1);
+    for (size_t i = 0; i < lens[m]; i++) {
+      pt[m][i] = (uint8_t)(i * 7 + m);
+    }
+    gcm_sm4_pool_seal(&seal, m, aad, sizeof(aad), pt[m], lens[m], ct[m],
+                      tags[m]);
+
+    GCM_SM4_CTX ctx;
+    sm4_kspool_nonce(&tx, m, nonce);
+    gcm_sm4_init(&ctx, key, nonce, 12, ghash_impl);
+    gcm_sm4_aad(&ctx, aad, sizeof(aad));
+    gcm_sm4_encrypt(&ctx, pt[m], lens[m], ref_ct);
+    gcm_sm4_tag(&ctx, ref_tag);
+    same &= memcmp(ct[m], ref_ct, lens[m]) == 0;
+    same &= memcmp(tags[m], ref_tag, 16) == 0;
+  }
+  SM4_KSPOOL_STATS st;
+  sm4_kspool_stats(&tx, &st);
+  if (same && st.hits == 7 && st.misses == 5) {
+    printf("[✓] Keystream pool seal matches GCM (hits %llu, misses %llu).\n",
+           (unsigned long long)st.hits, (unsigned long long)st.misses);
+  } else {
+    printf("[✗] Keystream pool seal does NOT match GCM!\n");
+  }
+
+  // 收方：原地解密，最后一条篡改标签
+  int ok = 1;
+  tags[MSGS - 1][0] ^= 1;
+  for (int m = 0; m < MSGS; m++) {
+    int ret = gcm_sm4_pool_open(&open, m, aad, sizeof(aad), ct[m], lens[m],
+                                tags[m], ct[m]);
+    if (m == MSGS - 1) {
+      ok &= ret == -1;
+    } else {
+      ok &= ret == 0 && memcmp(ct[m], pt[m], lens[m]) == 0;
+    }
+  }
+  // 更换密钥后预生成的密钥流被丢弃，新密钥下仍与逐条计算一致
+  static const uint8_t key2[16] = {0x10};
+  gcm_sm4_pool_rekey(&seal, key2, iv);
+  sm4_kspool_fill(&tx, 8);
+  gcm_sm4_pool_seal(&seal, 0, NULL, 0, pt[1], lens[1], ct[1], tags[1]);
+  GCM_SM4_CTX ctx;
+  sm4_kspool_nonce(&tx, 0, nonce);
+  gcm_sm4_init(&ctx, key2, nonce, 12, ghash_impl);
+  gcm_sm4_encrypt(&ctx, pt[1], lens[1], ref_ct);
+  gcm_sm4_tag(&ctx, ref_tag);
+  ok &= memcmp(ct[1], ref_ct, lens[1]) == 0;
+  ok &= memcmp(tags[1], ref_tag, 16) == 0;
+  if (ok) {
+    printf("[✓] Keystream pool open/rekey works.\n");
+  } else {
+    printf("[✗] Keystream pool open/rekey FAILED!\n");
+  }
+  sm4_kspool_free(&tx);
+  sm4_kspool_free(&rx);
+}
+
+// 插桩：一条消息在各 gcm_sm4_* 插桩点各计一次，GHASH 只计入所用的实现
+void test_trace(const GHASH_METHOD *ghash_impl) {
+  if (!sm4_trace_compiled()) {
+    return;
+  }
+  static const uint8_t key[16] = {0x01, 0x23, 0x45, 0x67};
+  static const uint8_t iv[12] = {0};
+  static const uint8_t aad[13] = "rpc-header-01";
+  static SM4_TRACE_STATS before[SM4_TRACE_SITES], after[SM4_TRACE_SITES];
+  uint8_t pt[100] = {0}, ct[100], tag[16];
+
+  sm4_trace_snapshot(before);
+  GCM_SM4_CTX ctx;
+  gcm_sm4_init(&ctx, key, iv, 12, ghash_impl);
+  gcm_sm4_aad(&ctx, aad, sizeof(aad));
+  gcm_sm4_encrypt(&ctx, pt, sizeof(pt), ct);
+  gcm_sm4_tag(&ctx, tag);
+  sm4_trace_snapshot(after);
+
+#define DELTA(site, field) (after[site].field - before[site].field)
+  SM4_TRACE_SITE used = ghash_impl->update == ghash_update
+                            ? SM4_TRACE_GHASH
+                            : SM4_TRACE_GHASH_TABLE;
+  SM4_TRACE_SITE other = used == SM4_TRACE_GHASH ? SM4_TRACE_GHASH_TABLE
+                                                 : SM4_TRACE_GHASH;
+  int ok = DELTA(SM4_TRACE_GCM_INIT, calls) == 1 &&
+           DELTA(SM4_TRACE_GCM_AAD, bytes) == sizeof(aad) &&
+           DELTA(SM4_TRACE_GCM_ENCRYPT, bytes) == sizeof(pt) &&
+           DELTA(SM4_TRACE_GCM_ENCRYPT, blocks) == 7 &&
+           DELTA(SM4_TRACE_GCM_TAG, calls) == 1 &&
+           DELTA(SM4_TRACE_GCTR, bytes) >= sizeof(pt) &&
+           DELTA(used, calls) > 0 && DELTA(other, calls) == 0;
+#undef DELTA
+  if (ok) {
+    printf("[✓] Trace counters match the GCM call sequence.\n");
+  } else {
+    printf("[✗] Trace counters do NOT match the GCM call sequence!\n");
+  }
+}
+
+// 卸载守护进程的批处理：一批里混合不同密钥、长度的 seal 与 open，
+// 结果与逐条调用 gcm_sm4_* 相同，篡改的标签与非法长度被拒绝
+void test_offload(void) {
+  enum { N = 40 };
+  static SM4_OFFLOAD_SLOT slots[N];
+  static uint8_t ref_ct[N][SM4_OFFLOAD_MAX_DATA];
+  uint8_t ref_tag[N][16];
+  SM4_OFFLOAD_SLOT *reqs[N];
+  SM4_OFFLOAD_WORK *w = sm4_offload_work_new();
+
+  for (int i = 0; i < N; i++) {
+    SM4_OFFLOAD_SLOT *s = &slots[i];
+    reqs[i] = s;
+    s->op = SM4_OFFLOAD_SEAL;
+    s->aad_len = (uint32_t)(i * 7 % 40);
+    s->len = (uint32_t)(i == N - 1 ? 4000 : i * 53 % 300);
+    for (int j = 0; j < 16; j++) {
+      s->key[j] = (uint8_t)(i * 31 + j);
+    }
+    for (int j = 0; j < 12; j++) {
+      s->iv[j] = (uint8_t)(i + j * 9);
+    }
+    for (uint32_t j = 0; j < s->aad_len + s->len; j++) {
+      s->data[j] = (uint8_t)(j * 13 + i);
+    }
+    GCM_SM4_CTX ctx;
+    gcm_sm4_init(&ctx, s->key, s->iv, 12, &GHASH_TABLE);
+    gcm_sm4_aad(&ctx, s->data, s->aad_len);
+    gcm_sm4_encrypt(&ctx, s->data + s->aad_len, s->len, ref_ct[i]);
+    gcm_sm4_tag(&ctx, ref_tag[i]);
+  }
+  slots[5].len = SM4_OFFLOAD_MAX_DATA; // 加上 AAD 超过上限
+  sm4_offload_process(w, reqs, N);
+  int seal_ok = slots[5].status == SM4_OFFLOAD_INVALID;
+  for (int i = 0; i < N; i++) {
+    if (i != 5) {
+      seal_ok &= slots[i].status == SM4_OFFLOAD_OK &&
+                 memcmp(slots[i].data + slots[i].aad_len, ref_ct[i],
+                        slots[i].len) == 0 &&
+                 memcmp(slots[i].tag, ref_tag[i], 16) == 0;
+    }
+  }
+
+  // 把密文原地解回，第 3 条篡改标签
+  slots[5].len = 0;
+  for (int i = 0; i < N; i++) {
+    slots[i].op = SM4_OFFLOAD_OPEN;
+  }
+  slots[3].tag[0] ^= 1;
+  sm4_offload_process(w, reqs, N);
+  int open_ok = slots[3].status == SM4_OFFLOAD_BAD_TAG;
+  for (uint32_t j = 0; j < slots[3].len; j++) {
+    open_ok &= slots[3].data[slots[3].aad_len + j] == 0;
+  }
+  for (int i = 0; i < N; i++) {
+    if (i == 3 || i == 5) {
+      continue;
+    }
+    open_ok &= slots[i].status == SM4_OFFLOAD_OK;
+    for (uint32_t j = 0; j < slots[i].aad_len + slots[i].len; j++) {
+      open_ok &= slots[i].data[j] == (uint8_t)(j * 13 + i);
+    }
+  }
+  sm4_offload_work_free(w);
+
+  if (seal_ok && open_ok) {
+    printf("[✓] Offload batch matches per-message GCM.\n");
+  } else {
+    printf("[✗] Offload batch does NOT match per-message GCM!\n");
+  }
+}
+
+typedef struct {
+  SM4_ASYNC *a;
+  int id;
+  int ok;
+} ASYNC_ARG;
+
+// 每个提交线程用自己的完成队列（0 号用 eventfd），各类任务混合提交，
+// 完成队列容量小于任务数，提交返回 EAGAIN 时先取回再重试
+static void *async_submitter(void *p) {
+  enum { M = 150, DEPTH = 16 };
+  ASYNC_ARG *arg = p;
+  SM4_ASYNC_CQ *cq =
+      sm4_async_cq_create(DEPTH, arg->id == 0 ? SM4_ASYNC_CQ_EVENTFD : 0);
+  SM4_ASYNC_JOB *jobs = calloc(M, sizeof(SM4_ASYNC_JOB));
+  uint8_t (*raw)[16] = malloc(M * 16);
+  SM4_Key *keys = malloc(M * sizeof(SM4_Key));
+  uint8_t **ref = malloc(M * sizeof(uint8_t *));
+  uint8_t (*ref_tag)[16] = malloc(M * 16);
+  int ok = cq != NULL, done = 0;
+
+  for (int i = 0; i < M; i++) {
+    SM4_ASYNC_JOB *j = &jobs[i];
+    size_t len = (size_t)(i * 97 + arg->id * 31) % 700;
+    if (i % 23 == 0) {
+      len = 9000; // 超过合批上限，单独执行
+    }
+    j->op = SM4_ASYNC_ECB_ENC + i % 5;
+    if (j->op == SM4_ASYNC_ECB_ENC || j->op == SM4_ASYNC_ECB_DEC) {
+      len &= ~(size_t)15;
+    }
+    for (int k = 0; k < 16; k++) {
+      raw[i][k] = (uint8_t)(i * 7 + arg->id * 13 + k);
+      j->iv[k] = (uint8_t)(i + k * 5);
+    }
+    j->iv[12] = j->iv[13] = j->iv[14] = 0xFF; // CTR 计数器在 32 位内回绕
+    sm4_keyInit(raw[i], &keys[i]);
+    j->key = &keys[arg->id % 2 ? 0 : i]; // 奇数号线程的 ECB/CTR 共用一个密钥
+    j->gcm_key = raw[i];
+    j->aad = raw[i];
+    j->aad_len = i % 3 == 0 ? 16 : 0;
+    j->len = len;
+    uint8_t *in = malloc(len + 1);
+    j->out = in; // 原地
+    j->in = in;
+    ref[i] = malloc(len + 1);
+    for (size_t k = 0; k < len; k++) {
+      in[k] = (uint8_t)(k * 11 + i);
+    }
+    GCM_SM4_CTX ctx;
+    switch (j->op) {
+    case SM4_ASYNC_ECB_ENC:
+      sm4_engine_encrypt_blocks(in, ref[i], len / 16, j->key);
+      break;
+    case SM4_ASYNC_ECB_DEC:
+      sm4_engine_decrypt_blocks(in, ref[i], len / 16, j->key);
+      break;
+    case SM4_ASYNC_CTR:
+      sm4_ctr_range(j->key, j->iv, 32, 0, in, ref[i], len);
+      break;
+    case SM4_ASYNC_GCM_SEAL:
+      gcm_sm4_init(&ctx, raw[i], j->iv, 12, &GHASH_TABLE);
+      gcm_sm4_aad(&ctx, j->aad, j->aad_len);
+      gcm_sm4_encrypt(&ctx, in, len, ref[i]);
+      gcm_sm4_tag(&ctx, ref_tag[i]);
+      break;
+    case SM4_ASYNC_GCM_OPEN:
+      // 输入换成密文，期望还原明文；每 4 条篡改一条标签
+      memcpy(ref[i], in, len);
+      gcm_sm4_init(&ctx, raw[i], j->iv, 12, &GHASH_TABLE);
+      gcm_sm4_aad(&ctx, j->aad, j->aad_len);
+      gcm_sm4_encrypt(&ctx, ref[i], len, in);
+      gcm_sm4_tag(&ctx, j->tag);
+      j->tag[0] ^= i % 4 == 0;
+      break;
+    }
+    j->user = (void *)(intptr_t)i;
+  }
+  jobs[1].len = 15; // ECB 解密长度不是 16 的倍数
+
+  for (int i = 0; ok && i < M;) {
+    SM4_ASYNC_JOB *got[8];
+    if (sm4_async_submit(arg->a, cq, &jobs[i]) == 0) {
+      i++;
+      continue;
+    }
+    ok &= errno == EAGAIN;
+    size_t n = sm4_async_wait(cq, got, 8);
+    for (size_t k = 0; k < n; k++) {
+      ok &= got[k] == &jobs[(intptr_t)got[k]->user];
+    }
+    done += (int)n;
+  }
+  while (ok && done < M) {
+    SM4_ASYNC_JOB *got[8];
+    if (arg->id == 0) {
+      // 先取空，取不到时再阻塞在 eventfd 上
+      size_t n = sm4_async_poll(cq, got, 8);
+      uint64_t v;
+      if (n == 0) {
+        ok &= read(sm4_async_cq_fd(cq), &v, sizeof(v)) == sizeof(v);
+      }
+      done += (int)n;
+    } else {
+      done += (int)sm4_async_wait(cq, got, 8);
+    }
+  }
+  ok &= done == M && cq && sm4_async_inflight(cq) == 0;
+
+  for (int i = 0; ok && i < M; i++) {
+    SM4_ASYNC_JOB *j = &jobs[i];
+    if (i == 1) {
+      ok &= j->status == SM4_ASYNC_INVALID;
+    } else if (j->op == SM4_ASYNC_GCM_OPEN && i % 4 == 0) {
+      ok &= j->status == SM4_ASYNC_BAD_TAG;
+      for (size_t k = 0; k < j->len; k++) {
+        ok &= j->out[k] == 0;
+      }
+    } else {
+      ok &= j->status == SM4_ASYNC_OK &&
+            memcmp(j->out, ref[i], j->len) == 0;
+      if (j->op == SM4_ASYNC_GCM_SEAL) {
+        ok &= memcmp(j->tag, ref_tag[i], 16) == 0;
+      }
+    }
+  }
+  for (int i = 0; i < M; i++) {
+    free(jobs[i].out);
+    free(ref[i]);
+  }
+  sm4_async_cq_destroy(cq);
+  free(jobs);
+  free(raw);
+  free(keys);
+  free(ref);
+  free(ref_tag);
+  arg->ok = ok;
+  return NULL;
+}
+
+void test_async(void) {
+  enum { T = 4 };
+  SM4_ASYNC *a = sm4_async_create(2, 64);
+  pthread_t th[T];
+  ASYNC_ARG args[T];
+  int ok = a != NULL;
+  for (int t = 0; ok && t < T; t++) {
+    args[t] = (ASYNC_ARG){.a = a, .id = t};
+    pthread_create(&th[t], NULL, async_submitter, &args[t]);
+  }
+  for (int t = 0; ok && t < T; t++) {
+    pthread_join(th[t], NULL);
+  }
+  for (int t = 0; ok && t < T; t++) {
+    ok &= args[t].ok;
+  }
+  SM4_ASYNC_STATS st = {0, 0};
+  if (a) {
+    sm4_async_stats(a, &st);
+    sm4_async_destroy(a);
+  }
+  ok &= st.jobs == 150 * T;
+
+  if (ok) {
+    printf("[✓] Async jobs match synchronous calls.\n");
+  } else {
+    printf("[✗] Async jobs do NOT match synchronous calls!\n");
+  }
+}
+
 int main() {
 
   printf("test gcm with comman ghash\n");
   test(&GHASH_COMMAN);
+  test_rfc8998(&GHASH_COMMAN);
+  test_pool(&GHASH_COMMAN);
+  test_trace(&GHASH_COMMAN);
 
   printf("\n==========================\n\n");
 
   printf("test gcm with ghash table\n");
   test(&GHASH_TABLE);
+  test_rfc8998(&GHASH_TABLE);
+  test_pool(&GHASH_TABLE);
+  test_trace(&GHASH_TABLE);
+
+  printf("\n==========================\n\n");
+
+  printf("test offload batch\n");
+  test_offload();
+
+  printf("\n==========================\n\n");
+
+  printf("test async jobs\n");
+  test_async();
 
   return 0;
 }
\ No newline at end of file
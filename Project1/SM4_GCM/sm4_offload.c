@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+#include "sm4_offload.h"
+#include "../sm4_engine.h"
+#include "ghash_lanes.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// 每条请求占 2 + len / 16 块：H、J0 与数据的计数器块
+#define WORK_BLOCKS (SM4_OFFLOAD_BATCH * (2 + SM4_OFFLOAD_MAX_DATA / 16))
+
+struct SM4_OFFLOAD_WORK {
+  uint8_t in[16 * WORK_BLOCKS];
+  uint8_t out[16 * WORK_BLOCKS];
+  const SM4_Key *key_of[WORK_BLOCKS]; // 每一块所用的轮密钥
+  SM4_Key keys[SM4_OFFLOAD_BATCH];
+  const uint8_t *raw[SM4_OFFLOAD_BATCH];
+  GHASH_LANE lanes[SM4_OFFLOAD_BATCH];
+  size_t first[SM4_OFFLOAD_BATCH]; // 该请求 H 所在的块号
+  SM4_OFFLOAD_DESC desc[SM4_OFFLOAD_BATCH];
+  SM4_OFFLOAD_SLOT *req[SM4_OFFLOAD_BATCH];
+};
+
+SM4_OFFLOAD_WORK *sm4_offload_work_new(void) {
+  return aligned_alloc(64, (sizeof(SM4_OFFLOAD_WORK) + 63) & ~(size_t)63);
+}
+
+void sm4_offload_work_free(SM4_OFFLOAD_WORK *w) { free(w); }
+
+static void store_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static void xor_bytes(uint8_t *out, const uint8_t *in, const uint8_t *ks,
+                      size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    out[i] = in[i] ^ ks[i];
+  }
+}
+
+void sm4_offload_run(SM4_OFFLOAD_WORK *w, SM4_OFFLOAD_DESC *d, size_t n) {
+  n = n < SM4_OFFLOAD_BATCH ? n : SM4_OFFLOAD_BATCH;
+  if (n == 0) {
+    return;
+  }
+  for (size_t k = 0; k < n; k++) {
+    w->raw[k] = d[k].key;
+  }
+  sm4_keyInit_batch(w->raw, n, w->keys);
+
+  // 各请求的块依次排列：0^128（求 H）、J0（标签掩码）、inc32(J0) 起的计数器
+  size_t nb = 0;
+  for (size_t k = 0; k < n; k++) {
+    size_t blocks = 2 + (d[k].len + 15) / 16;
+    w->first[k] = nb;
+    memset(w->in + 16 * nb, 0, 16);
+    for (size_t b = 1; b < blocks; b++) {
+      memcpy(w->in + 16 * (nb + b), d[k].iv, 12);
+      store_be32(w->in + 16 * (nb + b) + 12, (uint32_t)b);
+    }
+    for (size_t b = 0; b < blocks; b++) {
+      w->key_of[nb + b] = &w->keys[k];
+    }
+    nb += blocks;
+  }
+  sm4_engine_encrypt_multikey(w->in, w->out, nb, w->key_of);
+
+  // seal 对输出的密文做 GHASH，open 对输入的密文做，解密之前算完
+  for (size_t k = 0; k < n; k++) {
+    GHASH_LANE *l = &w->lanes[k];
+    if (d[k].op == SM4_OFFLOAD_SEAL) {
+      xor_bytes(d[k].out, d[k].in, w->out + 16 * (w->first[k] + 2), d[k].len);
+    }
+    memcpy(l->H, w->out + 16 * w->first[k], 16);
+    l->aad = d[k].aad;
+    l->aad_len = d[k].aad_len;
+    l->ct = d[k].op == SM4_OFFLOAD_SEAL ? d[k].out : d[k].in;
+    l->ct_len = d[k].len;
+  }
+  ghash_lanes(w->lanes, n);
+
+  for (size_t k = 0; k < n; k++) {
+    uint8_t tag[16], diff = 0;
+    const uint8_t *ek0 = w->out + 16 * (w->first[k] + 1);
+    for (int i = 0; i < 16; i++) {
+      tag[i] = w->lanes[k].S[i] ^ ek0[i];
+    }
+    if (d[k].op == SM4_OFFLOAD_SEAL) {
+      memcpy(d[k].tag, tag, 16);
+      d[k].status = SM4_OFFLOAD_OK;
+      continue;
+    }
+    for (int i = 0; i < 16; i++) {
+      diff |= tag[i] ^ d[k].tag[i];
+    }
+    if (diff == 0) {
+      xor_bytes(d[k].out, d[k].in, w->out + 16 * (w->first[k] + 2), d[k].len);
+      d[k].status = SM4_OFFLOAD_OK;
+    } else {
+      memset(d[k].out, 0, d[k].len);
+      d[k].status = SM4_OFFLOAD_BAD_TAG;
+    }
+  }
+}
+
+void sm4_offload_process(SM4_OFFLOAD_WORK *w, SM4_OFFLOAD_SLOT *const *reqs,
+                         size_t n) {
+  // 槽位在客户端的共享内存里，客户端随时可能改写：长度和操作码只读一次，
+  // 之后都用这份副本，改写最多破坏它自己的结果
+  size_t m = 0;
+  for (size_t i = 0; i < n && i < SM4_OFFLOAD_BATCH; i++) {
+    SM4_OFFLOAD_SLOT *s = reqs[i];
+    uint32_t op = s->op, aad_len = s->aad_len, len = s->len;
+    if ((op != SM4_OFFLOAD_SEAL && op != SM4_OFFLOAD_OPEN) ||
+        aad_len > SM4_OFFLOAD_MAX_DATA ||
+        len > SM4_OFFLOAD_MAX_DATA - aad_len) {
+      s->status = SM4_OFFLOAD_INVALID;
+      continue;
+    }
+    SM4_OFFLOAD_DESC *d = &w->desc[m];
+    d->op = op;
+    d->key = s->key;
+    d->iv = s->iv;
+    d->aad = s->data;
+    d->aad_len = aad_len;
+    d->in = s->data + aad_len;
+    d->out = s->data + aad_len;
+    d->len = len;
+    d->tag = s->tag;
+    w->req[m++] = s;
+  }
+  sm4_offload_run(w, w->desc, m);
+  for (size_t k = 0; k < m; k++) {
+    w->req[k]->status = w->desc[k].status;
+  }
+}
+
+int sm4_offload_connect(SM4_OFFLOAD_CLIENT *c, const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+  memset(c, 0, sizeof(*c));
+  c->sock = -1;
+
+  // 封住大小，守护进程据此确认映射不会被截断
+  int fd = memfd_create("sm4_offload", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0) {
+    return -1;
+  }
+  if (ftruncate(fd, sizeof(SM4_OFFLOAD_RING)) != 0 ||
+      fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    goto fail;
+  }
+  c->ring = mmap(NULL, sizeof(SM4_OFFLOAD_RING), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  if (c->ring == MAP_FAILED) {
+    c->ring = NULL;
+    goto fail;
+  }
+  c->ring->magic = SM4_OFFLOAD_MAGIC;
+  c->ring->version = SM4_OFFLOAD_VERSION;
+
+  c->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (c->sock < 0 ||
+      connect(c->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    goto fail;
+  }
+
+  char hello = 'h', ack;
+  char cbuf[CMSG_SPACE(sizeof(int))] = {0};
+  struct iovec iov = {&hello, 1};
+  struct msghdr msg = {.msg_iov = &iov,
+                       .msg_iovlen = 1,
+                       .msg_control = cbuf,
+                       .msg_controllen = sizeof(cbuf)};
+  struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_SOCKET;
+  cm->cmsg_type = SCM_RIGHTS;
+  cm->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+  if (sendmsg(c->sock, &msg, MSG_NOSIGNAL) != 1) {
+    goto fail;
+  }
+  // 守护进程检查并映射共享内存后回复 1 字节
+  ssize_t r;
+  while ((r = read(c->sock, &ack, 1)) < 0 && errno == EINTR) {
+  }
+  if (r != 1) {
+    errno = r == 0 ? ECONNREFUSED : errno;
+    goto fail;
+  }
+  close(fd);
+
+  for (uint32_t i = 0; i < SM4_OFFLOAD_SLOTS; i++) {
+    c->free[i] = SM4_OFFLOAD_SLOTS - 1 - i;
+  }
+  c->nfree = SM4_OFFLOAD_SLOTS;
+  return 0;
+
+fail:;
+  int saved = errno;
+  close(fd);
+  sm4_offload_close(c);
+  errno = saved;
+  return -1;
+}
+
+void sm4_offload_close(SM4_OFFLOAD_CLIENT *c) {
+  if (c->sock >= 0) {
+    close(c->sock);
+  }
+  if (c->ring != NULL) {
+    munmap(c->ring, sizeof(SM4_OFFLOAD_RING));
+  }
+  c->sock = -1;
+  c->ring = NULL;
+  c->nfree = 0;
+}
+
+SM4_OFFLOAD_SLOT *sm4_offload_slot(SM4_OFFLOAD_CLIENT *c) {
+  if (c->nfree == 0) {
+    return NULL;
+  }
+  return &c->ring->slot[c->free[--c->nfree]];
+}
+
+void sm4_offload_release(SM4_OFFLOAD_CLIENT *c, SM4_OFFLOAD_SLOT *s) {
+  c->free[c->nfree++] = (uint32_t)(s - c->ring->slot);
+}
+
+void sm4_offload_submit(SM4_OFFLOAD_CLIENT *c, SM4_OFFLOAD_SLOT *s) {
+  SM4_OFFLOAD_RING *ring = c->ring;
+  uint32_t tail = ring->sq_tail;
+  ring->sq[tail % SM4_OFFLOAD_SLOTS] = (uint32_t)(s - ring->slot);
+  __atomic_store_n(&ring->sq_tail, tail + 1, __ATOMIC_SEQ_CST);
+  // 守护进程醒着（正在处理或轮询）时不必唤醒；套接字缓冲区满（EAGAIN）
+  // 说明它还有没读的唤醒字节，也不必再写
+  if (__atomic_exchange_n(&ring->sq_wakeup, 0, __ATOMIC_SEQ_CST)) {
+    send(c->sock, "s", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
+}
+
+int sm4_offload_reap(SM4_OFFLOAD_CLIENT *c, SM4_OFFLOAD_SLOT **done, int max,
+                     int wait) {
+  SM4_OFFLOAD_RING *ring = c->ring;
+  for (;;) {
+    uint32_t head = ring->cq_head;
+    uint32_t tail = __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE);
+    int got = 0;
+    while (head != tail && got < max) {
+      done[got++] = &ring->slot[ring->cq[head % SM4_OFFLOAD_SLOTS] %
+                                SM4_OFFLOAD_SLOTS];
+      head++;
+    }
+    __atomic_store_n(&ring->cq_head, head, __ATOMIC_RELEASE);
+    if (got > 0 || !wait) {
+      return got;
+    }
+    // 先声明将要阻塞再检查一次：守护进程在此之前发布的完成在这里看到，
+    // 之后发布的会看到标志并写唤醒字节。多余的字节只会造成一次空转
+    __atomic_store_n(&ring->cq_wakeup, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->cq_tail, __ATOMIC_SEQ_CST) != head) {
+      __atomic_store_n(&ring->cq_wakeup, 0, __ATOMIC_RELAXED);
+      continue;
+    }
+    char buf[64];
+    ssize_t r = read(c->sock, buf, sizeof(buf));
+    if (r == 0 || (r < 0 && errno != EINTR)) {
+      return -1;
+    }
+  }
+}
+
+static int call(SM4_OFFLOAD_CLIENT *c, SM4_OFFLOAD_OP op,
+                const uint8_t key[16], const uint8_t iv[12], const uint8_t *aad,
+                size_t aad_len, const uint8_t *in, size_t len, uint8_t tag[16],
+                uint8_t *out) {
+  SM4_OFFLOAD_SLOT *s = sm4_offload_slot(c), *done;
+  if (s == NULL || aad_len > SM4_OFFLOAD_MAX_DATA ||
+      len > SM4_OFFLOAD_MAX_DATA - aad_len) {
+    if (s != NULL) {
+      sm4_offload_release(c, s);
+    }
+    return SM4_OFFLOAD_INVALID;
+  }
+  s->op = op;
+  s->aad_len = (uint32_t)aad_len;
+  s->len = (uint32_t)len;
+  memcpy(s->key, key, 16);
+  memcpy(s->iv, iv, 12);
+  memcpy(s->tag, tag, 16);
+  memcpy(s->data, aad, aad_len);
+  memcpy(s->data + aad_len, in, len);
+  sm4_offload_submit(c, s);
+  if (sm4_offload_reap(c, &done, 1, 1) != 1) {
+    return SM4_OFFLOAD_INVALID;
+  }
+  int status = done->status;
+  memcpy(out, done->data + aad_len, len);
+  memcpy(tag, done->tag, 16);
+  sm4_offload_release(c, done);
+  return status;
+}
+
+int sm4_offload_seal(SM4_OFFLOAD_CLIENT *c, const uint8_t key[16],
+                     const uint8_t iv[12], const uint8_t *aad, size_t aad_len,
+                     const uint8_t *plaintext, size_t len, uint8_t *ciphertext,
+                     uint8_t tag[16]) {
+  memset(tag, 0, 16);
+  return call(c, SM4_OFFLOAD_SEAL, key, iv, aad, aad_len, plaintext, len, tag,
+              ciphertext);
+}
+
+int sm4_offload_open(SM4_OFFLOAD_CLIENT *c, const uint8_t key[16],
+                     const uint8_t iv[12], const uint8_t *aad, size_t aad_len,
+                     const uint8_t *ciphertext, size_t len,
+                     const uint8_t tag[16], uint8_t *plaintext) {
+  uint8_t t[16];
+  memcpy(t, tag, 16);
+  return call(c, SM4_OFFLOAD_OPEN, key, iv, aad, aad_len, ciphertext, len, t,
+              plaintext);
+}
@@ -0,0 +1,132 @@
+#ifndef SM4_OFFLOAD_H
+#define SM4_OFFLOAD_H
+
+// SM4-GCM 卸载：各进程把小消息交给本机的守护进程 sm4d，守护进程把同一时刻
+// 来自多个客户端的请求合成一批，用多密钥 SM4 和多路 GHASH 一起处理。
+//
+// 连接：客户端创建一块共享内存（memfd），通过 Unix 域套接字的 SCM_RIGHTS
+// 交给守护进程，之后套接字只用来唤醒对方（写 1 字节）。对方醒着时不写：
+// 守护进程睡眠前置 sq_wakeup，客户端提交时把它换成 0，换出 1 才写；客户端
+// 阻塞前置 cq_wakeup，守护进程发布完成时同样处理。两边都是先写下标/标志、
+// 再（seq_cst）读对方的标志/下标，不会都错过对方。
+// 共享内存：SM4_OFFLOAD_SLOTS 个槽位和两个单生产者单消费者队列。
+//   提交队列 sq：客户端填好槽位后写入槽位号，守护进程取走；
+//   完成队列 cq：守护进程原地写回结果后写入槽位号，客户端取走。
+// 槽位归客户端所有，同时在途的请求不超过槽位数，两个队列都不会溢出
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SM4_OFFLOAD_SLOTS 64        // 每个客户端的槽位数，2 的幂
+#define SM4_OFFLOAD_MAX_DATA 4096   // 每条请求 AAD 与数据合计的上限
+#define SM4_OFFLOAD_BATCH 64        // 守护进程每批最多处理的请求数
+#define SM4_OFFLOAD_MAGIC 0x44344D53u // "SM4D"（小端）
+#define SM4_OFFLOAD_VERSION 1
+
+typedef enum { SM4_OFFLOAD_SEAL = 1, SM4_OFFLOAD_OPEN = 2 } SM4_OFFLOAD_OP;
+
+// 请求状态
+#define SM4_OFFLOAD_OK 0
+#define SM4_OFFLOAD_BAD_TAG -1 // 解密时标签不符，数据已清零
+#define SM4_OFFLOAD_INVALID -2 // 操作码或长度不合法
+
+typedef struct {
+  uint32_t op;      // SM4_OFFLOAD_OP
+  uint32_t aad_len; // data 的前 aad_len 字节是 AAD
+  uint32_t len;     // 之后 len 字节是明文（seal）或密文（open），结果原地写回
+  int32_t status;   // 完成时写入
+  uint64_t user;    // 客户端自定义，原样保留
+  uint8_t key[16];
+  uint8_t iv[12];
+  uint8_t tag[16]; // seal 输出，open 输入
+  uint8_t data[SM4_OFFLOAD_MAX_DATA];
+} SM4_OFFLOAD_SLOT;
+
+typedef struct {
+  uint32_t magic; // SM4_OFFLOAD_MAGIC
+  uint32_t version;
+  // 各下标只由一方写入，分开放在不同缓存行
+  uint32_t sq_tail __attribute__((aligned(64))); // 客户端写
+  uint32_t sq_head __attribute__((aligned(64))); // 守护进程写
+  uint32_t cq_tail __attribute__((aligned(64))); // 守护进程写
+  // 每完成一条请求，守护进程把该请求所在批次的请求数累加到 coalesced，
+  // coalesced / completed 即客户端看到的平均批大小
+  uint64_t completed;
+  uint64_t coalesced;
+  uint32_t cq_head __attribute__((aligned(64))); // 客户端写
+  uint32_t sq_wakeup __attribute__((aligned(64))); // 守护进程将要睡眠
+  uint32_t cq_wakeup __attribute__((aligned(64))); // 客户端将要阻塞
+  uint32_t sq[SM4_OFFLOAD_SLOTS];
+  uint32_t cq[SM4_OFFLOAD_SLOTS];
+  SM4_OFFLOAD_SLOT slot[SM4_OFFLOAD_SLOTS] __attribute__((aligned(64)));
+} SM4_OFFLOAD_RING;
+
+// 守护进程处理一批请求所需的工作区（约 700 KB），预先分配、重复使用
+typedef struct SM4_OFFLOAD_WORK SM4_OFFLOAD_WORK;
+
+SM4_OFFLOAD_WORK *sm4_offload_work_new(void);
+void sm4_offload_work_free(SM4_OFFLOAD_WORK *w);
+
+// 一条 GCM 请求的描述，输入输出都由调用方持有（out 可以等于 in）
+typedef struct {
+  uint32_t op; // SM4_OFFLOAD_OP
+  const uint8_t *key;
+  const uint8_t *iv; // 12 字节
+  const uint8_t *aad;
+  size_t aad_len;
+  const uint8_t *in;
+  uint8_t *out;
+  size_t len;   // 不超过 SM4_OFFLOAD_MAX_DATA
+  uint8_t *tag; // seal 输出，open 输入
+  int status;   // 完成时写入
+} SM4_OFFLOAD_DESC;
+
+// 合批处理至多 SM4_OFFLOAD_BATCH 条请求（调用方保证 op 与 len 合法）：
+//   1. 批量密钥扩展（sm4_keyInit_batch）；
+//   2. 所有请求的 H = E_K(0)、E_K(J0) 与数据的计数器块排成一列，
+//      一次多密钥加密（sm4_engine_encrypt_multikey）；
+//   3. seal 先异或出密文，然后所有请求的 GHASH 一起计算（ghash_lanes）；
+//   4. open 比较标签，相符才异或出明文，否则输出清零
+void sm4_offload_run(SM4_OFFLOAD_WORK *w, SM4_OFFLOAD_DESC *d, size_t n);
+
+// 检查各槽位的请求后交给 sm4_offload_run，结果写回槽位
+void sm4_offload_process(SM4_OFFLOAD_WORK *w, SM4_OFFLOAD_SLOT *const *reqs,
+                         size_t n);
+
+// ---- 客户端 ----
+
+typedef struct {
+  int sock;
+  SM4_OFFLOAD_RING *ring;
+  uint32_t free[SM4_OFFLOAD_SLOTS]; // 空闲槽位号
+  uint32_t nfree;
+} SM4_OFFLOAD_CLIENT;
+
+// 连接守护进程，成功返回 0，失败返回 -1 并设置 errno
+int sm4_offload_connect(SM4_OFFLOAD_CLIENT *c, const char *path);
+void sm4_offload_close(SM4_OFFLOAD_CLIENT *c);
+
+// 取一个空闲槽位，没有时返回 NULL，需先收回并归还已完成的请求
+SM4_OFFLOAD_SLOT *sm4_offload_slot(SM4_OFFLOAD_CLIENT *c);
+
+// 提交填好的槽位并唤醒守护进程
+void sm4_offload_submit(SM4_OFFLOAD_CLIENT *c, SM4_OFFLOAD_SLOT *s);
+
+// 收回至多 max 条已完成的请求，wait 非 0 时至少等到一条。
+// 返回收回的条数，连接断开时返回 -1。用完后以 sm4_offload_release 归还
+int sm4_offload_reap(SM4_OFFLOAD_CLIENT *c, SM4_OFFLOAD_SLOT **done, int max,
+                     int wait);
+void sm4_offload_release(SM4_OFFLOAD_CLIENT *c, SM4_OFFLOAD_SLOT *s);
+
+// 同步接口：提交一条请求并等待结果，返回请求状态，连接断开时返回
+// SM4_OFFLOAD_INVALID。只能在没有其他在途请求时使用
+int sm4_offload_seal(SM4_OFFLOAD_CLIENT *c, const uint8_t key[16],
+                     const uint8_t iv[12], const uint8_t *aad, size_t aad_len,
+                     const uint8_t *plaintext, size_t len, uint8_t *ciphertext,
+                     uint8_t tag[16]);
+int sm4_offload_open(SM4_OFFLOAD_CLIENT *c, const uint8_t key[16],
+                     const uint8_t iv[12], const uint8_t *aad, size_t aad_len,
+                     const uint8_t *ciphertext, size_t len,
+                     const uint8_t tag[16], uint8_t *plaintext);
+
+#endif // SM4_OFFLOAD_H
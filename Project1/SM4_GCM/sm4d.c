@@ -0,0 +1,419 @@
+// sm4d：SM4-GCM 卸载守护进程，协议见 sm4_offload.h。
+//
+// 单线程事件循环：epoll 等待新连接和客户端的唤醒字节，之后轮流从各客户端的
+// 提交队列取请求拼成一批（每轮每个客户端取一条，一个队列很深的客户端不会
+// 独占整批），交给 sm4_offload_process，再把槽位号写进各自的完成队列并唤醒
+// 客户端。批未满且设置了 --linger 时，在这段时间内让出 CPU 继续收集，
+// 用一点延迟换更大的批；--poll 让守护进程在没有请求后继续轮询一段时间再
+// 睡眠，期间两边都不必通过套接字唤醒对方
+#define _GNU_SOURCE
+#include "sm4_offload.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS 256
+#define DEFAULT_SOCKET "/tmp/sm4d.sock"
+#define HANDSHAKE_NS 100000000ull // 连接后须在此时间内发来共享内存
+
+typedef struct {
+  int sock;               // -1 表示空位
+  SM4_OFFLOAD_RING *ring; // NULL 表示还在等共享内存（握手中）
+  uint64_t deadline;      // 握手截止时间
+  uint32_t sq_head; // 守护进程自己的副本，不信任共享内存里的值
+  uint32_t cq_tail;
+  uint32_t done; // 本批完成的条数，用于批末统一发布和唤醒
+  int bad;       // 下标被写坏，本批处理完后断开
+} CLIENT;
+
+static CLIENT clients[MAX_CLIENTS];
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+  (void)sig;
+  stop = 1;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void drop_client(CLIENT *cl) {
+  close(cl->sock);
+  if (cl->ring != NULL) {
+    munmap(cl->ring, sizeof(SM4_OFFLOAD_RING));
+  }
+  cl->sock = -1;
+  cl->ring = NULL;
+}
+
+// 新连接先以非阻塞方式放进 epoll 等待共享内存，事件循环不在 recvmsg 上
+// 阻塞；没有空位时直接关闭
+static void accept_client(int listen_fd, int ep) {
+  int sock = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (sock < 0) {
+    return;
+  }
+  CLIENT *cl = NULL;
+  for (int i = 0; i < MAX_CLIENTS && cl == NULL; i++) {
+    cl = clients[i].sock < 0 ? &clients[i] : NULL;
+  }
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = cl};
+  if (cl == NULL || epoll_ctl(ep, EPOLL_CTL_ADD, sock, &ev) != 0) {
+    close(sock);
+    return;
+  }
+  cl->sock = sock;
+  cl->ring = NULL;
+  cl->deadline = now_ns() + HANDSHAKE_NS;
+}
+
+// 连接可读时接收客户端的共享内存：必须封住大小且不小于 SM4_OFFLOAD_RING，
+// 否则客户端截断文件会让守护进程访问映射时收到 SIGBUS。数据还没到时返回，
+// 等下次可读或超时
+static void handshake(CLIENT *cl) {
+  char hello, cbuf[CMSG_SPACE(sizeof(int))];
+  struct iovec iov = {&hello, 1};
+  struct msghdr msg = {.msg_iov = &iov,
+                       .msg_iovlen = 1,
+                       .msg_control = cbuf,
+                       .msg_controllen = sizeof(cbuf)};
+  ssize_t r = recvmsg(cl->sock, &msg, MSG_CMSG_CLOEXEC);
+  if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  int fd = -1;
+  if (r == 1) {
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (cm != NULL && cm->cmsg_level == SOL_SOCKET &&
+        cm->cmsg_type == SCM_RIGHTS && cm->cmsg_len == CMSG_LEN(sizeof(int))) {
+      memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+    }
+  }
+
+  struct stat st;
+  int seals = fd >= 0 ? fcntl(fd, F_GET_SEALS) : -1;
+  SM4_OFFLOAD_RING *ring = MAP_FAILED;
+  if (seals >= 0 && (seals & F_SEAL_SHRINK) && fstat(fd, &st) == 0 &&
+      st.st_size >= (off_t)sizeof(SM4_OFFLOAD_RING)) {
+    ring = mmap(NULL, sizeof(SM4_OFFLOAD_RING), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (ring == MAP_FAILED || ring->magic != SM4_OFFLOAD_MAGIC ||
+      ring->version != SM4_OFFLOAD_VERSION) {
+    if (ring != MAP_FAILED) {
+      munmap(ring, sizeof(SM4_OFFLOAD_RING));
+    }
+    drop_client(cl);
+    return;
+  }
+  cl->ring = ring;
+  cl->sq_head = ring->sq_head;
+  cl->cq_tail = ring->cq_tail;
+  cl->done = 0;
+  cl->bad = 0;
+  if (send(cl->sock, "k", 1, MSG_NOSIGNAL) != 1) {
+    drop_client(cl);
+  }
+}
+
+// 断开超时仍未握手的连接，返回到最早的握手截止时间的毫秒数（向上取整），
+// 没有握手中的连接时返回 -1，供 epoll_wait 作超时
+static int expire_handshakes(void) {
+  uint64_t now = now_ns(), next = 0;
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    CLIENT *cl = &clients[i];
+    if (cl->sock < 0 || cl->ring != NULL) {
+      continue;
+    }
+    if (now >= cl->deadline) {
+      drop_client(cl);
+    } else if (next == 0 || cl->deadline < next) {
+      next = cl->deadline;
+    }
+  }
+  return next == 0 ? -1 : (int)((next - now + 999999) / 1000000);
+}
+
+// 读掉唤醒字节，对端关闭时返回 -1
+static int drain(CLIENT *cl) {
+  char buf[256];
+  for (;;) {
+    ssize_t r = read(cl->sock, buf, sizeof(buf));
+    if (r > 0) {
+      continue;
+    }
+    if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+      return 0;
+    }
+    return -1;
+  }
+}
+
+// 轮流从各客户端取请求追加到批中，返回新的批大小。提交队列里的条数超过
+// 槽位数说明客户端写坏了下标，不再从它取请求；批中可能已有它的请求，
+// 等这批完成后再断开
+static size_t collect(SM4_OFFLOAD_SLOT **batch, CLIENT **owner, size_t n,
+                      size_t max, int *rr) {
+  int progress = 1;
+  while (n < max && progress) {
+    progress = 0;
+    for (int j = 0; j < MAX_CLIENTS && n < max; j++) {
+      CLIENT *cl = &clients[(*rr + j) % MAX_CLIENTS];
+      if (cl->ring == NULL || cl->bad) {
+        continue;
+      }
+      SM4_OFFLOAD_RING *ring = cl->ring;
+      uint32_t tail = __atomic_load_n(&ring->sq_tail, __ATOMIC_ACQUIRE);
+      if (tail - cl->sq_head > SM4_OFFLOAD_SLOTS) {
+        cl->bad = 1;
+        continue;
+      }
+      if (tail == cl->sq_head) {
+        continue;
+      }
+      uint32_t idx = ring->sq[cl->sq_head % SM4_OFFLOAD_SLOTS];
+      batch[n] = &ring->slot[idx % SM4_OFFLOAD_SLOTS];
+      owner[n++] = cl;
+      cl->sq_head++;
+      __atomic_store_n(&ring->sq_head, cl->sq_head, __ATOMIC_RELAXED);
+      progress = 1;
+    }
+  }
+  *rr = (*rr + 1) % MAX_CLIENTS;
+  return n;
+}
+
+// 睡眠前请各客户端在下次提交时唤醒自己，标志置位后再检查一次提交队列；
+// wake 为 0 时撤销请求（醒着时客户端不必写套接字）
+static void want_wakeup(int wake) {
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    if (clients[i].ring != NULL) {
+      __atomic_store_n(&clients[i].ring->sq_wakeup, wake, __ATOMIC_SEQ_CST);
+    }
+  }
+}
+
+static int pending(void) {
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    if (clients[i].ring != NULL && !clients[i].bad &&
+        __atomic_load_n(&clients[i].ring->sq_tail, __ATOMIC_ACQUIRE) !=
+            clients[i].sq_head) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// 写完成队列；每个客户端在批末只发布一次 cq_tail 并唤醒一次
+static void complete(SM4_OFFLOAD_SLOT **batch, CLIENT **owner, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    CLIENT *cl = owner[i];
+    SM4_OFFLOAD_RING *ring = cl->ring;
+    ring->cq[cl->cq_tail++ % SM4_OFFLOAD_SLOTS] =
+        (uint32_t)(batch[i] - ring->slot);
+    cl->done++;
+  }
+  for (size_t i = 0; i < n; i++) {
+    CLIENT *cl = owner[i];
+    if (cl->done == 0) {
+      continue;
+    }
+    SM4_OFFLOAD_RING *ring = cl->ring;
+    ring->completed += cl->done;
+    ring->coalesced += (uint64_t)cl->done * n;
+    __atomic_store_n(&ring->cq_tail, cl->cq_tail, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&ring->cq_wakeup, 0, __ATOMIC_SEQ_CST)) {
+      send(cl->sock, "c", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    cl->done = 0;
+  }
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "用法：sm4d [-S 套接字路径] [--linger 微秒] [--poll 微秒] "
+          "[--batch 条数] [-v]\n"
+          "  -S        监听的 Unix 域套接字（默认 " DEFAULT_SOCKET "）\n"
+          "  --linger  批未满时继续收集请求的最长时间（默认 0）\n"
+          "  --poll    没有请求后继续轮询的时间，期间客户端提交不必写套接字"
+          "（默认 0，适合有空闲核的机器）\n"
+          "  --batch   每批最多的请求数（1 ~ %d，默认 %d）\n"
+          "  -v        退出时输出批处理统计\n",
+          SM4_OFFLOAD_BATCH, SM4_OFFLOAD_BATCH);
+}
+
+int main(int argc, char **argv) {
+  static const struct option LONG_OPTS[] = {{"linger", 1, NULL, 'l'},
+                                            {"batch", 1, NULL, 'b'},
+                                            {"poll", 1, NULL, 'p'},
+                                            {NULL, 0, NULL, 0}};
+  const char *path = DEFAULT_SOCKET;
+  uint64_t linger_ns = 0, poll_ns = 0;
+  size_t max_batch = SM4_OFFLOAD_BATCH;
+  int verbose = 0, opt;
+  while ((opt = getopt_long(argc, argv, "S:v", LONG_OPTS, NULL)) != -1) {
+    switch (opt) {
+    case 'S':
+      path = optarg;
+      break;
+    case 'l':
+      linger_ns = strtoull(optarg, NULL, 10) * 1000;
+      break;
+    case 'p':
+      poll_ns = strtoull(optarg, NULL, 10) * 1000;
+      break;
+    case 'b':
+      max_batch = strtoul(optarg, NULL, 10);
+      if (max_batch < 1 || max_batch > SM4_OFFLOAD_BATCH) {
+        usage();
+        return 1;
+      }
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "sm4d：套接字路径过长\n");
+    return 1;
+  }
+  strcpy(addr.sun_path, path);
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    fprintf(stderr, "sm4d：无法创建套接字：%s\n", strerror(errno));
+    return 1;
+  }
+  // 路径上的套接字还能连上说明已有守护进程在监听，不能删掉它的套接字；
+  // 连不上（ECONNREFUSED）的是上次异常退出留下的，才删除后重新绑定
+  int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  struct stat st;
+  if (probe >= 0 &&
+      connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    fprintf(stderr, "sm4d：%s 上已有守护进程在运行\n", path);
+    close(probe);
+    return 1;
+  }
+  if (probe >= 0 && errno == ECONNREFUSED && lstat(path, &st) == 0 &&
+      S_ISSOCK(st.st_mode)) {
+    unlink(path);
+  }
+  if (probe >= 0) {
+    close(probe);
+  }
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 64) != 0) {
+    fprintf(stderr, "sm4d：无法监听 %s：%s\n", path, strerror(errno));
+    return 1;
+  }
+
+  // 不设 SA_RESTART：收到信号时 epoll_wait 返回 EINTR，循环随即退出
+  struct sigaction sa = {.sa_handler = on_signal};
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  SM4_OFFLOAD_WORK *work = sm4_offload_work_new();
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  if (work == NULL || ep < 0 ||
+      epoll_ctl(ep, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+    fprintf(stderr, "sm4d：初始化失败\n");
+    return 1;
+  }
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    clients[i].sock = -1;
+  }
+
+  SM4_OFFLOAD_SLOT *batch[SM4_OFFLOAD_BATCH];
+  CLIENT *owner[SM4_OFFLOAD_BATCH];
+  uint64_t requests = 0, batches = 0;
+  int rr = 0, busy = 0;
+  uint64_t idle_since = now_ns();
+  while (!stop) {
+    struct epoll_event events[64];
+    int sleep = 0;
+    int timeout = expire_handshakes();
+    if (!busy && now_ns() - idle_since >= poll_ns) {
+      want_wakeup(1);
+      sleep = !pending();
+    }
+    int nev = epoll_wait(ep, events, 64, sleep ? timeout : 0);
+    if (sleep) {
+      want_wakeup(0);
+    }
+    for (int i = 0; i < nev; i++) {
+      CLIENT *cl = events[i].data.ptr;
+      if (cl == NULL) {
+        accept_client(listen_fd, ep);
+      } else if (cl->sock >= 0 && cl->ring == NULL) {
+        handshake(cl);
+      } else if (cl->sock >= 0 && drain(cl) != 0) {
+        drop_client(cl);
+      }
+    }
+
+    size_t n = collect(batch, owner, 0, max_batch, &rr);
+    if (n > 0 && n < max_batch && linger_ns > 0) {
+      uint64_t deadline = now_ns() + linger_ns;
+      while (n < max_batch && now_ns() < deadline) {
+        sched_yield();
+        n = collect(batch, owner, n, max_batch, &rr);
+      }
+    }
+    if (n > 0) {
+      sm4_offload_process(work, batch, n);
+      complete(batch, owner, n);
+      requests += n;
+      batches++;
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+      if (clients[i].sock >= 0 && clients[i].bad) {
+        drop_client(&clients[i]);
+      }
+    }
+    busy = pending();
+    if (n > 0) {
+      idle_since = now_ns();
+    }
+  }
+
+  if (verbose) {
+    fprintf(stderr, "sm4d：%llu 条请求，%llu 批，平均每批 %.1f 条\n",
+            (unsigned long long)requests, (unsigned long long)batches,
+            batches > 0 ? (double)requests / batches : 0.0);
+  }
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    if (clients[i].sock >= 0) {
+      drop_client(&clients[i]);
+    }
+  }
+  unlink(path);
+  sm4_offload_work_free(work);
+  return 0;
+}
@@ -0,0 +1,459 @@
+// sm4d_load：sm4d 的正确性检查与压测。
+//
+// 先用一个连接核对 seal/open 的结果与 gcm_sm4_* 相同、篡改的标签和非法的
+// 请求被拒绝、多条请求同时在途时结果各归其位；然后 fork 出 -c 个客户端
+// 进程（各用自己的密钥），每个保持 -d 条在途请求，持续 -t 秒，统计吞吐和
+// 每条请求从提交到收回的延迟；最后让同样多的进程各自直接调用 gcm_sm4_*
+// 作为对照。--spawn 给出 sm4d 的路径时由本程序启动守护进程，结束时停止它
+#define _GNU_SOURCE
+#include "sm4_gcm.h"
+#include "sm4_offload.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS 128
+#define MAX_SAMPLES 65536 // 每个客户端保留的延迟样本数，超出后循环覆盖
+
+static const GHASH_METHOD GHASH_TBL = {.init = ghash_table_init,
+                                       .update = ghash_table_update,
+                                       .final = ghash_table_final,
+                                       .reset = ghash_table_reset};
+
+typedef struct {
+  const char *path;
+  int clients;
+  int depth;
+  size_t size;
+  size_t aad;
+  double seconds;
+} OPTIONS;
+
+// 子进程写、父进程汇总，放在 MAP_SHARED 的匿名映射里
+typedef struct {
+  uint64_t ops;
+  uint64_t completed; // 取自共享环，用于计算平均批大小
+  uint64_t coalesced;
+  uint64_t nsamples;
+  int failed;
+  uint32_t lat[MAX_SAMPLES]; // 纳秒
+} RESULT;
+
+typedef struct {
+  int ready;
+  int go;
+  uint64_t deadline;
+  RESULT result[MAX_CLIENTS];
+} SHARED;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void record(RESULT *r, uint64_t ns) {
+  r->lat[r->nsamples++ % MAX_SAMPLES] = ns > UINT32_MAX ? UINT32_MAX : ns;
+  r->ops++;
+}
+
+// 守护进程刚启动时套接字可能还没开始监听，最多重试 2 秒
+static int connect_retry(SM4_OFFLOAD_CLIENT *c, const char *path) {
+  for (int i = 0; i < 200; i++) {
+    if (sm4_offload_connect(c, path) == 0) {
+      return 0;
+    }
+    if (errno != ENOENT && errno != ECONNREFUSED) {
+      break;
+    }
+    usleep(10000);
+  }
+  return -1;
+}
+
+static void fill_message(uint8_t *buf, size_t len, unsigned seed) {
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = (uint8_t)(i * 131 + seed * 7 + 3);
+  }
+}
+
+static void reference_seal(const uint8_t key[16], const uint8_t iv[12],
+                           const uint8_t *aad, size_t aad_len,
+                           const uint8_t *pt, size_t len, uint8_t *ct,
+                           uint8_t tag[16]) {
+  GCM_SM4_CTX ctx;
+  gcm_sm4_init(&ctx, key, iv, 12, &GHASH_TBL);
+  gcm_sm4_aad(&ctx, aad, aad_len);
+  gcm_sm4_encrypt(&ctx, pt, len, ct);
+  gcm_sm4_tag(&ctx, tag);
+}
+
+// 第 i 条测试请求的参数：密钥、IV、AAD 与消息都由 i 决定
+static void test_case(unsigned i, uint8_t key[16], uint8_t iv[12],
+                      uint8_t *msg, size_t total) {
+  for (int j = 0; j < 16; j++) {
+    key[j] = (uint8_t)(i * 17 + j);
+  }
+  for (int j = 0; j < 12; j++) {
+    iv[j] = (uint8_t)(i * 5 + j * 3);
+  }
+  fill_message(msg, total, i);
+}
+
+static const char *tf(int ok) { return ok ? "true" : "false"; }
+
+static int verify(const char *path) {
+  static const size_t AADS[] = {0, 13, 16, 33};
+  static const size_t LENS[] = {0, 1, 15, 16, 17, 64, 255, 1000, 4000};
+  static uint8_t msg[SM4_OFFLOAD_MAX_DATA], ref[SM4_OFFLOAD_MAX_DATA];
+  static uint8_t out[SM4_OFFLOAD_MAX_DATA], back[SM4_OFFLOAD_MAX_DATA];
+  uint8_t key[16], iv[12], tag[16], ref_tag[16];
+  SM4_OFFLOAD_CLIENT c;
+  if (connect_retry(&c, path) != 0) {
+    fprintf(stderr, "sm4d_load：无法连接 %s：%s\n", path, strerror(errno));
+    return 0;
+  }
+
+  int seal_ok = 1, open_ok = 1, reject_ok = 1;
+  unsigned n = 0;
+  for (size_t a = 0; a < sizeof(AADS) / sizeof(AADS[0]); a++) {
+    for (size_t l = 0; l < sizeof(LENS) / sizeof(LENS[0]); l++) {
+      size_t aad = AADS[a], len = LENS[l];
+      if (aad + len > SM4_OFFLOAD_MAX_DATA) {
+        continue;
+      }
+      test_case(n++, key, iv, msg, aad + len);
+      reference_seal(key, iv, msg, aad, msg + aad, len, ref, ref_tag);
+      seal_ok &= sm4_offload_seal(&c, key, iv, msg, aad, msg + aad, len, out,
+                                  tag) == SM4_OFFLOAD_OK &&
+                 memcmp(out, ref, len) == 0 && memcmp(tag, ref_tag, 16) == 0;
+      open_ok &= sm4_offload_open(&c, key, iv, msg, aad, out, len, tag,
+                                  back) == SM4_OFFLOAD_OK &&
+                 memcmp(back, msg + aad, len) == 0;
+      tag[len % 16] ^= 1;
+      memset(back, 0xA5, len);
+      int ret = sm4_offload_open(&c, key, iv, msg, aad, out, len, tag, back);
+      reject_ok &= ret == SM4_OFFLOAD_BAD_TAG;
+      for (size_t i = 0; i < len; i++) {
+        reject_ok &= back[i] == 0;
+      }
+    }
+  }
+  printf("seal 是否等于 gcm_sm4_*：\t%s\n", tf(seal_ok));
+  printf("open 是否还原明文：\t\t%s\n", tf(open_ok));
+  printf("篡改标签是否被拒绝：\t\t%s\n", tf(reject_ok));
+
+  // 守护进程一侧的检查：未知操作码、AAD 与数据合计超过上限
+  SM4_OFFLOAD_SLOT *s = sm4_offload_slot(&c), *done[SM4_OFFLOAD_SLOTS];
+  s->op = 7;
+  s->aad_len = 0;
+  s->len = 16;
+  sm4_offload_submit(&c, s);
+  int invalid_ok = sm4_offload_reap(&c, done, 1, 1) == 1 &&
+                   done[0]->status == SM4_OFFLOAD_INVALID;
+  s->op = SM4_OFFLOAD_SEAL;
+  s->aad_len = SM4_OFFLOAD_MAX_DATA;
+  s->len = 1;
+  sm4_offload_submit(&c, s);
+  invalid_ok &= sm4_offload_reap(&c, done, 1, 1) == 1 &&
+                done[0]->status == SM4_OFFLOAD_INVALID;
+  sm4_offload_release(&c, s);
+  printf("非法请求是否被拒绝：\t\t%s\n", tf(invalid_ok));
+
+  // 占满所有槽位再一起收回，长度各不相同
+  for (unsigned i = 0; i < SM4_OFFLOAD_SLOTS; i++) {
+    s = sm4_offload_slot(&c);
+    s->op = SM4_OFFLOAD_SEAL;
+    s->aad_len = i % 20;
+    s->len = (uint32_t)(i * 37 % 600);
+    s->user = i;
+    test_case(1000 + i, s->key, s->iv, s->data, s->aad_len + s->len);
+    sm4_offload_submit(&c, s);
+  }
+  int pipe_ok = 1, got = 0;
+  while (got < SM4_OFFLOAD_SLOTS && pipe_ok) {
+    int r = sm4_offload_reap(&c, done, SM4_OFFLOAD_SLOTS, 1);
+    pipe_ok &= r > 0;
+    for (int k = 0; k < r; k++) {
+      s = done[k];
+      test_case(1000 + (unsigned)s->user, key, iv, msg, s->aad_len + s->len);
+      reference_seal(key, iv, msg, s->aad_len, msg + s->aad_len, s->len, ref,
+                     ref_tag);
+      pipe_ok &= s->status == SM4_OFFLOAD_OK &&
+                 memcmp(s->data + s->aad_len, ref, s->len) == 0 &&
+                 memcmp(s->tag, ref_tag, 16) == 0;
+      sm4_offload_release(&c, s);
+    }
+    got += r > 0 ? r : 0;
+  }
+  printf("多条在途请求是否各归其位：\t%s\n", tf(pipe_ok));
+  sm4_offload_close(&c);
+  return seal_ok && open_ok && reject_ok && invalid_ok && pipe_ok;
+}
+
+static void wait_start(SHARED *sh) {
+  __atomic_add_fetch(&sh->ready, 1, __ATOMIC_SEQ_CST);
+  while (!__atomic_load_n(&sh->go, __ATOMIC_ACQUIRE)) {
+    usleep(100);
+  }
+}
+
+static void submit_one(SM4_OFFLOAD_CLIENT *c, const OPTIONS *opt,
+                       const uint8_t key[16], const uint8_t *msg,
+                       uint32_t seq) {
+  SM4_OFFLOAD_SLOT *s = sm4_offload_slot(c);
+  s->op = SM4_OFFLOAD_SEAL;
+  s->aad_len = (uint32_t)opt->aad;
+  s->len = (uint32_t)opt->size;
+  memcpy(s->key, key, 16);
+  memset(s->iv, 0, 8);
+  memcpy(s->iv + 8, &seq, 4);
+  memcpy(s->data, msg, opt->aad + opt->size);
+  s->user = now_ns();
+  sm4_offload_submit(c, s);
+}
+
+// 保持 depth 条在途：每收回一条就补交一条，直到截止时间
+static void offload_client(int id, const OPTIONS *opt, SHARED *sh) {
+  RESULT *r = &sh->result[id];
+  static uint8_t msg[SM4_OFFLOAD_MAX_DATA];
+  uint8_t key[16], iv[12];
+  test_case((unsigned)id, key, iv, msg, opt->aad + opt->size);
+  SM4_OFFLOAD_CLIENT c;
+  if (connect_retry(&c, opt->path) != 0) {
+    r->failed = 1;
+    __atomic_add_fetch(&sh->ready, 1, __ATOMIC_SEQ_CST);
+    return;
+  }
+  wait_start(sh);
+
+  uint32_t seq = 0;
+  int inflight = 0;
+  for (; inflight < opt->depth; inflight++) {
+    submit_one(&c, opt, key, msg, seq++);
+  }
+  while (inflight > 0) {
+    SM4_OFFLOAD_SLOT *done[SM4_OFFLOAD_SLOTS];
+    int got = sm4_offload_reap(&c, done, SM4_OFFLOAD_SLOTS, 1);
+    if (got < 0) {
+      r->failed = 1;
+      break;
+    }
+    uint64_t t = now_ns();
+    for (int k = 0; k < got; k++) {
+      record(r, t - done[k]->user);
+      r->failed |= done[k]->status != SM4_OFFLOAD_OK;
+      sm4_offload_release(&c, done[k]);
+    }
+    inflight -= got;
+    while (t < sh->deadline && inflight < opt->depth) {
+      submit_one(&c, opt, key, msg, seq++);
+      inflight++;
+    }
+  }
+  r->completed = c.ring->completed;
+  r->coalesced = c.ring->coalesced;
+  sm4_offload_close(&c);
+}
+
+// 对照：每条消息都在本进程内完整走一遍 gcm_sm4_*
+static void local_client(int id, const OPTIONS *opt, SHARED *sh) {
+  RESULT *r = &sh->result[id];
+  static uint8_t msg[SM4_OFFLOAD_MAX_DATA], out[SM4_OFFLOAD_MAX_DATA];
+  uint8_t key[16], iv[12], tag[16];
+  test_case((unsigned)id, key, iv, msg, opt->aad + opt->size);
+  wait_start(sh);
+
+  for (uint32_t seq = 0;; seq++) {
+    uint64_t t = now_ns();
+    if (t >= sh->deadline) {
+      break;
+    }
+    memcpy(iv + 8, &seq, 4);
+    reference_seal(key, iv, msg, opt->aad, msg + opt->aad, opt->size, out, tag);
+    record(r, now_ns() - t);
+  }
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint32_t *v, size_t n, double q) {
+  size_t i = (size_t)(q * n);
+  return n == 0 ? 0 : v[i < n ? i : n - 1] / 1000.0;
+}
+
+// 跑一轮并输出一行，客户端有失败时返回 0
+static int run(const char *mode, const OPTIONS *opt, SHARED *sh,
+               void (*client)(int, const OPTIONS *, SHARED *)) {
+  memset(sh, 0, sizeof(*sh));
+  fflush(stdout);
+  pid_t pids[MAX_CLIENTS];
+  for (int i = 0; i < opt->clients; i++) {
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      client(i, opt, sh);
+      _exit(0);
+    }
+  }
+  while (__atomic_load_n(&sh->ready, __ATOMIC_ACQUIRE) < opt->clients) {
+    usleep(1000);
+  }
+  uint64_t start = now_ns();
+  sh->deadline = start + (uint64_t)(opt->seconds * 1e9);
+  __atomic_store_n(&sh->go, 1, __ATOMIC_RELEASE);
+  int ok = 1;
+  for (int i = 0; i < opt->clients; i++) {
+    int status;
+    waitpid(pids[i], &status, 0);
+    ok &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  double elapsed = (now_ns() - start) / 1e9;
+
+  uint64_t ops = 0, completed = 0, coalesced = 0;
+  size_t total = 0;
+  for (int i = 0; i < opt->clients; i++) {
+    RESULT *r = &sh->result[i];
+    ok &= !r->failed;
+    ops += r->ops;
+    completed += r->completed;
+    coalesced += r->coalesced;
+    total += r->nsamples < MAX_SAMPLES ? r->nsamples : MAX_SAMPLES;
+  }
+  uint32_t *lat = malloc(sizeof(uint32_t) * (total + 1));
+  size_t n = 0;
+  for (int i = 0; i < opt->clients; i++) {
+    RESULT *r = &sh->result[i];
+    size_t k = r->nsamples < MAX_SAMPLES ? r->nsamples : MAX_SAMPLES;
+    memcpy(lat + n, r->lat, sizeof(uint32_t) * k);
+    n += k;
+  }
+  qsort(lat, n, sizeof(uint32_t), cmp_u32);
+
+  char depth[16] = "-", batch[16] = "-";
+  if (completed > 0) {
+    snprintf(depth, sizeof(depth), "%d", opt->depth);
+    snprintf(batch, sizeof(batch), "%.1f", (double)coalesced / completed);
+  }
+  printf("%-8s %7d %5s %5zu %4zu %9.0f %8.2f %8.1f %8.1f %8.1f %6s%s\n", mode,
+         opt->clients, depth, opt->size, opt->aad, ops / elapsed,
+         ops * opt->size / elapsed / 1048576.0, percentile_us(lat, n, 0.5),
+         percentile_us(lat, n, 0.99), percentile_us(lat, n, 0.999), batch,
+         ok ? "" : "  （有客户端失败）");
+  free(lat);
+  return ok;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "用法：sm4d_load [选项]\n"
+          "  -S 路径         sm4d 的套接字（默认 /tmp/sm4d.sock）\n"
+          "  --spawn 路径    启动该 sm4d 并使用临时套接字，结束时停止它\n"
+          "  --linger 微秒   传给启动的 sm4d（默认 0）\n"
+          "  --poll 微秒     传给启动的 sm4d（默认 0）\n"
+          "  -c 进程数       客户端进程数（默认 8，最多 %d）\n"
+          "  -d 深度         每个客户端的在途请求数（默认 1，最多 %d）\n"
+          "  -s 字节         每条消息的长度（默认 64）\n"
+          "  -a 字节         每条消息的 AAD 长度（默认 16）\n"
+          "  -t 秒           每轮持续时间（默认 2）\n"
+          "  --no-local      不跑进程内直接调用的对照\n",
+          MAX_CLIENTS, SM4_OFFLOAD_SLOTS);
+}
+
+int main(int argc, char **argv) {
+  static const struct option LONG_OPTS[] = {{"spawn", 1, NULL, 'p'},
+                                            {"linger", 1, NULL, 'l'},
+                                            {"poll", 1, NULL, 'P'},
+                                            {"no-local", 0, NULL, 'n'},
+                                            {NULL, 0, NULL, 0}};
+  OPTIONS opt = {"/tmp/sm4d.sock", 8, 1, 64, 16, 2.0};
+  const char *daemon = NULL, *linger = "0", *poll = "0";
+  int local = 1, c;
+  while ((c = getopt_long(argc, argv, "S:c:d:s:a:t:", LONG_OPTS, NULL)) !=
+         -1) {
+    switch (c) {
+    case 'S':
+      opt.path = optarg;
+      break;
+    case 'p':
+      daemon = optarg;
+      break;
+    case 'l':
+      linger = optarg;
+      break;
+    case 'P':
+      poll = optarg;
+      break;
+    case 'n':
+      local = 0;
+      break;
+    case 'c':
+      opt.clients = atoi(optarg);
+      break;
+    case 'd':
+      opt.depth = atoi(optarg);
+      break;
+    case 's':
+      opt.size = strtoul(optarg, NULL, 10);
+      break;
+    case 'a':
+      opt.aad = strtoul(optarg, NULL, 10);
+      break;
+    case 't':
+      opt.seconds = atof(optarg);
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+  if (opt.clients < 1 || opt.clients > MAX_CLIENTS || opt.depth < 1 ||
+      opt.depth > SM4_OFFLOAD_SLOTS || opt.seconds <= 0 ||
+      opt.aad + opt.size > SM4_OFFLOAD_MAX_DATA) {
+    usage();
+    return 1;
+  }
+
+  char path[64];
+  pid_t daemon_pid = -1;
+  if (daemon != NULL) {
+    snprintf(path, sizeof(path), "/tmp/sm4d_load.%d.sock", (int)getpid());
+    opt.path = path;
+    daemon_pid = fork();
+    if (daemon_pid == 0) {
+      execl(daemon, daemon, "-S", path, "--linger", linger, "--poll", poll,
+            "-v", (char *)NULL);
+      fprintf(stderr, "sm4d_load：无法启动 %s：%s\n", daemon, strerror(errno));
+      _exit(127);
+    }
+  }
+
+  printf("\n正确性检查\n");
+  int ok = verify(opt.path);
+  if (ok) {
+    SHARED *sh = mmap(NULL, sizeof(SHARED), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    printf("\n压测（每轮 %.1f 秒，batch 为平均每批请求数）\n", opt.seconds);
+    printf("%-8s %7s %5s %5s %4s %9s %8s %8s %8s %8s %6s\n", "mode",
+           "clients", "depth", "size", "aad", "ops/s", "MB/s", "p50_us",
+           "p99_us", "p999_us", "batch");
+    ok &= run("offload", &opt, sh, offload_client);
+    if (local) {
+      ok &= run("local", &opt, sh, local_client);
+    }
+    munmap(sh, sizeof(SHARED));
+  }
+
+  if (daemon_pid > 0) {
+    kill(daemon_pid, SIGTERM);
+    waitpid(daemon_pid, NULL, 0);
+  }
+  return ok ? 0 : 1;
+}
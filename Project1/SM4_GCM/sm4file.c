@@ -0,0 +1,558 @@
+// sm4file：按段用 SM4-GCM 加解密任意大小的文件。
+//
+// 读、加解密、写三级流水线：读线程按段把输入放进有界的槽位环（普通文件用
+// mmap 映射并提前 MADV_WILLNEED，管道等用 read 并 posix_fadvise 预读），
+// --threads 个工作线程并行处理各段，主线程按段号顺序写出。
+//
+// 文件格式：32 字节文件头，之后每段为密文 || 16 字节标签。
+//   文件头：魔数 "SM4F"、版本、段长（大端 32 位）、7 字节 0、16 字节随机盐
+//   文件密钥：SM4_K(盐)，K 为用户密钥，每个文件各用一个 GCM 密钥
+//   第 i 段的 nonce：7 字节 0 || i（大端 32 位）|| 末段标志，AAD 为整个文件头
+// 同一密钥下 nonce 只在一个文件内唯一，不同文件靠随机盐得到不同的文件密钥，
+// 避免直接用用户密钥时随机 nonce 前缀碰撞导致的 nonce 重用
+// 明文不足一段的段是末段（明文恰为段长的整数倍时追加一个空的末段），
+// 因此删除、重排、截断段或篡改文件头都会使标签校验失败
+#define _GNU_SOURCE
+#include "sm4_gcm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SM4F_MAGIC "SM4F"
+#define SM4F_VERSION 2
+#define SM4F_HEADER_LEN 32
+#define SM4F_TAG_LEN 16
+#define SM4F_SALT_LEN 16
+#define DEFAULT_SEGMENT (1 << 20)
+#define MAX_SEGMENT (64 << 20)
+#define MAX_THREADS 64
+
+static const GHASH_METHOD GHASH_TBL = {.init = ghash_table_init,
+                                       .update = ghash_table_update,
+                                       .final = ghash_table_final,
+                                       .reset = ghash_table_reset};
+
+typedef enum { SLOT_FREE, SLOT_READ, SLOT_DONE } SLOT_STATE;
+
+// 槽位：段号 seq 固定使用第 seq % nslots 个
+typedef struct {
+  SLOT_STATE state;
+  uint64_t seq;
+  const uint8_t *in; // mmap 模式指向映射，否则指向 buf_in
+  size_t in_len;
+  int final;
+  int ok; // 解密时标签是否正确
+  uint8_t *buf_in;
+  uint8_t *buf_out;
+  size_t out_len;
+} SLOT;
+
+typedef struct {
+  int decrypt;
+  uint8_t key[16];      // 用户密钥
+  uint8_t file_key[16]; // 由文件头中的盐导出，实际用于 GCM
+  uint8_t header[SM4F_HEADER_LEN];
+  size_t segment; // 明文段长
+  size_t chunk;   // 每段的输入长度：加密为段长，解密再加标签
+  int in_fd;
+  int out_fd;
+  const uint8_t *map; // 输入映射，NULL 表示 read 模式
+  size_t map_len;
+  size_t map_off; // 数据在映射中的起点（解密时跳过文件头）
+
+  SLOT *slots;
+  size_t nslots;
+  pthread_mutex_t lock; // 保护槽位状态和以下字段
+  pthread_cond_t cond;  // 任一槽位状态变化或出错时广播
+  uint64_t next_crypt;  // 下一个待处理的段号
+  uint64_t nread;       // 读线程已放入的段数
+  int read_done;        // 读线程已结束（读到末段或出错）
+  int abort;
+  const char *error;
+} PIPE;
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static uint32_t get_be32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         p[3];
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 读满 len 字节或到文件尾，返回读到的字节数，出错返回 -1
+static ssize_t read_full(int fd, uint8_t *buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = read(fd, buf + done, len - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+static int write_full(int fd, const uint8_t *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+// 出错：记录第一个错误并唤醒所有等待的线程
+static void pipe_fail(PIPE *p, const char *error) {
+  pthread_mutex_lock(&p->lock);
+  if (!p->abort) {
+    p->abort = 1;
+    p->error = error;
+  }
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+}
+
+// 第一级：按段读取输入
+static void *reader_main(void *arg) {
+  PIPE *p = arg;
+  const char *error = NULL;
+  for (uint64_t seq = 0;; seq++) {
+    SLOT *s = &p->slots[seq % p->nslots];
+    pthread_mutex_lock(&p->lock);
+    while (s->state != SLOT_FREE && !p->abort) {
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    int abort = p->abort;
+    pthread_mutex_unlock(&p->lock);
+    if (abort) {
+      break;
+    }
+    if (seq > UINT32_MAX) {
+      error = "文件过大：段数超过 2^32";
+      break;
+    }
+
+    size_t len;
+    if (p->map != NULL) {
+      size_t off = p->map_off + seq * p->chunk;
+      size_t avail = off < p->map_len ? p->map_len - off : 0;
+      len = avail < p->chunk ? avail : p->chunk;
+      s->in = p->map + off;
+      // 提前让内核读入后面两段，工作线程访问时不再缺页等待磁盘
+      if (avail > p->chunk) {
+        size_t ahead = avail - p->chunk < 2 * p->chunk ? avail - p->chunk
+                                                       : 2 * p->chunk;
+        uintptr_t start = (uintptr_t)(s->in + p->chunk) & ~(uintptr_t)4095;
+        madvise((void *)start, (uintptr_t)(s->in + p->chunk) - start + ahead,
+                MADV_WILLNEED);
+      }
+    } else {
+      ssize_t n = read_full(p->in_fd, s->buf_in, p->chunk);
+      if (n < 0) {
+        error = "读取输入失败";
+        break;
+      }
+      len = n;
+      s->in = s->buf_in;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    s->seq = seq;
+    s->in_len = len;
+    s->final = len < p->chunk;
+    s->state = SLOT_READ;
+    p->nread = seq + 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    if (len < p->chunk) {
+      break;
+    }
+  }
+  if (error != NULL) {
+    pipe_fail(p, error);
+  }
+  pthread_mutex_lock(&p->lock);
+  p->read_done = 1;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+static void process_segment(const PIPE *p, SLOT *s) {
+  uint8_t nonce[12] = {0};
+  put_be32(nonce + 7, (uint32_t)s->seq);
+  nonce[11] = (uint8_t)s->final;
+
+  if (!p->decrypt) {
+    GCM_SM4_CTX ctx;
+    gcm_sm4_init(&ctx, p->file_key, nonce, sizeof(nonce), &GHASH_TBL);
+    gcm_sm4_aad(&ctx, p->header, SM4F_HEADER_LEN);
+    gcm_sm4_encrypt(&ctx, s->in, s->in_len, s->buf_out);
+    gcm_sm4_tag(&ctx, s->buf_out + s->in_len);
+    s->out_len = s->in_len + SM4F_TAG_LEN;
+    s->ok = 1;
+  } else if (s->in_len < SM4F_TAG_LEN) {
+    s->out_len = 0;
+    s->ok = 0;
+  } else {
+    size_t len = s->in_len - SM4F_TAG_LEN;
+    s->ok = sm4_gcm_decrypt(p->file_key, nonce, sizeof(nonce), p->header,
+                            SM4F_HEADER_LEN, s->in, len, s->in + len,
+                            s->buf_out, &GHASH_TBL) == 0;
+    s->out_len = len;
+  }
+}
+
+// 第二级：工作线程按段号顺序领取已读入的段，并行加解密
+static void *worker_main(void *arg) {
+  PIPE *p = arg;
+  for (;;) {
+    pthread_mutex_lock(&p->lock);
+    SLOT *s = NULL;
+    while (!p->abort) {
+      if (p->read_done && p->next_crypt >= p->nread) {
+        break;
+      }
+      SLOT *next = &p->slots[p->next_crypt % p->nslots];
+      if (next->state == SLOT_READ && next->seq == p->next_crypt) {
+        s = next;
+        p->next_crypt++;
+        break;
+      }
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    if (s == NULL) {
+      return NULL;
+    }
+
+    process_segment(p, s);
+
+    pthread_mutex_lock(&p->lock);
+    s->state = SLOT_DONE;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+  }
+}
+
+// 第三级（调用线程）：按段号顺序写出，返回写出的字节数，出错返回 -1
+static int64_t writer_run(PIPE *p) {
+  int64_t total = 0;
+  for (uint64_t seq = 0;; seq++) {
+    SLOT *s = &p->slots[seq % p->nslots];
+    pthread_mutex_lock(&p->lock);
+    while (!p->abort && !(s->state == SLOT_DONE && s->seq == seq) &&
+           !(p->read_done && seq >= p->nread)) {
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    int ready = !p->abort && s->state == SLOT_DONE && s->seq == seq;
+    pthread_mutex_unlock(&p->lock);
+    if (!ready) {
+      if (!p->abort) {
+        pipe_fail(p, "输入被截断：缺少末段");
+      }
+      return -1;
+    }
+    if (!s->ok) {
+      pipe_fail(p, s->in_len < SM4F_TAG_LEN
+                       ? "输入被截断：缺少末段"
+                       : "标签校验失败：密钥错误或数据被篡改");
+      return -1;
+    }
+    if (write_full(p->out_fd, s->buf_out, s->out_len) != 0) {
+      pipe_fail(p, "写出失败");
+      return -1;
+    }
+    total += s->out_len;
+    int final = s->final;
+
+    pthread_mutex_lock(&p->lock);
+    s->state = SLOT_FREE;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    if (final) {
+      return total;
+    }
+  }
+}
+
+// 文件密钥为用户密钥加密文件头中的盐所得的分组
+static void derive_file_key(PIPE *p) {
+  SM4_Key k;
+  sm4_keyInit(p->key, &k);
+  sm4_encrypt(p->header + SM4F_HEADER_LEN - SM4F_SALT_LEN, &k, p->file_key);
+  memset(&k, 0, sizeof(k));
+}
+
+// 建立文件头（加密）或读取并检查文件头（解密），导出文件密钥，
+// 之后确定输入方式
+static const char *pipe_setup(PIPE *p) {
+  struct stat st;
+  int regular = fstat(p->in_fd, &st) == 0 && S_ISREG(st.st_mode);
+
+  // 标准输入重定向自文件时，只有位于文件开头才能按偏移 0 映射
+  if (regular && st.st_size > 0 && lseek(p->in_fd, 0, SEEK_CUR) == 0) {
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, p->in_fd, 0);
+    if (map != MAP_FAILED) {
+      p->map = map;
+      p->map_len = st.st_size;
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+    }
+  }
+  if (p->map == NULL) {
+    posix_fadvise(p->in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  if (!p->decrypt) {
+    memcpy(p->header, SM4F_MAGIC, 4);
+    p->header[4] = SM4F_VERSION;
+    put_be32(p->header + 5, (uint32_t)p->segment);
+    memset(p->header + 9, 0, SM4F_HEADER_LEN - 9 - SM4F_SALT_LEN);
+    uint8_t *salt = p->header + SM4F_HEADER_LEN - SM4F_SALT_LEN;
+    if (getrandom(salt, SM4F_SALT_LEN, 0) != SM4F_SALT_LEN) {
+      return "获取随机盐失败";
+    }
+    derive_file_key(p);
+    p->chunk = p->segment;
+    return NULL;
+  }
+
+  if (p->map != NULL) {
+    if (p->map_len < SM4F_HEADER_LEN) {
+      return "输入过短，不是 sm4file 格式";
+    }
+    memcpy(p->header, p->map, SM4F_HEADER_LEN);
+    p->map_off = SM4F_HEADER_LEN;
+  } else if (read_full(p->in_fd, p->header, SM4F_HEADER_LEN) !=
+             SM4F_HEADER_LEN) {
+    return "输入过短，不是 sm4file 格式";
+  }
+  if (memcmp(p->header, SM4F_MAGIC, 4) != 0 ||
+      p->header[4] != SM4F_VERSION) {
+    return "不是 sm4file 格式或版本不支持";
+  }
+  p->segment = get_be32(p->header + 5);
+  if (p->segment == 0 || p->segment > MAX_SEGMENT) {
+    return "文件头中的段长无效";
+  }
+  derive_file_key(p);
+  p->chunk = p->segment + SM4F_TAG_LEN;
+  return NULL;
+}
+
+static int parse_key(const char *hex, uint8_t key[16]) {
+  if (strlen(hex) != 32) {
+    return -1;
+  }
+  for (int i = 0; i < 16; i++) {
+    unsigned v;
+    if (sscanf(hex + 2 * i, "%2x", &v) != 1) {
+      return -1;
+    }
+    key[i] = (uint8_t)v;
+  }
+  return 0;
+}
+
+static int read_keyfile(const char *path, uint8_t key[16]) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  ssize_t n = read_full(fd, key, 16);
+  close(fd);
+  return n == 16 ? 0 : -1;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "用法：sm4file enc|dec (-k 十六进制密钥 | -K 密钥文件) [-s 段长KB]\n"
+          "              [-t 线程数] [-v] 输入 输出\n"
+          "  输入/输出为 - 时使用标准输入/输出；段长只在加密时指定，"
+          "默认 1024 KB\n");
+}
+
+int main(int argc, char **argv) {
+  static const struct option LONG_OPTS[] = {
+      {"key", required_argument, NULL, 'k'},
+      {"keyfile", required_argument, NULL, 'K'},
+      {"segment", required_argument, NULL, 's'},
+      {"threads", required_argument, NULL, 't'},
+      {"verbose", no_argument, NULL, 'v'},
+      {NULL, 0, NULL, 0}};
+  PIPE p;
+  memset(&p, 0, sizeof(p));
+  p.segment = DEFAULT_SEGMENT;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int have_key = 0, verbose = 0, opt;
+
+  if (argc < 2 || (strcmp(argv[1], "enc") != 0 && strcmp(argv[1], "dec"))) {
+    usage();
+    return 2;
+  }
+  p.decrypt = strcmp(argv[1], "dec") == 0;
+  while ((opt = getopt_long(argc - 1, argv + 1, "k:K:s:t:v", LONG_OPTS,
+                            NULL)) != -1) {
+    switch (opt) {
+    case 'k':
+      if (parse_key(optarg, p.key) != 0) {
+        fprintf(stderr, "密钥必须是 32 个十六进制字符\n");
+        return 2;
+      }
+      have_key = 1;
+      break;
+    case 'K':
+      if (read_keyfile(optarg, p.key) != 0) {
+        fprintf(stderr, "无法从 %s 读取 16 字节密钥\n", optarg);
+        return 2;
+      }
+      have_key = 1;
+      break;
+    case 's':
+      p.segment = (size_t)atol(optarg) << 10;
+      break;
+    case 't':
+      threads = atol(optarg);
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      usage();
+      return 2;
+    }
+  }
+  // getopt 从 argv + 1 开始解析，optind 相对于它
+  if (!have_key || argc - 1 - optind != 2 || p.segment == 0 ||
+      p.segment > MAX_SEGMENT || threads < 1 || threads > MAX_THREADS) {
+    usage();
+    return 2;
+  }
+  const char *in_path = argv[1 + optind], *out_path = argv[2 + optind];
+
+  p.in_fd = strcmp(in_path, "-") == 0 ? STDIN_FILENO : open(in_path, O_RDONLY);
+  if (p.in_fd < 0) {
+    fprintf(stderr, "无法打开输入 %s：%s\n", in_path, strerror(errno));
+    return 1;
+  }
+  int out_is_file = strcmp(out_path, "-") != 0;
+  p.out_fd = out_is_file ? open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0600)
+                         : STDOUT_FILENO;
+  if (p.out_fd < 0) {
+    fprintf(stderr, "无法打开输出 %s：%s\n", out_path, strerror(errno));
+    return 1;
+  }
+
+  const char *error = pipe_setup(&p);
+  if (error == NULL && !p.decrypt &&
+      write_full(p.out_fd, p.header, SM4F_HEADER_LEN) != 0) {
+    error = "写出失败";
+  }
+
+  // 槽位数决定流水线中同时存在的段数，也决定内存上限
+  p.nslots = 2 * threads + 2;
+  p.slots = calloc(p.nslots, sizeof(SLOT));
+  if (p.slots == NULL) {
+    p.nslots = 0;
+    error = error != NULL ? error : "内存不足";
+  }
+  for (size_t i = 0; error == NULL && i < p.nslots; i++) {
+    p.slots[i].buf_out = malloc(p.chunk + SM4F_TAG_LEN);
+    p.slots[i].buf_in = p.map == NULL ? malloc(p.chunk) : NULL;
+    if (p.slots[i].buf_out == NULL || (p.map == NULL && !p.slots[i].buf_in)) {
+      error = "内存不足";
+    }
+  }
+
+  int64_t written = -1;
+  double start = now_sec();
+  if (error == NULL) {
+    pthread_t reader, workers[MAX_THREADS];
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.cond, NULL);
+    // 创建失败时让已启动的线程退出，只等待实际启动了的线程
+    int have_reader = pthread_create(&reader, NULL, reader_main, &p) == 0;
+    long started = 0;
+    while (have_reader && started < threads &&
+           pthread_create(&workers[started], NULL, worker_main, &p) == 0) {
+      started++;
+    }
+    if (!have_reader || started < threads) {
+      pipe_fail(&p, "无法创建线程");
+    } else {
+      written = writer_run(&p);
+      if (written < 0) {
+        pipe_fail(&p, "写出失败");
+      }
+    }
+    if (have_reader) {
+      pthread_join(reader, NULL);
+    }
+    for (long i = 0; i < started; i++) {
+      pthread_join(workers[i], NULL);
+    }
+    error = p.error;
+  }
+  double elapsed = now_sec() - start;
+
+  for (size_t i = 0; i < p.nslots; i++) {
+    free(p.slots[i].buf_in);
+    free(p.slots[i].buf_out);
+  }
+  free(p.slots);
+  if (p.map != NULL) {
+    munmap((void *)p.map, p.map_len);
+  }
+  memset(p.key, 0, sizeof(p.key));
+  memset(p.file_key, 0, sizeof(p.file_key));
+
+  if (error != NULL || written < 0) {
+    fprintf(stderr, "sm4file：%s\n", error != NULL ? error : "写出失败");
+    // 不保留未通过校验或不完整的输出
+    if (out_is_file) {
+      unlink(out_path);
+    }
+    return 1;
+  }
+  if (out_is_file && close(p.out_fd) != 0) {
+    fprintf(stderr, "sm4file：写出失败\n");
+    unlink(out_path);
+    return 1;
+  }
+  if (verbose) {
+    fprintf(stderr,
+            "%s %.1f MB，%ld 线程，段长 %zu KB，用时 %.3f s，%.1f MB/s\n",
+            p.decrypt ? "解密" : "加密", written / 1048576.0, threads,
+            p.segment >> 10, elapsed, written / 1048576.0 / elapsed);
+  }
+  return 0;
+}
@@ -0,0 +1,864 @@
+// 基准测试框架：按消息大小 × 后端 × 工作模式 × 线程数逐组测量。
+//
+// 每组先预热并估计单次耗时，据此确定每轮的调用次数，再重复多轮，给出中位数
+// 与 p99 耗时、rdtsc 周期/字节，以及 perf_event_open 读取的核心周期、IPC、
+// 末级缓存缺失和分支预测失败次数。输入为随机数据，吞吐按实际处理的字节数
+// 计算。结果可输出为文本表格、CSV 或 JSON，便于不同版本之间对比。
+//
+// 空载的微基准里查找表总在 L1 中。--pollute 在每次调用前扫过一段缓冲区，
+// 模拟应用自己的工作集与查找表争用缓存，只计加解密本身的耗时；
+// --corunner 另起线程持续扫缓冲区，绑到同一物理核的超线程上时争用 L1/L2
+#define _GNU_SOURCE
+#include "SM4_GCM/sm4_gcm.h"
+#include "sm4.h"
+#include "sm4_cbc.h"
+#include "sm4_ccm.h"
+#include "sm4_ctr.h"
+#include "sm4_engine.h"
+#include "sm4_mt.h"
+#include "sm4_xts.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#define MAX_LIST 32
+#define MAX_TRIALS 101
+#define XTS_SECTOR 4096 // 超过一个扇区的 XTS 消息按 4 KB 扇区批量处理
+
+typedef enum {
+  MODE_ECB_ENC,
+  MODE_ECB_DEC,
+  MODE_CTR,
+  MODE_CBC_ENC,
+  MODE_CBC_DEC,
+  MODE_XTS,
+  MODE_GCM,
+  MODE_CCM,
+  MODE_COUNT
+} BENCH_MODE;
+
+typedef struct {
+  const char *name;
+  int mt; // 是否有 sm4_mt.c 的多线程版本
+} MODE_INFO;
+
+static const MODE_INFO MODES[MODE_COUNT] = {
+    {"ecb-enc", 1}, {"ecb-dec", 1}, {"ctr", 1}, {"cbc-enc", 0},
+    {"cbc-dec", 1}, {"xts", 0},     {"gcm", 0}, {"ccm", 0},
+};
+
+static const GHASH_METHOD GHASH_TBL = {ghash_table_init, ghash_table_update,
+                                       ghash_table_final, ghash_table_reset};
+
+typedef struct {
+  size_t sizes[MAX_LIST];
+  size_t nsizes;
+  const char *backends[MAX_LIST]; // "auto" 表示不强制，由校准选择
+  size_t nbackends;
+  int modes[MODE_COUNT];
+  size_t nmodes;
+  unsigned threads[MAX_LIST];
+  size_t nthreads;
+  unsigned min_trials;
+  unsigned max_trials;
+  double trial_ms;  // 每轮的目标耗时，决定每轮调用次数
+  double warmup_ms; // 预热时长
+  double row_ms;    // 每组的时间预算，超出后只做到 min_trials 轮
+  int cpu;          // 绑定到的 CPU，-1 表示不绑定
+  int use_perf;
+  size_t pollute;       // 每次调用前扫过的字节数，0 表示不扫
+  size_t corunner;      // 干扰线程反复扫过的字节数，0 表示不启动
+  int corunner_cpu;     // 干扰线程绑定到的 CPU，-1 表示不绑定
+  enum { FMT_TEXT, FMT_CSV, FMT_JSON } format;
+} BENCH_OPTS;
+
+// 一组测量所需的输入与状态
+typedef struct {
+  BENCH_MODE mode;
+  unsigned threads;
+  const uint8_t *in;
+  uint8_t *out;
+  size_t len;
+  uint8_t key_bytes[16];
+  SM4_Key key;
+  SM4_XTS_CTX xts;
+  uint8_t iv[16];
+  uint8_t tag[16];
+} BENCH_CTX;
+
+// 硬件计数器：cycles 为组长，其余随组一起启停
+typedef enum {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_COUNT
+} PERF_EVENT;
+
+static const uint64_t PERF_CONFIG[PERF_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+static int perf_fds[PERF_COUNT] = {-1, -1, -1, -1};
+static const char *perf_error; // 计数器不可用的原因
+
+typedef struct {
+  size_t bytes;
+  const char *backend;
+  const char *mode;
+  unsigned threads;
+  unsigned trials;
+  uint64_t iters;
+  double ns_median, ns_p99, ns_min;
+  double tsc_median, tsc_p99; // TSC 周期/字节
+  int have_perf;
+  double cpb, ipc, llc_per_kb, br_per_kb; // have_perf 为 0 时无效
+} BENCH_RESULT;
+
+static FILE *out;
+static size_t nresults;
+static double tsc_ghz;
+static uint64_t tsc_overhead; // 一对空的 tsc_begin/tsc_end 的周期数
+
+static uint8_t *pollute_buf;
+static volatile int corunner_stop;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// lfence 防止 rdtsc 与前后的指令重排
+static uint64_t tsc_begin(void) {
+  _mm_lfence();
+  uint64_t t = __rdtsc();
+  _mm_lfence();
+  return t;
+}
+
+static uint64_t tsc_end(void) {
+  unsigned aux;
+  uint64_t t = __rdtscp(&aux);
+  _mm_lfence();
+  return t;
+}
+
+// 逐次计时时扣除的 rdtsc 自身开销：取多次空测量的最小值
+static uint64_t measure_tsc_overhead(void) {
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < 1000; i++) {
+    uint64_t c0 = tsc_begin(), c1 = tsc_end();
+    best = c1 - c0 < best ? c1 - c0 : best;
+  }
+  return best;
+}
+
+// 每个缓存行读改写一次，被换出的行是脏的，挤出时还要写回
+static void sweep(uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; i += 64) {
+    ((volatile uint8_t *)buf)[i]++;
+  }
+}
+
+static void *corunner_main(void *arg) {
+  const BENCH_OPTS *opt = arg;
+  uint8_t *buf = aligned_alloc(64, (opt->corunner + 63) & ~(size_t)63);
+  if (buf == NULL) {
+    return NULL;
+  }
+  memset(buf, 0, opt->corunner);
+  while (!corunner_stop) {
+    sweep(buf, opt->corunner);
+  }
+  free(buf);
+  return NULL;
+}
+
+// 用单调时钟标定 TSC 频率（GHz），TSC 周期与核心周期只在定频时一致
+static double measure_tsc_ghz(void) {
+  double t0 = now_ns();
+  uint64_t c0 = tsc_begin();
+  while (now_ns() - t0 < 50e6) {
+  }
+  return (tsc_end() - c0) / (now_ns() - t0);
+}
+
+// perf_event_open：只计用户态、只计调用线程。虚拟机或容器中常常没有
+// 硬件事件，此时各计数项输出为空
+static void perf_open(void) {
+  for (int i = 0; i < PERF_COUNT; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_CONFIG[i];
+    attr.disabled = i == PERF_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    perf_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1,
+                          i == PERF_CYCLES ? -1 : perf_fds[PERF_CYCLES], 0);
+    if (perf_fds[i] < 0) {
+      perf_error = strerror(errno);
+      for (int j = 0; j < i; j++) {
+        close(perf_fds[j]);
+        perf_fds[j] = -1;
+      }
+      return;
+    }
+  }
+}
+
+static int perf_ok(void) { return perf_fds[PERF_CYCLES] >= 0; }
+
+static void perf_start(void) {
+  ioctl(perf_fds[PERF_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(perf_fds[PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// 停止计数并累加到 acc；计数器被多路复用时按运行时间比例放大
+static void perf_stop(double acc[PERF_COUNT]) {
+  uint64_t buf[3 + PERF_COUNT];
+  ioctl(perf_fds[PERF_CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  if (read(perf_fds[PERF_CYCLES], buf, sizeof(buf)) != sizeof(buf) ||
+      buf[2] == 0) {
+    return;
+  }
+  double scale = (double)buf[1] / buf[2];
+  for (int i = 0; i < PERF_COUNT; i++) {
+    acc[i] += buf[3 + i] * scale;
+  }
+}
+
+static void run_op(BENCH_CTX *c) {
+  size_t nblocks = c->len / 16;
+  uint8_t iv[16];
+  int mt = c->threads > 1;
+
+  switch (c->mode) {
+  case MODE_ECB_ENC:
+    if (mt) {
+      sm4_mt_encrypt_blocks(c->in, c->out, nblocks, &c->key);
+    } else {
+      sm4_engine_encrypt_blocks(c->in, c->out, nblocks, &c->key);
+    }
+    break;
+  case MODE_ECB_DEC:
+    if (mt) {
+      sm4_mt_decrypt_blocks(c->in, c->out, nblocks, &c->key);
+    } else {
+      sm4_engine_decrypt_blocks(c->in, c->out, nblocks, &c->key);
+    }
+    break;
+  case MODE_CTR:
+    if (mt) {
+      sm4_mt_ctr_range(&c->key, c->iv, 32, 0, c->in, c->out, c->len);
+    } else {
+      sm4_ctr_range(&c->key, c->iv, 32, 0, c->in, c->out, c->len);
+    }
+    break;
+  case MODE_CBC_ENC:
+    memcpy(iv, c->iv, 16);
+    sm4_cbc_encrypt(c->in, c->out, nblocks, iv, &c->key);
+    break;
+  case MODE_CBC_DEC:
+    memcpy(iv, c->iv, 16);
+    if (mt) {
+      sm4_mt_cbc_decrypt(c->in, c->out, nblocks, iv, &c->key);
+    } else {
+      sm4_cbc_decrypt(c->in, c->out, nblocks, iv, &c->key);
+    }
+    break;
+  case MODE_XTS:
+    if (c->len <= XTS_SECTOR) {
+      sm4_xts_encrypt(&c->xts, c->iv, c->in, c->out, c->len);
+    } else {
+      // 整扇区批量处理，不足一个扇区的尾部作为下一个扇区单独加密，
+      // 计入吞吐量的字节都实际加密过（--sizes 要求 16 的倍数，尾部至少
+      // 16 字节）
+      size_t nsectors = c->len / XTS_SECTOR, done = nsectors * XTS_SECTOR;
+      sm4_xts_encrypt_sectors(&c->xts, 0, XTS_SECTOR, c->in, c->out,
+                              nsectors);
+      if (done < c->len) {
+        memset(iv, 0, 16);
+        for (int i = 0; i < 8; i++) {
+          iv[i] = (uint8_t)((uint64_t)nsectors >> (8 * i));
+        }
+        sm4_xts_encrypt(&c->xts, iv, c->in + done, c->out + done,
+                        c->len - done);
+      }
+    }
+    break;
+  case MODE_GCM: {
+    // 每条消息都重新扩展密钥、计算 H，与 sm4_gcm_encrypt 的调用方式一致
+    GCM_SM4_CTX ctx;
+    gcm_sm4_init(&ctx, c->key_bytes, c->iv, 12, &GHASH_TBL);
+    gcm_sm4_encrypt(&ctx, c->in, c->len, c->out);
+    gcm_sm4_tag(&ctx, c->tag);
+    break;
+  }
+  case MODE_CCM:
+    // 8 字节 nonce 留出 7 字节长度字段，64 MB 的消息也能表示
+    sm4_ccm_encrypt(&c->key, c->iv, 8, NULL, 0, c->in, c->out, c->len,
+                    c->tag, 16);
+    break;
+  default:
+    break;
+  }
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+// 已排序样本的中位数；p99 取最近秩，轮数少于 100 时即最大值
+static double median(const double *v, size_t n) {
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static double p99(const double *v, size_t n) {
+  size_t rank = (size_t)((99 * n + 99) / 100);
+  return v[rank - 1];
+}
+
+static void measure(BENCH_CTX *c, const BENCH_OPTS *opt, BENCH_RESULT *r) {
+  // 预热：缓存、分支预测、TLB 与线程池都进入稳态，同时估计单次耗时
+  uint64_t warm = 0;
+  double start = now_ns();
+  do {
+    if (opt->pollute) {
+      sweep(pollute_buf, opt->pollute);
+    }
+    run_op(c);
+    warm++;
+  } while (now_ns() - start < opt->warmup_ms * 1e6);
+  double est = (now_ns() - start) / warm;
+  uint64_t iters = (uint64_t)(opt->trial_ms * 1e6 / est);
+  if (iters == 0) {
+    iters = 1;
+  }
+
+  double ns[MAX_TRIALS], tsc[MAX_TRIALS], counts[PERF_COUNT] = {0};
+  // 多线程时计数器只覆盖调用线程，不能代表整体，不采集；扫缓冲区时
+  // 计数器会把扫描也算进去，同样不采集
+  int use_perf = perf_ok() && c->threads == 1 && !opt->pollute;
+  unsigned trials = 0;
+  double row_start = now_ns();
+  while (trials < opt->max_trials &&
+         (trials < opt->min_trials ||
+          now_ns() - row_start < opt->row_ms * 1e6)) {
+    if (use_perf) {
+      perf_start();
+    }
+    uint64_t cycles = 0;
+    if (opt->pollute) {
+      // 逐次计时，只计加解密本身
+      for (uint64_t i = 0; i < iters; i++) {
+        sweep(pollute_buf, opt->pollute);
+        uint64_t c0 = tsc_begin();
+        run_op(c);
+        uint64_t c1 = tsc_end();
+        cycles += c1 - c0 > tsc_overhead ? c1 - c0 - tsc_overhead : 0;
+      }
+      ns[trials] = (double)cycles / tsc_ghz / iters;
+    } else {
+      double t0 = now_ns();
+      uint64_t c0 = tsc_begin();
+      for (uint64_t i = 0; i < iters; i++) {
+        run_op(c);
+      }
+      cycles = tsc_end() - c0;
+      ns[trials] = (now_ns() - t0) / iters;
+    }
+    if (use_perf) {
+      perf_stop(counts);
+    }
+    tsc[trials] = (double)cycles / iters / c->len;
+    trials++;
+  }
+  qsort(ns, trials, sizeof(double), cmp_double);
+  qsort(tsc, trials, sizeof(double), cmp_double);
+
+  r->trials = trials;
+  r->iters = iters;
+  r->ns_median = median(ns, trials);
+  r->ns_p99 = p99(ns, trials);
+  r->ns_min = ns[0];
+  r->tsc_median = median(tsc, trials);
+  r->tsc_p99 = p99(tsc, trials);
+  r->have_perf = use_perf && counts[PERF_CYCLES] > 0;
+  if (r->have_perf) {
+    double bytes = (double)c->len * iters * trials;
+    r->cpb = counts[PERF_CYCLES] / bytes;
+    r->ipc = counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES];
+    r->llc_per_kb = counts[PERF_LLC_MISSES] / bytes * 1024;
+    r->br_per_kb = counts[PERF_BRANCH_MISSES] / bytes * 1024;
+  }
+}
+
+static double mb_per_s(const BENCH_RESULT *r) {
+  return r->bytes / (1024.0 * 1024.0) / (r->ns_median / 1e9);
+}
+
+static void format_size(size_t bytes, char *buf, size_t n) {
+  if (bytes >= (1 << 20) && bytes % (1 << 20) == 0) {
+    snprintf(buf, n, "%zuM", bytes >> 20);
+  } else if (bytes >= 1024 && bytes % 1024 == 0) {
+    snprintf(buf, n, "%zuK", bytes >> 10);
+  } else {
+    snprintf(buf, n, "%zu", bytes);
+  }
+}
+
+// 计数器不可用时输出 missing：文本为 -，CSV 留空，JSON 为 null
+static void print_counter(int have, double v, const char *fmt,
+                          const char *missing) {
+  if (have) {
+    fprintf(out, fmt, v);
+  } else {
+    fprintf(out, "%s", missing);
+  }
+}
+
+static void print_header(const BENCH_OPTS *opt, double tsc_ghz) {
+  char cpu[128] = "unknown";
+  FILE *f = fopen("/proc/cpuinfo", "r");
+  char line[256];
+  while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+    char *colon = strchr(line, ':');
+    if (strncmp(line, "model name", 10) == 0 && colon != NULL) {
+      snprintf(cpu, sizeof(cpu), "%s", colon + 2);
+      cpu[strcspn(cpu, "\n")] = 0;
+      break;
+    }
+  }
+  if (f != NULL) {
+    fclose(f);
+  }
+
+  switch (opt->format) {
+  case FMT_TEXT:
+    fprintf(out,
+            "CPU：%s，在线 %ld 个，TSC %.3f GHz，自动选择的大批量后端：%s\n",
+            cpu, sysconf(_SC_NPROCESSORS_ONLN), tsc_ghz,
+            sm4_engine_get(1024)->name);
+    fprintf(out, "硬件计数器：%s\n", perf_ok() ? "可用" : perf_error);
+    if (opt->pollute || opt->corunner) {
+      fprintf(out, "缓存干扰：每次调用前扫过 %zu B，干扰线程 %zu B（CPU %d）\n",
+              opt->pollute, opt->corunner, opt->corunner_cpu);
+    }
+    fprintf(out, "%-8s %-7s %3s %5s %5s %9s %12s %12s %9s %7s %7s %8s %8s "
+                 "%8s %8s\n",
+            "backend", "mode", "thr", "size", "trial", "iters", "median_ns",
+            "p99_ns", "MB/s", "tsc_cpb", "p99_cpb", "cpb", "ipc",
+            "llc/KB", "br/KB");
+    break;
+  case FMT_CSV:
+    fprintf(out, "backend,mode,threads,bytes,trials,iters,median_ns,p99_ns,"
+                 "min_ns,mb_per_s,tsc_cpb_median,tsc_cpb_p99,cycles_per_byte,"
+                 "ipc,llc_misses_per_kb,branch_misses_per_kb\n");
+    break;
+  case FMT_JSON:
+    fprintf(out,
+            "{\n  \"host\": {\"cpu\": \"%s\", \"online_cpus\": %ld, "
+            "\"tsc_ghz\": %.4f, \"auto_bulk_backend\": \"%s\", "
+            "\"perf_counters\": %s, \"pollute_bytes\": %zu, "
+            "\"corunner_bytes\": %zu},\n  \"results\": [",
+            cpu, sysconf(_SC_NPROCESSORS_ONLN), tsc_ghz,
+            sm4_engine_get(1024)->name, perf_ok() ? "true" : "false",
+            opt->pollute, opt->corunner);
+    break;
+  }
+}
+
+static void print_result(const BENCH_OPTS *opt, const BENCH_RESULT *r) {
+  char size[24];
+  format_size(r->bytes, size, sizeof(size));
+  switch (opt->format) {
+  case FMT_TEXT:
+    fprintf(out,
+            "%-8s %-7s %3u %5s %5u %9llu %12.1f %12.1f %9.2f %7.2f %7.2f ",
+            r->backend, r->mode, r->threads, size, r->trials,
+            (unsigned long long)r->iters, r->ns_median, r->ns_p99,
+            mb_per_s(r), r->tsc_median, r->tsc_p99);
+    print_counter(r->have_perf, r->cpb, "%8.2f", "       -");
+    print_counter(r->have_perf, r->ipc, " %8.2f", "        -");
+    print_counter(r->have_perf, r->llc_per_kb, " %8.2f", "        -");
+    print_counter(r->have_perf, r->br_per_kb, " %8.2f", "        -");
+    fprintf(out, "\n");
+    break;
+  case FMT_CSV:
+    fprintf(out, "%s,%s,%u,%zu,%u,%llu,%.1f,%.1f,%.1f,%.3f,%.4f,%.4f,",
+            r->backend, r->mode, r->threads, r->bytes, r->trials,
+            (unsigned long long)r->iters, r->ns_median, r->ns_p99, r->ns_min,
+            mb_per_s(r), r->tsc_median, r->tsc_p99);
+    print_counter(r->have_perf, r->cpb, "%.4f", "");
+    print_counter(r->have_perf, r->ipc, ",%.4f", ",");
+    print_counter(r->have_perf, r->llc_per_kb, ",%.4f", ",");
+    print_counter(r->have_perf, r->br_per_kb, ",%.4f", ",");
+    fprintf(out, "\n");
+    break;
+  case FMT_JSON:
+    fprintf(out,
+            "%s\n    {\"backend\": \"%s\", \"mode\": \"%s\", \"threads\": %u, "
+            "\"bytes\": %zu, \"trials\": %u, \"iters\": %llu, "
+            "\"median_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f, "
+            "\"mb_per_s\": %.3f, \"tsc_cpb_median\": %.4f, "
+            "\"tsc_cpb_p99\": %.4f, \"cycles_per_byte\": ",
+            nresults ? "," : "", r->backend, r->mode, r->threads, r->bytes,
+            r->trials, (unsigned long long)r->iters, r->ns_median, r->ns_p99,
+            r->ns_min, mb_per_s(r), r->tsc_median, r->tsc_p99);
+    print_counter(r->have_perf, r->cpb, "%.4f", "null");
+    fprintf(out, ", \"ipc\": ");
+    print_counter(r->have_perf, r->ipc, "%.4f", "null");
+    fprintf(out, ", \"llc_misses_per_kb\": ");
+    print_counter(r->have_perf, r->llc_per_kb, "%.4f", "null");
+    fprintf(out, ", \"branch_misses_per_kb\": ");
+    print_counter(r->have_perf, r->br_per_kb, "%.4f", "null");
+    fprintf(out, "}");
+    break;
+  }
+  nresults++;
+  fflush(out);
+}
+
+// 强制后端：与 SM4_ENGINE 环境变量相同的机制，各档位及线程池都使用它
+static void select_backend(const char *name) {
+  if (strcmp(name, "auto") == 0) {
+    unsetenv("SM4_ENGINE");
+  } else {
+    setenv("SM4_ENGINE", name, 1);
+  }
+  sm4_engine_calibrate();
+}
+
+static size_t parse_size(const char *s) {
+  char *end;
+  size_t v = strtoull(s, &end, 10);
+  if (*end == 'K' || *end == 'k') {
+    v <<= 10;
+  } else if (*end == 'M' || *end == 'm') {
+    v <<= 20;
+  }
+  return v;
+}
+
+// 逗号分隔的列表，返回项数；超过 MAX_LIST 项的部分忽略
+static size_t split_list(char *s, char **items) {
+  size_t n = 0;
+  for (char *tok = strtok(s, ","); tok != NULL && n < MAX_LIST;
+       tok = strtok(NULL, ",")) {
+    items[n++] = tok;
+  }
+  return n;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "用法：sm4_bench [选项]\n"
+          "  --sizes 16,4K,1M     消息大小，默认 16 B 到 64 MB 按 4 倍递增\n"
+          "  --backends a,b       后端（auto、ref、ttable、ttable1k、sbox、\n"
+          "                       ttable4k、aesni、gather、avx2、bitslice），\n"
+          "                       默认 auto 与全部可用后端\n"
+          "  --modes a,b          ecb-enc、ecb-dec、ctr、cbc-enc、cbc-dec、\n"
+          "                       xts、gcm、ccm，默认全部\n"
+          "  --threads 1,2,4      线程数，只用于有多线程版本的模式，\n"
+          "                       默认 1,2,4\n"
+          "  --trials MIN,MAX     每组轮数，默认 5,31\n"
+          "  --trial-ms N         每轮目标耗时，默认 2\n"
+          "  --warmup-ms N        每组预热时长，默认 20\n"
+          "  --row-ms N           每组时间预算，超出后只做到最少轮数，\n"
+          "                       默认 300\n"
+          "  --cpu N              把测试线程绑定到 CPU N\n"
+          "  --no-perf            不使用 perf_event_open\n"
+          "  --pollute SIZE       每次调用前扫过 SIZE 字节，逐次计时\n"
+          "  --corunner SIZE      干扰线程反复扫过 SIZE 字节\n"
+          "  --corunner-cpu N     把干扰线程绑定到 CPU N\n"
+          "  --format text|csv|json，-o 文件\n");
+}
+
+static int parse_opts(int argc, char **argv, BENCH_OPTS *opt) {
+  static const struct option LONG_OPTS[] = {
+      {"sizes", required_argument, NULL, 's'},
+      {"backends", required_argument, NULL, 'b'},
+      {"modes", required_argument, NULL, 'm'},
+      {"threads", required_argument, NULL, 't'},
+      {"trials", required_argument, NULL, 'n'},
+      {"trial-ms", required_argument, NULL, 'T'},
+      {"warmup-ms", required_argument, NULL, 'w'},
+      {"row-ms", required_argument, NULL, 'r'},
+      {"cpu", required_argument, NULL, 'c'},
+      {"no-perf", no_argument, NULL, 'P'},
+      {"pollute", required_argument, NULL, 'p'},
+      {"corunner", required_argument, NULL, 'C'},
+      {"corunner-cpu", required_argument, NULL, 'k'},
+      {"format", required_argument, NULL, 'f'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+  char *items[MAX_LIST];
+  int c;
+
+  memset(opt, 0, sizeof(*opt));
+  for (size_t s = 16; s <= (64 << 20); s *= 4) {
+    opt->sizes[opt->nsizes++] = s;
+  }
+  opt->backends[opt->nbackends++] = "auto";
+  size_t engine_count;
+  const SM4_ENGINE *engines = sm4_engine_list(&engine_count);
+  for (size_t i = 0; i < engine_count; i++) {
+    opt->backends[opt->nbackends++] = engines[i].name;
+  }
+  for (int m = 0; m < MODE_COUNT; m++) {
+    opt->modes[opt->nmodes++] = m;
+  }
+  opt->threads[0] = 1;
+  opt->threads[1] = 2;
+  opt->threads[2] = 4;
+  opt->nthreads = 3;
+  opt->min_trials = 5;
+  opt->max_trials = 31;
+  opt->trial_ms = 2;
+  opt->warmup_ms = 20;
+  opt->row_ms = 300;
+  opt->cpu = -1;
+  opt->use_perf = 1;
+  opt->corunner_cpu = -1;
+
+  while ((c = getopt_long(argc, argv, "o:h", LONG_OPTS, NULL)) != -1) {
+    switch (c) {
+    case 's':
+      opt->nsizes = split_list(optarg, items);
+      for (size_t i = 0; i < opt->nsizes; i++) {
+        opt->sizes[i] = parse_size(items[i]);
+        if (opt->sizes[i] < 16 || opt->sizes[i] % 16 != 0) {
+          fprintf(stderr, "消息大小必须是 16 的倍数：%s\n", items[i]);
+          return -1;
+        }
+      }
+      break;
+    case 'b':
+      opt->nbackends = split_list(optarg, items);
+      for (size_t i = 0; i < opt->nbackends; i++) {
+        if (strcmp(items[i], "auto") != 0 && !sm4_engine_find(items[i])) {
+          fprintf(stderr, "未知后端：%s\n", items[i]);
+          return -1;
+        }
+        opt->backends[i] = items[i];
+      }
+      break;
+    case 'm':
+      opt->nmodes = split_list(optarg, items);
+      for (size_t i = 0; i < opt->nmodes; i++) {
+        int m = 0;
+        while (m < MODE_COUNT && strcmp(items[i], MODES[m].name) != 0) {
+          m++;
+        }
+        if (m == MODE_COUNT) {
+          fprintf(stderr, "未知模式：%s\n", items[i]);
+          return -1;
+        }
+        opt->modes[i] = m;
+      }
+      break;
+    case 't':
+      opt->nthreads = split_list(optarg, items);
+      for (size_t i = 0; i < opt->nthreads; i++) {
+        opt->threads[i] = atoi(items[i]);
+        if (opt->threads[i] == 0) {
+          return -1;
+        }
+      }
+      break;
+    case 'n':
+      if (sscanf(optarg, "%u,%u", &opt->min_trials, &opt->max_trials) != 2 ||
+          opt->min_trials == 0 || opt->min_trials > opt->max_trials ||
+          opt->max_trials > MAX_TRIALS) {
+        fprintf(stderr, "--trials 需要 MIN,MAX，1 <= MIN <= MAX <= %d\n",
+                MAX_TRIALS);
+        return -1;
+      }
+      break;
+    case 'T':
+      opt->trial_ms = atof(optarg);
+      break;
+    case 'w':
+      opt->warmup_ms = atof(optarg);
+      break;
+    case 'r':
+      opt->row_ms = atof(optarg);
+      break;
+    case 'c':
+      opt->cpu = atoi(optarg);
+      break;
+    case 'P':
+      opt->use_perf = 0;
+      break;
+    case 'p':
+      opt->pollute = parse_size(optarg);
+      break;
+    case 'C':
+      opt->corunner = parse_size(optarg);
+      break;
+    case 'k':
+      opt->corunner_cpu = atoi(optarg);
+      break;
+    case 'f':
+      if (strcmp(optarg, "text") == 0) {
+        opt->format = FMT_TEXT;
+      } else if (strcmp(optarg, "csv") == 0) {
+        opt->format = FMT_CSV;
+      } else if (strcmp(optarg, "json") == 0) {
+        opt->format = FMT_JSON;
+      } else {
+        return -1;
+      }
+      break;
+    case 'o':
+      out = fopen(optarg, "w");
+      if (out == NULL) {
+        fprintf(stderr, "无法写入 %s\n", optarg);
+        return -1;
+      }
+      break;
+    default:
+      return -1;
+    }
+  }
+  return optind == argc ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+  BENCH_OPTS opt;
+  out = stdout;
+  if (parse_opts(argc, argv, &opt) != 0) {
+    usage();
+    return 2;
+  }
+  if (opt.cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(opt.cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+  }
+  if (opt.use_perf) {
+    perf_open();
+  } else {
+    perf_error = "已用 --no-perf 关闭";
+  }
+
+  size_t max_size = 0;
+  for (size_t i = 0; i < opt.nsizes; i++) {
+    max_size = opt.sizes[i] > max_size ? opt.sizes[i] : max_size;
+  }
+  // 随机输入，避免全零数据让分支预测或缓存表现失真
+  uint8_t *in = aligned_alloc(64, max_size);
+  uint8_t *buf = aligned_alloc(64, max_size);
+  if (in == NULL || buf == NULL) {
+    fprintf(stderr, "内存分配失败\n");
+    return 1;
+  }
+  uint64_t x = 0x9E3779B97F4A7C15ULL;
+  for (size_t i = 0; i < max_size; i++) {
+    x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+    in[i] = (uint8_t)x;
+  }
+  memset(buf, 0, max_size);
+
+  if (opt.pollute) {
+    pollute_buf = aligned_alloc(64, (opt.pollute + 63) & ~(size_t)63);
+    if (pollute_buf == NULL) {
+      fprintf(stderr, "内存分配失败\n");
+      return 1;
+    }
+    memset(pollute_buf, 0, opt.pollute);
+  }
+  pthread_t corunner;
+  if (opt.corunner) {
+    pthread_create(&corunner, NULL, corunner_main, &opt);
+    if (opt.corunner_cpu >= 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(opt.corunner_cpu, &set);
+      pthread_setaffinity_np(corunner, sizeof(set), &set);
+    }
+  }
+
+  BENCH_CTX ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  memcpy(ctx.key_bytes, in, 16);
+  sm4_keyInit(ctx.key_bytes, &ctx.key);
+  sm4_xts_init(&ctx.xts, in + 16, SM4_XTS_GB);
+  memcpy(ctx.iv, in + 48, 16);
+  ctx.in = in;
+  ctx.out = buf;
+
+  tsc_ghz = measure_tsc_ghz();
+  tsc_overhead = measure_tsc_overhead();
+  print_header(&opt, tsc_ghz);
+  unsigned configured = 0;
+  for (size_t b = 0; b < opt.nbackends; b++) {
+    const SM4_ENGINE *engine = sm4_engine_find(opt.backends[b]);
+    if (engine != NULL && !sm4_engine_available(engine)) {
+      fprintf(stderr, "后端 %s：当前 CPU 不支持，跳过\n", opt.backends[b]);
+      continue;
+    }
+    select_backend(opt.backends[b]);
+    for (size_t m = 0; m < opt.nmodes; m++) {
+      for (size_t t = 0; t < opt.nthreads; t++) {
+        unsigned threads = opt.threads[t];
+        if (threads > 1 && !MODES[opt.modes[m]].mt) {
+          continue;
+        }
+        if (threads > 1 && threads != configured) {
+          SM4_MT_OPTIONS mt = {threads, 0, 0};
+          sm4_mt_configure(&mt);
+          configured = threads;
+        }
+        for (size_t s = 0; s < opt.nsizes; s++) {
+          BENCH_RESULT r;
+          memset(&r, 0, sizeof(r));
+          ctx.mode = opt.modes[m];
+          ctx.threads = threads;
+          ctx.len = opt.sizes[s];
+          measure(&ctx, &opt, &r);
+          r.bytes = ctx.len;
+          r.backend = opt.backends[b];
+          r.mode = MODES[ctx.mode].name;
+          r.threads = threads;
+          print_result(&opt, &r);
+        }
+      }
+    }
+  }
+  if (opt.format == FMT_JSON) {
+    fprintf(out, "\n  ]\n}\n");
+  }
+
+  if (opt.corunner) {
+    corunner_stop = 1;
+    pthread_join(corunner, NULL);
+  }
+  sm4_mt_shutdown();
+  free(in);
+  free(buf);
+  free(pollute_buf);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -1,17 +1,42 @@
 #include "sm4.h"
 #include "sm4_aesni.h"
+#include "sm4_avx2.h"
+#include "sm4_bitslice.h"
+#include "sm4_cbc.h"
+#include "sm4_ccm.h"
+#include "sm4_ctr.h"
+#include "sm4_drbg.h"
+#include "sm4_engine.h"
+#include "sm4_gather.h"
+#include "sm4_kspool.h"
+#include "sm4_mt.h"
+#include "sm4_stream.h"
 #include "sm4_ttable.h"
+#include "sm4_xts.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #define BLOCK_SIZE 16       // SM4 每个块是 128 位（16 字节）
 #define NUM_BLOCKS 10000000 // 可根据需要调整数据量
 
+#define MULTIKEY_KEYS 4096   // 多密钥 benchmark 中的会话密钥数
+#define MULTIKEY_BATCH 64    // 网关每次凑齐的记录数
+
+#define CCM_MSG_SIZE 1024 // CCM benchmark 中每条消息的字节数
+
+#define KEYINIT_ROUNDS 256 // 密钥扩展 benchmark 把 MULTIKEY_KEYS 个密钥扩展几遍
+
+#define RANGE_OBJECT_SIZE (8ULL << 30) // 区间读取所在对象的大小：8 GB
+#define RANGE_READS 200000             // 每种读取长度的随机读取次数
+
 typedef void (*EncryptFunc)(const uint8_t[16], const SM4_Key *, uint8_t[16]);
 typedef void (*DecryptFunc)(const uint8_t[16], const SM4_Key *, uint8_t[16]);
+typedef void (*BlocksFunc)(const uint8_t *, uint8_t *, size_t,
+                           const SM4_Key *);
 
 void print_speed(const char *label, size_t total_bytes, double seconds) {
   double speed = total_bytes / (1024.0 * 1024.0) / seconds;
@@ -53,6 +78,614 @@ void benchmark(const char *label_enc, const char *label_dec,
   free(output);
 }
 
+// 多块接口 benchmark：一次调用处理整个缓冲区
+void benchmark_blocks(const char *label_enc, const char *label_dec,
+                      BlocksFunc encrypt, BlocksFunc decrypt,
+                      const uint8_t *key) {
+  uint8_t *buf = malloc(NUM_BLOCKS * BLOCK_SIZE);
+  if (!buf) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < (size_t)NUM_BLOCKS * BLOCK_SIZE; i++) {
+    buf[i] = (uint8_t)i;
+  }
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+
+  printf("开始 benchmark：%s\n", label_enc);
+  clock_t start_enc = clock();
+  encrypt(buf, buf, NUM_BLOCKS, &sm4_key);
+  clock_t end_enc = clock();
+  double time_enc = (double)(end_enc - start_enc) / CLOCKS_PER_SEC;
+  print_speed(label_enc, NUM_BLOCKS * BLOCK_SIZE, time_enc);
+
+  printf("开始 benchmark：%s\n", label_dec);
+  clock_t start_dec = clock();
+  decrypt(buf, buf, NUM_BLOCKS, &sm4_key);
+  clock_t end_dec = clock();
+  double time_dec = (double)(end_dec - start_dec) / CLOCKS_PER_SEC;
+  print_speed(label_dec, NUM_BLOCKS * BLOCK_SIZE, time_dec);
+
+  free(buf);
+}
+
+typedef void (*KernelFunc)(const uint8_t *, uint8_t *, const SM4_Key *, int);
+
+// 单个 SIMD 内核直接循环调用，width 为每次处理的块数。缓冲区放在 L1 内
+// 反复加密，只比较 S 盒实现本身（AES 单元仿射变换 vs vpgatherdd 查 T 表）
+static void benchmark_kernel(const char *label, KernelFunc kernel, int width,
+                             const SM4_Key *key) {
+  enum { KERNEL_BUF_BLOCKS = 256 };
+  static uint8_t buf[KERNEL_BUF_BLOCKS * BLOCK_SIZE];
+  size_t rounds = (size_t)NUM_BLOCKS / KERNEL_BUF_BLOCKS;
+  clock_t start = clock();
+  for (size_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < KERNEL_BUF_BLOCKS; i += width) {
+      kernel(buf + BLOCK_SIZE * i, buf + BLOCK_SIZE * i, key, 0);
+    }
+  }
+  print_speed(label, rounds * KERNEL_BUF_BLOCKS * BLOCK_SIZE,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+}
+
+void benchmark_kernels(const uint8_t *key) {
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  if (sm4_engine_available(sm4_engine_find("aesni"))) {
+    benchmark_kernel("SM4_AESNI_do（4 路，AES-NI S 盒）", SM4_AESNI_do, 4,
+                     &sm4_key);
+  }
+  if (sm4_engine_available(sm4_engine_find("avx2"))) {
+    benchmark_kernel("SM4_AVX2_do8（8 路，AES S 盒）", SM4_AVX2_do8, 8,
+                     &sm4_key);
+  }
+  if (sm4_engine_available(sm4_engine_find("gather"))) {
+    benchmark_kernel("SM4_GATHER_do8（8 路，gather 查 T 表）", SM4_GATHER_do8,
+                     8, &sm4_key);
+  }
+}
+
+// 区间读取 benchmark：在 RANGE_OBJECT_SIZE 大小的 CTR 密文对象中随机偏移
+// 读取小区间。只计时解密本身，密文内容不影响耗时，因此不必真的分配 8 GB；
+// 另用大块 CTR 吞吐估算“从头顺序解密到偏移处”的平均代价作为对照
+void benchmark_range(const uint8_t *key) {
+  static const size_t LENS[] = {64, 4096, 65536};
+  size_t max_len = LENS[sizeof(LENS) / sizeof(LENS[0]) - 1];
+  uint8_t iv[16] = {0};
+  uint8_t *src = malloc(max_len);
+  uint8_t *dst = malloc(max_len);
+  uint8_t *bulk = malloc(NUM_BLOCKS * BLOCK_SIZE);
+  if (!src || !dst || !bulk) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  memset(src, 0x5A, max_len);
+  memset(bulk, 0x5A, NUM_BLOCKS * BLOCK_SIZE);
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+
+  clock_t start = clock();
+  sm4_ctr_range(&sm4_key, iv, 32, 0, bulk, bulk, NUM_BLOCKS * BLOCK_SIZE);
+  double bulk_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+  double bulk_speed = NUM_BLOCKS * BLOCK_SIZE / bulk_time;
+  print_speed("SM4-CTR 顺序解密", NUM_BLOCKS * BLOCK_SIZE, bulk_time);
+  printf("顺序解密到平均偏移（%.1f GB）约需：%.2f s\n",
+         RANGE_OBJECT_SIZE / 2 / (1024.0 * 1024.0 * 1024.0),
+         RANGE_OBJECT_SIZE / 2 / bulk_speed);
+
+  uint64_t seed = 0x9E3779B97F4A7C15ULL;
+  for (size_t l = 0; l < sizeof(LENS) / sizeof(LENS[0]); l++) {
+    size_t len = LENS[l];
+    size_t reads = RANGE_READS * 64 / len + 1; // 长区间少读几次，总量相近
+    start = clock();
+    for (size_t r = 0; r < reads; r++) {
+      // xorshift64 生成随机偏移，起点一般不按 16 字节对齐
+      seed ^= seed << 13;
+      seed ^= seed >> 7;
+      seed ^= seed << 17;
+      uint64_t off = seed % (RANGE_OBJECT_SIZE - len);
+      sm4_ctr_range(&sm4_key, iv, 32, off, src, dst, len);
+    }
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("随机区间读取 %6zu 字节：%.2f us/次，", len, elapsed * 1e6 / reads);
+    print_speed("吞吐", reads * len, elapsed);
+  }
+
+  free(src);
+  free(dst);
+  free(bulk);
+}
+
+// 多密钥 benchmark：每条记录一个分组、各用不同会话密钥。
+// 对照组逐条调用单块最快的后端，实验组每 MULTIKEY_BATCH 条合成一次多密钥调用
+void benchmark_multikey(void) {
+  size_t total = (size_t)NUM_BLOCKS * BLOCK_SIZE;
+  uint8_t *buf = malloc(total);
+  SM4_Key *keys = malloc(MULTIKEY_KEYS * sizeof(SM4_Key));
+  const SM4_Key **key_ptrs = malloc(NUM_BLOCKS * sizeof(SM4_Key *));
+  if (!buf || !keys || !key_ptrs) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  memset(buf, 0x2D, total);
+  for (size_t i = 0; i < MULTIKEY_KEYS; i++) {
+    uint8_t key[16];
+    for (int j = 0; j < 16; j++) {
+      key[j] = (uint8_t)(i * 31 + j);
+    }
+    sm4_keyInit(key, &keys[i]);
+  }
+  // 记录与密钥的对应关系打乱，模拟交错到达的会话
+  for (size_t i = 0; i < NUM_BLOCKS; i++) {
+    key_ptrs[i] = &keys[(i * 2654435761u) % MULTIKEY_KEYS];
+  }
+
+  SM4_BlocksFunc single = sm4_engine_get(1)->encrypt_blocks;
+  clock_t start = clock();
+  for (size_t i = 0; i < NUM_BLOCKS; i++) {
+    single(buf + 16 * i, buf + 16 * i, 1, key_ptrs[i]);
+  }
+  char label[64];
+  snprintf(label, sizeof(label), "逐条单块加密（%s）", sm4_engine_get(1)->name);
+  print_speed(label, total, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  size_t engine_count;
+  const SM4_ENGINE *engines = sm4_engine_list(&engine_count);
+  for (size_t e = 0; e < engine_count; e++) {
+    if (!sm4_engine_available(&engines[e]) ||
+        engines[e].encrypt_multikey == NULL) {
+      continue;
+    }
+    start = clock();
+    for (size_t i = 0; i < NUM_BLOCKS; i += MULTIKEY_BATCH) {
+      size_t n = NUM_BLOCKS - i < MULTIKEY_BATCH ? NUM_BLOCKS - i
+                                                 : MULTIKEY_BATCH;
+      engines[e].encrypt_multikey(buf + 16 * i, buf + 16 * i, n,
+                                  key_ptrs + i);
+    }
+    snprintf(label, sizeof(label), "%s 多密钥加密（每批 %d 条）",
+             engines[e].name, MULTIKEY_BATCH);
+    print_speed(label, total, (double)(clock() - start) / CLOCKS_PER_SEC);
+  }
+
+  free(buf);
+  free(keys);
+  free(key_ptrs);
+}
+
+// CBC benchmark：单路串行加密、多路交错加密、并行解密
+void benchmark_cbc(const uint8_t *key) {
+  enum { CBC_STREAMS = 8 };
+  size_t total = (size_t)NUM_BLOCKS * BLOCK_SIZE;
+  uint8_t *buf = malloc(total);
+  if (!buf) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  memset(buf, 0x3C, total);
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  uint8_t iv[16] = {0};
+
+  clock_t start = clock();
+  sm4_cbc_encrypt(buf, buf, NUM_BLOCKS, iv, &sm4_key);
+  print_speed("SM4-CBC 单路加密", total,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  // 把同一缓冲区切成 CBC_STREAMS 段，当作互相独立的消息
+  SM4_CBC_STREAM streams[CBC_STREAMS];
+  size_t per = NUM_BLOCKS / CBC_STREAMS;
+  for (int s = 0; s < CBC_STREAMS; s++) {
+    streams[s].in = buf + 16 * per * s;
+    streams[s].out = buf + 16 * per * s;
+    streams[s].nblocks = per;
+    memset(streams[s].iv, s, 16);
+  }
+  start = clock();
+  sm4_cbc_encrypt_multi(streams, CBC_STREAMS, &sm4_key);
+  print_speed("SM4-CBC 8 路交错加密", 16 * per * CBC_STREAMS,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  memset(iv, 0, 16);
+  start = clock();
+  sm4_cbc_decrypt(buf, buf, NUM_BLOCKS, iv, &sm4_key);
+  print_speed("SM4-CBC 并行解密", total,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  free(buf);
+}
+
+// XTS benchmark：512 B / 4 KB 扇区，单扇区延迟与批量吞吐
+void benchmark_xts(void) {
+  static const size_t SECTOR_SIZES[] = {512, 4096};
+  static const uint8_t xts_key[32] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB,
+                                      0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98,
+                                      0x76, 0x54, 0x32, 0x10};
+  size_t total = (size_t)NUM_BLOCKS * BLOCK_SIZE;
+  uint8_t *buf = malloc(total);
+  if (!buf) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  memset(buf, 0x6E, total);
+
+  SM4_XTS_CTX ctx;
+  sm4_xts_init(&ctx, xts_key, SM4_XTS_GB);
+
+  for (size_t i = 0; i < sizeof(SECTOR_SIZES) / sizeof(SECTOR_SIZES[0]); i++) {
+    size_t sector_size = SECTOR_SIZES[i];
+    size_t nsectors = total / sector_size;
+    char label[64];
+
+    // 逐扇区调用，统计单扇区延迟
+    clock_t start = clock();
+    for (size_t s = 0; s < nsectors; s++) {
+      sm4_xts_encrypt_sectors(&ctx, s, sector_size, buf + s * sector_size,
+                              buf + s * sector_size, 1);
+    }
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("SM4-XTS %zu 字节扇区：%.2f us/扇区，", sector_size,
+           elapsed * 1e6 / nsectors);
+    print_speed("加密", total, elapsed);
+
+    start = clock();
+    sm4_xts_decrypt_sectors(&ctx, 0, sector_size, buf, buf, nsectors);
+    snprintf(label, sizeof(label), "SM4-XTS %zu 字节扇区批量解密", sector_size);
+    print_speed(label, total, (double)(clock() - start) / CLOCKS_PER_SEC);
+  }
+
+  free(buf);
+}
+
+typedef void (*KeyInitBatchFunc)(const uint8_t *const *, size_t, SM4_Key *);
+
+static void report_keyinit(const char *label, double seconds) {
+  double count = (double)MULTIKEY_KEYS * KEYINIT_ROUNDS;
+  printf("%s：%.1f ns/个，%.2f 百万个/s\n", label, seconds * 1e9 / count,
+         count / seconds / 1e6);
+}
+
+// 密钥扩展：逐个 sm4_keyInit 与各批量实现。每次为 MULTIKEY_BATCH 个新连接
+// 扩展密钥，结果写入同一块缓冲区（随后即被记录加密使用，仍在缓存中）
+void benchmark_keyinit(void) {
+  uint8_t (*raw)[16] = malloc(MULTIKEY_KEYS * 16);
+  const uint8_t **key_ptrs = malloc(MULTIKEY_KEYS * sizeof(uint8_t *));
+  SM4_Key *keys = malloc(MULTIKEY_BATCH * sizeof(SM4_Key));
+  if (!raw || !key_ptrs || !keys) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < MULTIKEY_KEYS; i++) {
+    for (int j = 0; j < 16; j++) {
+      raw[i][j] = (uint8_t)(i * 131 + j);
+    }
+    key_ptrs[i] = raw[i];
+  }
+
+  clock_t start = clock();
+  for (int r = 0; r < KEYINIT_ROUNDS; r++) {
+    for (size_t i = 0; i < MULTIKEY_KEYS; i++) {
+      sm4_keyInit(raw[i], &keys[i % MULTIKEY_BATCH]);
+    }
+  }
+  report_keyinit("逐个 sm4_keyInit",
+                 (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  struct {
+    const char *engine;
+    const char *label;
+    KeyInitBatchFunc fn;
+  } impls[] = {
+      {"aesni", "AES-NI 批量扩展（4 路）", sm4_keyInit_batch_aesni},
+      {"avx2", "AVX2 批量扩展（16 路）", sm4_keyInit_batch_avx2},
+  };
+  for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+    if (!sm4_engine_available(sm4_engine_find(impls[k].engine))) {
+      continue;
+    }
+    start = clock();
+    for (int r = 0; r < KEYINIT_ROUNDS; r++) {
+      for (size_t i = 0; i < MULTIKEY_KEYS; i += MULTIKEY_BATCH) {
+        impls[k].fn(key_ptrs + i, MULTIKEY_BATCH, keys);
+      }
+    }
+    report_keyinit(impls[k].label, (double)(clock() - start) / CLOCKS_PER_SEC);
+  }
+
+  free(raw);
+  free(key_ptrs);
+  free(keys);
+}
+
+// 朴素 CCM 加密：CBC-MAC 与 CTR 各自逐块调用单块接口（nonce 12 字节、
+// 无 AAD、长度为 16 的倍数），作为流水线实现的对照
+static void naive_ccm_encrypt(const SM4_Key *key, const uint8_t nonce[12],
+                              const uint8_t *in, uint8_t *out, size_t len,
+                              uint8_t tag[16]) {
+  SM4_BlocksFunc encrypt = sm4_engine_get(1)->encrypt_blocks;
+  uint8_t x[16] = {(16 - 2) / 2 << 3 | 2}, a[16] = {2}, s[16];
+  memcpy(x + 1, nonce, 12);
+  x[14] = (uint8_t)(len >> 8);
+  x[15] = (uint8_t)len;
+  memcpy(a + 1, nonce, 12);
+  encrypt(x, x, 1, key);
+  for (size_t i = 0; i < len; i += 16) {
+    for (int j = 0; j < 16; j++) {
+      x[j] ^= in[i + j];
+    }
+    encrypt(x, x, 1, key);
+  }
+  for (size_t i = 0; i <= len / 16; i++) {
+    a[14] = (uint8_t)(i >> 8);
+    a[15] = (uint8_t)i;
+    encrypt(a, s, 1, key);
+    for (int j = 0; j < 16; j++) {
+      if (i == 0) {
+        tag[j] = x[j] ^ s[j];
+      } else {
+        out[16 * (i - 1) + j] = in[16 * (i - 1) + j] ^ s[j];
+      }
+    }
+  }
+}
+
+void benchmark_ccm(const uint8_t *key) {
+  enum { CCM_STREAMS = 8 };
+  size_t total = (size_t)NUM_BLOCKS * BLOCK_SIZE / 4;
+  size_t nmsgs = total / CCM_MSG_SIZE;
+  uint8_t *buf = malloc(total);
+  uint8_t nonce[12] = {0};
+  uint8_t tag[16];
+  if (!buf) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  memset(buf, 0x6B, total);
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  char label[64];
+
+  clock_t start = clock();
+  for (size_t m = 0; m < nmsgs; m++) {
+    uint8_t *p = buf + m * CCM_MSG_SIZE;
+    naive_ccm_encrypt(&sm4_key, nonce, p, p, CCM_MSG_SIZE, tag);
+  }
+  snprintf(label, sizeof(label), "朴素 CCM 加密（%d 字节/条）", CCM_MSG_SIZE);
+  print_speed(label, total, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  start = clock();
+  for (size_t m = 0; m < nmsgs; m++) {
+    uint8_t *p = buf + m * CCM_MSG_SIZE;
+    sm4_ccm_encrypt(&sm4_key, nonce, 12, NULL, 0, p, p, CCM_MSG_SIZE, tag, 16);
+  }
+  print_speed("sm4_ccm_encrypt 单条加密", total,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  SM4_CCM_MSG msgs[CCM_STREAMS];
+  start = clock();
+  for (size_t m = 0; m + CCM_STREAMS <= nmsgs; m += CCM_STREAMS) {
+    for (int s = 0; s < CCM_STREAMS; s++) {
+      uint8_t *p = buf + (m + s) * CCM_MSG_SIZE;
+      msgs[s] = (SM4_CCM_MSG){.nonce = nonce, .nonce_len = 12, .in = p,
+                              .out = p, .len = CCM_MSG_SIZE};
+    }
+    sm4_ccm_encrypt_multi(msgs, CCM_STREAMS, 16, &sm4_key);
+  }
+  snprintf(label, sizeof(label), "%d 条消息交错加密", CCM_STREAMS);
+  print_speed(label, nmsgs / CCM_STREAMS * CCM_STREAMS * CCM_MSG_SIZE,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  free(buf);
+}
+
+// 随机数生成：libc rand() 逐字节、DRBG 整块生成、每线程实例取 16 字节 nonce
+void benchmark_drbg(void) {
+  enum { NONCE_LEN = 16 };
+  size_t total = (size_t)NUM_BLOCKS * BLOCK_SIZE / 4;
+  uint8_t *buf = malloc(total);
+  uint8_t entropy[32] = {0};
+  if (!buf) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+
+  clock_t start = clock();
+  for (size_t i = 0; i < total; i++) {
+    buf[i] = rand() % 256;
+  }
+  print_speed("rand() % 256 逐字节", total,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  static SM4_DRBG drbg;
+  sm4_drbg_instantiate(&drbg, entropy, 32, NULL, 0, NULL, 0);
+  start = clock();
+  sm4_drbg_generate(&drbg, buf, total, NULL, 0);
+  print_speed("sm4_drbg_generate 整块生成", total,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  start = clock();
+  for (size_t off = 0; off + NONCE_LEN <= total; off += NONCE_LEN) {
+    sm4_random_bytes(buf + off, NONCE_LEN);
+  }
+  print_speed("sm4_random_bytes 逐个 16 字节", total,
+              (double)(clock() - start) / CLOCKS_PER_SEC);
+
+  sm4_drbg_clear(&drbg);
+  free(buf);
+}
+
+// 墙钟时间（秒）：多线程时 clock() 统计的是所有线程的 CPU 时间
+static double wall_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// 小消息 CTR 延迟：现场计算密钥流（池为空，全部未命中）与预生成后只做
+// 异或（全部命中）。填充不计时，模拟在消息间隙完成
+void benchmark_kspool(const uint8_t *key) {
+  static const size_t SIZES[] = {64, 256, 512};
+  enum { POOL_SLOTS = 256, POOL_ROUNDS = 2000 };
+  static const uint8_t iv[12] = {0};
+  static uint8_t msg[512];
+  uint8_t ek0[16];
+
+  for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+    size_t len = SIZES[i];
+    SM4_KSPOOL pool;
+    if (sm4_kspool_init(&pool, key, iv, len, POOL_SLOTS, 0) != 0) {
+      fprintf(stderr, "内存分配失败\n");
+      exit(1);
+    }
+    uint64_t seq = 0;
+    double miss_time = 0, hit_time = 0;
+    for (int r = 0; r < POOL_ROUNDS; r++) {
+      // 池为空：跳到新序号后仍未填充，每条都现场计算
+      double start = wall_time();
+      for (int m = 0; m < POOL_SLOTS; m++) {
+        sm4_kspool_xor(&pool, seq++, ek0, msg, msg, len);
+      }
+      miss_time += wall_time() - start;
+
+      sm4_kspool_fill(&pool, POOL_SLOTS);
+      start = wall_time();
+      for (int m = 0; m < POOL_SLOTS; m++) {
+        sm4_kspool_xor(&pool, seq++, ek0, msg, msg, len);
+      }
+      hit_time += wall_time() - start;
+    }
+    double n = (double)POOL_SLOTS * POOL_ROUNDS;
+    SM4_KSPOOL_STATS st;
+    sm4_kspool_stats(&pool, &st);
+    printf("%zu 字节消息：现场计算 %.0f ns/条，预生成命中 %.0f ns/条"
+           "（命中 %llu，未命中 %llu）\n",
+           len, miss_time / n * 1e9, hit_time / n * 1e9,
+           (unsigned long long)st.hits, (unsigned long long)st.misses);
+    sm4_kspool_free(&pool);
+  }
+}
+
+#define SWEEP_MIN_BYTES (16 << 10)   // 大小扫描的起点：16 KB，在 L1 内
+#define SWEEP_WORK_BYTES (64 << 20) // 每个大小至少处理的总字节数
+
+// 把 bytes 字节反复加密到总量不少于 SWEEP_WORK_BYTES，返回 MB/s
+static double sweep_speed(const uint8_t *in, uint8_t *out, size_t bytes,
+                          int ctr, const SM4_Key *key) {
+  size_t reps = SWEEP_WORK_BYTES / bytes + 1;
+  uint8_t counter[16] = {0};
+  double start = wall_time();
+  for (size_t r = 0; r < reps; r++) {
+    if (ctr) {
+      sm4_ctr32_blocks(in, out, bytes / 16, counter, key);
+    } else {
+      sm4_stream_encrypt_blocks(in, out, bytes / 16, key);
+    }
+  }
+  return (double)reps * bytes / (1024.0 * 1024.0) / (wall_time() - start);
+}
+
+// 大小扫描：从 L1 到末级缓存的 4 倍，比较普通存储与非临时存储（输入
+// 预取 + _mm_stream_si128）。阈值分别设为 SIZE_MAX 与 1 强制两种路径
+void benchmark_stream(const uint8_t *key) {
+  size_t llc = sm4_stream_threshold() * 2;
+  size_t max_bytes = 4 * llc;
+  uint8_t *in = sm4_stream_alloc(max_bytes, 1);
+  uint8_t *out = sm4_stream_alloc(max_bytes, 1);
+  if (!in || !out) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  memset(in, 0x3C, max_bytes);
+  memset(out, 0, max_bytes);
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  size_t saved = sm4_stream_threshold();
+
+  printf("末级缓存约 %.1f MB，默认阈值 %.1f MB（MB/s）\n",
+         llc / (1024.0 * 1024.0), saved / (1024.0 * 1024.0));
+  printf("%10s %12s %12s %12s %12s\n", "大小", "ECB 普通", "ECB 非临时",
+         "CTR 普通", "CTR 非临时");
+  for (size_t bytes = SWEEP_MIN_BYTES;; bytes *= 4) {
+    if (bytes > max_bytes) {
+      bytes = max_bytes;
+    }
+    double speed[4];
+    for (int mode = 0; mode < 4; mode++) {
+      sm4_stream_set_threshold(mode % 2 ? 1 : SIZE_MAX);
+      speed[mode] = sweep_speed(in, out, bytes, mode / 2, &sm4_key);
+    }
+    if (bytes >= 1 << 20) {
+      printf("%8.1fMB", bytes / (1024.0 * 1024.0));
+    } else {
+      printf("%8zuKB", bytes >> 10);
+    }
+    printf(" %10.2f %12.2f %10.2f %12.2f\n", speed[0], speed[1], speed[2],
+           speed[3]);
+    if (bytes == max_bytes) {
+      break;
+    }
+  }
+  sm4_stream_free(out, max_bytes);
+
+  // 最大的大小下对比普通页与大页（非临时存储路径，新分配的输出缓冲区）
+  sm4_stream_set_threshold(1);
+  for (int huge = 0; huge <= 1; huge++) {
+    out = sm4_stream_alloc(max_bytes, huge);
+    if (!out) {
+      fprintf(stderr, "内存分配失败\n");
+      exit(1);
+    }
+    double start = wall_time();
+    sm4_stream_encrypt_blocks(in, out, max_bytes / 16, &sm4_key);
+    print_speed(huge ? "大页输出缓冲区（含首次缺页）"
+                     : "普通页输出缓冲区（含首次缺页）",
+                max_bytes, wall_time() - start);
+    sm4_stream_free(out, max_bytes);
+  }
+  sm4_stream_set_threshold(saved);
+  sm4_stream_free(in, max_bytes);
+}
+
+// 多线程扩展性：同一份数据分别用 1/2/4/8 个线程做 ECB 加密与 CTR
+void benchmark_mt(const uint8_t *key) {
+  static const unsigned THREADS[] = {1, 2, 4, 8};
+  size_t bytes = (size_t)NUM_BLOCKS * BLOCK_SIZE;
+  uint8_t *buf = malloc(bytes);
+  uint8_t iv[16] = {0};
+  if (!buf) {
+    fprintf(stderr, "内存分配失败\n");
+    exit(1);
+  }
+  memset(buf, 0x5A, bytes);
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  char label[64];
+
+  for (size_t i = 0; i < sizeof(THREADS) / sizeof(THREADS[0]); i++) {
+    SM4_MT_OPTIONS opt = {.max_threads = THREADS[i], .pin = 1};
+    sm4_mt_configure(&opt);
+
+    double start = wall_time();
+    sm4_mt_encrypt_blocks(buf, buf, NUM_BLOCKS, &sm4_key);
+    snprintf(label, sizeof(label), "%u 线程 ECB 加密", sm4_mt_threads());
+    print_speed(label, bytes, wall_time() - start);
+
+    start = wall_time();
+    sm4_mt_ctr_range(&sm4_key, iv, 32, 0, buf, buf, bytes);
+    snprintf(label, sizeof(label), "%u 线程 CTR", sm4_mt_threads());
+    print_speed(label, bytes, wall_time() - start);
+  }
+
+  sm4_mt_shutdown();
+  free(buf);
+}
+
 int main() {
   uint8_t key[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
                      0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10};
@@ -67,13 +700,68 @@ int main() {
 
   printf("\n");
 
-  benchmark("SM4 AES-NI 加密", "SM4 AES-NI 解密", sm4_encrypt_aesni,
-            sm4_decrypt_aesni, key, input);
-
-  printf("\n");
+  if (sm4_engine_available(sm4_engine_find("aesni"))) {
+    benchmark("SM4 AES-NI 加密", "SM4 AES-NI 解密", sm4_encrypt_aesni,
+              sm4_decrypt_aesni, key, input);
+    printf("\n");
+  }
 
   benchmark("SM4 T-table 加密", "SM4 T-table 解密", sm4_encrypt_ttable,
             sm4_decrypt_ttable, key, input);
 
+  printf("\n多块接口（单次调用处理全部数据）\n\n");
+
+  // 遍历所有后端，跳过当前 CPU 不支持的
+  size_t engine_count;
+  const SM4_ENGINE *engines = sm4_engine_list(&engine_count);
+  char label_enc[64], label_dec[64];
+  for (size_t i = 0; i < engine_count; i++) {
+    if (!sm4_engine_available(&engines[i])) {
+      printf("后端 %s：当前 CPU 不支持，跳过\n\n", engines[i].name);
+      continue;
+    }
+    snprintf(label_enc, sizeof(label_enc), "SM4 %s 多块加密", engines[i].name);
+    snprintf(label_dec, sizeof(label_dec), "SM4 %s 多块解密", engines[i].name);
+    benchmark_blocks(label_enc, label_dec, engines[i].encrypt_blocks,
+                     engines[i].decrypt_blocks, key);
+    printf("\n");
+  }
+
+  printf("自动选择的大批量后端：%s\n", sm4_engine_get(NUM_BLOCKS)->name);
+
+  printf("\nSIMD 内核对比（S 盒：AES 单元 vs gather）\n\n");
+  benchmark_kernels(key);
+
+  printf("\n多密钥（每条记录不同会话密钥）\n\n");
+  benchmark_multikey();
+
+  printf("\n批量密钥扩展\n\n");
+  benchmark_keyinit();
+
+  printf("\nCBC 模式\n\n");
+  benchmark_cbc(key);
+
+  printf("\nCCM 模式\n\n");
+  benchmark_ccm(key);
+
+  printf("\n随机数生成（SM4-CTR DRBG）\n\n");
+  benchmark_drbg();
+
+  printf("\nCTR/GCM 小消息密钥流池\n\n");
+  benchmark_kspool(key);
+
+  printf("\n大缓冲区模式（预取 + 非临时存储）\n\n");
+  benchmark_stream(key);
+
+  printf("\nXTS 模式\n\n");
+  benchmark_xts();
+
+  printf("\nCTR 随机区间读取（对象大小 %.0f GB）\n\n",
+         RANGE_OBJECT_SIZE / (1024.0 * 1024.0 * 1024.0));
+  benchmark_range(key);
+
+  printf("\n多线程（在线 CPU 数：%ld）\n\n", sysconf(_SC_NPROCESSORS_ONLN));
+  benchmark_mt(key);
+
   return 0;
 }
@@ -1,11 +1,31 @@
 #include "sm4.h"
 #include "sm4_aesni.h"
+#include "sm4_avx2.h"
+#include "sm4_bitslice.h"
+#include "sm4_cbc.h"
+#include "sm4_ccm.h"
+#include "sm4_ctr.h"
+#include "sm4_drbg.h"
+#include "sm4_engine.h"
+#include "sm4_kspool.h"
+#include "sm4_mt.h"
+#include "sm4_stream.h"
+#include "sm4_trace.h"
 #include "sm4_ttable.h"
+#include "sm4_xts.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 typedef void (*EncryptFunc)(const uint8_t[16], const SM4_Key *, uint8_t[16]);
 typedef void (*DecryptFunc)(const uint8_t[16], const SM4_Key *, uint8_t[16]);
+typedef void (*BlocksFunc)(const uint8_t *, uint8_t *, size_t,
+                           const SM4_Key *);
+typedef void (*KeyInitBatchFunc)(const uint8_t *const *, size_t, SM4_Key *);
+
+#define TEST_BLOCKS 37 // 非 4 的倍数，覆盖尾块处理
+#define TEST_BATCH 453 // 覆盖 x16/x8 及位切片 256/128/64 各批大小和补齐
 
 void print_hex(const uint8_t *data, size_t len) {
   for (size_t i = 0; i < len; i++) {
@@ -40,6 +60,984 @@ void run_test(const char *title, EncryptFunc encrypt, DecryptFunc decrypt,
          memcmp(decrypted_text, plaintext, 16) == 0 ? "true" : "false");
 }
 
+// 多块接口测试：与原始实现逐块对比，块数覆盖 1 ~ TEST_BLOCKS
+void run_blocks_test(const char *title, BlocksFunc encrypt, BlocksFunc decrypt,
+                     const uint8_t *key) {
+  printf("\n%s\n", title);
+
+  uint8_t plaintext[16 * TEST_BLOCKS];
+  uint8_t expected[16 * TEST_BLOCKS];
+  uint8_t ciphertext[16 * TEST_BLOCKS + 16];
+  uint8_t decrypted[16 * TEST_BLOCKS];
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 131 + 7);
+  }
+  for (size_t i = 0; i < TEST_BLOCKS; i++) {
+    sm4_encrypt(plaintext + 16 * i, &sm4_key, expected + 16 * i);
+  }
+
+  int enc_ok = 1, dec_ok = 1, bound_ok = 1;
+  for (size_t n = 1; n <= TEST_BLOCKS; n++) {
+    // 哨兵字节用于检测越界写
+    memset(ciphertext, 0xA5, sizeof(ciphertext));
+    encrypt(plaintext, ciphertext, n, &sm4_key);
+    enc_ok &= memcmp(ciphertext, expected, 16 * n) == 0;
+    bound_ok &= ciphertext[16 * n] == 0xA5;
+
+    decrypt(ciphertext, decrypted, n, &sm4_key);
+    dec_ok &= memcmp(decrypted, plaintext, 16 * n) == 0;
+  }
+
+  printf("多块加密是否等于逐块结果：\t%s\n", enc_ok ? "true" : "false");
+  printf("多块解密是否等于原文：\t\t%s\n", dec_ok ? "true" : "false");
+  printf("是否无越界写：\t\t\t%s\n", bound_ok ? "true" : "false");
+}
+
+// 多密钥测试：每个分组使用不同密钥，与逐块单密钥结果对比
+void run_multikey_test(const char *title, SM4_MultiKeyFunc encrypt,
+                       SM4_MultiKeyFunc decrypt) {
+  printf("\n%s\n", title);
+
+  static SM4_Key keys[TEST_BLOCKS];
+  const SM4_Key *key_ptrs[TEST_BLOCKS];
+  uint8_t plaintext[16 * TEST_BLOCKS];
+  uint8_t expected[16 * TEST_BLOCKS];
+  uint8_t ciphertext[16 * TEST_BLOCKS + 16];
+  uint8_t decrypted[16 * TEST_BLOCKS];
+
+  for (size_t i = 0; i < TEST_BLOCKS; i++) {
+    uint8_t key[16];
+    for (int j = 0; j < 16; j++) {
+      key[j] = (uint8_t)(i * 17 + j * 29 + 1);
+    }
+    sm4_keyInit(key, &keys[i]);
+    key_ptrs[i] = &keys[i];
+  }
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 13 + 9);
+  }
+  for (size_t i = 0; i < TEST_BLOCKS; i++) {
+    sm4_encrypt(plaintext + 16 * i, &keys[i], expected + 16 * i);
+  }
+
+  int enc_ok = 1, dec_ok = 1, bound_ok = 1;
+  for (size_t n = 1; n <= TEST_BLOCKS; n++) {
+    memset(ciphertext, 0xA5, sizeof(ciphertext));
+    encrypt(plaintext, ciphertext, n, key_ptrs);
+    enc_ok &= memcmp(ciphertext, expected, 16 * n) == 0;
+    bound_ok &= ciphertext[16 * n] == 0xA5;
+
+    decrypt(ciphertext, decrypted, n, key_ptrs);
+    dec_ok &= memcmp(decrypted, plaintext, 16 * n) == 0;
+  }
+
+  printf("多密钥加密是否等于逐块结果：\t%s\n", enc_ok ? "true" : "false");
+  printf("多密钥解密是否等于原文：\t%s\n", dec_ok ? "true" : "false");
+  printf("是否无越界写：\t\t\t%s\n", bound_ok ? "true" : "false");
+}
+
+// 批量密钥扩展测试：与逐个 sm4_keyInit 的结果逐字节比较
+void run_keyinit_batch_test(const char *title, KeyInitBatchFunc keyinit) {
+  printf("\n%s\n", title);
+
+  static SM4_Key expected[TEST_BLOCKS];
+  static SM4_Key out[TEST_BLOCKS + 1];
+  uint8_t raw[TEST_BLOCKS][16];
+  const uint8_t *key_ptrs[TEST_BLOCKS];
+
+  for (size_t i = 0; i < TEST_BLOCKS; i++) {
+    for (int j = 0; j < 16; j++) {
+      raw[i][j] = (uint8_t)(i * 53 + j * 7 + 3);
+    }
+    key_ptrs[i] = raw[i];
+    sm4_keyInit(raw[i], &expected[i]);
+  }
+
+  int ok = 1, bound_ok = 1;
+  for (size_t n = 1; n <= TEST_BLOCKS; n++) {
+    memset(out, 0xA5, sizeof(out));
+    keyinit(key_ptrs, n, out);
+    ok &= memcmp(out, expected, n * sizeof(SM4_Key)) == 0;
+    bound_ok &= ((uint8_t *)&out[n])[0] == 0xA5;
+  }
+
+  printf("批量扩展是否等于逐个扩展：\t%s\n", ok ? "true" : "false");
+  printf("是否无越界写：\t\t\t%s\n", bound_ok ? "true" : "false");
+}
+
+// 大批量测试：覆盖位切片实现的各批大小
+void run_batch_test(const char *title, BlocksFunc encrypt, BlocksFunc decrypt,
+                    const uint8_t *key) {
+  printf("\n%s\n", title);
+
+  static uint8_t plaintext[16 * TEST_BATCH];
+  static uint8_t expected[16 * TEST_BATCH];
+  static uint8_t buf[16 * TEST_BATCH];
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 167 + (i >> 8));
+  }
+  sm4_encrypt_blocks(plaintext, expected, TEST_BATCH, &sm4_key);
+
+  memcpy(buf, plaintext, sizeof(buf));
+  encrypt(buf, buf, TEST_BATCH, &sm4_key);
+  printf("批量加密是否等于逐块结果：\t%s\n",
+         memcmp(buf, expected, sizeof(buf)) == 0 ? "true" : "false");
+  decrypt(buf, buf, TEST_BATCH, &sm4_key);
+  printf("批量解密是否等于原文：\t\t%s\n",
+         memcmp(buf, plaintext, sizeof(buf)) == 0 ? "true" : "false");
+}
+
+// 参考计数器递增：只在最后 bytes 个字节内按大端加一（bytes 超过 16 按 16）
+static void ref_ctr_inc(uint8_t counter[16], int bytes) {
+  for (int i = 15; i > 15 - bytes && i >= 0; i--) {
+    if (++counter[i]) {
+      break;
+    }
+  }
+}
+
+// 逐块调用 sm4_encrypt 生成参考密文
+static void ref_ctr(const uint8_t *in, uint8_t *out, size_t len,
+                    const uint8_t iv[16], int ctr_bits, const SM4_Key *key) {
+  uint8_t counter[16], ks[16];
+  memcpy(counter, iv, 16);
+  for (size_t off = 0; off < len; off += 16) {
+    sm4_encrypt(counter, key, ks);
+    for (size_t i = 0; i < 16 && off + i < len; i++) {
+      out[off + i] = in[off + i] ^ ks[i];
+    }
+    ref_ctr_inc(counter, ctr_bits / 8);
+  }
+}
+
+// CTR 测试：分段调用、32 位计数器回绕、128 位计数器进位
+void run_ctr_test(const uint8_t *key) {
+  printf("\nSM4-CTR 测试\n");
+
+  // 分段长度覆盖半块续用、整块和跨多批的情况
+  static const size_t CHUNKS[] = {1, 5, 16, 17, 100, 16 * SM4_CTR_BATCH + 3};
+  static uint8_t plaintext[16 * TEST_BATCH + 7];
+  static uint8_t expected[sizeof(plaintext)];
+  static uint8_t buf[sizeof(plaintext)];
+  uint8_t iv[16];
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 29 + 3);
+  }
+  for (int i = 0; i < 16; i++) {
+    iv[i] = (uint8_t)(0xF0 + i);
+  }
+
+  int chunk_ok = 1;
+  for (int bits = 32; bits <= 128; bits += 96) {
+    ref_ctr(plaintext, expected, sizeof(plaintext), iv, bits, &sm4_key);
+    for (size_t c = 0; c < sizeof(CHUNKS) / sizeof(CHUNKS[0]); c++) {
+      SM4_CTR_CTX ctx;
+      sm4_ctr_init(&ctx, key, iv, bits);
+      for (size_t off = 0; off < sizeof(plaintext); off += CHUNKS[c]) {
+        size_t n = sizeof(plaintext) - off;
+        n = n < CHUNKS[c] ? n : CHUNKS[c];
+        sm4_ctr_update(&ctx, plaintext + off, buf + off, n);
+      }
+      chunk_ok &= memcmp(buf, expected, sizeof(buf)) == 0;
+    }
+  }
+  printf("分段加密是否等于逐块结果：\t%s\n", chunk_ok ? "true" : "false");
+
+  // 低 32 位从 0xFFFFFFFE 开始：ctr32 回绕且不进位到前 12 字节
+  memset(iv, 0xFF, 16);
+  iv[15] = 0xFE;
+  ref_ctr(plaintext, expected, 16 * 4, iv, 32, &sm4_key);
+  uint8_t counter[16];
+  memcpy(counter, iv, 16);
+  sm4_ctr32_blocks(plaintext, buf, 4, counter, &sm4_key);
+  int wrap_ok = memcmp(buf, expected, 16 * 4) == 0 && counter[11] == 0xFF &&
+                counter[15] == 2;
+  printf("32 位计数器回绕是否正确：\t%s\n", wrap_ok ? "true" : "false");
+
+  // 低 64 位全 1：ctr128 需要向高 64 位进位
+  memset(iv, 0, 16);
+  memset(iv + 8, 0xFF, 8);
+  iv[15] = 0xFE;
+  ref_ctr(plaintext, expected, 16 * 4, iv, 128, &sm4_key);
+  memcpy(counter, iv, 16);
+  sm4_ctr128_blocks(plaintext, buf, 4, counter, &sm4_key);
+  int carry_ok = memcmp(buf, expected, 16 * 4) == 0 && counter[7] == 1 &&
+                 counter[15] == 2;
+  printf("128 位计数器进位是否正确：\t%s\n", carry_ok ? "true" : "false");
+}
+
+// 随机访问测试：任意区间的结果应等于整段加密结果的对应切片
+void run_ctr_range_test(const uint8_t *key) {
+  printf("\nSM4-CTR 随机访问测试\n");
+
+  static uint8_t plaintext[16 * TEST_BATCH + 7];
+  static uint8_t expected[sizeof(plaintext)];
+  static uint8_t buf[sizeof(plaintext)];
+  uint8_t iv[16];
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 53 + 11);
+  }
+  // 低 32 位从 0xFFFFFF00 开始，第 256 块处跨过 inc32 的回绕点
+  memset(iv, 0xFF, 16);
+  iv[15] = 0x00;
+
+  int range_ok = 1, seek_ok = 1;
+  uint32_t seed = 12345;
+  for (int bits = 32; bits <= 128; bits += 96) {
+    ref_ctr(plaintext, expected, sizeof(plaintext), iv, bits, &sm4_key);
+    for (int t = 0; t < 200; t++) {
+      seed = seed * 1103515245 + 12345;
+      size_t off = (seed >> 8) % sizeof(plaintext);
+      seed = seed * 1103515245 + 12345;
+      size_t len = (seed >> 8) % (sizeof(plaintext) - off + 1);
+
+      sm4_ctr_range(&sm4_key, iv, bits, off, plaintext + off, buf, len);
+      range_ok &= memcmp(buf, expected + off, len) == 0;
+
+      SM4_CTR_CTX ctx;
+      sm4_ctr_init(&ctx, key, iv, bits);
+      sm4_ctr_seek(&ctx, iv, off);
+      sm4_ctr_update(&ctx, plaintext + off, buf, len);
+      seek_ok &= memcmp(buf, expected + off, len) == 0;
+    }
+  }
+  printf("区间解密是否等于整段结果：\t%s\n", range_ok ? "true" : "false");
+  printf("seek 后续写是否等于整段结果：\t%s\n", seek_ok ? "true" : "false");
+}
+
+// CBC/CFB 测试：标准向量、与逐块参考实现对比、原地解密、多路加密
+void run_cbc_cfb_test(const uint8_t *key) {
+  printf("\nSM4-CBC/CFB 测试\n");
+
+  // 测试向量（draft-ribose-cfrg-sm4 附录 A.2）
+  static const uint8_t VEC_IV[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+                                     0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+                                     0x0C, 0x0D, 0x0E, 0x0F};
+  static const uint8_t VEC_ROWS[8] = {0xAA, 0xBB, 0xCC, 0xDD,
+                                      0xEE, 0xFF, 0xAA, 0xBB};
+  static const uint8_t VEC_CBC[32] = {
+      0x78, 0xEB, 0xB1, 0x1C, 0xC4, 0x0B, 0x0A, 0x48, 0x31, 0x2A, 0xAE,
+      0xB2, 0x04, 0x02, 0x44, 0xCB, 0x4C, 0xB7, 0x01, 0x69, 0x51, 0x90,
+      0x92, 0x26, 0x97, 0x9B, 0x0D, 0x15, 0xDC, 0x6A, 0x8F, 0x6D};
+  static const uint8_t VEC_CFB[32] = {
+      0xAC, 0x32, 0x36, 0xCB, 0x86, 0x1D, 0xD3, 0x16, 0xE6, 0x41, 0x3B,
+      0x4E, 0x3C, 0x75, 0x24, 0xB7, 0x69, 0xD4, 0xC5, 0x4E, 0xD4, 0x33,
+      0xB9, 0xA0, 0x34, 0x60, 0x09, 0xBE, 0xB3, 0x7B, 0x2B, 0x3F};
+  uint8_t vec_pt[32], vec_out[32], iv[16];
+  for (int i = 0; i < 32; i++) {
+    vec_pt[i] = VEC_ROWS[i / 4];
+  }
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+
+  memcpy(iv, VEC_IV, 16);
+  sm4_cbc_encrypt(vec_pt, vec_out, 2, iv, &sm4_key);
+  printf("CBC 是否等于标准输出：\t\t%s\n",
+         memcmp(vec_out, VEC_CBC, 32) == 0 ? "true" : "false");
+  memcpy(iv, VEC_IV, 16);
+  sm4_cfb_encrypt(vec_pt, vec_out, 2, iv, &sm4_key);
+  printf("CFB 是否等于标准输出：\t\t%s\n",
+         memcmp(vec_out, VEC_CFB, 32) == 0 ? "true" : "false");
+
+  // 大批量：跨多批解密、原地解密，以及分两次调用时 iv 的衔接
+  static uint8_t plaintext[16 * TEST_BATCH];
+  static uint8_t expected[16 * TEST_BATCH];
+  static uint8_t buf[16 * TEST_BATCH];
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 71 + 5);
+  }
+
+  uint8_t chain[16], ks[16];
+  memcpy(chain, VEC_IV, 16);
+  for (size_t i = 0; i < TEST_BATCH; i++) {
+    for (int j = 0; j < 16; j++) {
+      chain[j] ^= plaintext[16 * i + j];
+    }
+    sm4_encrypt(chain, &sm4_key, chain);
+    memcpy(expected + 16 * i, chain, 16);
+  }
+  memcpy(iv, VEC_IV, 16);
+  sm4_cbc_encrypt(plaintext, buf, 100, iv, &sm4_key);
+  sm4_cbc_encrypt(plaintext + 1600, buf + 1600, TEST_BATCH - 100, iv, &sm4_key);
+  int cbc_ok = memcmp(buf, expected, sizeof(buf)) == 0;
+  memcpy(iv, VEC_IV, 16);
+  sm4_cbc_decrypt(buf, buf, 100, iv, &sm4_key);
+  sm4_cbc_decrypt(buf + 1600, buf + 1600, TEST_BATCH - 100, iv, &sm4_key);
+  cbc_ok &= memcmp(buf, plaintext, sizeof(buf)) == 0;
+  printf("CBC 批量加解密是否正确：\t%s\n", cbc_ok ? "true" : "false");
+
+  memcpy(chain, VEC_IV, 16);
+  for (size_t i = 0; i < TEST_BATCH; i++) {
+    sm4_encrypt(chain, &sm4_key, ks);
+    for (int j = 0; j < 16; j++) {
+      chain[j] = ks[j] ^ plaintext[16 * i + j];
+    }
+    memcpy(expected + 16 * i, chain, 16);
+  }
+  memcpy(iv, VEC_IV, 16);
+  sm4_cfb_encrypt(plaintext, buf, TEST_BATCH, iv, &sm4_key);
+  int cfb_ok = memcmp(buf, expected, sizeof(buf)) == 0;
+  memcpy(iv, VEC_IV, 16);
+  sm4_cfb_decrypt(buf, buf, 100, iv, &sm4_key);
+  sm4_cfb_decrypt(buf + 1600, buf + 1600, TEST_BATCH - 100, iv, &sm4_key);
+  cfb_ok &= memcmp(buf, plaintext, sizeof(buf)) == 0;
+  printf("CFB 批量加解密是否正确：\t%s\n", cfb_ok ? "true" : "false");
+
+  // 多路加密：路数超过一组，各路长度不同（含 0 块），结果应等于逐路加密
+  enum { NSTREAMS = SM4_CBC_BATCH + 3 };
+  static SM4_CBC_STREAM streams[NSTREAMS];
+  static uint8_t multi_out[NSTREAMS][16 * 16];
+  int multi_ok = 1;
+  for (size_t s = 0; s < NSTREAMS; s++) {
+    streams[s].in = plaintext + 16 * s;
+    streams[s].out = multi_out[s];
+    streams[s].nblocks = s % 17 == 16 ? 0 : s % 17;
+    memset(streams[s].iv, (int)s, 16);
+  }
+  sm4_cbc_encrypt_multi(streams, NSTREAMS, &sm4_key);
+  for (size_t s = 0; s < NSTREAMS; s++) {
+    uint8_t single[16 * 16];
+    memset(iv, (int)s, 16);
+    sm4_cbc_encrypt(plaintext + 16 * s, single, streams[s].nblocks, iv,
+                    &sm4_key);
+    multi_ok &= memcmp(single, multi_out[s], 16 * streams[s].nblocks) == 0;
+    multi_ok &= memcmp(iv, streams[s].iv, 16) == 0;
+  }
+  printf("多路 CBC 加密是否等于逐路结果：\t%s\n", multi_ok ? "true" : "false");
+}
+
+// XTS 测试：GB/IEEE 测试向量（含密文挪用）、各长度往返、扇区接口
+void run_xts_test(void) {
+  printf("\nSM4-XTS 测试\n");
+
+  // 测试向量（OpenSSL evpciph_sm4.txt，56 字节，最后半块走密文挪用）
+  static const uint8_t KEY[32] = {
+      0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15,
+      0x88, 0x09, 0xCF, 0x4F, 0x3C, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+      0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+  static const uint8_t IV[16] = {0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5,
+                                 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB,
+                                 0xFC, 0xFD, 0xFE, 0xFF};
+  static const uint8_t PT[56] = {
+      0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11,
+      0x73, 0x93, 0x17, 0x2A, 0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+      0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51, 0x30, 0xC8, 0x1C, 0x46,
+      0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+      0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17};
+  static const uint8_t CT_GB[56] = {
+      0xE9, 0x53, 0x82, 0x51, 0xC7, 0x1D, 0x7B, 0x80, 0xBB, 0xE4, 0x48, 0x3F,
+      0xEF, 0x49, 0x7B, 0xD1, 0x2C, 0x5C, 0x58, 0x1B, 0xD6, 0x24, 0x2F, 0xC5,
+      0x1E, 0x08, 0x96, 0x4F, 0xB4, 0xF6, 0x0F, 0xDB, 0x0B, 0xA4, 0x2F, 0x63,
+      0x49, 0x92, 0x79, 0x21, 0x3D, 0x31, 0x8D, 0x2C, 0x11, 0xF6, 0x88, 0x6E,
+      0x90, 0x3B, 0xE7, 0xF9, 0x3A, 0x1B, 0x34, 0x79};
+  static const uint8_t CT_IEEE[56] = {
+      0xE9, 0x53, 0x82, 0x51, 0xC7, 0x1D, 0x7B, 0x80, 0xBB, 0xE4, 0x48, 0x3F,
+      0xEF, 0x49, 0x7B, 0xD1, 0xB3, 0xDB, 0x1A, 0x3E, 0x60, 0x40, 0x8C, 0x57,
+      0x5D, 0x63, 0xFF, 0x7D, 0xB3, 0x9F, 0x83, 0x26, 0x08, 0x69, 0xF9, 0xE2,
+      0x58, 0x5F, 0xEC, 0x9F, 0x0B, 0x86, 0x3B, 0xF8, 0xFD, 0x78, 0x4B, 0x86,
+      0x27, 0xD1, 0x6C, 0x0D, 0xB6, 0xD2, 0xCF, 0xC7};
+  static const uint8_t *EXPECTED[2] = {CT_GB, CT_IEEE};
+  static const char *NAMES[2] = {"GB", "IEEE"};
+
+  static uint8_t plaintext[4096 + 15];
+  static uint8_t buf[sizeof(plaintext)];
+  static uint8_t single[sizeof(plaintext)];
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 37 + 1);
+  }
+
+  for (int std = SM4_XTS_GB; std <= SM4_XTS_IEEE; std++) {
+    SM4_XTS_CTX ctx;
+    sm4_xts_init(&ctx, KEY, std);
+
+    uint8_t out[56];
+    sm4_xts_encrypt(&ctx, IV, PT, out, sizeof(PT));
+    printf("%s 是否等于标准输出：\t\t%s\n", NAMES[std],
+           memcmp(out, EXPECTED[std], sizeof(out)) == 0 ? "true" : "false");
+
+    // 往返：覆盖整块、挪用和跨多批的长度，原地解密
+    int roundtrip_ok = 1;
+    for (size_t len = 16; len <= sizeof(plaintext);
+         len += (len < 80 ? 1 : 509)) {
+      sm4_xts_encrypt(&ctx, IV, plaintext, buf, len);
+      sm4_xts_decrypt(&ctx, IV, buf, buf, len);
+      roundtrip_ok &= memcmp(buf, plaintext, len) == 0;
+    }
+    roundtrip_ok &= sm4_xts_encrypt(&ctx, IV, plaintext, buf, 15) == -1;
+    printf("%s 各长度加解密是否正确：\t%s\n", NAMES[std],
+           roundtrip_ok ? "true" : "false");
+
+    // 扇区接口：等于逐扇区以小端扇区号作 iv 调用
+    int sector_ok = 1;
+    sm4_xts_encrypt_sectors(&ctx, 0x1234, 512, plaintext, buf, 8);
+    for (int i = 0; i < 8; i++) {
+      uint8_t iv[16] = {0};
+      iv[0] = (uint8_t)(0x34 + i);
+      iv[1] = 0x12;
+      sm4_xts_encrypt(&ctx, iv, plaintext + 512 * i, single + 512 * i, 512);
+    }
+    sector_ok &= memcmp(buf, single, 512 * 8) == 0;
+    sm4_xts_decrypt_sectors(&ctx, 0x1234, 512, buf, buf, 8);
+    sector_ok &= memcmp(buf, plaintext, 512 * 8) == 0;
+    printf("%s 扇区接口是否正确：\t\t%s\n", NAMES[std],
+           sector_ok ? "true" : "false");
+  }
+}
+
+// 逐块参考实现：按 SP 800-38C 拼出完整的 MAC 输入后用 sm4_encrypt 计算
+static void ref_ccm(const SM4_Key *key, const uint8_t *nonce, size_t nonce_len,
+                    const uint8_t *aad, size_t aad_len, const uint8_t *pt,
+                    size_t len, uint8_t *ct, uint8_t *tag, size_t tag_len) {
+  static uint8_t b[16 * 64];
+  size_t q = 15 - nonce_len, pos = 16;
+  memset(b, 0, sizeof(b));
+  b[0] = (aad_len ? 0x40 : 0) | ((tag_len - 2) / 2) << 3 | (q - 1);
+  memcpy(b + 1, nonce, nonce_len);
+  b[14] = len >> 8;
+  b[15] = len & 0xFF;
+  if (aad_len) {
+    b[pos++] = aad_len >> 8;
+    b[pos++] = aad_len & 0xFF;
+    memcpy(b + pos, aad, aad_len);
+    pos = (pos + aad_len + 15) / 16 * 16;
+  }
+  memcpy(b + pos, pt, len);
+  pos = (pos + len + 15) / 16 * 16;
+
+  uint8_t x[16] = {0}, a[16] = {0}, s[16];
+  for (size_t i = 0; i < pos; i += 16) {
+    for (int j = 0; j < 16; j++) {
+      x[j] ^= b[i + j];
+    }
+    sm4_encrypt(x, key, x);
+  }
+  a[0] = q - 1;
+  memcpy(a + 1, nonce, nonce_len);
+  for (size_t i = 0; i <= (len + 15) / 16; i++) {
+    a[15] = (uint8_t)i;
+    sm4_encrypt(a, key, s);
+    for (size_t j = 0; j < 16; j++) {
+      if (i == 0 && j < tag_len) {
+        tag[j] = x[j] ^ s[j];
+      } else if (i > 0 && 16 * (i - 1) + j < len) {
+        ct[16 * (i - 1) + j] = pt[16 * (i - 1) + j] ^ s[j];
+      }
+    }
+  }
+}
+
+void run_ccm_test(const uint8_t *key) {
+  printf("\nSM4-CCM 测试\n");
+
+  // 测试向量（RFC 8998 附录 A.2）
+  static const uint8_t VEC_NONCE[12] = {0x00, 0x00, 0x12, 0x34, 0x56, 0x78,
+                                        0x00, 0x00, 0x00, 0x00, 0xAB, 0xCD};
+  static const uint8_t VEC_AAD[20] = {0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD, 0xBE,
+                                      0xEF, 0xFE, 0xED, 0xFA, 0xCE, 0xDE, 0xAD,
+                                      0xBE, 0xEF, 0xAB, 0xAD, 0xDA, 0xD2};
+  static const uint8_t VEC_ROWS[8] = {0xAA, 0xBB, 0xCC, 0xDD,
+                                      0xEE, 0xFF, 0xEE, 0xAA};
+  static const uint8_t VEC_CT[64] = {
+      0x48, 0xAF, 0x93, 0x50, 0x1F, 0xA6, 0x2A, 0xDB, 0xCD, 0x41, 0x4C,
+      0xCE, 0x60, 0x34, 0xD8, 0x95, 0xDD, 0xA1, 0xBF, 0x8F, 0x13, 0x2F,
+      0x04, 0x20, 0x98, 0x66, 0x15, 0x72, 0xE7, 0x48, 0x30, 0x94, 0xFD,
+      0x12, 0xE5, 0x18, 0xCE, 0x06, 0x2C, 0x98, 0xAC, 0xEE, 0x28, 0xD9,
+      0x5D, 0xF4, 0x41, 0x6B, 0xED, 0x31, 0xA2, 0xF0, 0x44, 0x76, 0xC1,
+      0x8B, 0xB4, 0x0C, 0x84, 0xA7, 0x4B, 0x97, 0xDC, 0x5B};
+  static const uint8_t VEC_TAG[16] = {0x16, 0x84, 0x2D, 0x4F, 0xA1, 0x86,
+                                      0xF5, 0x6A, 0xB3, 0x32, 0x56, 0x97,
+                                      0x1F, 0xA1, 0x10, 0xF4};
+  uint8_t pt[64], ct[64], tag[16];
+  for (int i = 0; i < 64; i++) {
+    pt[i] = VEC_ROWS[i / 8];
+  }
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+
+  sm4_ccm_encrypt(&sm4_key, VEC_NONCE, 12, VEC_AAD, 20, pt, ct, 64, tag, 16);
+  printf("CCM 是否等于标准输出：\t\t%s\n",
+         memcmp(ct, VEC_CT, 64) == 0 && memcmp(tag, VEC_TAG, 16) == 0
+             ? "true"
+             : "false");
+  int dec_ok = sm4_ccm_decrypt(&sm4_key, VEC_NONCE, 12, VEC_AAD, 20, ct, ct,
+                               64, VEC_TAG, 16) == 0 &&
+               memcmp(ct, pt, 64) == 0;
+  uint8_t bad_tag[16];
+  memcpy(bad_tag, VEC_TAG, 16);
+  bad_tag[15] ^= 1;
+  memcpy(ct, VEC_CT, 64);
+  dec_ok &= sm4_ccm_decrypt(&sm4_key, VEC_NONCE, 12, VEC_AAD, 20, ct, ct, 64,
+                            bad_tag, 16) == -1;
+  printf("CCM 原地解密与标签校验：\t%s\n", dec_ok ? "true" : "false");
+
+  // 各种 nonce/标签/AAD/数据长度与逐块参考实现对比
+  static const size_t NONCE_LENS[] = {7, 12, 13};
+  static const size_t TAG_LENS[] = {4, 10, 16};
+  uint8_t data[80], aad[40], nonce[13], out[80], ref_out[80], ref_tag[16];
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+  for (size_t i = 0; i < sizeof(aad); i++) {
+    aad[i] = (uint8_t)(i * 5 + 1);
+  }
+  for (size_t i = 0; i < sizeof(nonce); i++) {
+    nonce[i] = (uint8_t)(0xC0 + i);
+  }
+  int ref_ok = 1;
+  for (size_t k = 0; k < 3; k++) {
+    for (size_t aad_len = 0; aad_len <= sizeof(aad); aad_len += 13) {
+      for (size_t len = 0; len <= sizeof(data); len += 7) {
+        size_t nl = NONCE_LENS[k], tl = TAG_LENS[k];
+        ref_ccm(&sm4_key, nonce, nl, aad, aad_len, data, len, ref_out,
+                ref_tag, tl);
+        sm4_ccm_encrypt(&sm4_key, nonce, nl, aad, aad_len, data, out, len,
+                        tag, tl);
+        ref_ok &= memcmp(out, ref_out, len) == 0 &&
+                  memcmp(tag, ref_tag, tl) == 0;
+        ref_ok &= sm4_ccm_decrypt(&sm4_key, nonce, nl, aad, aad_len, out, out,
+                                  len, tag, tl) == 0 &&
+                  memcmp(out, data, len) == 0;
+      }
+    }
+  }
+  printf("CCM 是否等于逐块参考实现：\t%s\n", ref_ok ? "true" : "false");
+
+  // 多消息：长度各不相同，其中一条标签被篡改
+  enum { MSGS = 9 };
+  static uint8_t bufs[MSGS][80];
+  SM4_CCM_MSG msgs[MSGS];
+  int multi_ok = 1;
+  for (size_t m = 0; m < MSGS; m++) {
+    msgs[m] = (SM4_CCM_MSG){.nonce = nonce, .nonce_len = 12, .aad = aad,
+                            .aad_len = m * 4, .in = data, .out = bufs[m],
+                            .len = m * 9};
+  }
+  multi_ok &= sm4_ccm_encrypt_multi(msgs, MSGS, 16, &sm4_key) == 0;
+  for (size_t m = 0; m < MSGS; m++) {
+    ref_ccm(&sm4_key, nonce, 12, aad, m * 4, data, m * 9, ref_out, ref_tag,
+            16);
+    multi_ok &= memcmp(bufs[m], ref_out, m * 9) == 0 &&
+                memcmp(msgs[m].tag, ref_tag, 16) == 0;
+    msgs[m].in = bufs[m];
+  }
+  msgs[3].tag[0] ^= 1;
+  multi_ok &= sm4_ccm_decrypt_multi(msgs, MSGS, 16, &sm4_key) == -1;
+  for (size_t m = 0; m < MSGS; m++) {
+    multi_ok &= msgs[m].result == (m == 3 ? -1 : 0);
+    multi_ok &= m == 3 || memcmp(bufs[m], data, m * 9) == 0;
+  }
+  printf("CCM 多消息是否正确：\t\t%s\n", multi_ok ? "true" : "false");
+}
+
+// DRBG 测试：输出与状态的对应关系、分段与缓冲的一致性、重播种和每线程实例
+void run_drbg_test(void) {
+  printf("\nSM4-CTR DRBG 测试\n");
+
+  uint8_t entropy[32], nonce[16], pers[5] = "test";
+  for (int i = 0; i < 32; i++) {
+    entropy[i] = (uint8_t)(i * 11 + 3);
+  }
+  for (int i = 0; i < 16; i++) {
+    nonce[i] = (uint8_t)(0xF0 - i);
+  }
+
+  enum { BULK = 3 * SM4_DRBG_MAX_REQUEST + 777 };
+  static uint8_t a[BULK], b[BULK];
+  static SM4_DRBG d1, d2;
+
+  // 输出为 E(V + 1), E(V + 2), ...：把 V 的低 64 位设为接近回绕，检查进位
+  sm4_drbg_instantiate(&d1, entropy, 32, nonce, 16, pers, 4);
+  memset(d1.v + 8, 0xFF, 8);
+  d1.v[15] = 0xF0;
+  uint8_t v[16];
+  memcpy(v, d1.v, 16);
+  SM4_Key key = d1.key;
+  sm4_drbg_generate(&d1, a, 16 * 40, NULL, 0);
+  int state_ok = 1;
+  for (int i = 0; i < 40; i++) {
+    ref_ctr_inc(v, 16);
+    sm4_encrypt(v, &key, b + 16 * i);
+  }
+  state_ok &= memcmp(a, b, 16 * 40) == 0;
+  printf("输出是否为 E(V+i)：\t\t%s\n", state_ok ? "true" : "false");
+
+  // 大请求按 SM4_DRBG_MAX_REQUEST 拆分，应与手动分次请求一致
+  sm4_drbg_instantiate(&d1, entropy, 32, nonce, 16, pers, 4);
+  sm4_drbg_instantiate(&d2, entropy, 32, nonce, 16, pers, 4);
+  sm4_drbg_generate(&d1, a, BULK, NULL, 0);
+  for (size_t off = 0; off < BULK; off += SM4_DRBG_MAX_REQUEST) {
+    size_t n = BULK - off < SM4_DRBG_MAX_REQUEST ? BULK - off
+                                                 : SM4_DRBG_MAX_REQUEST;
+    sm4_drbg_generate(&d2, b + off, n, NULL, 0);
+  }
+  int split_ok = memcmp(a, b, BULK) == 0;
+
+  // 缓冲接口：零碎的小请求拼起来等于整块补充的内容
+  sm4_drbg_instantiate(&d1, entropy, 32, nonce, 16, pers, 4);
+  sm4_drbg_instantiate(&d2, entropy, 32, nonce, 16, pers, 4);
+  size_t got = 0;
+  for (size_t n = 1; got + n <= 2 * SM4_DRBG_BUFFER; n = n % 37 + 1) {
+    sm4_drbg_bytes(&d1, a + got, n);
+    got += n;
+  }
+  sm4_drbg_generate(&d2, b, SM4_DRBG_BUFFER, NULL, 0);
+  sm4_drbg_generate(&d2, b + SM4_DRBG_BUFFER, SM4_DRBG_BUFFER, NULL, 0);
+  split_ok &= memcmp(a, b, got) == 0;
+  printf("分段与缓冲输出是否一致：\t%s\n", split_ok ? "true" : "false");
+
+  // 个性化串与附加输入都应改变输出；请求数到上限时要求重播种
+  sm4_drbg_instantiate(&d1, entropy, 32, nonce, 16, pers, 4);
+  sm4_drbg_instantiate(&d2, entropy, 32, nonce, 16, pers, 3);
+  sm4_drbg_generate(&d1, a, 64, NULL, 0);
+  sm4_drbg_generate(&d2, b, 64, NULL, 0);
+  int input_ok = memcmp(a, b, 64) != 0;
+  sm4_drbg_instantiate(&d2, entropy, 32, nonce, 16, pers, 4);
+  sm4_drbg_generate(&d2, b, 64, pers, 4);
+  input_ok &= memcmp(a, b, 64) != 0;
+  d1.reseed_counter = SM4_DRBG_RESEED_INTERVAL + 1;
+  input_ok &= sm4_drbg_generate(&d1, a, 16, NULL, 0) == SM4_DRBG_NEED_RESEED;
+  input_ok &= sm4_drbg_reseed(&d1, entropy, 32, NULL, 0) == SM4_DRBG_OK;
+  input_ok &= sm4_drbg_generate(&d1, a, 16, NULL, 0) == SM4_DRBG_OK;
+  input_ok &= sm4_drbg_instantiate(&d1, entropy, 8, NULL, 0, NULL, 0) ==
+              SM4_DRBG_ERROR;
+  printf("输入与重播种处理是否正确：\t%s\n", input_ok ? "true" : "false");
+
+  // 每线程实例：字节分布的卡方值（自由度 255）应远小于 400
+  size_t count[256] = {0};
+  int sys_ok = sm4_random_bytes(a, BULK) == SM4_DRBG_OK;
+  sys_ok &= sm4_random_bytes(b, 32) == SM4_DRBG_OK;
+  sys_ok &= memcmp(a, b, 32) != 0;
+  for (size_t i = 0; i < BULK; i++) {
+    count[a[i]]++;
+  }
+  double expect = BULK / 256.0, chi2 = 0;
+  for (int i = 0; i < 256; i++) {
+    chi2 += (count[i] - expect) * (count[i] - expect) / expect;
+  }
+  sys_ok &= chi2 < 400;
+  printf("系统熵源实例是否正常：\t\t%s\n", sys_ok ? "true" : "false");
+}
+
+// 密钥流池测试：命中与未命中的输出都等于 nonce || ctr32 的 CTR，
+// 序号跳跃、回退和后台填充
+void run_kspool_test(const uint8_t *key) {
+  printf("\n密钥流池测试\n");
+
+  static const uint8_t iv[12] = {0xCA, 0xFE, 0xBA, 0xBE, 1, 2,
+                                 3,    4,    5,    6,    7, 8};
+  enum { MAX_LEN = 100 };
+  uint8_t in[MAX_LEN + 40], out[MAX_LEN + 40], ref[MAX_LEN + 40];
+  uint8_t ek0[16], ref_ek0[16], ctr[16];
+  for (int i = 0; i < MAX_LEN + 40; i++) {
+    in[i] = (uint8_t)(i * 13);
+  }
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+
+  SM4_KSPOOL pool;
+  sm4_kspool_init(&pool, key, iv, MAX_LEN, 4, 0);
+  int fill_ok = sm4_kspool_fill(&pool, 10) == 4;
+  fill_ok &= sm4_kspool_fill(&pool, 10) == 0;
+
+  // 序号 0 命中，1 超过 max_len，跳到 3（丢弃 2）命中，5 尚未生成，
+  // 之后回退到 2，6 在跳跃后未重新填充
+  static const uint64_t SEQS[] = {0, 1, 3, 5, 2, 6};
+  static const int HITS[] = {1, 0, 1, 0, 0, 0};
+  int ok = 1;
+  for (int t = 0; t < 6; t++) {
+    size_t len = t == 1 ? MAX_LEN + 33 : (size_t)(t * 19) % MAX_LEN;
+    ok &= sm4_kspool_xor(&pool, SEQS[t], ek0, in, out, len) == HITS[t];
+    sm4_kspool_nonce(&pool, SEQS[t], ctr);
+    memset(ctr + 12, 0, 4);
+    ctr[15] = 1;
+    sm4_encrypt(ctr, &sm4_key, ref_ek0);
+    ctr[15] = 2;
+    ref_ctr(in, ref, len, ctr, 32, &sm4_key);
+    ok &= memcmp(ek0, ref_ek0, 16) == 0 && memcmp(out, ref, len) == 0;
+  }
+  SM4_KSPOOL_STATS st;
+  sm4_kspool_stats(&pool, &st);
+  ok &= st.hits == 2 && st.misses == 4 && st.ready == 0;
+  printf("命中/未命中输出是否正确：\t%s\n", ok && fill_ok ? "true" : "false");
+  sm4_kspool_free(&pool);
+
+  // 后台线程把环填满，之后的消息全部命中
+  sm4_kspool_init(&pool, key, iv, MAX_LEN, 16, 1);
+  for (int spin = 0; spin < 2000; spin++) {
+    sm4_kspool_stats(&pool, &st);
+    if (st.ready == 16) {
+      break;
+    }
+    usleep(1000);
+  }
+  int bg_ok = st.ready == 16;
+  for (uint64_t seq = 0; seq < 16; seq++) {
+    bg_ok &= sm4_kspool_xor(&pool, seq, ek0, in, out, MAX_LEN) == 1;
+  }
+  sm4_kspool_free(&pool);
+  printf("后台填充是否生效：\t\t%s\n", bg_ok ? "true" : "false");
+}
+
+// 大缓冲区模式测试：阈值压到 1 字节强制走非临时存储，结果与普通路径一致；
+// 输出不对齐时自动退回普通路径
+void run_stream_test(const uint8_t *key) {
+  printf("\n大缓冲区模式测试\n");
+
+  enum { NB = 3 * SM4_STREAM_CHUNK + 37 };
+  size_t bytes = 16 * NB + 16;
+  uint8_t *in = sm4_stream_alloc(bytes, 1);
+  uint8_t *out = sm4_stream_alloc(bytes, 0);
+  static uint8_t ref[16 * NB + 16];
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  for (size_t i = 0; i < bytes; i++) {
+    in[i] = (uint8_t)(i * 29 + 1);
+  }
+
+  size_t saved = sm4_stream_threshold();
+  sm4_stream_set_threshold(1);
+  int ecb_ok = 1;
+  for (int shift = 0; shift <= 1; shift++) {
+    sm4_engine_encrypt_blocks(in, ref, NB, &sm4_key);
+    sm4_stream_encrypt_blocks(in, out + shift, NB, &sm4_key);
+    ecb_ok &= memcmp(out + shift, ref, 16 * NB) == 0;
+    sm4_stream_decrypt_blocks(out + shift, out + shift, NB, &sm4_key);
+    ecb_ok &= memcmp(out + shift, in, 16 * NB) == 0;
+  }
+  printf("ECB 非临时存储是否正确：\t%s\n", ecb_ok ? "true" : "false");
+
+  uint8_t iv[16] = {0xFF, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0xFF, 0xFF, 0xFF};
+  uint8_t c1[16], c2[16];
+  memcpy(c1, iv, 16);
+  memcpy(c2, iv, 16);
+  sm4_ctr32_blocks(in, out, NB, c1, &sm4_key);
+  sm4_stream_set_threshold(SIZE_MAX);
+  sm4_ctr32_blocks(in, ref, NB, c2, &sm4_key);
+  int ctr_ok = memcmp(out, ref, 16 * NB) == 0 && memcmp(c1, c2, 16) == 0;
+  printf("CTR 非临时存储是否正确：\t%s\n", ctr_ok ? "true" : "false");
+  sm4_stream_set_threshold(saved);
+
+  sm4_stream_free(in, bytes);
+  sm4_stream_free(out, bytes);
+}
+
+// 多线程测试：小分片、线程数多于 CPU 数以触发窃取，结果应与单线程一致
+void run_mt_test(const uint8_t *key) {
+  printf("\n多线程测试\n");
+
+  enum { MT_BLOCKS = 4099 };
+  static uint8_t plaintext[16 * MT_BLOCKS];
+  static uint8_t expected[sizeof(plaintext)];
+  static uint8_t buf[sizeof(plaintext)];
+  uint8_t iv[16], iv_mt[16];
+
+  SM4_MT_OPTIONS opt = {.max_threads = 4, .min_chunk = 1000, .pin = 1};
+  sm4_mt_configure(&opt);
+  printf("线程数：%u\n", sm4_mt_threads());
+
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  for (size_t i = 0; i < sizeof(plaintext); i++) {
+    plaintext[i] = (uint8_t)(i * 97 + (i >> 9));
+  }
+  for (int i = 0; i < 16; i++) {
+    iv[i] = (uint8_t)(i * 3);
+  }
+
+  sm4_encrypt_blocks(plaintext, expected, MT_BLOCKS, &sm4_key);
+  sm4_mt_encrypt_blocks(plaintext, buf, MT_BLOCKS, &sm4_key);
+  int ecb_ok = memcmp(buf, expected, sizeof(buf)) == 0;
+  sm4_mt_decrypt_blocks(buf, buf, MT_BLOCKS, &sm4_key);
+  ecb_ok &= memcmp(buf, plaintext, sizeof(buf)) == 0;
+  printf("多线程 ECB 是否正确：\t\t%s\n", ecb_ok ? "true" : "false");
+
+  // 起始偏移与长度都不按 16 字节对齐
+  size_t len = sizeof(plaintext) - 21;
+  sm4_ctr_range(&sm4_key, iv, 32, 5, plaintext, expected, len);
+  sm4_mt_ctr_range(&sm4_key, iv, 32, 5, plaintext, buf, len);
+  printf("多线程 CTR 是否正确：\t\t%s\n",
+         memcmp(buf, expected, len) == 0 ? "true" : "false");
+
+  // 原地解密，分片链值需在覆盖前保存
+  memcpy(iv_mt, iv, 16);
+  sm4_cbc_encrypt(plaintext, buf, MT_BLOCKS, iv_mt, &sm4_key);
+  memcpy(iv_mt, iv, 16);
+  sm4_mt_cbc_decrypt(buf, buf, MT_BLOCKS, iv_mt, &sm4_key);
+  int cbc_ok = memcmp(buf, plaintext, sizeof(buf)) == 0;
+  memcpy(iv_mt, iv, 16);
+  sm4_cfb_encrypt(plaintext, buf, MT_BLOCKS, iv_mt, &sm4_key);
+  memcpy(expected, iv_mt, 16);
+  memcpy(iv_mt, iv, 16);
+  sm4_mt_cfb_decrypt(buf, buf, MT_BLOCKS, iv_mt, &sm4_key);
+  cbc_ok &= memcmp(buf, plaintext, sizeof(buf)) == 0;
+  cbc_ok &= memcmp(iv_mt, expected, 16) == 0;
+  printf("多线程 CBC/CFB 解密是否正确：\t%s\n", cbc_ok ? "true" : "false");
+
+  sm4_mt_shutdown();
+}
+
+static const SM4_Key *trace_key;
+
+// 后端插桩点（SM4_TRACE_REF 到 SM4_TRACE_BITSLICE）中除 site 外是否都没有
+// 变化：处理尾部时借用的其他后端不应计数
+static int trace_backends_unchanged(const SM4_TRACE_STATS *before,
+                                    const SM4_TRACE_STATS *after, int site) {
+  for (int i = SM4_TRACE_REF; i <= SM4_TRACE_BITSLICE; i++) {
+    if (i != site && (after[i].calls != before[i].calls ||
+                      after[i].blocks != before[i].blocks)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void *trace_worker(void *arg) {
+  uint8_t buf[16 * 5] = {0};
+  for (int i = 0; i < 3; i++) {
+    sm4_engine_encrypt_blocks(buf, buf, 5, trace_key);
+  }
+  return arg;
+}
+
+void run_trace_test(const uint8_t *key) {
+  printf("\n插桩测试\n");
+  if (!sm4_trace_compiled()) {
+    SM4_TRACE_STATS stats[SM4_TRACE_SITES];
+    sm4_trace_snapshot(stats);
+    int zero = 1;
+    for (int i = 0; i < SM4_TRACE_SITES; i++) {
+      zero &= stats[i].calls == 0;
+    }
+    printf("未编入插桩（make TRACE=1），快照是否为 0：\t%s\n",
+           zero ? "true" : "false");
+    return;
+  }
+
+  static SM4_TRACE_STATS before[SM4_TRACE_SITES], after[SM4_TRACE_SITES];
+  uint8_t buf[16 * 100] = {0}, ctr[16] = {0};
+  SM4_Key sm4_key;
+  sm4_keyInit(key, &sm4_key);
+  trace_key = &sm4_key;
+
+  // 多块入口按实际分派到的后端计数
+  int site = -1;
+  for (int i = 0; i < SM4_TRACE_SITES; i++) {
+    if (strcmp(sm4_trace_site_name(i), sm4_engine_get(100)->name) == 0) {
+      site = i;
+    }
+  }
+
+  sm4_trace_set_sample_period(1);
+  sm4_trace_snapshot(before);
+  sm4_engine_encrypt_blocks(buf, buf, 100, &sm4_key);
+  sm4_trace_snapshot(after);
+  SM4_TRACE_STATS *a = &after[site], *b = &before[site];
+  uint64_t hist = 0;
+  for (int i = 0; i < SM4_TRACE_BUCKETS; i++) {
+    hist += a->hist[i] - b->hist[i];
+  }
+  int count_ok = site >= 0 && a->calls - b->calls == 1 &&
+                 a->blocks - b->blocks == 100 && a->bytes - b->bytes == 1600 &&
+                 trace_backends_unchanged(before, after, site);
+  printf("后端 %s 计数是否正确：\t%s\n", sm4_engine_get(100)->name,
+         count_ok ? "true" : "false");
+  printf("周期直方图是否与采样数一致：\t%s\n",
+         a->sampled - b->sampled == 1 && hist == 1 && a->cycles > b->cycles
+             ? "true"
+             : "false");
+
+  // 逐个后端：100 块含 4 块尾部，单密钥与多密钥入口都只计入自己
+  size_t engine_count;
+  const SM4_ENGINE *engines = sm4_engine_list(&engine_count);
+  const SM4_Key *keys[100];
+  for (int i = 0; i < 100; i++) {
+    keys[i] = &sm4_key;
+  }
+  int each_ok = 1;
+  for (size_t e = 0; e < engine_count; e++) {
+    const SM4_ENGINE *engine = &engines[e];
+    int own = -1;
+    for (int i = 0; i < SM4_TRACE_SITES; i++) {
+      if (strcmp(sm4_trace_site_name(i), engine->name) == 0) {
+        own = i;
+      }
+    }
+    if (!sm4_engine_available(engine)) {
+      continue;
+    }
+    uint64_t calls = 2;
+    sm4_trace_snapshot(before);
+    engine->encrypt_blocks(buf, buf, 100, &sm4_key);
+    engine->decrypt_blocks(buf, buf, 100, &sm4_key);
+    if (engine->encrypt_multikey != NULL) {
+      engine->encrypt_multikey(buf, buf, 100, keys);
+      engine->decrypt_multikey(buf, buf, 100, keys);
+      calls = 4;
+    }
+    sm4_trace_snapshot(after);
+    each_ok &= own >= 0 && after[own].calls - before[own].calls == calls &&
+               after[own].blocks - before[own].blocks == 100 * calls &&
+               trace_backends_unchanged(before, after, own);
+  }
+  printf("各后端只计入自己的插桩点：	%s\n", each_ok ? "true" : "false");
+
+  // 工作模式与其调用的后端各计一次
+  sm4_trace_snapshot(before);
+  sm4_ctr32_blocks(buf, buf, 10, ctr, &sm4_key);
+  sm4_trace_snapshot(after);
+  printf("CTR 计数是否正确：\t\t%s\n",
+         after[SM4_TRACE_CTR].calls - before[SM4_TRACE_CTR].calls == 1 &&
+                 after[SM4_TRACE_CTR].blocks - before[SM4_TRACE_CTR].blocks ==
+                     10
+             ? "true"
+             : "false");
+
+  // 已退出线程的计数仍计入快照
+  pthread_t th;
+  sm4_trace_snapshot(before);
+  pthread_create(&th, NULL, trace_worker, NULL);
+  pthread_join(th, NULL);
+  sm4_trace_snapshot(after);
+  printf("已退出线程是否计入：\t\t%s\n",
+         site >= 0 && after[site].calls - before[site].calls == 3 &&
+                 after[site].blocks - before[site].blocks == 15
+             ? "true"
+             : "false");
+  sm4_trace_set_sample_period(16);
+
+  char line[256], want[64];
+  int found = 0;
+  snprintf(want, sizeof(want), "sm4_calls_total{site=\"%s\"}",
+           sm4_trace_site_name(site));
+  FILE *f = tmpfile();
+  int lines = f != NULL ? sm4_trace_dump(f) : 0;
+  if (f != NULL) {
+    rewind(f);
+    while (fgets(line, sizeof(line), f) != NULL) {
+      found |= strncmp(line, want, strlen(want)) == 0;
+    }
+    fclose(f);
+  }
+  printf("Prometheus 输出是否包含后端：\t%s（%d 行）\n",
+         found ? "true" : "false", lines);
+}
+
 int main() {
   // 测试向量（来自 SM4 标准）
   uint8_t plaintext[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
@@ -55,11 +1053,63 @@ int main() {
   run_test("SM4 原始实现标准示例测试", sm4_encrypt, sm4_decrypt, key, plaintext,
            expected_ciphertext);
 
-  run_test("SM4 AES-NI x4 优化测试", sm4_encrypt_aesni, sm4_decrypt_aesni, key,
-           plaintext, expected_ciphertext);
+  if (sm4_engine_available(sm4_engine_find("aesni"))) {
+    run_test("SM4 AES-NI x4 优化测试", sm4_encrypt_aesni, sm4_decrypt_aesni,
+             key, plaintext, expected_ciphertext);
+  }
 
   run_test("SM4 T-table 优化测试", sm4_encrypt_ttable, sm4_decrypt_ttable, key,
            plaintext, expected_ciphertext);
 
+  // 多块接口：遍历所有后端，跳过当前 CPU 不支持的
+  size_t engine_count;
+  const SM4_ENGINE *engines = sm4_engine_list(&engine_count);
+  char title[128];
+  for (size_t i = 0; i < engine_count; i++) {
+    if (!sm4_engine_available(&engines[i])) {
+      printf("\n后端 %s：当前 CPU 不支持，跳过\n", engines[i].name);
+      continue;
+    }
+    snprintf(title, sizeof(title), "后端 %s 多块测试", engines[i].name);
+    run_blocks_test(title, engines[i].encrypt_blocks, engines[i].decrypt_blocks,
+                    key);
+    snprintf(title, sizeof(title), "后端 %s 批量测试", engines[i].name);
+    run_batch_test(title, engines[i].encrypt_blocks, engines[i].decrypt_blocks,
+                   key);
+    if (engines[i].encrypt_multikey != NULL) {
+      snprintf(title, sizeof(title), "后端 %s 多密钥测试", engines[i].name);
+      run_multikey_test(title, engines[i].encrypt_multikey,
+                        engines[i].decrypt_multikey);
+    }
+  }
+
+  printf("\n自动选择：单块 %s，小批量 %s，大批量 %s%s\n",
+         sm4_engine_get(1)->name, sm4_engine_get(16)->name,
+         sm4_engine_get(4096)->name,
+         sm4_avx2_has_vaes() ? "（支持 VAES）" : "");
+  run_blocks_test("自动选择后端多块测试", sm4_engine_encrypt_blocks,
+                  sm4_engine_decrypt_blocks, key);
+  run_multikey_test("自动选择后端多密钥测试", sm4_engine_encrypt_multikey,
+                    sm4_engine_decrypt_multikey);
+
+  if (sm4_engine_available(sm4_engine_find("aesni"))) {
+    run_keyinit_batch_test("AES-NI 批量密钥扩展测试", sm4_keyInit_batch_aesni);
+  }
+  if (sm4_engine_available(sm4_engine_find("avx2"))) {
+    run_keyinit_batch_test("AVX2 批量密钥扩展测试", sm4_keyInit_batch_avx2);
+  }
+  run_keyinit_batch_test("自动选择批量密钥扩展测试", sm4_keyInit_batch);
+
+  run_ctr_test(key);
+  run_ctr_range_test(key);
+  run_cbc_cfb_test(key);
+  run_xts_test();
+  run_ccm_test(key);
+  run_drbg_test();
+  run_kspool_test(key);
+  run_stream_test(key);
+  run_mt_test(key);
+  run_trace_test(key);
+
   return 0;
 }
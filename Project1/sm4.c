@@ -1,4 +1,5 @@
 #include "sm4.h"
+#include "sm4_trace.h"
 
 static uint32_t FK[4] = {0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc};
 
@@ -65,6 +66,17 @@ void sm4_keyInit(const uint8_t *key, SM4_Key *sm4_key) {
     k[2] = k[3];
     k[3] = sm4_key->rk[i];
   }
+
+  // 解密序轮密钥与广播形式的向量轮密钥
+  for (int i = 0; i < 32; i++) {
+    sm4_key->rk_dec[i] = sm4_key->rk[31 - i];
+  }
+  for (int i = 0; i < 32; i++) {
+    for (int j = 0; j < 4; j++) {
+      sm4_key->rk_x4[0][i][j] = sm4_key->rk[i];
+      sm4_key->rk_x4[1][i][j] = sm4_key->rk_dec[i];
+    }
+  }
 }
 
 // S-Box变换函数
@@ -95,8 +107,8 @@ void split_int(uint32_t n, uint8_t out[4]) {
   out[3] = n & 0xFF;
 }
 
-// SM4 迭代主函数
-void sm4_main(const uint8_t input[16], const uint32_t rk[32], int mode,
+// SM4 迭代主函数，rk 为按使用顺序排列的轮密钥（加密 rk，解密 rk_dec）
+void sm4_main(const uint8_t input[16], const uint32_t rk[32],
               uint8_t output[16]) {
   uint32_t text[4];
 
@@ -108,8 +120,7 @@ void sm4_main(const uint8_t input[16], const uint32_t rk[32], int mode,
 
   // 32轮迭代
   for (int i = 0; i < 32; i++) {
-    int index = (mode == 0) ? i : (31 - i); // mode==0 加密；mode==1 解密
-    uint32_t box_input = text[1] ^ text[2] ^ text[3] ^ rk[index];
+    uint32_t box_input = text[1] ^ text[2] ^ text[3] ^ rk[i];
     uint32_t box_output = sBox(box_input);
     uint32_t temp = text[0] ^ box_output ^ rotl32(box_output, 2) ^
                     rotl32(box_output, 10) ^ rotl32(box_output, 18) ^
@@ -126,9 +137,45 @@ void sm4_main(const uint8_t input[16], const uint32_t rk[32], int mode,
 }
 
 void sm4_encrypt(const uint8_t *input, const SM4_Key *key, uint8_t *output) {
-  sm4_main(input, key->rk, 0, output);
+  sm4_main(input, key->rk, output);
 }
 
 void sm4_decrypt(const uint8_t *input, const SM4_Key *key, uint8_t *output) {
-  sm4_main(input, key->rk, 1, output);
-}
\ No newline at end of file
+  sm4_main(input, key->rk_dec, output);
+}
+
+void sm4_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        const SM4_Key *key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_REF, 16 * nblocks, nblocks);
+  for (size_t i = 0; i < nblocks; i++) {
+    sm4_main(in + 16 * i, key->rk, out + 16 * i);
+  }
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        const SM4_Key *key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_REF, 16 * nblocks, nblocks);
+  for (size_t i = 0; i < nblocks; i++) {
+    sm4_main(in + 16 * i, key->rk_dec, out + 16 * i);
+  }
+  SM4_TRACE_END();
+}
+
+void sm4_encrypt_multikey(const uint8_t *in, uint8_t *out, size_t nblocks,
+                          const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_REF, 16 * nblocks, nblocks);
+  for (size_t i = 0; i < nblocks; i++) {
+    sm4_main(in + 16 * i, keys[i]->rk, out + 16 * i);
+  }
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_multikey(const uint8_t *in, uint8_t *out, size_t nblocks,
+                          const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_REF, 16 * nblocks, nblocks);
+  for (size_t i = 0; i < nblocks; i++) {
+    sm4_main(in + 16 * i, keys[i]->rk_dec, out + 16 * i);
+  }
+  SM4_TRACE_END();
+}
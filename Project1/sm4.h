@@ -2,10 +2,14 @@
 #define SM4_H
 
 #include "stdint.h"
+#include <stddef.h>
 
-//轮密钥
+//轮密钥：sm4_keyInit 一次性生成各后端需要的形式，加解密时不再判断方向
 typedef struct sm4_key {
-  uint32_t rk[32];
+  uint32_t rk[32];     // 加密序轮密钥
+  uint32_t rk_dec[32]; // 解密序轮密钥（rk 逆序）
+  // 每个轮密钥广播到 4 个 32 位槽位，供 SIMD 后端直接装载：[0] 加密，[1] 解密
+  uint32_t rk_x4[2][32][4] __attribute__((aligned(16)));
 } SM4_Key;
 
 //初始化密钥
@@ -17,4 +21,20 @@ void sm4_encrypt(const uint8_t *input, const SM4_Key *key, uint8_t *output);
 //解密函数
 void sm4_decrypt(const uint8_t *input, const SM4_Key *key, uint8_t *output);
 
+//多块加密函数（nblocks 个连续的 16 字节分组）
+void sm4_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        const SM4_Key *key);
+
+//多块解密函数
+void sm4_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        const SM4_Key *key);
+
+//多密钥加密函数：第 i 个分组使用 keys[i]
+void sm4_encrypt_multikey(const uint8_t *in, uint8_t *out, size_t nblocks,
+                          const SM4_Key *const *keys);
+
+//多密钥解密函数
+void sm4_decrypt_multikey(const uint8_t *in, uint8_t *out, size_t nblocks,
+                          const SM4_Key *const *keys);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,522 @@
+#ifndef SM4_HPP
+#define SM4_HPP
+
+// C++20 头文件前端：分组密码后端作为模板参数在编译期选定，内核与调用方在同一
+// 翻译单元内展开内联，不经过函数指针和运行时分派。只依赖本头文件，不需要链接
+// Project1 的 C 代码，轮密钥与 sm4_keyInit 生成的 rk / rk_dec 相同。
+//
+// SIMD 后端只在翻译单元开启了对应指令集时才定义：sm4::aesni 需要
+// -maes -mssse3，sm4::avx2 还需要 -mavx2（再加 -mvaes 时 S 盒使用 256 位
+// vaesenclast）。调用方负责在运行前用 available() 确认 CPU 支持
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AES__) && defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace sm4 {
+
+namespace detail {
+
+inline constexpr std::array<uint8_t, 256> SBOX = {
+    0xD6, 0x90, 0xE9, 0xFE, 0xCC, 0xE1, 0x3D, 0xB7, 0x16, 0xB6, 0x14, 0xC2,
+    0x28, 0xFB, 0x2C, 0x05, 0x2B, 0x67, 0x9A, 0x76, 0x2A, 0xBE, 0x04, 0xC3,
+    0xAA, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99, 0x9C, 0x42, 0x50, 0xF4,
+    0x91, 0xEF, 0x98, 0x7A, 0x33, 0x54, 0x0B, 0x43, 0xED, 0xCF, 0xAC, 0x62,
+    0xE4, 0xB3, 0x1C, 0xA9, 0xC9, 0x08, 0xE8, 0x95, 0x80, 0xDF, 0x94, 0xFA,
+    0x75, 0x8F, 0x3F, 0xA6, 0x47, 0x07, 0xA7, 0xFC, 0xF3, 0x73, 0x17, 0xBA,
+    0x83, 0x59, 0x3C, 0x19, 0xE6, 0x85, 0x4F, 0xA8, 0x68, 0x6B, 0x81, 0xB2,
+    0x71, 0x64, 0xDA, 0x8B, 0xF8, 0xEB, 0x0F, 0x4B, 0x70, 0x56, 0x9D, 0x35,
+    0x1E, 0x24, 0x0E, 0x5E, 0x63, 0x58, 0xD1, 0xA2, 0x25, 0x22, 0x7C, 0x3B,
+    0x01, 0x21, 0x78, 0x87, 0xD4, 0x00, 0x46, 0x57, 0x9F, 0xD3, 0x27, 0x52,
+    0x4C, 0x36, 0x02, 0xE7, 0xA0, 0xC4, 0xC8, 0x9E, 0xEA, 0xBF, 0x8A, 0xD2,
+    0x40, 0xC7, 0x38, 0xB5, 0xA3, 0xF7, 0xF2, 0xCE, 0xF9, 0x61, 0x15, 0xA1,
+    0xE0, 0xAE, 0x5D, 0xA4, 0x9B, 0x34, 0x1A, 0x55, 0xAD, 0x93, 0x32, 0x30,
+    0xF5, 0x8C, 0xB1, 0xE3, 0x1D, 0xF6, 0xE2, 0x2E, 0x82, 0x66, 0xCA, 0x60,
+    0xC0, 0x29, 0x23, 0xAB, 0x0D, 0x53, 0x4E, 0x6F, 0xD5, 0xDB, 0x37, 0x45,
+    0xDE, 0xFD, 0x8E, 0x2F, 0x03, 0xFF, 0x6A, 0x72, 0x6D, 0x6C, 0x5B, 0x51,
+    0x8D, 0x1B, 0xAF, 0x92, 0xBB, 0xDD, 0xBC, 0x7F, 0x11, 0xD9, 0x5C, 0x41,
+    0x1F, 0x10, 0x5A, 0xD8, 0x0A, 0xC1, 0x31, 0x88, 0xA5, 0xCD, 0x7B, 0xBD,
+    0x2D, 0x74, 0xD0, 0x12, 0xB8, 0xE5, 0xB4, 0xB0, 0x89, 0x69, 0x97, 0x4A,
+    0x0C, 0x96, 0x77, 0x7E, 0x65, 0xB9, 0xF1, 0x09, 0xC5, 0x6E, 0xC6, 0x84,
+    0x18, 0xF0, 0x7D, 0xEC, 0x3A, 0xDC, 0x4D, 0x20, 0x79, 0xEE, 0x5F, 0x3E,
+    0xD7, 0xCB, 0x39, 0x48};
+
+inline constexpr std::array<uint32_t, 4> FK = {0xa3b1bac6, 0x56aa3350,
+                                               0x677d9197, 0xb27022dc};
+
+constexpr uint32_t rotl(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+// CK 第 i 个字的第 j 个字节（大端）为 (4i + j) * 7 mod 256
+constexpr std::array<uint32_t, 32> make_ck() {
+  std::array<uint32_t, 32> ck{};
+  for (uint32_t i = 0; i < 32; i++) {
+    for (uint32_t j = 0; j < 4; j++) {
+      ck[i] = (ck[i] << 8) | (((4 * i + j) * 7) & 0xFF);
+    }
+  }
+  return ck;
+}
+
+inline constexpr auto CK = make_ck();
+
+// 合并 S 盒与线性变换 L 的 T 表，shift 为输入字节在字中的位置
+constexpr std::array<uint32_t, 256> make_table(int shift) {
+  std::array<uint32_t, 256> t{};
+  for (int i = 0; i < 256; i++) {
+    uint32_t b = (uint32_t)SBOX[i] << shift;
+    t[i] = b ^ rotl(b, 2) ^ rotl(b, 10) ^ rotl(b, 18) ^ rotl(b, 24);
+  }
+  return t;
+}
+
+inline constexpr auto T0 = make_table(24);
+inline constexpr auto T1 = make_table(16);
+inline constexpr auto T2 = make_table(8);
+inline constexpr auto T3 = make_table(0);
+
+// 与 sm4_ttable.c 中手写的 Table0~Table3 一致
+static_assert(CK[1] == 0x1c232a31 && CK[31] == 0x646b7279);
+static_assert(T0[0] == 0x8ED55B5B && T1[255] == 0x21684921);
+static_assert(T2[1] == 0x4242D092 && T3[255] == 0x49212168);
+
+constexpr uint32_t load_be32(const uint8_t *p) {
+  if (std::is_constant_evaluated()) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | p[3];
+  }
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return __builtin_bswap32(v);
+}
+
+inline void store_be32(uint8_t *p, uint32_t v) {
+  v = __builtin_bswap32(v);
+  std::memcpy(p, &v, 4);
+}
+
+} // namespace detail
+
+// 轮密钥：加密序与解密序（enc 逆序）
+struct key_schedule {
+  std::array<uint32_t, 32> enc{};
+  std::array<uint32_t, 32> dec{};
+};
+
+// 密钥扩展，可在编译期求值
+constexpr key_schedule expand_key(std::span<const uint8_t, 16> key) {
+  key_schedule ks;
+  uint32_t k[4];
+  for (int i = 0; i < 4; i++) {
+    k[i] = detail::load_be32(key.data() + 4 * i) ^ detail::FK[i];
+  }
+  for (int i = 0; i < 32; i++) {
+    uint32_t t = k[(i + 1) % 4] ^ k[(i + 2) % 4] ^ k[(i + 3) % 4] ^
+                 detail::CK[i];
+    t = (uint32_t)detail::SBOX[t >> 24] << 24 |
+        (uint32_t)detail::SBOX[(t >> 16) & 0xFF] << 16 |
+        (uint32_t)detail::SBOX[(t >> 8) & 0xFF] << 8 |
+        detail::SBOX[t & 0xFF];
+    k[i % 4] ^= t ^ detail::rotl(t, 13) ^ detail::rotl(t, 23);
+    ks.enc[i] = k[i % 4];
+    ks.dec[31 - i] = k[i % 4];
+  }
+  return ks;
+}
+
+namespace detail {
+
+// GB/T 32907 附录 A 的密钥，rk0 与 rk31 见标准示例
+inline constexpr std::array<uint8_t, 16> STD_KEY = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+    0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10};
+static_assert(expand_key(STD_KEY).enc[0] == 0xF12186F9 &&
+              expand_key(STD_KEY).enc[31] == 0x9124A012);
+
+// T 表后端的第 I 轮（I 为编译期常量，状态字的角色轮换不需要移动数据）
+template <size_t I, size_t L>
+[[gnu::always_inline]] inline void ttable_round(uint32_t (&x)[L][4],
+                                                const uint32_t *rk) {
+  uint32_t k = rk[I];
+  for (size_t l = 0; l < L; l++) {
+    uint32_t t = x[l][(I + 1) % 4] ^ x[l][(I + 2) % 4] ^ x[l][(I + 3) % 4] ^ k;
+    x[l][I % 4] ^= T0[t >> 24] ^ T1[(t >> 16) & 0xFF] ^ T2[(t >> 8) & 0xFF] ^
+                   T3[t & 0xFF];
+  }
+}
+
+template <size_t L, size_t... I>
+[[gnu::always_inline]] inline void
+ttable_rounds(uint32_t (&x)[L][4], const uint32_t *rk,
+              std::index_sequence<I...>) {
+  (ttable_round<I>(x, rk), ...);
+}
+
+// T 表后端的 L 路交错：L 个分组的状态在寄存器中，32 轮完全展开
+template <size_t L>
+[[gnu::always_inline]] inline void ttable_lanes(const uint8_t *in,
+                                                uint8_t *out,
+                                                const uint32_t *rk) {
+  uint32_t x[L][4];
+  for (size_t l = 0; l < L; l++) {
+    for (size_t j = 0; j < 4; j++) {
+      x[l][j] = load_be32(in + 16 * l + 4 * j);
+    }
+  }
+  ttable_rounds(x, rk, std::make_index_sequence<32>{});
+  for (size_t l = 0; l < L; l++) {
+    for (size_t j = 0; j < 4; j++) {
+      store_be32(out + 16 * l + 4 * j, x[l][3 - j]);
+    }
+  }
+}
+
+} // namespace detail
+
+// 后端约定：crypt(in, out, nblocks, rk) 用 32 个轮密钥处理 nblocks 个连续
+// 分组（rk 为解密序时即解密），允许 in == out；available() 检查当前 CPU
+
+// 查表后端：不依赖指令集扩展，4 块交错
+struct ttable {
+  static constexpr const char *name = "ttable";
+
+  static bool available() noexcept { return true; }
+
+  [[gnu::always_inline]] static void crypt(const uint8_t *in, uint8_t *out,
+                                           size_t nblocks,
+                                           const uint32_t *rk) noexcept {
+    for (; nblocks >= 4; nblocks -= 4, in += 64, out += 64) {
+      detail::ttable_lanes<4>(in, out, rk);
+    }
+    if (nblocks >= 2) {
+      detail::ttable_lanes<2>(in, out, rk);
+      nblocks -= 2, in += 32, out += 32;
+    }
+    if (nblocks > 0) {
+      detail::ttable_lanes<1>(in, out, rk);
+    }
+  }
+};
+
+#if defined(__AES__) && defined(__SSSE3__)
+namespace detail {
+
+// 向量宽度抽象：SM4 的 4 个状态字各占一个寄存器，每个 32 位通道一个分组，
+// 因此一组寄存器处理 blocks = 4 * (寄存器字节数 / 16) 个分组。字节重排和
+// 解包都在 128 位半区内进行，256 位时每个半区各自按 4 块转置
+struct v128 {
+  using type = __m128i;
+  static constexpr size_t blocks = 4;
+
+  static type load(const uint8_t *p) {
+    return _mm_loadu_si128((const __m128i *)p);
+  }
+  static void store(uint8_t *p, type v) { _mm_storeu_si128((__m128i *)p, v); }
+  static type bcast(__m128i v) { return v; }
+  static type set1(uint32_t v) { return _mm_set1_epi32((int)v); }
+  static type xor_(type a, type b) { return _mm_xor_si128(a, b); }
+  static type and_(type a, type b) { return _mm_and_si128(a, b); }
+  static type shuffle(type a, type idx) { return _mm_shuffle_epi8(a, idx); }
+  static type srli16_4(type a) { return _mm_srli_epi16(a, 4); }
+  template <int N> static type rotl(type a) {
+    return _mm_xor_si128(_mm_slli_epi32(a, N), _mm_srli_epi32(a, 32 - N));
+  }
+  static type unpacklo32(type a, type b) { return _mm_unpacklo_epi32(a, b); }
+  static type unpackhi32(type a, type b) { return _mm_unpackhi_epi32(a, b); }
+  static type unpacklo64(type a, type b) { return _mm_unpacklo_epi64(a, b); }
+  static type unpackhi64(type a, type b) { return _mm_unpackhi_epi64(a, b); }
+  static type aesenclast(type a) {
+    return _mm_aesenclast_si128(a, _mm_setzero_si128());
+  }
+};
+
+#if defined(__AVX2__)
+struct v256 {
+  using type = __m256i;
+  static constexpr size_t blocks = 8;
+
+  static type load(const uint8_t *p) {
+    return _mm256_loadu_si256((const __m256i *)p);
+  }
+  static void store(uint8_t *p, type v) {
+    _mm256_storeu_si256((__m256i *)p, v);
+  }
+  static type bcast(__m128i v) { return _mm256_broadcastsi128_si256(v); }
+  static type set1(uint32_t v) { return _mm256_set1_epi32((int)v); }
+  static type xor_(type a, type b) { return _mm256_xor_si256(a, b); }
+  static type and_(type a, type b) { return _mm256_and_si256(a, b); }
+  static type shuffle(type a, type idx) { return _mm256_shuffle_epi8(a, idx); }
+  static type srli16_4(type a) { return _mm256_srli_epi16(a, 4); }
+  template <int N> static type rotl(type a) {
+    return _mm256_xor_si256(_mm256_slli_epi32(a, N),
+                            _mm256_srli_epi32(a, 32 - N));
+  }
+  static type unpacklo32(type a, type b) {
+    return _mm256_unpacklo_epi32(a, b);
+  }
+  static type unpackhi32(type a, type b) {
+    return _mm256_unpackhi_epi32(a, b);
+  }
+  static type unpacklo64(type a, type b) {
+    return _mm256_unpacklo_epi64(a, b);
+  }
+  static type unpackhi64(type a, type b) {
+    return _mm256_unpackhi_epi64(a, b);
+  }
+  static type aesenclast(type a) {
+#if defined(__VAES__)
+    return _mm256_aesenclast_epi128(a, _mm256_setzero_si256());
+#else
+    __m128i z = _mm_setzero_si128();
+    return _mm256_set_m128i(
+        _mm_aesenclast_si128(_mm256_extracti128_si256(a, 1), z),
+        _mm_aesenclast_si128(_mm256_castsi256_si128(a), z));
+#endif
+  }
+};
+#endif
+
+// 4 位查表实现 GF(2) 上的 8x8 矩阵乘法（同 sm4_aesni.c 的 MulMatrix）
+template <class V>
+[[gnu::always_inline]] inline typename V::type
+mul_matrix(typename V::type x, __m128i hi, __m128i lo) {
+  typename V::type mask = V::set1(0x0f0f0f0f);
+  typename V::type l = V::shuffle(V::bcast(lo), V::and_(x, mask));
+  typename V::type h = V::shuffle(V::bcast(hi), V::and_(V::srli16_4(x), mask));
+  return V::xor_(l, h);
+}
+
+// SM4 S 盒经仿射变换映射到 AES S 盒：先抵消 aesenclast 的行移位，
+// 再做 TA 映射、AES 求逆，最后做 ATA 映射回来
+template <class V>
+[[gnu::always_inline]] inline typename V::type sbox(typename V::type x) {
+  const __m128i shift_rows =
+      _mm_set_epi8(0x03, 0x06, 0x09, 0x0c, 0x0f, 0x02, 0x05, 0x08, 0x0b, 0x0e,
+                   0x01, 0x04, 0x07, 0x0a, 0x0d, 0x00);
+  const __m128i ta_hi =
+      _mm_set_epi8(0x22, 0x58, 0x1a, 0x60, 0x02, 0x78, 0x3a, 0x40, 0x62, 0x18,
+                   0x5a, 0x20, 0x42, 0x38, 0x7a, 0x00);
+  const __m128i ta_lo =
+      _mm_set_epi8(0xe2, 0x28, 0x95, 0x5f, 0x69, 0xa3, 0x1e, 0xd4, 0x36, 0xfc,
+                   0x41, 0x8b, 0xbd, 0x77, 0xca, 0x00);
+  const __m128i ata_hi =
+      _mm_set_epi8(0x14, 0x07, 0xc6, 0xd5, 0x6c, 0x7f, 0xbe, 0xad, 0xb9, 0xaa,
+                   0x6b, 0x78, 0xc1, 0xd2, 0x13, 0x00);
+  const __m128i ata_lo =
+      _mm_set_epi8(0xd8, 0xb8, 0xfa, 0x9a, 0xc5, 0xa5, 0xe7, 0x87, 0x5f, 0x3f,
+                   0x7d, 0x1d, 0x42, 0x22, 0x60, 0x00);
+  x = V::shuffle(x, V::bcast(shift_rows));
+  x = V::xor_(mul_matrix<V>(x, ta_hi, ta_lo), V::set1(0x23232323));
+  x = V::aesenclast(x);
+  return V::xor_(mul_matrix<V>(x, ata_hi, ata_lo), V::set1(0x3b3b3b3b));
+}
+
+// 4 个寄存器在每个 128 位半区内做 4x4 的 32 位转置（自逆）
+template <class V>
+[[gnu::always_inline]] inline void transpose(typename V::type x[4]) {
+  typename V::type t0 = V::unpacklo32(x[0], x[1]);
+  typename V::type t1 = V::unpacklo32(x[2], x[3]);
+  typename V::type t2 = V::unpackhi32(x[0], x[1]);
+  typename V::type t3 = V::unpackhi32(x[2], x[3]);
+  x[0] = V::unpacklo64(t0, t1);
+  x[1] = V::unpackhi64(t0, t1);
+  x[2] = V::unpacklo64(t2, t3);
+  x[3] = V::unpackhi64(t2, t3);
+}
+
+// SIMD 后端的第 I 轮，G 组状态共用同一轮密钥
+template <class V, size_t I, size_t G>
+[[gnu::always_inline]] inline void simd_round(typename V::type (&x)[G][4],
+                                              const uint32_t *rk) {
+  using T = typename V::type;
+  T k = V::set1(rk[I]);
+  T s[G];
+  for (size_t g = 0; g < G; g++) {
+    s[g] = sbox<V>(V::xor_(V::xor_(x[g][(I + 1) % 4], x[g][(I + 2) % 4]),
+                           V::xor_(x[g][(I + 3) % 4], k)));
+  }
+  for (size_t g = 0; g < G; g++) {
+    T t = s[g];
+    T l = V::xor_(V::xor_(t, V::template rotl<2>(t)),
+                  V::xor_(V::template rotl<10>(t),
+                          V::xor_(V::template rotl<18>(t),
+                                  V::template rotl<24>(t))));
+    x[g][I % 4] = V::xor_(x[g][I % 4], l);
+  }
+}
+
+template <class V, size_t G, size_t... I>
+[[gnu::always_inline]] inline void simd_rounds(typename V::type (&x)[G][4],
+                                               const uint32_t *rk,
+                                               std::index_sequence<I...>) {
+  (simd_round<V, I>(x, rk), ...);
+}
+
+// G 组寄存器交错，共处理 G * V::blocks 个分组，32 轮完全展开
+template <class V, size_t G>
+[[gnu::always_inline]] inline void simd_kernel(const uint8_t *in,
+                                               uint8_t *out,
+                                               const uint32_t *rk) {
+  using T = typename V::type;
+  constexpr size_t W = sizeof(T);
+  const T bswap = V::bcast(
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  T x[G][4];
+  for (size_t g = 0; g < G; g++) {
+    for (size_t j = 0; j < 4; j++) {
+      x[g][j] = V::load(in + (4 * g + j) * W);
+    }
+    transpose<V>(x[g]);
+    for (size_t j = 0; j < 4; j++) {
+      x[g][j] = V::shuffle(x[g][j], bswap);
+    }
+  }
+  simd_rounds<V>(x, rk, std::make_index_sequence<32>{});
+  for (size_t g = 0; g < G; g++) {
+    T y[4] = {V::shuffle(x[g][3], bswap), V::shuffle(x[g][2], bswap),
+              V::shuffle(x[g][1], bswap), V::shuffle(x[g][0], bswap)};
+    transpose<V>(y);
+    for (size_t j = 0; j < 4; j++) {
+      V::store(out + (4 * g + j) * W, y[j]);
+    }
+  }
+}
+
+} // namespace detail
+
+// AES-NI 后端：4 块一组，8 块交错，剩余 1~3 块补齐后处理
+struct aesni {
+  static constexpr const char *name = "aesni";
+
+  static bool available() noexcept {
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3");
+  }
+
+  [[gnu::always_inline]] static void crypt(const uint8_t *in, uint8_t *out,
+                                           size_t nblocks,
+                                           const uint32_t *rk) noexcept {
+    for (; nblocks >= 8; nblocks -= 8, in += 128, out += 128) {
+      detail::simd_kernel<detail::v128, 2>(in, out, rk);
+    }
+    if (nblocks >= 4) {
+      detail::simd_kernel<detail::v128, 1>(in, out, rk);
+      nblocks -= 4, in += 64, out += 64;
+    }
+    if (nblocks > 0) {
+      uint8_t buf[64] = {0};
+      std::memcpy(buf, in, 16 * nblocks);
+      detail::simd_kernel<detail::v128, 1>(buf, buf, rk);
+      std::memcpy(out, buf, 16 * nblocks);
+    }
+  }
+};
+
+#if defined(__AVX2__)
+// AVX2 后端：8 块一组，16 块交错，不足 8 块的部分交给 AES-NI 后端
+struct avx2 {
+  static constexpr const char *name = "avx2";
+
+  static bool available() noexcept {
+#if defined(__VAES__)
+    if (!__builtin_cpu_supports("vaes")) {
+      return false;
+    }
+#endif
+    return aesni::available() && __builtin_cpu_supports("avx2");
+  }
+
+  [[gnu::always_inline]] static void crypt(const uint8_t *in, uint8_t *out,
+                                           size_t nblocks,
+                                           const uint32_t *rk) noexcept {
+    for (; nblocks >= 16; nblocks -= 16, in += 256, out += 256) {
+      detail::simd_kernel<detail::v256, 2>(in, out, rk);
+    }
+    if (nblocks >= 8) {
+      detail::simd_kernel<detail::v256, 1>(in, out, rk);
+      nblocks -= 8, in += 128, out += 128;
+    }
+    if (nblocks > 0) {
+      aesni::crypt(in, out, nblocks, rk);
+    }
+  }
+};
+#endif
+#endif
+
+// 分组密码：Backend 为上面的某个后端。in / out 的长度按分组计，
+// encrypt / decrypt 要求 in.size() 是 16 的倍数、out 不短于 in，可以原地
+template <class Backend> class cipher {
+public:
+  using backend = Backend;
+  static constexpr size_t block_size = 16;
+
+  constexpr explicit cipher(std::span<const uint8_t, 16> key) noexcept
+      : ks_(expand_key(key)) {}
+
+  void encrypt(std::span<const uint8_t> in,
+               std::span<uint8_t> out) const noexcept {
+    Backend::crypt(in.data(), out.data(), in.size() / 16, ks_.enc.data());
+  }
+
+  void decrypt(std::span<const uint8_t> in,
+               std::span<uint8_t> out) const noexcept {
+    Backend::crypt(in.data(), out.data(), in.size() / 16, ks_.dec.data());
+  }
+
+  void encrypt_block(std::span<const uint8_t, 16> in,
+                     std::span<uint8_t, 16> out) const noexcept {
+    Backend::crypt(in.data(), out.data(), 1, ks_.enc.data());
+  }
+
+  void decrypt_block(std::span<const uint8_t, 16> in,
+                     std::span<uint8_t, 16> out) const noexcept {
+    Backend::crypt(in.data(), out.data(), 1, ks_.dec.data());
+  }
+
+  // 计数器模式，只递增计数器的低 32 位（同 sm4_ctr32_blocks），长度任意，
+  // 最后不足一块的部分也消耗一个计数器值。返回时 counter 指向下一个未用的值
+  void ctr32(std::span<const uint8_t> in, std::span<uint8_t> out,
+             std::span<uint8_t, 16> counter) const noexcept {
+    constexpr size_t BATCH = 64;
+    alignas(64) uint8_t ks[16 * BATCH];
+    uint32_t c = detail::load_be32(counter.data() + 12);
+    const uint8_t *src = in.data();
+    uint8_t *dst = out.data();
+    size_t len = in.size();
+
+    while (len > 0) {
+      size_t n = (len + 15) / 16 < BATCH ? (len + 15) / 16 : BATCH;
+      for (size_t b = 0; b < n; b++) {
+        std::memcpy(ks + 16 * b, counter.data(), 12);
+        detail::store_be32(ks + 16 * b + 12, c++);
+      }
+      Backend::crypt(ks, ks, n, ks_.enc.data());
+      size_t bytes = 16 * n < len ? 16 * n : len;
+      for (size_t i = 0; i < bytes; i++) {
+        dst[i] = src[i] ^ ks[i];
+      }
+      src += bytes;
+      dst += bytes;
+      len -= bytes;
+    }
+    detail::store_be32(counter.data() + 12, c);
+  }
+
+  const key_schedule &schedule() const noexcept { return ks_; }
+
+private:
+  key_schedule ks_;
+};
+
+} // namespace sm4
+
+#endif
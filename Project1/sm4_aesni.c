@@ -1,16 +1,8 @@
 #include "sm4_aesni.h"
+#include "sm4_trace.h"
 
 #include <immintrin.h>
-
-void sm4_encrypt_aesni(const uint8_t *plaintext, const SM4_Key *sm4_key,
-                       uint8_t *ciphertext) {
-  SM4_AESNI_do(plaintext, ciphertext, sm4_key, 0);
-}
-
-void sm4_decrypt_aesni(const uint8_t *ciphertext, const SM4_Key *sm4_key,
-                       uint8_t *plaintext) {
-  SM4_AESNI_do(ciphertext, plaintext, sm4_key, 1);
-}
+#include <string.h>
 
 #define MM_PACK0_EPI32(a, b, c, d)                                             \
   _mm_unpacklo_epi64(_mm_unpacklo_epi32(a, b), _mm_unpacklo_epi32(c, d))
@@ -31,49 +23,256 @@ void sm4_decrypt_aesni(const uint8_t *ciphertext, const SM4_Key *sm4_key,
 
 static __m128i SM4_SBox(__m128i x);
 
-void SM4_AESNI_do(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
-                  int enc) {
-  __m128i X[4], Tmp[4];
+// 单轮：结果写回 X0，寄存器角色靠宏参数轮换
+#define AESNI_ROUND(X0, X1, X2, X3, k)                                         \
+  Tmp = SM4_SBox(MM_XOR4(X1, X2, X3, k));                                      \
+  X0 = MM_XOR6(X0, Tmp, MM_ROTL_EPI32(Tmp, 2), MM_ROTL_EPI32(Tmp, 10),         \
+               MM_ROTL_EPI32(Tmp, 18), MM_ROTL_EPI32(Tmp, 24))
+
+#define AESNI_ROUNDS4(rkv, i)                                                  \
+  AESNI_ROUND(X0, X1, X2, X3, _mm_load_si128((rkv) + (i) + 0));                \
+  AESNI_ROUND(X1, X2, X3, X0, _mm_load_si128((rkv) + (i) + 1));                \
+  AESNI_ROUND(X2, X3, X0, X1, _mm_load_si128((rkv) + (i) + 2));                \
+  AESNI_ROUND(X3, X0, X1, X2, _mm_load_si128((rkv) + (i) + 3))
+
+// 4 块内核，rkv 为预先广播好的轮密钥（SM4_Key.rk_x4），32 轮完全展开
+static inline void SM4_AESNI_kernel(const uint8_t *in, uint8_t *out,
+                                    const __m128i *rkv) {
+  __m128i X0, X1, X2, X3, Tmp, In[4];
   __m128i vindex;
   // load and pack
-  Tmp[0] = _mm_loadu_si128((const __m128i *)in + 0);
-  Tmp[1] = _mm_loadu_si128((const __m128i *)in + 1);
-  Tmp[2] = _mm_loadu_si128((const __m128i *)in + 2);
-  Tmp[3] = _mm_loadu_si128((const __m128i *)in + 3);
+  In[0] = _mm_loadu_si128((const __m128i *)in + 0);
+  In[1] = _mm_loadu_si128((const __m128i *)in + 1);
+  In[2] = _mm_loadu_si128((const __m128i *)in + 2);
+  In[3] = _mm_loadu_si128((const __m128i *)in + 3);
   vindex = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
-  X[0] = MM_PACK0_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
-  X[1] = MM_PACK1_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
-  X[2] = MM_PACK2_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
-  X[3] = MM_PACK3_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
-
-  X[0] = _mm_shuffle_epi8(X[0], vindex);
-  X[1] = _mm_shuffle_epi8(X[1], vindex);
-  X[2] = _mm_shuffle_epi8(X[2], vindex);
-  X[3] = _mm_shuffle_epi8(X[3], vindex);
-  for (int i = 0; i < 32; i++) {
-    __m128i k =
-        _mm_set1_epi32((enc == 0) ? sm4_key->rk[i] : sm4_key->rk[31 - i]);
-    Tmp[0] = MM_XOR4(X[1], X[2], X[3], k);
-    // S盒
-    Tmp[0] = SM4_SBox(Tmp[0]);
-    // L函数
-    Tmp[0] = MM_XOR6(X[0], Tmp[0], MM_ROTL_EPI32(Tmp[0], 2),
-                     MM_ROTL_EPI32(Tmp[0], 10), MM_ROTL_EPI32(Tmp[0], 18),
-                     MM_ROTL_EPI32(Tmp[0], 24));
-    X[0] = X[1];
-    X[1] = X[2];
-    X[2] = X[3];
-    X[3] = Tmp[0];
-  }
-  X[0] = _mm_shuffle_epi8(X[0], vindex);
-  X[1] = _mm_shuffle_epi8(X[1], vindex);
-  X[2] = _mm_shuffle_epi8(X[2], vindex);
-  X[3] = _mm_shuffle_epi8(X[3], vindex);
+  X0 = MM_PACK0_EPI32(In[0], In[1], In[2], In[3]);
+  X1 = MM_PACK1_EPI32(In[0], In[1], In[2], In[3]);
+  X2 = MM_PACK2_EPI32(In[0], In[1], In[2], In[3]);
+  X3 = MM_PACK3_EPI32(In[0], In[1], In[2], In[3]);
+
+  X0 = _mm_shuffle_epi8(X0, vindex);
+  X1 = _mm_shuffle_epi8(X1, vindex);
+  X2 = _mm_shuffle_epi8(X2, vindex);
+  X3 = _mm_shuffle_epi8(X3, vindex);
+
+  AESNI_ROUNDS4(rkv, 0);
+  AESNI_ROUNDS4(rkv, 4);
+  AESNI_ROUNDS4(rkv, 8);
+  AESNI_ROUNDS4(rkv, 12);
+  AESNI_ROUNDS4(rkv, 16);
+  AESNI_ROUNDS4(rkv, 20);
+  AESNI_ROUNDS4(rkv, 24);
+  AESNI_ROUNDS4(rkv, 28);
+
+  X0 = _mm_shuffle_epi8(X0, vindex);
+  X1 = _mm_shuffle_epi8(X1, vindex);
+  X2 = _mm_shuffle_epi8(X2, vindex);
+  X3 = _mm_shuffle_epi8(X3, vindex);
   // pack and store
-  _mm_storeu_si128((__m128i *)out + 0, MM_PACK0_EPI32(X[3], X[2], X[1], X[0]));
-  _mm_storeu_si128((__m128i *)out + 1, MM_PACK1_EPI32(X[3], X[2], X[1], X[0]));
-  _mm_storeu_si128((__m128i *)out + 2, MM_PACK2_EPI32(X[3], X[2], X[1], X[0]));
-  _mm_storeu_si128((__m128i *)out + 3, MM_PACK3_EPI32(X[3], X[2], X[1], X[0]));
+  _mm_storeu_si128((__m128i *)out + 0, MM_PACK0_EPI32(X3, X2, X1, X0));
+  _mm_storeu_si128((__m128i *)out + 1, MM_PACK1_EPI32(X3, X2, X1, X0));
+  _mm_storeu_si128((__m128i *)out + 2, MM_PACK2_EPI32(X3, X2, X1, X0));
+  _mm_storeu_si128((__m128i *)out + 3, MM_PACK3_EPI32(X3, X2, X1, X0));
+}
+
+// 处理 4 块一组之后剩余的 1~3 块：拷贝到 64 字节缓冲区，避免越界读写
+static void SM4_AESNI_tail(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const __m128i *rkv) {
+  uint8_t buf[64] = {0};
+  memcpy(buf, in, 16 * nblocks);
+  SM4_AESNI_kernel(buf, buf, rkv);
+  memcpy(out, buf, 16 * nblocks);
+}
+
+static void SM4_AESNI_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const __m128i *rkv) {
+  while (nblocks >= 4) {
+    SM4_AESNI_kernel(in, out, rkv);
+    in += 64;
+    out += 64;
+    nblocks -= 4;
+  }
+  if (nblocks > 0) {
+    SM4_AESNI_tail(in, out, nblocks, rkv);
+  }
+}
+
+#define RKV_ENC(key) ((const __m128i *)(key)->rk_x4[0])
+#define RKV_DEC(key) ((const __m128i *)(key)->rk_x4[1])
+
+void sm4_encrypt_aesni(const uint8_t *plaintext, const SM4_Key *sm4_key,
+                       uint8_t *ciphertext) {
+  SM4_AESNI_tail(plaintext, ciphertext, 1, RKV_ENC(sm4_key));
+}
+
+void sm4_decrypt_aesni(const uint8_t *ciphertext, const SM4_Key *sm4_key,
+                       uint8_t *plaintext) {
+  SM4_AESNI_tail(ciphertext, plaintext, 1, RKV_DEC(sm4_key));
+}
+
+void sm4_aesni_blocks_impl(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *sm4_key, int dec) {
+  SM4_AESNI_blocks(in, out, nblocks,
+                   dec ? RKV_DEC(sm4_key) : RKV_ENC(sm4_key));
+}
+
+void sm4_encrypt_blocks_aesni(const uint8_t *in, uint8_t *out, size_t nblocks,
+                              const SM4_Key *sm4_key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AESNI, 16 * nblocks, nblocks);
+  sm4_aesni_blocks_impl(in, out, nblocks, sm4_key, 0);
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_blocks_aesni(const uint8_t *in, uint8_t *out, size_t nblocks,
+                              const SM4_Key *sm4_key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AESNI, 16 * nblocks, nblocks);
+  sm4_aesni_blocks_impl(in, out, nblocks, sm4_key, 1);
+  SM4_TRACE_END();
+}
+
+// 多密钥：把 4 个密钥的轮密钥转置成逐轮向量，rkv[i] 的第 j 个通道为
+// keys[j] 的第 i 个轮密钥，之后与单密钥共用同一个内核
+static void SM4_AESNI_lane_keys(const SM4_Key *const keys[4], int dec,
+                                __m128i rkv[32]) {
+  for (int i = 0; i < 32; i += 4) {
+    __m128i K[4];
+    for (int j = 0; j < 4; j++) {
+      const uint32_t *rk = dec ? keys[j]->rk_dec : keys[j]->rk;
+      K[j] = _mm_loadu_si128((const __m128i *)(rk + i));
+    }
+    rkv[i + 0] = MM_PACK0_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 1] = MM_PACK1_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 2] = MM_PACK2_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 3] = MM_PACK3_EPI32(K[0], K[1], K[2], K[3]);
+  }
+}
+
+void sm4_aesni_multikey_impl(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *const *keys, int dec) {
+  __m128i rkv[32];
+  while (nblocks >= 4) {
+    SM4_AESNI_lane_keys(keys, dec, rkv);
+    SM4_AESNI_kernel(in, out, rkv);
+    in += 64;
+    out += 64;
+    keys += 4;
+    nblocks -= 4;
+  }
+  // 尾部不足 4 个通道时，空闲通道借用第一个密钥
+  if (nblocks > 0) {
+    const SM4_Key *lane[4] = {keys[0], keys[0], keys[0], keys[0]};
+    for (size_t j = 0; j < nblocks; j++) {
+      lane[j] = keys[j];
+    }
+    SM4_AESNI_lane_keys(lane, dec, rkv);
+    SM4_AESNI_tail(in, out, nblocks, rkv);
+  }
+}
+
+void sm4_encrypt_multikey_aesni(const uint8_t *in, uint8_t *out,
+                                size_t nblocks, const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AESNI, 16 * nblocks, nblocks);
+  sm4_aesni_multikey_impl(in, out, nblocks, keys, 0);
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_multikey_aesni(const uint8_t *in, uint8_t *out,
+                                size_t nblocks, const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AESNI, 16 * nblocks, nblocks);
+  sm4_aesni_multikey_impl(in, out, nblocks, keys, 1);
+  SM4_TRACE_END();
+}
+
+// 批量密钥扩展：通道 j 为 keys[j] 的密钥状态，轮函数与加密相同，只是线性变换
+// 换成 L'(B) = B ^ (B <<< 13) ^ (B <<< 23)
+#define AESNI_KEY_ROUND(K0, K1, K2, K3)                                        \
+  Tmp = SM4_SBox(MM_XOR4(K1, K2, K3, ck));                                     \
+  K0 = MM_XOR4(K0, Tmp, MM_ROTL_EPI32(Tmp, 13), MM_ROTL_EPI32(Tmp, 23));       \
+  ck = _mm_add_epi8(ck, ck_step)
+
+// 第 i 轮起连续 4 个轮密钥 t 写入 rk_x4 的广播形式（加密序与解密序）
+static inline void SM4_AESNI_bcast_rk(SM4_Key *key, int i, __m128i t) {
+  __m128i v[4] = {_mm_shuffle_epi32(t, 0x00), _mm_shuffle_epi32(t, 0x55),
+                  _mm_shuffle_epi32(t, 0xAA), _mm_shuffle_epi32(t, 0xFF)};
+  for (int r = 0; r < 4; r++) {
+    _mm_store_si128((__m128i *)key->rk_x4[0][i + r], v[r]);
+    _mm_store_si128((__m128i *)key->rk_x4[1][31 - i - r], v[r]);
+  }
+}
+
+// K[r] 为第 i + r 轮的轮密钥（通道 j 属于 out[j]），转置后写出 SM4_Key 的
+// 全部三种形式
+static inline void SM4_AESNI_store_rk(SM4_Key *const out[4],
+                                      const __m128i K[4], int i) {
+  __m128i T[4];
+  T[0] = MM_PACK0_EPI32(K[0], K[1], K[2], K[3]);
+  T[1] = MM_PACK1_EPI32(K[0], K[1], K[2], K[3]);
+  T[2] = MM_PACK2_EPI32(K[0], K[1], K[2], K[3]);
+  T[3] = MM_PACK3_EPI32(K[0], K[1], K[2], K[3]);
+  for (int j = 0; j < 4; j++) {
+    _mm_storeu_si128((__m128i *)(out[j]->rk + i), T[j]);
+    _mm_storeu_si128((__m128i *)(out[j]->rk_dec + 28 - i),
+                     _mm_shuffle_epi32(T[j], 0x1B));
+    SM4_AESNI_bcast_rk(out[j], i, T[j]);
+  }
+}
+
+static void SM4_AESNI_keys4(const uint8_t *const keys[4],
+                            SM4_Key *const out[4]) {
+  __m128i vindex =
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  __m128i In[4], K[4], Tmp;
+  for (int j = 0; j < 4; j++) {
+    In[j] = _mm_loadu_si128((const __m128i *)keys[j]);
+  }
+  K[0] = _mm_shuffle_epi8(MM_PACK0_EPI32(In[0], In[1], In[2], In[3]), vindex);
+  K[1] = _mm_shuffle_epi8(MM_PACK1_EPI32(In[0], In[1], In[2], In[3]), vindex);
+  K[2] = _mm_shuffle_epi8(MM_PACK2_EPI32(In[0], In[1], In[2], In[3]), vindex);
+  K[3] = _mm_shuffle_epi8(MM_PACK3_EPI32(In[0], In[1], In[2], In[3]), vindex);
+  K[0] = MM_XOR2(K[0], _mm_set1_epi32(0xa3b1bac6));
+  K[1] = MM_XOR2(K[1], _mm_set1_epi32(0x56aa3350));
+  K[2] = MM_XOR2(K[2], _mm_set1_epi32(0x677d9197));
+  K[3] = MM_XOR2(K[3], _mm_set1_epi32(0xb27022dc));
+
+  // CK 第 i 个字的第 b 个字节（大端）为 (4i + b) * 7 mod 256，按字节加 28 递推
+  __m128i ck = _mm_setr_epi8(21, 14, 7, 0, 21, 14, 7, 0, 21, 14, 7, 0, 21, 14,
+                             7, 0);
+  __m128i ck_step = _mm_set1_epi8(28);
+  for (int i = 0; i < 32; i += 4) {
+    AESNI_KEY_ROUND(K[0], K[1], K[2], K[3]);
+    AESNI_KEY_ROUND(K[1], K[2], K[3], K[0]);
+    AESNI_KEY_ROUND(K[2], K[3], K[0], K[1]);
+    AESNI_KEY_ROUND(K[3], K[0], K[1], K[2]);
+    SM4_AESNI_store_rk(out, K, i);
+  }
+}
+
+void sm4_keyInit_batch_aesni(const uint8_t *const *keys, size_t n,
+                             SM4_Key *out) {
+  while (n >= 4) {
+    SM4_Key *const lane[4] = {out, out + 1, out + 2, out + 3};
+    SM4_AESNI_keys4(keys, lane);
+    keys += 4;
+    out += 4;
+    n -= 4;
+  }
+  // 尾部不足 4 个时空闲通道重复第一个密钥，结果写到临时变量后丢弃
+  if (n > 0) {
+    SM4_Key spare;
+    const uint8_t *in[4] = {keys[0], keys[0], keys[0], keys[0]};
+    SM4_Key *lane[4] = {&spare, &spare, &spare, &spare};
+    for (size_t j = 0; j < n; j++) {
+      in[j] = keys[j];
+      lane[j] = out + j;
+    }
+    SM4_AESNI_keys4(in, lane);
+  }
+}
+
+void SM4_AESNI_do(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                  int enc) {
+  SM4_AESNI_kernel(in, out, (enc == 0) ? RKV_ENC(sm4_key) : RKV_DEC(sm4_key));
 }
 
 static __m128i MulMatrix(__m128i x, __m128i higherMask, __m128i lowerMask) {
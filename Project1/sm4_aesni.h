@@ -9,6 +9,32 @@ void sm4_encrypt_aesni(const uint8_t *plaintext, const SM4_Key *sm4_key,
 void sm4_decrypt_aesni(const uint8_t *ciphertext, const SM4_Key *sm4_key,
                        uint8_t *plaintext);
 
+// 多块接口：4 块一组走 SIMD，剩余 1~3 块补齐后处理
+void sm4_encrypt_blocks_aesni(const uint8_t *in, uint8_t *out, size_t nblocks,
+                              const SM4_Key *sm4_key);
+
+void sm4_decrypt_blocks_aesni(const uint8_t *in, uint8_t *out, size_t nblocks,
+                              const SM4_Key *sm4_key);
+
+// 多密钥接口：第 i 个分组使用 keys[i]，4 个分组一组、每个通道独立轮密钥
+void sm4_encrypt_multikey_aesni(const uint8_t *in, uint8_t *out,
+                                size_t nblocks, const SM4_Key *const *keys);
+
+void sm4_decrypt_multikey_aesni(const uint8_t *in, uint8_t *out,
+                                size_t nblocks, const SM4_Key *const *keys);
+
+// 同上两组接口的实现（dec 为 1 时解密），不计入插桩，供以本后端处理尾部
+// 的其他后端调用，使插桩只记在实际被分派到的后端上
+void sm4_aesni_blocks_impl(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *sm4_key, int dec);
+void sm4_aesni_multikey_impl(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *const *keys, int dec);
+// 批量密钥扩展：结果与逐个调用 sm4_keyInit 相同，4 个密钥一组在向量通道上
+// 并行迭代，S 盒与加密共用 AES-NI 实现
+void sm4_keyInit_batch_aesni(const uint8_t *const *keys, size_t n,
+                             SM4_Key *out);
+
+// 一次处理 4 个分组（读写 64 字节）
 void SM4_AESNI_do(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
                   int enc);
 
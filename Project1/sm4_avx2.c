@@ -0,0 +1,498 @@
+#include "sm4_avx2.h"
+#include "sm4_aesni.h"
+#include "sm4_engine.h"
+#include "sm4_trace.h"
+
+#include <immintrin.h>
+
+#define MM256_PACK0_EPI32(a, b, c, d)                                          \
+  _mm256_unpacklo_epi64(_mm256_unpacklo_epi32(a, b),                           \
+                        _mm256_unpacklo_epi32(c, d))
+#define MM256_PACK1_EPI32(a, b, c, d)                                          \
+  _mm256_unpackhi_epi64(_mm256_unpacklo_epi32(a, b),                           \
+                        _mm256_unpacklo_epi32(c, d))
+#define MM256_PACK2_EPI32(a, b, c, d)                                          \
+  _mm256_unpacklo_epi64(_mm256_unpackhi_epi32(a, b),                           \
+                        _mm256_unpackhi_epi32(c, d))
+#define MM256_PACK3_EPI32(a, b, c, d)                                          \
+  _mm256_unpackhi_epi64(_mm256_unpackhi_epi32(a, b),                           \
+                        _mm256_unpackhi_epi32(c, d))
+
+#define MM256_XOR2(a, b) _mm256_xor_si256(a, b)
+#define MM256_XOR3(a, b, c) MM256_XOR2(a, MM256_XOR2(b, c))
+#define MM256_XOR4(a, b, c, d) MM256_XOR2(a, MM256_XOR3(b, c, d))
+#define MM256_XOR5(a, b, c, d, e) MM256_XOR2(a, MM256_XOR4(b, c, d, e))
+#define MM256_XOR6(a, b, c, d, e, f) MM256_XOR2(a, MM256_XOR5(b, c, d, e, f))
+#define MM256_ROTL_EPI32(a, n)                                                 \
+  MM256_XOR2(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n))
+
+// 128 位常量复制到两个半区（vpshufb 只在半区内查表）
+#define MM256_DUP(x) _mm256_broadcastsi128_si256(x)
+
+static inline __m256i MulMatrix(__m256i x, __m256i higherMask,
+                                __m256i lowerMask) {
+  __m256i tmp1, tmp2;
+  __m256i andMask = _mm256_set1_epi32(0x0f0f0f0f);
+  tmp2 = _mm256_srli_epi16(x, 4);
+  tmp1 = _mm256_and_si256(x, andMask);
+  tmp2 = _mm256_and_si256(tmp2, andMask);
+  tmp1 = _mm256_shuffle_epi8(lowerMask, tmp1);
+  tmp2 = _mm256_shuffle_epi8(higherMask, tmp2);
+  tmp1 = _mm256_xor_si256(tmp1, tmp2);
+  return tmp1;
+}
+
+static inline __m256i MulMatrixATA(__m256i x) {
+  __m256i higherMask = MM256_DUP(
+      _mm_set_epi8(0x14, 0x07, 0xc6, 0xd5, 0x6c, 0x7f, 0xbe, 0xad, 0xb9, 0xaa,
+                   0x6b, 0x78, 0xc1, 0xd2, 0x13, 0x00));
+  __m256i lowerMask = MM256_DUP(
+      _mm_set_epi8(0xd8, 0xb8, 0xfa, 0x9a, 0xc5, 0xa5, 0xe7, 0x87, 0x5f, 0x3f,
+                   0x7d, 0x1d, 0x42, 0x22, 0x60, 0x00));
+  return MulMatrix(x, higherMask, lowerMask);
+}
+
+static inline __m256i MulMatrixTA(__m256i x) {
+  __m256i higherMask = MM256_DUP(
+      _mm_set_epi8(0x22, 0x58, 0x1a, 0x60, 0x02, 0x78, 0x3a, 0x40, 0x62, 0x18,
+                   0x5a, 0x20, 0x42, 0x38, 0x7a, 0x00));
+  __m256i lowerMask = MM256_DUP(
+      _mm_set_epi8(0xe2, 0x28, 0x95, 0x5f, 0x69, 0xa3, 0x1e, 0xd4, 0x36, 0xfc,
+                   0x41, 0x8b, 0xbd, 0x77, 0xca, 0x00));
+  return MulMatrix(x, higherMask, lowerMask);
+}
+
+static inline __m256i AddTC(__m256i x) {
+  __m256i TC = _mm256_set1_epi8(0b00100011);
+  return _mm256_xor_si256(x, TC);
+}
+
+static inline __m256i AddATAC(__m256i x) {
+  __m256i ATAC = _mm256_set1_epi8(0b00111011);
+  return _mm256_xor_si256(x, ATAC);
+}
+
+// vaes 为编译期常量：1 时使用 256 位 vaesenclast，0 时拆成两个 128 位半区
+static inline __attribute__((always_inline)) __m256i SM4_SBox(__m256i x,
+                                                              int vaes) {
+  __m256i MASK = MM256_DUP(
+      _mm_set_epi8(0x03, 0x06, 0x09, 0x0c, 0x0f, 0x02, 0x05, 0x08, 0x0b, 0x0e,
+                   0x01, 0x04, 0x07, 0x0a, 0x0d, 0x00));
+  x = _mm256_shuffle_epi8(x, MASK);
+  x = AddTC(MulMatrixTA(x));
+  if (vaes) {
+    x = _mm256_aesenclast_epi128(x, _mm256_setzero_si256());
+  } else {
+    __m128i lo = _mm256_castsi256_si128(x);
+    __m128i hi = _mm256_extracti128_si256(x, 1);
+    lo = _mm_aesenclast_si128(lo, _mm_setzero_si128());
+    hi = _mm_aesenclast_si128(hi, _mm_setzero_si128());
+    x = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+  }
+  return AddATAC(MulMatrixATA(x));
+}
+
+// L 函数并与 X0 异或
+static inline __m256i SM4_L(__m256i x0, __m256i t) {
+  return MM256_XOR6(x0, t, MM256_ROTL_EPI32(t, 2), MM256_ROTL_EPI32(t, 10),
+                    MM256_ROTL_EPI32(t, 18), MM256_ROTL_EPI32(t, 24));
+}
+
+// 装载 8 个分组：低半区为分组 0~3，高半区为分组 4~7
+static inline void SM4_load8(const uint8_t *in, __m256i X[4]) {
+  __m256i Tmp[4];
+  __m256i vindex = MM256_DUP(
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  for (int j = 0; j < 4; j++) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)in + j);
+    __m128i hi = _mm_loadu_si128((const __m128i *)in + j + 4);
+    Tmp[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+  }
+  X[0] = MM256_PACK0_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  X[1] = MM256_PACK1_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  X[2] = MM256_PACK2_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  X[3] = MM256_PACK3_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  for (int j = 0; j < 4; j++) {
+    X[j] = _mm256_shuffle_epi8(X[j], vindex);
+  }
+}
+
+// 反序输出 (X3, X2, X1, X0) 并写回 8 个分组
+static inline void SM4_store8(uint8_t *out, __m256i X[4]) {
+  __m256i Tmp[4];
+  __m256i vindex = MM256_DUP(
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  for (int j = 0; j < 4; j++) {
+    X[j] = _mm256_shuffle_epi8(X[j], vindex);
+  }
+  Tmp[0] = MM256_PACK0_EPI32(X[3], X[2], X[1], X[0]);
+  Tmp[1] = MM256_PACK1_EPI32(X[3], X[2], X[1], X[0]);
+  Tmp[2] = MM256_PACK2_EPI32(X[3], X[2], X[1], X[0]);
+  Tmp[3] = MM256_PACK3_EPI32(X[3], X[2], X[1], X[0]);
+  for (int j = 0; j < 4; j++) {
+    _mm_storeu_si128((__m128i *)out + j, _mm256_castsi256_si128(Tmp[j]));
+    _mm_storeu_si128((__m128i *)out + j + 4,
+                     _mm256_extracti128_si256(Tmp[j], 1));
+  }
+}
+
+// 轮密钥。perlane 为编译期常量：0 时 rkv 为 rk_x4（__m128i），广播值再复制到
+// 两个半区；1 时 rkv 为每通道独立的 __m256i 轮密钥（多密钥）
+#define AVX2_RK(rkv, i)                                                        \
+  (perlane ? _mm256_load_si256((const __m256i *)(rkv) + (i))                   \
+           : MM256_DUP(_mm_load_si128((const __m128i *)(rkv) + (i))))
+
+// 单轮：结果写回 X0，寄存器角色靠宏参数轮换
+#define AVX2_ROUND(X0, X1, X2, X3, k)                                          \
+  X0 = SM4_L(X0, SM4_SBox(MM256_XOR4(X1, X2, X3, k), vaes))
+
+#define AVX2_ROUNDS4(rkv, i)                                                   \
+  AVX2_ROUND(X[0], X[1], X[2], X[3], AVX2_RK(rkv, (i) + 0));                   \
+  AVX2_ROUND(X[1], X[2], X[3], X[0], AVX2_RK(rkv, (i) + 1));                   \
+  AVX2_ROUND(X[2], X[3], X[0], X[1], AVX2_RK(rkv, (i) + 2));                   \
+  AVX2_ROUND(X[3], X[0], X[1], X[2], AVX2_RK(rkv, (i) + 3))
+
+// 两组状态共用同一轮密钥，同一轮内交错推进
+#define AVX2_ROUND2(X0, X1, X2, X3, Y0, Y1, Y2, Y3, k)                         \
+  do {                                                                         \
+    __m256i k_ = (k);                                                          \
+    __m256i TmpX = SM4_SBox(MM256_XOR4(X1, X2, X3, k_), vaes);                 \
+    __m256i TmpY = SM4_SBox(MM256_XOR4(Y1, Y2, Y3, k_), vaes);                 \
+    X0 = SM4_L(X0, TmpX);                                                      \
+    Y0 = SM4_L(Y0, TmpY);                                                      \
+  } while (0)
+
+#define AVX2_ROUNDS4_2(rkv, i)                                                 \
+  AVX2_ROUND2(X[0], X[1], X[2], X[3], Y[0], Y[1], Y[2], Y[3],                  \
+              AVX2_RK(rkv, (i) + 0));                                          \
+  AVX2_ROUND2(X[1], X[2], X[3], X[0], Y[1], Y[2], Y[3], Y[0],                  \
+              AVX2_RK(rkv, (i) + 1));                                          \
+  AVX2_ROUND2(X[2], X[3], X[0], X[1], Y[2], Y[3], Y[0], Y[1],                  \
+              AVX2_RK(rkv, (i) + 2));                                          \
+  AVX2_ROUND2(X[3], X[0], X[1], X[2], Y[3], Y[0], Y[1], Y[2],                  \
+              AVX2_RK(rkv, (i) + 3))
+
+// rkv 为轮密钥（见 AVX2_RK），32 轮完全展开
+static inline __attribute__((always_inline)) void
+SM4_do8(const uint8_t *in, uint8_t *out, const void *rkv, int vaes,
+        int perlane) {
+  __m256i X[4];
+  SM4_load8(in, X);
+  AVX2_ROUNDS4(rkv, 0);
+  AVX2_ROUNDS4(rkv, 4);
+  AVX2_ROUNDS4(rkv, 8);
+  AVX2_ROUNDS4(rkv, 12);
+  AVX2_ROUNDS4(rkv, 16);
+  AVX2_ROUNDS4(rkv, 20);
+  AVX2_ROUNDS4(rkv, 24);
+  AVX2_ROUNDS4(rkv, 28);
+  SM4_store8(out, X);
+}
+
+// 两组独立状态逐轮交错，两条 S 盒依赖链可以同时占用 AES 单元
+static inline __attribute__((always_inline)) void
+SM4_do16(const uint8_t *in, uint8_t *out, const __m128i *rkv, int vaes) {
+  const int perlane = 0; // 两组状态共用广播轮密钥
+  __m256i X[4], Y[4];
+  SM4_load8(in, X);
+  SM4_load8(in + 128, Y);
+  AVX2_ROUNDS4_2(rkv, 0);
+  AVX2_ROUNDS4_2(rkv, 4);
+  AVX2_ROUNDS4_2(rkv, 8);
+  AVX2_ROUNDS4_2(rkv, 12);
+  AVX2_ROUNDS4_2(rkv, 16);
+  AVX2_ROUNDS4_2(rkv, 20);
+  AVX2_ROUNDS4_2(rkv, 24);
+  AVX2_ROUNDS4_2(rkv, 28);
+  SM4_store8(out, X);
+  SM4_store8(out + 128, Y);
+}
+
+static void SM4_do8_vaes(const uint8_t *in, uint8_t *out, const __m128i *rkv) {
+  SM4_do8(in, out, rkv, 1, 0);
+}
+
+static void SM4_do8_aesni(const uint8_t *in, uint8_t *out,
+                          const __m128i *rkv) {
+  SM4_do8(in, out, rkv, 0, 0);
+}
+
+static void SM4_do16_vaes(const uint8_t *in, uint8_t *out,
+                          const __m128i *rkv) {
+  SM4_do16(in, out, rkv, 1);
+}
+
+static void SM4_do16_aesni(const uint8_t *in, uint8_t *out,
+                           const __m128i *rkv) {
+  SM4_do16(in, out, rkv, 0);
+}
+
+static void SM4_do8_mk_vaes(const uint8_t *in, uint8_t *out,
+                            const __m256i *rkv) {
+  SM4_do8(in, out, rkv, 1, 1);
+}
+
+static void SM4_do8_mk_aesni(const uint8_t *in, uint8_t *out,
+                             const __m256i *rkv) {
+  SM4_do8(in, out, rkv, 0, 1);
+}
+
+#define RKV(key, enc) ((const __m128i *)(key)->rk_x4[(enc) != 0])
+
+int sm4_avx2_has_vaes(void) {
+  return (sm4_cpu_features() & SM4_CPU_VAES) != 0;
+}
+
+void SM4_AVX2_do8(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                  int enc) {
+  if (sm4_avx2_has_vaes()) {
+    SM4_do8_vaes(in, out, RKV(sm4_key, enc));
+  } else {
+    SM4_do8_aesni(in, out, RKV(sm4_key, enc));
+  }
+}
+
+void SM4_AVX2_do16(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                   int enc) {
+  if (sm4_avx2_has_vaes()) {
+    SM4_do16_vaes(in, out, RKV(sm4_key, enc));
+  } else {
+    SM4_do16_aesni(in, out, RKV(sm4_key, enc));
+  }
+}
+
+static void SM4_AVX2_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                            const SM4_Key *sm4_key, int enc) {
+  void (*do16)(const uint8_t *, uint8_t *, const __m128i *) =
+      sm4_avx2_has_vaes() ? SM4_do16_vaes : SM4_do16_aesni;
+  void (*do8)(const uint8_t *, uint8_t *, const __m128i *) =
+      sm4_avx2_has_vaes() ? SM4_do8_vaes : SM4_do8_aesni;
+  const __m128i *rkv = RKV(sm4_key, enc);
+
+  while (nblocks >= 16) {
+    do16(in, out, rkv);
+    in += 256;
+    out += 256;
+    nblocks -= 16;
+  }
+  if (nblocks >= 8) {
+    do8(in, out, rkv);
+    in += 128;
+    out += 128;
+    nblocks -= 8;
+  }
+  // 剩余 0~7 块：4 块一组及 1~3 块尾部由 AES-NI 实现处理
+  if (nblocks > 0) {
+    sm4_aesni_blocks_impl(in, out, nblocks, sm4_key, enc);
+  }
+}
+
+void sm4_encrypt_blocks_avx2(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *sm4_key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AVX2, 16 * nblocks, nblocks);
+  SM4_AVX2_blocks(in, out, nblocks, sm4_key, 0);
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_blocks_avx2(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *sm4_key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AVX2, 16 * nblocks, nblocks);
+  SM4_AVX2_blocks(in, out, nblocks, sm4_key, 1);
+  SM4_TRACE_END();
+}
+
+// 8 个密钥的轮密钥转置成逐轮向量：低半区通道 j 为 keys[j]，高半区通道 j 为
+// keys[4 + j]，与 SM4_load8 的分组布局一致
+static void SM4_AVX2_lane_keys(const SM4_Key *const keys[8], int dec,
+                               __m256i rkv[32]) {
+  for (int i = 0; i < 32; i += 4) {
+    __m256i K[4];
+    for (int j = 0; j < 4; j++) {
+      const uint32_t *lo = dec ? keys[j]->rk_dec : keys[j]->rk;
+      const uint32_t *hi = dec ? keys[j + 4]->rk_dec : keys[j + 4]->rk;
+      K[j] = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(lo + i))),
+          _mm_loadu_si128((const __m128i *)(hi + i)), 1);
+    }
+    rkv[i + 0] = MM256_PACK0_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 1] = MM256_PACK1_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 2] = MM256_PACK2_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 3] = MM256_PACK3_EPI32(K[0], K[1], K[2], K[3]);
+  }
+}
+
+static void SM4_AVX2_multikey(const uint8_t *in, uint8_t *out, size_t nblocks,
+                              const SM4_Key *const *keys, int dec) {
+  void (*do8)(const uint8_t *, uint8_t *, const __m256i *) =
+      sm4_avx2_has_vaes() ? SM4_do8_mk_vaes : SM4_do8_mk_aesni;
+  __m256i rkv[32];
+
+  while (nblocks >= 8) {
+    SM4_AVX2_lane_keys(keys, dec, rkv);
+    do8(in, out, rkv);
+    in += 128;
+    out += 128;
+    keys += 8;
+    nblocks -= 8;
+  }
+  // 剩余 0~7 块交给 AES-NI 多密钥实现
+  if (nblocks > 0) {
+    sm4_aesni_multikey_impl(in, out, nblocks, keys, dec);
+  }
+}
+
+void sm4_encrypt_multikey_avx2(const uint8_t *in, uint8_t *out,
+                               size_t nblocks, const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AVX2, 16 * nblocks, nblocks);
+  SM4_AVX2_multikey(in, out, nblocks, keys, 0);
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_multikey_avx2(const uint8_t *in, uint8_t *out,
+                               size_t nblocks, const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_AVX2, 16 * nblocks, nblocks);
+  SM4_AVX2_multikey(in, out, nblocks, keys, 1);
+  SM4_TRACE_END();
+}
+
+// 批量密钥扩展：8 个密钥一组，通道布局同 SM4_load8（低半区 keys[0~3]，
+// 高半区 keys[4~7]）。轮函数与加密相同，线性变换换成 L'
+#define AVX2_KEY_ROUND(K0, K1, K2, K3)                                         \
+  do {                                                                         \
+    __m256i t_ = SM4_SBox(MM256_XOR4(K1, K2, K3, ck), vaes);                   \
+    K0 = MM256_XOR4(K0, t_, MM256_ROTL_EPI32(t_, 13),                          \
+                    MM256_ROTL_EPI32(t_, 23));                                 \
+  } while (0)
+
+static inline void SM4_AVX2_load_keys(const uint8_t *const keys[8],
+                                      __m256i K[4]) {
+  __m256i In[4];
+  __m256i vindex = MM256_DUP(
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  for (int j = 0; j < 4; j++) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)keys[j]);
+    __m128i hi = _mm_loadu_si128((const __m128i *)keys[j + 4]);
+    In[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+  }
+  K[0] = MM256_PACK0_EPI32(In[0], In[1], In[2], In[3]);
+  K[1] = MM256_PACK1_EPI32(In[0], In[1], In[2], In[3]);
+  K[2] = MM256_PACK2_EPI32(In[0], In[1], In[2], In[3]);
+  K[3] = MM256_PACK3_EPI32(In[0], In[1], In[2], In[3]);
+  K[0] = MM256_XOR2(_mm256_shuffle_epi8(K[0], vindex),
+                    _mm256_set1_epi32(0xa3b1bac6));
+  K[1] = MM256_XOR2(_mm256_shuffle_epi8(K[1], vindex),
+                    _mm256_set1_epi32(0x56aa3350));
+  K[2] = MM256_XOR2(_mm256_shuffle_epi8(K[2], vindex),
+                    _mm256_set1_epi32(0x677d9197));
+  K[3] = MM256_XOR2(_mm256_shuffle_epi8(K[3], vindex),
+                    _mm256_set1_epi32(0xb27022dc));
+}
+
+// 第 i 轮起连续 4 个轮密钥 t 写入 rk_x4 的广播形式（加密序与解密序），
+// 相邻两轮拼成一个 256 位向量写出
+static inline void SM4_AVX2_bcast_rk(SM4_Key *key, int i, __m128i t) {
+  __m256i v = _mm256_castsi128_si256(t);
+  __m256i *enc = (__m256i *)key->rk_x4[0][i];
+  __m256i *dec = (__m256i *)key->rk_x4[1][28 - i];
+  __m256i r01 = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+  __m256i r23 = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+  __m256i r32 = _mm256_setr_epi32(3, 3, 3, 3, 2, 2, 2, 2);
+  __m256i r10 = _mm256_setr_epi32(1, 1, 1, 1, 0, 0, 0, 0);
+  _mm256_storeu_si256(enc + 0, _mm256_permutevar8x32_epi32(v, r01));
+  _mm256_storeu_si256(enc + 1, _mm256_permutevar8x32_epi32(v, r23));
+  _mm256_storeu_si256(dec + 0, _mm256_permutevar8x32_epi32(v, r32));
+  _mm256_storeu_si256(dec + 1, _mm256_permutevar8x32_epi32(v, r10));
+}
+
+// K[r] 为第 i + r 轮的轮密钥，转置后写出 out[0~7] 的全部三种形式
+static inline void SM4_AVX2_store_rk(SM4_Key *out, const __m256i K[4], int i) {
+  __m256i T[4];
+  T[0] = MM256_PACK0_EPI32(K[0], K[1], K[2], K[3]);
+  T[1] = MM256_PACK1_EPI32(K[0], K[1], K[2], K[3]);
+  T[2] = MM256_PACK2_EPI32(K[0], K[1], K[2], K[3]);
+  T[3] = MM256_PACK3_EPI32(K[0], K[1], K[2], K[3]);
+  for (int j = 0; j < 4; j++) {
+    __m128i t[2] = {_mm256_castsi256_si128(T[j]),
+                    _mm256_extracti128_si256(T[j], 1)};
+    for (int h = 0; h < 2; h++) {
+      SM4_Key *key = out + j + 4 * h;
+      _mm_storeu_si128((__m128i *)(key->rk + i), t[h]);
+      _mm_storeu_si128((__m128i *)(key->rk_dec + 28 - i),
+                       _mm_shuffle_epi32(t[h], 0x1B));
+      SM4_AVX2_bcast_rk(key, i, t[h]);
+    }
+  }
+}
+
+// nsets 为编译期常量：2 时两组 8 路状态逐轮交错（16 个密钥），同 SM4_do16
+static inline __attribute__((always_inline)) void
+SM4_AVX2_keys(const uint8_t *const *keys, SM4_Key *out, int nsets, int vaes) {
+  __m256i K[2][4];
+  for (int s = 0; s < nsets; s++) {
+    SM4_AVX2_load_keys(keys + 8 * s, K[s]);
+  }
+  // CK 第 i 个字的第 b 个字节（大端）为 (4i + b) * 7 mod 256，按字节加 28 递推
+  __m256i ck = MM256_DUP(_mm_setr_epi8(21, 14, 7, 0, 21, 14, 7, 0, 21, 14, 7,
+                                       0, 21, 14, 7, 0));
+  __m256i ck_step = _mm256_set1_epi8(28);
+  for (int i = 0; i < 32; i += 4) {
+    for (int s = 0; s < nsets; s++) {
+      AVX2_KEY_ROUND(K[s][0], K[s][1], K[s][2], K[s][3]);
+    }
+    ck = _mm256_add_epi8(ck, ck_step);
+    for (int s = 0; s < nsets; s++) {
+      AVX2_KEY_ROUND(K[s][1], K[s][2], K[s][3], K[s][0]);
+    }
+    ck = _mm256_add_epi8(ck, ck_step);
+    for (int s = 0; s < nsets; s++) {
+      AVX2_KEY_ROUND(K[s][2], K[s][3], K[s][0], K[s][1]);
+    }
+    ck = _mm256_add_epi8(ck, ck_step);
+    for (int s = 0; s < nsets; s++) {
+      AVX2_KEY_ROUND(K[s][3], K[s][0], K[s][1], K[s][2]);
+    }
+    ck = _mm256_add_epi8(ck, ck_step);
+    for (int s = 0; s < nsets; s++) {
+      SM4_AVX2_store_rk(out + 8 * s, K[s], i);
+    }
+  }
+}
+
+static void SM4_keys8_vaes(const uint8_t *const *keys, SM4_Key *out) {
+  SM4_AVX2_keys(keys, out, 1, 1);
+}
+
+static void SM4_keys8_aesni(const uint8_t *const *keys, SM4_Key *out) {
+  SM4_AVX2_keys(keys, out, 1, 0);
+}
+
+static void SM4_keys16_vaes(const uint8_t *const *keys, SM4_Key *out) {
+  SM4_AVX2_keys(keys, out, 2, 1);
+}
+
+static void SM4_keys16_aesni(const uint8_t *const *keys, SM4_Key *out) {
+  SM4_AVX2_keys(keys, out, 2, 0);
+}
+
+void sm4_keyInit_batch_avx2(const uint8_t *const *keys, size_t n,
+                            SM4_Key *out) {
+  int vaes = sm4_avx2_has_vaes();
+  void (*keys16)(const uint8_t *const *, SM4_Key *) =
+      vaes ? SM4_keys16_vaes : SM4_keys16_aesni;
+  void (*keys8)(const uint8_t *const *, SM4_Key *) =
+      vaes ? SM4_keys8_vaes : SM4_keys8_aesni;
+
+  for (; n >= 16; n -= 16, keys += 16, out += 16) {
+    keys16(keys, out);
+  }
+  if (n >= 8) {
+    keys8(keys, out);
+    keys += 8;
+    out += 8;
+    n -= 8;
+  }
+  // 剩余 0~7 个交给 AES-NI 实现
+  if (n > 0) {
+    sm4_keyInit_batch_aesni(keys, n, out);
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef SM4_AVX2_H
+#define SM4_AVX2_H
+
+#include "sm4.h"
+
+// 一次处理 8 个分组（读写 128 字节），__m256i 每个 128 位半区对应 4 个分组
+void SM4_AVX2_do8(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                  int enc);
+
+// 一次处理 16 个分组（读写 256 字节），两组 8 路状态交错以隐藏 AES 单元延迟
+void SM4_AVX2_do16(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                   int enc);
+
+// 多块接口：16 块/8 块一组走 AVX2，剩余部分交给 AES-NI x4 实现
+void sm4_encrypt_blocks_avx2(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *sm4_key);
+
+void sm4_decrypt_blocks_avx2(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *sm4_key);
+
+// 多密钥接口：第 i 个分组使用 keys[i]，8 个分组一组、每个通道独立轮密钥
+void sm4_encrypt_multikey_avx2(const uint8_t *in, uint8_t *out,
+                               size_t nblocks, const SM4_Key *const *keys);
+
+void sm4_decrypt_multikey_avx2(const uint8_t *in, uint8_t *out,
+                               size_t nblocks, const SM4_Key *const *keys);
+
+// 批量密钥扩展：16 个密钥一组（两组 8 路交错），剩余部分交给 AES-NI 实现
+void sm4_keyInit_batch_avx2(const uint8_t *const *keys, size_t n,
+                            SM4_Key *out);
+
+// CPU 是否支持 VAES（256 位 aesenclast），不支持时按 128 位半区拆分执行
+int sm4_avx2_has_vaes(void);
+
+#endif
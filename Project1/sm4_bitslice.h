@@ -0,0 +1,21 @@
+#ifndef SM4_BITSLICE_H
+#define SM4_BITSLICE_H
+
+#include "sm4.h"
+
+// 位切片 SM4：S 盒为布尔电路，全程无查表，访存模式与数据无关。
+// 一次分别处理 64/128/256 个分组（读写 16 * n 字节）
+void SM4_BS_do64(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                 int enc);
+void SM4_BS_do128(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                  int enc);
+void SM4_BS_do256(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                  int enc);
+
+// 多块接口：按 256/128/64 分批，不足 64 块时补零后按 64 路处理
+void sm4_encrypt_blocks_bs(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *sm4_key);
+void sm4_decrypt_blocks_bs(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *sm4_key);
+
+#endif
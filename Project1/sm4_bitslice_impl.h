@@ -0,0 +1,160 @@
+// 位切片 SM4 内核模板：由 sm4_bitslice.c 针对不同批大小多次包含，无头文件保护。
+// 包含前需定义：
+//   BS_WIDTH       每批分组数（64/128/256）
+//   BS_T           位平面类型，每个元素保存 BS_WIDTH 个分组的同一比特
+//   BS_XOR/BS_AND  按位运算
+//   BS_ONES        全 1 常量
+//   BS_MASK(bit)   bit 为 1 时得到全 1，否则全 0（用于轮密钥，无分支）
+//   BS_LOAD/BS_STORE  与 uint32_t 暂存区之间的装载与写回
+
+#define BS_CAT_(a, b) a##b
+#define BS_CAT(a, b) BS_CAT_(a, b)
+#define BS_FN(name) BS_CAT(name, BS_WIDTH)
+
+// GF(2^4) 乘法，模多项式 z^4 + z + 1
+static inline void BS_FN(bs_mul16_)(const BS_T a[4], const BS_T b[4],
+                                    BS_T c[4]) {
+  BS_T p0 = BS_AND(a[0], b[0]);
+  BS_T p1 = BS_XOR(BS_AND(a[0], b[1]), BS_AND(a[1], b[0]));
+  BS_T p2 = BS_XOR(BS_XOR(BS_AND(a[0], b[2]), BS_AND(a[1], b[1])),
+                   BS_AND(a[2], b[0]));
+  BS_T p3 = BS_XOR(BS_XOR(BS_AND(a[0], b[3]), BS_AND(a[1], b[2])),
+                   BS_XOR(BS_AND(a[2], b[1]), BS_AND(a[3], b[0])));
+  BS_T p4 = BS_XOR(BS_XOR(BS_AND(a[1], b[3]), BS_AND(a[2], b[2])),
+                   BS_AND(a[3], b[1]));
+  BS_T p5 = BS_XOR(BS_AND(a[2], b[3]), BS_AND(a[3], b[2]));
+  BS_T p6 = BS_AND(a[3], b[3]);
+  // z^4 = z + 1, z^5 = z^2 + z, z^6 = z^3 + z^2
+  c[0] = BS_XOR(p0, p4);
+  c[1] = BS_XOR(BS_XOR(p1, p4), p5);
+  c[2] = BS_XOR(BS_XOR(p2, p5), p6);
+  c[3] = BS_XOR(p3, p6);
+}
+
+// GF(2^4) 求逆（0 映射到 0），由代数正规型直接展开
+static inline void BS_FN(bs_inv16_)(const BS_T x[4], BS_T y[4]) {
+  BS_T x01 = BS_AND(x[0], x[1]), x02 = BS_AND(x[0], x[2]);
+  BS_T x12 = BS_AND(x[1], x[2]), x03 = BS_AND(x[0], x[3]);
+  BS_T x13 = BS_AND(x[1], x[3]), x23 = BS_AND(x[2], x[3]);
+  BS_T x012 = BS_AND(x01, x[2]), x123 = BS_AND(x12, x[3]);
+  BS_T x013 = BS_AND(x01, x[3]), x023 = BS_AND(x02, x[3]);
+  BS_T s = BS_XOR(x[2], x[3]);
+
+  y[0] = BS_XOR(BS_XOR(BS_XOR(x[0], x[1]), BS_XOR(s, x02)),
+                BS_XOR(BS_XOR(x12, x012), x123));
+  y[1] = BS_XOR(BS_XOR(BS_XOR(x01, x02), BS_XOR(x12, x[3])),
+                BS_XOR(x13, x013));
+  y[2] = BS_XOR(BS_XOR(BS_XOR(x01, s), BS_XOR(x02, x03)), x023);
+  y[3] = BS_XOR(BS_XOR(BS_XOR(x[1], s), BS_XOR(x03, x13)),
+                BS_XOR(x23, x123));
+}
+
+// SM4 S 盒：S(x) = A·I(A·x + C) + C。
+// 求逆在塔域 GF((2^4)^2) 中完成（y^2 + y + λ，λ = 0xF），
+// 同构映射与仿射变换合并为输入/输出两个线性层（矩阵预计算）。
+static inline void BS_FN(bs_sbox_)(BS_T s[8]) {
+  BS_T t8, t9, t10, t11, t12, t13, t14;
+  BS_T a[4], b[4], ab[4], d[4], di[4], apb[4], c[4], e[4];
+
+  // 输入线性层：M·A·x + M·C（常量 0x85）
+  t8 = BS_XOR(s[0], s[2]);
+  t9 = BS_XOR(s[1], s[3]);
+  t10 = BS_XOR(s[4], t8);
+  t11 = BS_XOR(s[5], t9);
+  t12 = BS_XOR(s[2], s[6]);
+  t13 = BS_XOR(s[6], t10);
+  t14 = BS_XOR(s[7], t12);
+  b[0] = BS_XOR(BS_XOR(s[3], s[7]), BS_XOR(t10, BS_ONES));
+  b[1] = t8;
+  b[2] = BS_XOR(BS_XOR(t11, t14), BS_ONES);
+  b[3] = BS_XOR(t8, t9);
+  a[0] = BS_XOR(s[1], t13);
+  a[1] = t14;
+  a[2] = BS_XOR(t10, t11);
+  a[3] = BS_XOR(BS_XOR(t11, t13), BS_ONES);
+
+  // (a·y + b)^-1 = (a·Δ^-1)·y + (a + b)·Δ^-1，Δ = λ·a^2 + a·b + b^2
+  BS_FN(bs_mul16_)(a, b, ab);
+  d[0] = BS_XOR(BS_XOR(BS_XOR(a[0], a[1]), BS_XOR(b[0], b[2])), ab[0]);
+  d[1] = BS_XOR(BS_XOR(a[0], a[2]), BS_XOR(b[2], ab[1]));
+  d[2] = BS_XOR(BS_XOR(a[0], b[1]), BS_XOR(b[3], ab[2]));
+  d[3] = BS_XOR(BS_XOR(BS_XOR(a[0], a[1]), BS_XOR(a[3], b[3])), ab[3]);
+  BS_FN(bs_inv16_)(d, di);
+  for (int i = 0; i < 4; i++) {
+    apb[i] = BS_XOR(a[i], b[i]);
+  }
+  BS_FN(bs_mul16_)(a, di, c);
+  BS_FN(bs_mul16_)(apb, di, e);
+
+  // 输出线性层：A·M^-1·u + C（常量 0xD3），u = (c, e)
+  t8 = BS_XOR(e[0], e[3]);
+  t9 = BS_XOR(c[0], c[3]);
+  t10 = BS_XOR(e[0], c[2]);
+  t11 = BS_XOR(e[1], c[2]);
+  t12 = BS_XOR(e[2], c[1]);
+  t13 = BS_XOR(e[2], t8);
+  t14 = BS_XOR(t9, t13);
+  s[0] = BS_XOR(BS_XOR(e[1], t14), BS_ONES);
+  s[1] = BS_XOR(t10, BS_ONES);
+  s[2] = BS_XOR(t11, c[3]);
+  s[3] = BS_XOR(t9, t10);
+  s[4] = BS_XOR(BS_XOR(t12, c[2]), BS_ONES);
+  s[5] = t12;
+  s[6] = BS_XOR(t14, BS_ONES);
+  s[7] = BS_XOR(BS_XOR(t8, t11), BS_ONES);
+}
+
+// 32 轮迭代。X[w][k] 为第 w 个字第 k 比特（k = 0 为最低位）的位平面；
+// 第 i 轮的结果写回 X[i % 4]，循环移位只是下标的轮换，L 变换中的循环左移
+// 同样只是位平面下标的偏移。rk 为按使用顺序排列的轮密钥（加密 rk，解密 rk_dec）。
+static void BS_FN(bs_rounds_)(BS_T X[4][32], const uint32_t rk[32]) {
+  BS_T t[32];
+  for (int i = 0; i < 32; i++) {
+    uint32_t k = rk[i];
+    BS_T *x0 = X[i & 3];
+    const BS_T *x1 = X[(i + 1) & 3];
+    const BS_T *x2 = X[(i + 2) & 3];
+    const BS_T *x3 = X[(i + 3) & 3];
+
+    for (int j = 0; j < 32; j++) {
+      t[j] = BS_XOR(BS_XOR(x1[j], x2[j]), BS_XOR(x3[j], BS_MASK((k >> j) & 1)));
+    }
+    // 每个字节对应连续的 8 个位平面
+    for (int m = 0; m < 4; m++) {
+      BS_FN(bs_sbox_)(t + 8 * m);
+    }
+    // L(B) = B ^ (B <<< 2) ^ (B <<< 10) ^ (B <<< 18) ^ (B <<< 24)
+    for (int j = 0; j < 32; j++) {
+      BS_T l = BS_XOR(BS_XOR(t[j], t[(j - 2) & 31]),
+                      BS_XOR(t[(j - 10) & 31], t[(j - 18) & 31]));
+      x0[j] = BS_XOR(x0[j], BS_XOR(l, t[(j - 24) & 31]));
+    }
+  }
+}
+
+void BS_FN(SM4_BS_do)(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                      int enc) {
+  uint32_t planes[128 * (BS_WIDTH / 32)] __attribute__((aligned(32)));
+  BS_T X[4][32];
+
+  sm4_bs_pack(in, planes, BS_WIDTH / 32);
+  for (int w = 0; w < 4; w++) {
+    for (int k = 0; k < 32; k++) {
+      X[w][k] = BS_LOAD(planes + (32 * w + k) * (BS_WIDTH / 32));
+    }
+  }
+
+  BS_FN(bs_rounds_)(X, (enc == 0) ? sm4_key->rk : sm4_key->rk_dec);
+
+  // 输出 (X35, X34, X33, X32)，即 X[3], X[2], X[1], X[0]
+  for (int w = 0; w < 4; w++) {
+    for (int k = 0; k < 32; k++) {
+      BS_STORE(planes + (32 * w + k) * (BS_WIDTH / 32), X[3 - w][k]);
+    }
+  }
+  sm4_bs_unpack(planes, out, BS_WIDTH / 32);
+}
+
+#undef BS_FN
+#undef BS_CAT
+#undef BS_CAT_
@@ -0,0 +1,144 @@
+#include "sm4_cbc.h"
+#include "sm4_engine.h"
+#include "sm4_trace.h"
+
+#include <emmintrin.h>
+#include <string.h>
+
+static inline __m128i load_block(const uint8_t *p) {
+  return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void store_block(uint8_t *p, __m128i v) {
+  _mm_storeu_si128((__m128i *)p, v);
+}
+
+void sm4_cbc_encrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_CBC, 16 * nblocks, nblocks);
+  SM4_BlocksFunc encrypt = sm4_engine_get(1)->encrypt_blocks;
+  uint8_t block[16];
+  __m128i chain = load_block(iv);
+
+  for (size_t i = 0; i < nblocks; i++) {
+    store_block(block, _mm_xor_si128(load_block(in + 16 * i), chain));
+    encrypt(block, out + 16 * i, 1, key);
+    chain = load_block(out + 16 * i);
+  }
+  store_block(iv, chain);
+  SM4_TRACE_END();
+}
+
+void sm4_cbc_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_CBC, 16 * nblocks, nblocks);
+  // 原地解密时输出会覆盖密文，先把本批密文留一份用于异或
+  uint8_t saved[16 * SM4_CBC_BATCH];
+  uint8_t plain[16 * SM4_CBC_BATCH];
+  __m128i chain = load_block(iv);
+
+  while (nblocks > 0) {
+    size_t n = nblocks < SM4_CBC_BATCH ? nblocks : SM4_CBC_BATCH;
+    memcpy(saved, in, 16 * n);
+    sm4_engine_get(n)->decrypt_blocks(saved, plain, n, key);
+    for (size_t i = 0; i < n; i++) {
+      store_block(out + 16 * i,
+                  _mm_xor_si128(load_block(plain + 16 * i), chain));
+      chain = load_block(saved + 16 * i);
+    }
+    in += 16 * n;
+    out += 16 * n;
+    nblocks -= n;
+  }
+  store_block(iv, chain);
+  SM4_TRACE_END();
+}
+
+void sm4_cfb_encrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_CBC, 16 * nblocks, nblocks);
+  SM4_BlocksFunc encrypt = sm4_engine_get(1)->encrypt_blocks;
+  uint8_t chain[16], ks[16];
+  memcpy(chain, iv, 16);
+
+  for (size_t i = 0; i < nblocks; i++) {
+    encrypt(chain, ks, 1, key);
+    store_block(chain, _mm_xor_si128(load_block(in + 16 * i), load_block(ks)));
+    store_block(out + 16 * i, load_block(chain));
+  }
+  memcpy(iv, chain, 16);
+  SM4_TRACE_END();
+}
+
+void sm4_cfb_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_CBC, 16 * nblocks, nblocks);
+  // feed = (C_{-1} = IV, C_0, ..., C_{n-2})，整批加密得到密钥流
+  uint8_t feed[16 * SM4_CBC_BATCH];
+  uint8_t ks[16 * SM4_CBC_BATCH];
+  uint8_t chain[16];
+  memcpy(chain, iv, 16);
+
+  while (nblocks > 0) {
+    size_t n = nblocks < SM4_CBC_BATCH ? nblocks : SM4_CBC_BATCH;
+    memcpy(feed, chain, 16);
+    memcpy(feed + 16, in, 16 * (n - 1));
+    memcpy(chain, in + 16 * (n - 1), 16);
+    sm4_engine_get(n)->encrypt_blocks(feed, ks, n, key);
+    for (size_t i = 0; i < n; i++) {
+      store_block(out + 16 * i, _mm_xor_si128(load_block(in + 16 * i),
+                                              load_block(ks + 16 * i)));
+    }
+    in += 16 * n;
+    out += 16 * n;
+    nblocks -= n;
+  }
+  memcpy(iv, chain, 16);
+  SM4_TRACE_END();
+}
+
+// 一组至多 SM4_CBC_BATCH 路：每一步把各路当前分组与各自的链值异或后
+// 收集到连续缓冲区，一次多块加密，再分发回各路并更新链值
+static void cbc_encrypt_group(SM4_CBC_STREAM *streams, size_t nstreams,
+                              const SM4_Key *key) {
+  uint8_t lanes[16 * SM4_CBC_BATCH];
+  SM4_CBC_STREAM *active[SM4_CBC_BATCH];
+  size_t nactive = 0;
+
+  for (size_t s = 0; s < nstreams; s++) {
+    if (streams[s].nblocks > 0) {
+      active[nactive++] = &streams[s];
+    }
+  }
+
+  for (size_t step = 0; nactive > 0; step++) {
+    for (size_t l = 0; l < nactive; l++) {
+      const uint8_t *p = active[l]->in + 16 * step;
+      store_block(lanes + 16 * l,
+                  _mm_xor_si128(load_block(p), load_block(active[l]->iv)));
+    }
+    sm4_engine_get(nactive)->encrypt_blocks(lanes, lanes, nactive, key);
+
+    // 分发结果，已完成的路从活动列表中移除
+    size_t kept = 0;
+    for (size_t l = 0; l < nactive; l++) {
+      SM4_CBC_STREAM *st = active[l];
+      memcpy(st->out + 16 * step, lanes + 16 * l, 16);
+      memcpy(st->iv, lanes + 16 * l, 16);
+      if (step + 1 < st->nblocks) {
+        active[kept++] = st;
+      }
+    }
+    nactive = kept;
+  }
+}
+
+void sm4_cbc_encrypt_multi(SM4_CBC_STREAM *streams, size_t nstreams,
+                           const SM4_Key *key) {
+  while (nstreams > 0) {
+    size_t n = nstreams < SM4_CBC_BATCH ? nstreams : SM4_CBC_BATCH;
+    cbc_encrypt_group(streams, n, key);
+    streams += n;
+    nstreams -= n;
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef SM4_CBC_H
+#define SM4_CBC_H
+
+#include "sm4.h"
+
+// 并行解密时每批处理的分组数
+#define SM4_CBC_BATCH 64
+
+// 以下接口均按完整分组处理，填充由调用方负责。iv 在调用后更新为
+// 最后一个密文分组，可直接用于同一消息的下一次调用。in 与 out 可以相同。
+
+// CBC 加密：C_i = E(P_i ^ C_{i-1})，天然串行
+void sm4_cbc_encrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key);
+
+// CBC 解密：P_i = D(C_i) ^ C_{i-1}，整批送入多块后端并行解密
+void sm4_cbc_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key);
+
+// CFB（128 位反馈）加密：C_i = P_i ^ E(C_{i-1})，串行
+void sm4_cfb_encrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key);
+
+// CFB 解密：P_i = C_i ^ E(C_{i-1})，E 的输入全部已知，整批并行加密
+void sm4_cfb_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                     uint8_t iv[16], const SM4_Key *key);
+
+// 多路 CBC 加密中的一路消息
+typedef struct {
+  const uint8_t *in;
+  uint8_t *out;
+  size_t nblocks;
+  uint8_t iv[16]; // 调用后更新为该路最后一个密文分组
+} SM4_CBC_STREAM;
+
+// 多路 CBC 加密：各路使用同一密钥、不同 IV，长度可以不同。
+// 每一步取出所有未完成路的当前分组，合成一次多块调用，
+// 让单路串行的 CBC 也能占满 SIMD 通道
+void sm4_cbc_encrypt_multi(SM4_CBC_STREAM *streams, size_t nstreams,
+                           const SM4_Key *key);
+
+#endif
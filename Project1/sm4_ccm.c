@@ -0,0 +1,373 @@
+#include "sm4_ccm.h"
+#include "sm4_ctr.h"
+#include "sm4_engine.h"
+#include "sm4_trace.h"
+
+#include <emmintrin.h>
+#include <string.h>
+
+// 单条消息每次调用的分组数：1 个 CBC-MAC 分组 + 3 个 CTR 分组
+#define CCM_LANES 4
+// CTR 密钥流最多领先 MAC 的分组数
+#define CCM_RING 16
+
+static inline __m128i load_block(const uint8_t *p) {
+  return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void store_block(uint8_t *p, __m128i v) {
+  _mm_storeu_si128((__m128i *)p, v);
+}
+
+static void xor_bytes(uint8_t *out, const uint8_t *in, const uint8_t *ks,
+                      size_t n) {
+  if (n == 16) {
+    store_block(out, _mm_xor_si128(load_block(in), load_block(ks)));
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    out[i] = in[i] ^ ks[i];
+  }
+}
+
+// 把 v 按大端写入 p 开始的 n 个字节
+static void put_be(uint8_t *p, size_t n, uint64_t v) {
+  for (size_t i = 0; i < n; i++) {
+    p[n - 1 - i] = i < 8 ? (uint8_t)(v >> (8 * i)) : 0;
+  }
+}
+
+// CBC-MAC 的输入：B0 | AAD 长度编码 | AAD | 补零 | 明文 | 补零，
+// 按分组序号随机访问
+typedef struct {
+  uint8_t b0[16];
+  uint8_t a0[16];  // 计数器块 A0，A_j 为其最后 q 字节替换成 j
+  uint8_t hdr[10]; // AAD 长度编码
+  size_t hdr_len;
+  size_t q; // 长度字段字节数，15 - nonce_len
+  const uint8_t *aad;
+  size_t aad_len;
+  size_t aad_blocks;      // 长度编码与 AAD 共占的分组数
+  const uint8_t *payload; // 参与 MAC 的明文：加密时为 in，解密时为 out
+  size_t len;
+  size_t nblocks; // MAC 分组总数
+} CCM_MAC;
+
+static int ccm_setup(CCM_MAC *m, const uint8_t *nonce, size_t nonce_len,
+                     const uint8_t *aad, size_t aad_len,
+                     const uint8_t *payload, size_t len, size_t tag_len) {
+  if (nonce_len < 7 || nonce_len > 13 || tag_len < 4 || tag_len > 16 ||
+      tag_len % 2 != 0) {
+    return -1;
+  }
+  m->q = 15 - nonce_len;
+  if (m->q < 8 && (uint64_t)len >> (8 * m->q) != 0) {
+    return -1;
+  }
+
+  m->b0[0] = (uint8_t)((aad_len > 0 ? 0x40 : 0) | ((tag_len - 2) / 2) << 3 |
+                       (m->q - 1));
+  memcpy(m->b0 + 1, nonce, nonce_len);
+  put_be(m->b0 + 1 + nonce_len, m->q, len);
+
+  memset(m->a0, 0, 16);
+  m->a0[0] = (uint8_t)(m->q - 1);
+  memcpy(m->a0 + 1, nonce, nonce_len);
+
+  if (aad_len == 0) {
+    m->hdr_len = 0;
+  } else if (aad_len < 0xFF00) {
+    m->hdr_len = 2;
+    put_be(m->hdr, 2, aad_len);
+  } else if ((uint64_t)aad_len <= 0xFFFFFFFFu) {
+    m->hdr_len = 6;
+    m->hdr[0] = 0xFF;
+    m->hdr[1] = 0xFE;
+    put_be(m->hdr + 2, 4, aad_len);
+  } else {
+    m->hdr_len = 10;
+    m->hdr[0] = 0xFF;
+    m->hdr[1] = 0xFF;
+    put_be(m->hdr + 2, 8, aad_len);
+  }
+
+  m->aad = aad;
+  m->aad_len = aad_len;
+  m->aad_blocks = (m->hdr_len + aad_len + 15) / 16;
+  m->payload = payload;
+  m->len = len;
+  m->nblocks = 1 + m->aad_blocks + (len + 15) / 16;
+  return 0;
+}
+
+// 第 i 个 MAC 分组。完整的明文分组直接返回原地址，其余拼到 tmp 中
+static const uint8_t *mac_block(const CCM_MAC *m, size_t i, uint8_t tmp[16]) {
+  if (i == 0) {
+    return m->b0;
+  }
+  memset(tmp, 0, 16);
+  if (i <= m->aad_blocks) {
+    // (hdr | aad) 中的第 [pos, pos + 16) 字节
+    size_t pos = 16 * (i - 1);
+    size_t n = 0;
+    for (; n < 16 && pos + n < m->hdr_len; n++) {
+      tmp[n] = m->hdr[pos + n];
+    }
+    size_t a = pos + n - m->hdr_len;
+    if (a < m->aad_len) {
+      size_t take = m->aad_len - a < 16 - n ? m->aad_len - a : 16 - n;
+      memcpy(tmp + n, m->aad + a, take);
+    }
+    return tmp;
+  }
+  size_t off = 16 * (i - 1 - m->aad_blocks);
+  if (m->len - off >= 16) {
+    return m->payload + off;
+  }
+  memcpy(tmp, m->payload + off, m->len - off);
+  return tmp;
+}
+
+static void ctr_block(const CCM_MAC *m, size_t j, uint8_t out[16]) {
+  memcpy(out, m->a0, 16);
+  put_be(out + 16 - m->q, m->q, j);
+}
+
+// 单条消息的流水线：第 i 步把 MAC 分组 i 与后续若干计数器块合成一次调用。
+// 计数器 0 生成标签掩码 S0，计数器 p + 1 对应第 p 个数据分组；CTR 每步
+// 最多前进 3 块而 MAC 只前进 1 块，处理数据分组时其密钥流总已算好。
+// 加密时先把明文计入 MAC 再写出密文，解密时先写出明文再计入 MAC，
+// 因此 in 与 out 相同也安全
+static void ccm_one(const CCM_MAC *m, const SM4_Key *key, const uint8_t *in,
+                    uint8_t *out, int enc, uint8_t mac[16], uint8_t s0[16]) {
+  SM4_BlocksFunc encrypt = sm4_engine_get(CCM_LANES)->encrypt_blocks;
+  uint8_t lanes[16 * CCM_LANES];
+  uint8_t ks[CCM_RING][16];
+  uint8_t tmp[16];
+  __m128i x = _mm_setzero_si128();
+  size_t nctr = (m->len + 15) / 16 + 1;
+  size_t produced = 0, need = 1;
+
+  for (size_t i = 0; i < m->nblocks; i++) {
+    if (i > m->aad_blocks) {
+      size_t p = i - 1 - m->aad_blocks;
+      size_t off = 16 * p;
+      size_t n = m->len - off < 16 ? m->len - off : 16;
+      const uint8_t *k = ks[(p + 1) % CCM_RING];
+      if (!enc) {
+        xor_bytes(out + off, in + off, k, n);
+      }
+      store_block(lanes, _mm_xor_si128(x, load_block(mac_block(m, i, tmp))));
+      if (enc) {
+        xor_bytes(out + off, in + off, k, n);
+      }
+      need = p + 2;
+    } else {
+      store_block(lanes, _mm_xor_si128(x, load_block(mac_block(m, i, tmp))));
+    }
+
+    size_t c = 1;
+    for (; c < CCM_LANES && produced < nctr && produced < need + CCM_RING;
+         c++, produced++) {
+      ctr_block(m, produced, lanes + 16 * c);
+    }
+    encrypt(lanes, lanes, c, key);
+
+    x = load_block(lanes);
+    for (size_t l = 1; l < c; l++) {
+      size_t j = produced - c + l;
+      memcpy(j == 0 ? s0 : ks[j % CCM_RING], lanes + 16 * l, 16);
+    }
+  }
+  store_block(mac, x);
+}
+
+// 单块最快的是标量后端（T-table 等）时，多块调用的耗时随块数线性增长，
+// 把 CTR 塞进 MAC 的调用里反而拖慢关键路径。此时 MAC 链逐块调用单块后端，
+// CTR 整段交给多块后端。加密先算 MAC 再写密文，解密先写明文再算 MAC
+static void ccm_serial(const CCM_MAC *m, const SM4_Key *key, const uint8_t *in,
+                       uint8_t *out, int enc, uint8_t mac[16],
+                       uint8_t s0[16]) {
+  SM4_BlocksFunc encrypt = sm4_engine_get(1)->encrypt_blocks;
+  uint8_t a1[16], tmp[16];
+  __m128i x = _mm_setzero_si128();
+
+  ctr_block(m, 1, a1);
+  if (!enc) {
+    sm4_ctr_range(key, a1, 128, 0, in, out, m->len);
+  }
+  for (size_t i = 0; i < m->nblocks; i++) {
+    store_block(tmp, _mm_xor_si128(x, load_block(mac_block(m, i, tmp))));
+    encrypt(tmp, tmp, 1, key);
+    x = load_block(tmp);
+  }
+  if (enc) {
+    sm4_ctr_range(key, a1, 128, 0, in, out, m->len);
+  }
+  store_block(mac, x);
+  ctr_block(m, 0, s0);
+  encrypt(s0, s0, 1, key);
+}
+
+// 单块后端是 SIMD 内核时空闲通道不额外耗时，走 MAC/CTR 同批的流水线
+static void ccm_crypt(const CCM_MAC *m, const SM4_Key *key, const uint8_t *in,
+                      uint8_t *out, int enc, uint8_t mac[16], uint8_t s0[16]) {
+  if (sm4_engine_get(1)->required & SM4_CPU_AESNI) {
+    ccm_one(m, key, in, out, enc, mac, s0);
+  } else {
+    ccm_serial(m, key, in, out, enc, mac, s0);
+  }
+}
+
+// 常量时间比较
+static int tag_equal(const uint8_t *a, const uint8_t *b, size_t n) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < n; i++) {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+int sm4_ccm_encrypt(const SM4_Key *key, const uint8_t *nonce,
+                    size_t nonce_len, const uint8_t *aad, size_t aad_len,
+                    const uint8_t *in, uint8_t *out, size_t len, uint8_t *tag,
+                    size_t tag_len) {
+  CCM_MAC m;
+  uint8_t mac[16], s0[16];
+  if (ccm_setup(&m, nonce, nonce_len, aad, aad_len, in, len, tag_len) != 0) {
+    return -1;
+  }
+  SM4_TRACE_BEGIN(SM4_TRACE_CCM, len, (len + 15) / 16);
+  ccm_crypt(&m, key, in, out, 1, mac, s0);
+  xor_bytes(tag, mac, s0, tag_len);
+  SM4_TRACE_END();
+  return 0;
+}
+
+int sm4_ccm_decrypt(const SM4_Key *key, const uint8_t *nonce,
+                    size_t nonce_len, const uint8_t *aad, size_t aad_len,
+                    const uint8_t *in, uint8_t *out, size_t len,
+                    const uint8_t *tag, size_t tag_len) {
+  CCM_MAC m;
+  uint8_t mac[16], s0[16];
+  if (ccm_setup(&m, nonce, nonce_len, aad, aad_len, out, len, tag_len) != 0) {
+    return -1;
+  }
+  SM4_TRACE_BEGIN(SM4_TRACE_CCM, len, (len + 15) / 16);
+  ccm_crypt(&m, key, in, out, 0, mac, s0);
+  xor_bytes(mac, mac, s0, 16);
+  SM4_TRACE_END();
+  if (!tag_equal(mac, tag, tag_len)) {
+    memset(out, 0, len);
+    return -1;
+  }
+  return 0;
+}
+
+// 一组消息（不超过 SM4_CCM_BATCH 条）。加密先交错计算 MAC 再做 CTR，
+// 解密先做 CTR 得到明文再计算 MAC
+static int ccm_group(SM4_CCM_MSG *msgs, size_t nmsgs, size_t tag_len,
+                     const SM4_Key *key, int enc) {
+  CCM_MAC mac[SM4_CCM_BATCH];
+  size_t idx[SM4_CCM_BATCH]; // 参数合法的消息
+  size_t nvalid = 0;
+  uint8_t lanes[16 * SM4_CCM_BATCH];
+  uint8_t s0[16 * SM4_CCM_BATCH];
+  size_t step[SM4_CCM_BATCH]; // 各消息下一个 MAC 分组的序号
+  uint8_t tmp[16];
+  int ret = 0;
+
+  for (size_t s = 0; s < nmsgs; s++) {
+    SM4_CCM_MSG *msg = &msgs[s];
+    msg->result = ccm_setup(&mac[nvalid], msg->nonce, msg->nonce_len,
+                            msg->aad, msg->aad_len, enc ? msg->in : msg->out,
+                            msg->len, tag_len);
+    if (msg->result != 0) {
+      ret = -1;
+      continue;
+    }
+    step[nvalid] = 0;
+    idx[nvalid++] = s;
+  }
+  if (nvalid == 0) {
+    return ret;
+  }
+
+  // 标签掩码 S0 = E(A0)，各消息合成一次调用；解密时顺带完成 CTR
+  for (size_t l = 0; l < nvalid; l++) {
+    memcpy(s0 + 16 * l, mac[l].a0, 16);
+    if (!enc) {
+      SM4_CCM_MSG *msg = &msgs[idx[l]];
+      ctr_block(&mac[l], 1, tmp);
+      sm4_ctr_range(key, tmp, 128, 0, msg->in, msg->out, msg->len);
+    }
+  }
+  sm4_engine_get(nvalid)->encrypt_blocks(s0, s0, nvalid, key);
+
+  // 交错 CBC-MAC：每一步取出所有未完成消息的当前分组，已完成的移出
+  __m128i x[SM4_CCM_BATCH];
+  size_t active[SM4_CCM_BATCH];
+  size_t nactive = nvalid;
+  for (size_t l = 0; l < nvalid; l++) {
+    x[l] = _mm_setzero_si128();
+    active[l] = l;
+  }
+  while (nactive > 0) {
+    for (size_t a = 0; a < nactive; a++) {
+      size_t l = active[a];
+      const uint8_t *b = mac_block(&mac[l], step[l], tmp);
+      store_block(lanes + 16 * a, _mm_xor_si128(x[l], load_block(b)));
+    }
+    sm4_engine_get(nactive)->encrypt_blocks(lanes, lanes, nactive, key);
+
+    size_t kept = 0;
+    for (size_t a = 0; a < nactive; a++) {
+      size_t l = active[a];
+      x[l] = load_block(lanes + 16 * a);
+      if (++step[l] < mac[l].nblocks) {
+        active[kept++] = l;
+      }
+    }
+    nactive = kept;
+  }
+
+  for (size_t l = 0; l < nvalid; l++) {
+    SM4_CCM_MSG *msg = &msgs[idx[l]];
+    uint8_t full[16];
+    store_block(full, _mm_xor_si128(x[l], load_block(s0 + 16 * l)));
+    if (enc) {
+      ctr_block(&mac[l], 1, tmp);
+      sm4_ctr_range(key, tmp, 128, 0, msg->in, msg->out, msg->len);
+      memcpy(msg->tag, full, tag_len);
+    } else if (!tag_equal(full, msg->tag, tag_len)) {
+      memset(msg->out, 0, msg->len);
+      msg->result = -1;
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
+static int ccm_multi(SM4_CCM_MSG *msgs, size_t nmsgs, size_t tag_len,
+                     const SM4_Key *key, int enc) {
+  int ret = 0;
+  while (nmsgs > 0) {
+    size_t n = nmsgs < SM4_CCM_BATCH ? nmsgs : SM4_CCM_BATCH;
+    if (ccm_group(msgs, n, tag_len, key, enc) != 0) {
+      ret = -1;
+    }
+    msgs += n;
+    nmsgs -= n;
+  }
+  return ret;
+}
+
+int sm4_ccm_encrypt_multi(SM4_CCM_MSG *msgs, size_t nmsgs, size_t tag_len,
+                          const SM4_Key *key) {
+  return ccm_multi(msgs, nmsgs, tag_len, key, 1);
+}
+
+int sm4_ccm_decrypt_multi(SM4_CCM_MSG *msgs, size_t nmsgs, size_t tag_len,
+                          const SM4_Key *key) {
+  return ccm_multi(msgs, nmsgs, tag_len, key, 0);
+}
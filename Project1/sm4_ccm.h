@@ -0,0 +1,46 @@
+#ifndef SM4_CCM_H
+#define SM4_CCM_H
+
+#include "sm4.h"
+
+// 多消息模式每组交错的消息数
+#define SM4_CCM_BATCH 64
+
+// SM4-CCM（NIST SP 800-38C / RFC 8998）：nonce 为 7~13 字节，标签为
+// 4~16 之间的偶数字节。in 与 out 可以相同。参数非法返回 -1
+
+// 单条消息：每次多块调用中 1 个通道推进 CBC-MAC，其余通道提前生成
+// CTR 密钥流，串行的 MAC 链与并行的 CTR 在同一次调用里完成
+int sm4_ccm_encrypt(const SM4_Key *key, const uint8_t *nonce,
+                    size_t nonce_len, const uint8_t *aad, size_t aad_len,
+                    const uint8_t *in, uint8_t *out, size_t len, uint8_t *tag,
+                    size_t tag_len);
+
+// 标签不符时清零 out 并返回 -1
+int sm4_ccm_decrypt(const SM4_Key *key, const uint8_t *nonce,
+                    size_t nonce_len, const uint8_t *aad, size_t aad_len,
+                    const uint8_t *in, uint8_t *out, size_t len,
+                    const uint8_t *tag, size_t tag_len);
+
+// 多消息模式中的一条消息
+typedef struct {
+  const uint8_t *nonce;
+  size_t nonce_len;
+  const uint8_t *aad;
+  size_t aad_len;
+  const uint8_t *in;
+  uint8_t *out;
+  size_t len;
+  uint8_t tag[16]; // 加密时输出，解密时输入
+  int result;      // 0 成功，-1 参数非法或标签不符（解密时 out 已清零）
+} SM4_CCM_MSG;
+
+// 多消息模式：同一密钥下的多条消息，每一步取出各消息 CBC-MAC 链的当前
+// 分组合成一次多块调用；CTR 部分整段走多块后端。全部成功返回 0，
+// 否则返回 -1，各消息的结果见 result
+int sm4_ccm_encrypt_multi(SM4_CCM_MSG *msgs, size_t nmsgs, size_t tag_len,
+                          const SM4_Key *key);
+int sm4_ccm_decrypt_multi(SM4_CCM_MSG *msgs, size_t nmsgs, size_t tag_len,
+                          const SM4_Key *key);
+
+#endif
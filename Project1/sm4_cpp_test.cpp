@@ -0,0 +1,236 @@
+// C++ 头文件前端测试：各后端与 C 实现逐块对比，GCM 与 sm4_gcm.c 对比，
+// 最后对比函数指针调用与模板内联的耗时。需要 -maes -mavx2 -mpclmul（makefile
+// 另加 -mvaes）
+#include "SM4_GCM/sm4_gcm.hpp"
+#include "sm4.hpp"
+
+extern "C" {
+#include "SM4_GCM/sm4_gcm.h"
+#include "sm4.h"
+#include "sm4_ctr.h"
+#include "sm4_engine.h"
+#include "sm4_ttable.h"
+}
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+typedef void (*EncryptFunc)(const uint8_t[16], const SM4_Key *, uint8_t[16]);
+
+#define TEST_BLOCKS 37 // 覆盖 16/8/4 块各分支与尾块补齐
+
+static const uint8_t KEY[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB,
+                                0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98,
+                                0x76, 0x54, 0x32, 0x10};
+static const uint8_t EXPECTED[16] = {0x68, 0x1E, 0xDF, 0x34, 0xD2, 0x06,
+                                     0x96, 0x5E, 0x86, 0xB3, 0xE9, 0x4F,
+                                     0x53, 0x6E, 0x42, 0x46};
+
+static const GHASH_METHOD GHASH_TBL = {ghash_table_init, ghash_table_update,
+                                       ghash_table_final, ghash_table_reset};
+
+static const char *tf(bool ok) { return ok ? "true" : "false"; }
+
+static double now_sec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 轮密钥在编译期求出，与 sm4_keyInit 对比
+static void run_constexpr_test() {
+  static constexpr std::array<uint8_t, 16> key = {
+      0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+      0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10};
+  static constexpr sm4::key_schedule ks = sm4::expand_key(key);
+  SM4_Key ref;
+  sm4_keyInit(KEY, &ref);
+
+  printf("\n编译期密钥扩展测试\n");
+  printf("轮密钥是否等于 sm4_keyInit：\t%s\n",
+         tf(memcmp(ks.enc.data(), ref.rk, 128) == 0 &&
+            memcmp(ks.dec.data(), ref.rk_dec, 128) == 0));
+  printf("T 表是否等于 sm4_ttable.c：\t%s\n",
+         tf(memcmp(sm4::detail::T0.data(), Table0, 1024) == 0 &&
+            memcmp(sm4::detail::T1.data(), Table1, 1024) == 0 &&
+            memcmp(sm4::detail::T2.data(), Table2, 1024) == 0 &&
+            memcmp(sm4::detail::T3.data(), Table3, 1024) == 0));
+}
+
+template <class Backend> static void run_cipher_test() {
+  printf("\nC++ 前端 %s 后端测试\n", Backend::name);
+  if (!Backend::available()) {
+    printf("当前 CPU 不支持，跳过\n");
+    return;
+  }
+  sm4::cipher<Backend> c(std::span<const uint8_t, 16>(KEY, 16));
+  SM4_Key ref;
+  sm4_keyInit(KEY, &ref);
+
+  uint8_t block[16], back[16];
+  c.encrypt_block(std::span<const uint8_t, 16>(KEY, 16), block);
+  c.decrypt_block(block, back);
+  printf("是否等于标准输出：\t\t%s\n", tf(memcmp(block, EXPECTED, 16) == 0));
+  printf("解密是否等于原文：\t\t%s\n", tf(memcmp(back, KEY, 16) == 0));
+
+  uint8_t pt[16 * TEST_BLOCKS], expect[16 * TEST_BLOCKS];
+  uint8_t ct[16 * TEST_BLOCKS + 16], dec[16 * TEST_BLOCKS];
+  for (size_t i = 0; i < sizeof(pt); i++) {
+    pt[i] = (uint8_t)(i * 131 + 7);
+  }
+  sm4_encrypt_blocks(pt, expect, TEST_BLOCKS, &ref);
+  bool enc_ok = true, dec_ok = true, bound_ok = true;
+  for (size_t n = 1; n <= TEST_BLOCKS; n++) {
+    memset(ct, 0xA5, sizeof(ct));
+    c.encrypt(std::span<const uint8_t>(pt, 16 * n), ct);
+    enc_ok &= memcmp(ct, expect, 16 * n) == 0;
+    bound_ok &= ct[16 * n] == 0xA5;
+    c.decrypt(std::span<const uint8_t>(ct, 16 * n), dec);
+    dec_ok &= memcmp(dec, pt, 16 * n) == 0;
+  }
+  printf("多块加密是否等于逐块结果：\t%s\n", tf(enc_ok));
+  printf("多块解密是否等于原文：\t\t%s\n", tf(dec_ok));
+  printf("是否无越界写：\t\t\t%s\n", tf(bound_ok));
+
+  // CTR：长度不是 16 的倍数，计数器低 32 位回绕
+  uint8_t ctr[16], ref_ctr[16], padded[16 * TEST_BLOCKS];
+  memset(ctr, 0x3C, 12);
+  sm4::detail::store_be32(ctr + 12, 0xFFFFFFF0);
+  memcpy(ref_ctr, ctr, 16);
+  size_t len = sizeof(pt) - 5;
+  memcpy(padded, pt, sizeof(pt));
+  sm4_ctr32_blocks(padded, padded, TEST_BLOCKS, ref_ctr, &ref);
+  c.ctr32(std::span<const uint8_t>(pt, len), ct, ctr);
+  printf("CTR 是否等于 sm4_ctr32_blocks：\t%s\n",
+         tf(memcmp(ct, padded, len) == 0 && memcmp(ctr, ref_ctr, 16) == 0));
+}
+
+template <class Backend, class Ghash> static void run_gcm_test() {
+  printf("\nC++ 前端 GCM（%s + %s）测试\n", Backend::name, Ghash::name);
+  if (!Backend::available() || !Ghash::available()) {
+    printf("当前 CPU 不支持，跳过\n");
+    return;
+  }
+  static const size_t IV_LENS[] = {12, 1, 60};
+  static const size_t AAD_LENS[] = {0, 13, 32};
+  static const size_t PT_LENS[] = {0, 1, 16, 63, 1000};
+  sm4::gcm<sm4::cipher<Backend>, Ghash> g(
+      std::span<const uint8_t, 16>(KEY, 16));
+  std::vector<uint8_t> buf(1024), pt(1024), ct(1024), ref_ct(1024);
+  for (size_t i = 0; i < buf.size(); i++) {
+    buf[i] = (uint8_t)(i * 29 + 3);
+  }
+
+  bool seal_ok = true, open_ok = true, reject_ok = true;
+  for (size_t iv_len : IV_LENS) {
+    for (size_t aad_len : AAD_LENS) {
+      for (size_t len : PT_LENS) {
+        std::span<const uint8_t> iv(buf.data() + 100, iv_len);
+        std::span<const uint8_t> aad(buf.data() + 200, aad_len);
+        uint8_t tag[16], ref_tag[16];
+        GCM_SM4_CTX ctx;
+        gcm_sm4_init(&ctx, KEY, iv.data(), iv_len, &GHASH_TBL);
+        gcm_sm4_aad(&ctx, aad.data(), aad_len);
+        gcm_sm4_encrypt(&ctx, buf.data(), len, ref_ct.data());
+        gcm_sm4_tag(&ctx, ref_tag);
+
+        g.seal(iv, aad, std::span<const uint8_t>(buf.data(), len), ct, tag);
+        seal_ok &= memcmp(ct.data(), ref_ct.data(), len) == 0 &&
+                   memcmp(tag, ref_tag, 16) == 0;
+        open_ok &= g.open(iv, aad, std::span<const uint8_t>(ct.data(), len),
+                          tag, pt) &&
+                   memcmp(pt.data(), buf.data(), len) == 0;
+        tag[len % 16] ^= 1;
+        reject_ok &= !g.open(iv, aad,
+                             std::span<const uint8_t>(ct.data(), len), tag,
+                             pt) &&
+                     (len == 0 || pt[0] == 0);
+      }
+    }
+  }
+  printf("加密与标签是否等于 sm4_gcm.c：\t%s\n", tf(seal_ok));
+  printf("解密是否等于原文：\t\t%s\n", tf(open_ok));
+  printf("篡改标签是否被拒绝：\t\t%s\n", tf(reject_ok));
+}
+
+// 单块：C 经函数指针调用 vs 模板内联；多块与 GCM：运行时分派 vs 静态分派
+template <class Backend, class Ghash> static void run_benchmark() {
+  constexpr size_t ITERS = 1 << 20;
+  constexpr size_t BULK = 1 << 20;
+  printf("\n性能对比（%s + %s）\n", Backend::name, Ghash::name);
+  if (!Backend::available() || !Ghash::available()) {
+    printf("当前 CPU 不支持，跳过\n");
+    return;
+  }
+
+  SM4_Key ref;
+  sm4_keyInit(KEY, &ref);
+  volatile EncryptFunc fp = sm4_encrypt_ttable;
+  EncryptFunc encrypt = fp;
+  uint8_t block[16] = {0};
+  double start = now_sec();
+  for (size_t i = 0; i < ITERS; i++) {
+    encrypt(block, &ref, block);
+  }
+  printf("单块 C 函数指针（ttable）：\t%.1f ns/块\n",
+         (now_sec() - start) * 1e9 / ITERS);
+  sm4::cipher<sm4::ttable> tc(std::span<const uint8_t, 16>(KEY, 16));
+  start = now_sec();
+  for (size_t i = 0; i < ITERS; i++) {
+    tc.encrypt_block(block, block);
+  }
+  printf("单块 C++ 内联（ttable）：\t%.1f ns/块\n",
+         (now_sec() - start) * 1e9 / ITERS);
+
+  std::vector<uint8_t> in(BULK, 0x5A), out(BULK + 16);
+  sm4::cipher<Backend> c(std::span<const uint8_t, 16>(KEY, 16));
+  start = now_sec();
+  for (int r = 0; r < 64; r++) {
+    sm4_engine_encrypt_blocks(in.data(), out.data(), BULK / 16, &ref);
+  }
+  printf("多块 C 运行时分派：\t\t%.2f MB/s\n", 64 / (now_sec() - start));
+  start = now_sec();
+  for (int r = 0; r < 64; r++) {
+    c.encrypt(in, out);
+  }
+  printf("多块 C++ 静态分派：\t\t%.2f MB/s\n", 64 / (now_sec() - start));
+
+  static const size_t MSG_LENS[] = {64, 1024, 16384};
+  sm4::gcm<sm4::cipher<Backend>, Ghash> g(
+      std::span<const uint8_t, 16>(KEY, 16));
+  uint8_t iv[12] = {0}, tag[16];
+  for (size_t len : MSG_LENS) {
+    size_t msgs = (64 << 20) / len / 8;
+    start = now_sec();
+    for (size_t m = 0; m < msgs; m++) {
+      GCM_SM4_CTX ctx;
+      gcm_sm4_init(&ctx, KEY, iv, 12, &GHASH_TBL);
+      gcm_sm4_encrypt(&ctx, in.data(), len, out.data());
+      gcm_sm4_tag(&ctx, tag);
+    }
+    double c_time = now_sec() - start;
+    start = now_sec();
+    for (size_t m = 0; m < msgs; m++) {
+      g.seal(iv, {}, std::span<const uint8_t>(in.data(), len), out, tag);
+    }
+    double cpp_time = now_sec() - start;
+    printf("GCM %5zu B：C（GHASH 查表）%.2f MB/s，C++ %.2f MB/s\n", len,
+           msgs * len / 1048576.0 / c_time, msgs * len / 1048576.0 / cpp_time);
+  }
+}
+
+int main() {
+  run_constexpr_test();
+  run_cipher_test<sm4::ttable>();
+  run_cipher_test<sm4::aesni>();
+  run_cipher_test<sm4::avx2>();
+
+  run_gcm_test<sm4::ttable, sm4::ghash_bitwise>();
+  run_gcm_test<sm4::aesni, sm4::ghash_table>();
+  run_gcm_test<sm4::avx2, sm4::ghash_clmul>();
+
+  run_benchmark<sm4::avx2, sm4::ghash_clmul>();
+  return 0;
+}
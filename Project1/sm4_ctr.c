@@ -0,0 +1,216 @@
+#include "sm4_ctr.h"
+#include "sm4_engine.h"
+#include "sm4_stream.h"
+#include "sm4_trace.h"
+
+#include <emmintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline uint32_t load32_be(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void store32_be(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static inline uint64_t load64_be(const uint8_t *p) {
+  return ((uint64_t)load32_be(p) << 32) | load32_be(p + 4);
+}
+
+static inline void store64_be(uint8_t *p, uint64_t v) {
+  store32_be(p, v >> 32);
+  store32_be(p + 4, (uint32_t)v);
+}
+
+// 生成 n 个计数器块：前 12 字节不变，最后 4 字节为大端的 c + i（模 2^32）
+static void ctr32_fill(uint8_t *blocks, size_t n, uint8_t counter[16]) {
+  __m128i prefix = _mm_and_si128(_mm_loadu_si128((const __m128i *)counter),
+                                 _mm_setr_epi32(-1, -1, -1, 0));
+  uint32_t c = load32_be(counter + 12);
+  for (size_t i = 0; i < n; i++) {
+    __m128i low = _mm_slli_si128(
+        _mm_cvtsi32_si128((int)__builtin_bswap32(c + (uint32_t)i)), 12);
+    _mm_storeu_si128((__m128i *)blocks + i, _mm_or_si128(prefix, low));
+  }
+  store32_be(counter + 12, c + (uint32_t)n);
+}
+
+// 生成 n 个计数器块：整个 128 位按大端递增
+static void ctr128_fill(uint8_t *blocks, size_t n, uint8_t counter[16]) {
+  uint64_t hi = load64_be(counter);
+  uint64_t lo = load64_be(counter + 8);
+  for (size_t i = 0; i < n; i++) {
+    _mm_storeu_si128((__m128i *)blocks + i,
+                     _mm_set_epi64x((long long)__builtin_bswap64(lo),
+                                    (long long)__builtin_bswap64(hi)));
+    if (++lo == 0) {
+      hi++;
+    }
+  }
+  store64_be(counter, hi);
+  store64_be(counter + 8, lo);
+}
+
+static void xor_blocks(const uint8_t *in, const uint8_t *ks, uint8_t *out,
+                       size_t nblocks) {
+  for (size_t i = 0; i < nblocks; i++) {
+    __m128i x = _mm_loadu_si128((const __m128i *)in + i);
+    __m128i k = _mm_loadu_si128((const __m128i *)ks + i);
+    _mm_storeu_si128((__m128i *)out + i, _mm_xor_si128(x, k));
+  }
+}
+
+// 大缓冲区路径：预取下一批输入，异或结果用非临时存储写出（out 16 字节对齐）
+static void xor_blocks_stream(const uint8_t *in, const uint8_t *ks,
+                              uint8_t *out, size_t nblocks) {
+  for (size_t off = 0; off < 16 * SM4_CTR_BATCH; off += 64) {
+    _mm_prefetch((const char *)in + 16 * nblocks + off, _MM_HINT_T0);
+  }
+  for (size_t i = 0; i < nblocks; i++) {
+    __m128i x = _mm_loadu_si128((const __m128i *)in + i);
+    __m128i k = _mm_loadu_si128((const __m128i *)ks + i);
+    _mm_stream_si128((__m128i *)out + i, _mm_xor_si128(x, k));
+  }
+}
+
+// 每批生成 SM4_CTR_BATCH 个计数器块，整批送入多块后端得到密钥流。
+// may_stream 且数据量达到 sm4_stream_threshold() 时输出绕过缓存
+static void ctr_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                       uint8_t counter[16], const SM4_Key *key, int ctr_bits,
+                       int may_stream) {
+  uint8_t ctrs[16 * SM4_CTR_BATCH];
+  uint8_t ks[16 * SM4_CTR_BATCH];
+  int stream = may_stream && nblocks * 16 >= sm4_stream_threshold() &&
+               ((uintptr_t)out & 15) == 0;
+  SM4_TRACE_BEGIN(SM4_TRACE_CTR, 16 * nblocks, nblocks);
+
+  while (nblocks > 0) {
+    size_t n = nblocks < SM4_CTR_BATCH ? nblocks : SM4_CTR_BATCH;
+    if (ctr_bits == 32) {
+      ctr32_fill(ctrs, n, counter);
+    } else {
+      ctr128_fill(ctrs, n, counter);
+    }
+    sm4_engine_get(n)->encrypt_blocks(ctrs, ks, n, key);
+    if (stream) {
+      xor_blocks_stream(in, ks, out, n);
+    } else {
+      xor_blocks(in, ks, out, n);
+    }
+    in += 16 * n;
+    out += 16 * n;
+    nblocks -= n;
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+  SM4_TRACE_END();
+}
+
+void sm4_ctr32_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                      uint8_t counter[16], const SM4_Key *key) {
+  ctr_blocks(in, out, nblocks, counter, key, 32, 1);
+}
+
+void sm4_ctr32_blocks_cached(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             uint8_t counter[16], const SM4_Key *key) {
+  ctr_blocks(in, out, nblocks, counter, key, 32, 0);
+}
+
+void sm4_ctr128_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                       uint8_t counter[16], const SM4_Key *key) {
+  ctr_blocks(in, out, nblocks, counter, key, 128, 1);
+}
+
+// 计数器加 n：ctr32 只在最后 4 字节内回绕，ctr128 整块进位
+static void ctr_add(uint8_t counter[16], uint64_t n, int ctr_bits) {
+  if (ctr_bits == 32) {
+    store32_be(counter + 12, load32_be(counter + 12) + (uint32_t)n);
+  } else {
+    uint64_t hi = load64_be(counter);
+    uint64_t lo = load64_be(counter + 8);
+    uint64_t sum = lo + n;
+    if (sum < lo) {
+      hi++;
+    }
+    store64_be(counter, hi);
+    store64_be(counter + 8, sum);
+  }
+}
+
+// 由初始计数器直接定位到字节偏移 offset：计数器跳到 offset / 16，
+// 起点不对齐时预先生成该块的密钥流并跳过前 offset % 16 字节
+static void ctr_seek(const SM4_Key *key, const uint8_t iv[16], int ctr_bits,
+                     uint64_t offset, uint8_t counter[16], uint8_t ks[16],
+                     size_t *ks_pos) {
+  static const uint8_t ZERO[16] = {0};
+  memcpy(counter, iv, 16);
+  ctr_add(counter, offset / 16, ctr_bits);
+  *ks_pos = 16;
+  if (offset % 16) {
+    ctr_blocks(ZERO, ks, 1, counter, key, ctr_bits, 1);
+    *ks_pos = offset % 16;
+  }
+}
+
+// 流式处理：先用完剩余密钥流，再整批处理完整分组，最后不足一块的部分
+// 生成一整块密钥流并把剩余部分留在 ks 中
+static void ctr_crypt(const SM4_Key *key, uint8_t counter[16], uint8_t ks[16],
+                      size_t *ks_pos, int ctr_bits, const uint8_t *in,
+                      uint8_t *out, size_t len) {
+  while (len > 0 && *ks_pos < 16) {
+    *out++ = *in++ ^ ks[(*ks_pos)++];
+    len--;
+  }
+
+  size_t nblocks = len / 16;
+  ctr_blocks(in, out, nblocks, counter, key, ctr_bits, 1);
+  in += 16 * nblocks;
+  out += 16 * nblocks;
+  len -= 16 * nblocks;
+
+  if (len > 0) {
+    static const uint8_t ZERO[16] = {0};
+    ctr_blocks(ZERO, ks, 1, counter, key, ctr_bits, 1);
+    for (size_t i = 0; i < len; i++) {
+      out[i] = in[i] ^ ks[i];
+    }
+    *ks_pos = len;
+  }
+}
+
+void sm4_ctr_init(SM4_CTR_CTX *ctx, const uint8_t *key, const uint8_t iv[16],
+                  int ctr_bits) {
+  sm4_keyInit(key, &ctx->key);
+  memcpy(ctx->counter, iv, 16);
+  memset(ctx->ks, 0, 16);
+  ctx->ks_pos = 16;
+  ctx->ctr_bits = (ctr_bits == 32) ? 32 : 128;
+}
+
+void sm4_ctr_update(SM4_CTR_CTX *ctx, const uint8_t *in, uint8_t *out,
+                    size_t len) {
+  ctr_crypt(&ctx->key, ctx->counter, ctx->ks, &ctx->ks_pos, ctx->ctr_bits, in,
+            out, len);
+}
+
+void sm4_ctr_seek(SM4_CTR_CTX *ctx, const uint8_t iv[16], uint64_t offset) {
+  ctr_seek(&ctx->key, iv, ctx->ctr_bits, offset, ctx->counter, ctx->ks,
+           &ctx->ks_pos);
+}
+
+void sm4_ctr_range(const SM4_Key *key, const uint8_t iv[16], int ctr_bits,
+                   uint64_t offset, const uint8_t *in, uint8_t *out,
+                   size_t len) {
+  uint8_t counter[16], ks[16];
+  size_t ks_pos;
+  ctr_bits = (ctr_bits == 32) ? 32 : 128;
+  ctr_seek(key, iv, ctr_bits, offset, counter, ks, &ks_pos);
+  ctr_crypt(key, counter, ks, &ks_pos, ctr_bits, in, out, len);
+}
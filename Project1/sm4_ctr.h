@@ -0,0 +1,48 @@
+#ifndef SM4_CTR_H
+#define SM4_CTR_H
+
+#include "sm4.h"
+
+// 每批生成的计数器块数，整批交给多块后端
+#define SM4_CTR_BATCH 64
+
+// CTR 上下文
+typedef struct {
+  SM4_Key key;
+  uint8_t counter[16]; // 下一个待加密的计数器块
+  uint8_t ks[16];      // 上次调用剩余的密钥流
+  size_t ks_pos;       // ks 中已使用的字节数，16 表示没有剩余
+  int ctr_bits;        // 计数器宽度：32（只递增最后 4 字节）或 128
+} SM4_CTR_CTX;
+
+// 初始化：iv 为初始计数器块，ctr_bits 取 32 或 128
+void sm4_ctr_init(SM4_CTR_CTX *ctx, const uint8_t *key, const uint8_t iv[16],
+                  int ctr_bits);
+
+// 加密/解密任意长度数据，不足一块的密钥流留到下次调用继续使用
+void sm4_ctr_update(SM4_CTR_CTX *ctx, const uint8_t *in, uint8_t *out,
+                    size_t len);
+
+// 定位到相对 iv 的字节偏移 offset，之后的 update 从该位置继续，
+// 计算量与 offset 无关（iv 为 init 时的初始计数器块）
+void sm4_ctr_seek(SM4_CTR_CTX *ctx, const uint8_t iv[16], uint64_t offset);
+
+// 随机访问：in/out 为数据流中 [offset, offset + len) 这一段，
+// 直接由 iv 计算起始计数器，起点可以不按 16 字节对齐
+void sm4_ctr_range(const SM4_Key *key, const uint8_t iv[16], int ctr_bits,
+                   uint64_t offset, const uint8_t *in, uint8_t *out,
+                   size_t len);
+
+// 底层接口：对 nblocks 个完整分组做 CTR，counter 更新为下一个计数器块。
+// ctr32 只在最后 4 字节内递增（与 GCM 的 inc32 一致），ctr128 整块递增
+void sm4_ctr32_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                      uint8_t counter[16], const SM4_Key *key);
+void sm4_ctr128_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                       uint8_t counter[16], const SM4_Key *key);
+
+// 同 sm4_ctr32_blocks，但输出总是普通存储、留在缓存中。GCTR 写出密文后
+// 马上要对它做 GHASH，非临时存储会让 GHASH 从内存重新读回
+void sm4_ctr32_blocks_cached(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             uint8_t counter[16], const SM4_Key *key);
+
+#endif
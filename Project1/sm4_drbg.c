@@ -0,0 +1,291 @@
+#include "sm4_drbg.h"
+#include "sm4_engine.h"
+#include "sm4_trace.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/random.h>
+
+// 派生函数的输入片段，按顺序拼接
+typedef struct {
+  const uint8_t *p;
+  size_t len;
+} DF_INPUT;
+
+// BCC（即 CBC-MAC）的增量计算，输入可以分多次送入
+typedef struct {
+  const SM4_Key *key;
+  uint8_t x[16];
+  uint8_t blk[16];
+  size_t n; // blk 中已有的字节数
+} DF_BCC;
+
+static void bcc_update(DF_BCC *b, const uint8_t *p, size_t len) {
+  SM4_BlocksFunc encrypt = sm4_engine_get(1)->encrypt_blocks;
+  while (len > 0) {
+    size_t take = 16 - b->n < len ? 16 - b->n : len;
+    memcpy(b->blk + b->n, p, take);
+    b->n += take;
+    p += take;
+    len -= take;
+    if (b->n == 16) {
+      for (int i = 0; i < 16; i++) {
+        b->x[i] ^= b->blk[i];
+      }
+      encrypt(b->x, b->x, 1, b->key);
+      b->n = 0;
+    }
+  }
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+// Block_Cipher_df：把任意长度的输入压缩成 SM4_DRBG_SEED_LEN 字节。
+// S = L || N || input || 0x80 || 补零，先用固定密钥 0x00..0x0F 对 IV_i || S
+// 做 BCC 得到临时密钥与 X，再用它们按 OFB 方式输出
+static void block_cipher_df(const DF_INPUT *in, size_t nin,
+                            uint8_t out[SM4_DRBG_SEED_LEN]) {
+  static const uint8_t K0[16] = {0, 1, 2,  3,  4,  5,  6,  7,
+                                 8, 9, 10, 11, 12, 13, 14, 15};
+  static const uint8_t PAD[16] = {0x80};
+  SM4_Key key;
+  uint8_t hdr[8], temp[SM4_DRBG_SEED_LEN];
+  size_t total = 0;
+
+  for (size_t i = 0; i < nin; i++) {
+    total += in[i].len;
+  }
+  put_be32(hdr, (uint32_t)total);
+  put_be32(hdr + 4, SM4_DRBG_SEED_LEN);
+  sm4_keyInit(K0, &key);
+
+  for (uint32_t i = 0; i < SM4_DRBG_SEED_LEN / 16; i++) {
+    DF_BCC b = {.key = &key};
+    uint8_t iv[16] = {0};
+    put_be32(iv, i);
+    bcc_update(&b, iv, 16);
+    bcc_update(&b, hdr, 8);
+    for (size_t j = 0; j < nin; j++) {
+      bcc_update(&b, in[j].p, in[j].len);
+    }
+    bcc_update(&b, PAD, 1);
+    if (b.n != 0) {
+      bcc_update(&b, PAD + 1, 16 - b.n);
+    }
+    memcpy(temp + 16 * i, b.x, 16);
+  }
+
+  SM4_BlocksFunc encrypt = sm4_engine_get(1)->encrypt_blocks;
+  sm4_keyInit(temp, &key);
+  for (int i = 0; i < SM4_DRBG_SEED_LEN / 16; i++) {
+    encrypt(temp + 16, temp + 16, 1, &key);
+    memcpy(out + 16 * i, temp + 16, 16);
+  }
+  memset(&key, 0, sizeof(key));
+  memset(temp, 0, sizeof(temp));
+}
+
+// 从 v 之后的计数器开始连续写出 nblocks 个计数器块（128 位大端递增），
+// v 更新为最后一个
+static void ctr_fill(uint8_t v[16], uint8_t *out, size_t nblocks) {
+  uint64_t hi = 0, lo = 0;
+  for (int i = 0; i < 8; i++) {
+    hi = hi << 8 | v[i];
+    lo = lo << 8 | v[8 + i];
+  }
+  for (size_t b = 0; b < nblocks; b++) {
+    hi += ++lo == 0;
+    uint64_t h = __builtin_bswap64(hi), l = __builtin_bswap64(lo);
+    memcpy(out + 16 * b, &h, 8);
+    memcpy(out + 16 * b + 8, &l, 8);
+  }
+  if (nblocks > 0) {
+    memcpy(v, out + 16 * (nblocks - 1), 16);
+  }
+}
+
+// CTR_DRBG_Update：用 provided 更新密钥与 V
+static void drbg_update(SM4_DRBG *drbg,
+                        const uint8_t provided[SM4_DRBG_SEED_LEN]) {
+  uint8_t temp[SM4_DRBG_SEED_LEN];
+  ctr_fill(drbg->v, temp, SM4_DRBG_SEED_LEN / 16);
+  sm4_engine_get(2)->encrypt_blocks(temp, temp, SM4_DRBG_SEED_LEN / 16,
+                                    &drbg->key);
+  for (int i = 0; i < SM4_DRBG_SEED_LEN; i++) {
+    temp[i] ^= provided[i];
+  }
+  sm4_keyInit(temp, &drbg->key);
+  memcpy(drbg->v, temp + 16, 16);
+  memset(temp, 0, sizeof(temp));
+}
+
+// 一次标准请求（不超过 SM4_DRBG_MAX_REQUEST 字节）：计数器块直接写进 out
+// 后原地整批加密，最后按附加输入更新状态
+static void drbg_request(SM4_DRBG *drbg, uint8_t *out, size_t len,
+                         const uint8_t adin[SM4_DRBG_SEED_LEN]) {
+  SM4_TRACE_BEGIN(SM4_TRACE_DRBG, len, (len + 15) / 16);
+  size_t nblocks = len / 16, rem = len % 16;
+  if (nblocks > 0) {
+    ctr_fill(drbg->v, out, nblocks);
+    sm4_engine_get(nblocks)->encrypt_blocks(out, out, nblocks, &drbg->key);
+  }
+  if (rem > 0) {
+    uint8_t last[16];
+    ctr_fill(drbg->v, last, 1);
+    sm4_engine_get(1)->encrypt_blocks(last, last, 1, &drbg->key);
+    memcpy(out + 16 * nblocks, last, rem);
+    memset(last, 0, sizeof(last));
+  }
+  drbg_update(drbg, adin);
+  drbg->reseed_counter++;
+  SM4_TRACE_END();
+}
+
+static void drbg_discard_buffer(SM4_DRBG *drbg) {
+  memset(drbg->buf, 0, sizeof(drbg->buf));
+  drbg->buf_pos = SM4_DRBG_BUFFER;
+}
+
+int sm4_drbg_instantiate(SM4_DRBG *drbg, const uint8_t *entropy,
+                         size_t entropy_len, const uint8_t *nonce,
+                         size_t nonce_len, const uint8_t *pers,
+                         size_t pers_len) {
+  static const uint8_t ZERO[16] = {0};
+  if (entropy == NULL || entropy_len < 16) {
+    return SM4_DRBG_ERROR;
+  }
+  DF_INPUT in[3] = {
+      {entropy, entropy_len}, {nonce, nonce_len}, {pers, pers_len}};
+  uint8_t seed[SM4_DRBG_SEED_LEN];
+  block_cipher_df(in, 3, seed);
+
+  sm4_keyInit(ZERO, &drbg->key);
+  memset(drbg->v, 0, 16);
+  drbg_update(drbg, seed);
+  drbg->reseed_counter = 1;
+  drbg_discard_buffer(drbg);
+  memset(seed, 0, sizeof(seed));
+  return SM4_DRBG_OK;
+}
+
+int sm4_drbg_reseed(SM4_DRBG *drbg, const uint8_t *entropy,
+                    size_t entropy_len, const uint8_t *adin, size_t adin_len) {
+  if (entropy == NULL || entropy_len < 16) {
+    return SM4_DRBG_ERROR;
+  }
+  DF_INPUT in[2] = {{entropy, entropy_len}, {adin, adin_len}};
+  uint8_t seed[SM4_DRBG_SEED_LEN];
+  block_cipher_df(in, 2, seed);
+
+  drbg_update(drbg, seed);
+  drbg->reseed_counter = 1;
+  drbg_discard_buffer(drbg);
+  memset(seed, 0, sizeof(seed));
+  return SM4_DRBG_OK;
+}
+
+int sm4_drbg_generate(SM4_DRBG *drbg, uint8_t *out, size_t len,
+                      const uint8_t *adin, size_t adin_len) {
+  // 整个调用需要的请求数一次检查，避免输出到一半才要求重播种
+  uint64_t requests = (len + SM4_DRBG_MAX_REQUEST - 1) / SM4_DRBG_MAX_REQUEST;
+  if (drbg->reseed_counter + requests - 1 > SM4_DRBG_RESEED_INTERVAL) {
+    return SM4_DRBG_NEED_RESEED;
+  }
+
+  uint8_t add[SM4_DRBG_SEED_LEN] = {0};
+  if (adin_len > 0) {
+    DF_INPUT in = {adin, adin_len};
+    block_cipher_df(&in, 1, add);
+  }
+  while (len > 0) {
+    size_t n = len < SM4_DRBG_MAX_REQUEST ? len : SM4_DRBG_MAX_REQUEST;
+    if (adin_len > 0) {
+      drbg_update(drbg, add);
+    }
+    drbg_request(drbg, out, n, add);
+    out += n;
+    len -= n;
+  }
+  return SM4_DRBG_OK;
+}
+
+int sm4_drbg_bytes(SM4_DRBG *drbg, uint8_t *out, size_t len) {
+  if (len >= SM4_DRBG_BUFFER) {
+    return sm4_drbg_generate(drbg, out, len, NULL, 0);
+  }
+  // 取走的字节立即从缓冲区清除，之后泄露状态也推不出已经给出的输出
+  size_t avail = SM4_DRBG_BUFFER - drbg->buf_pos;
+  if (len > avail) {
+    memcpy(out, drbg->buf + drbg->buf_pos, avail);
+    int ret = sm4_drbg_generate(drbg, drbg->buf, SM4_DRBG_BUFFER, NULL, 0);
+    if (ret != SM4_DRBG_OK) {
+      drbg_discard_buffer(drbg);
+      return ret;
+    }
+    drbg->buf_pos = 0;
+    out += avail;
+    len -= avail;
+  }
+  memcpy(out, drbg->buf + drbg->buf_pos, len);
+  memset(drbg->buf + drbg->buf_pos, 0, len);
+  drbg->buf_pos += len;
+  return SM4_DRBG_OK;
+}
+
+void sm4_drbg_clear(SM4_DRBG *drbg) { memset(drbg, 0, sizeof(*drbg)); }
+
+// 每线程实例。fork 后子进程会复制父进程的状态，用代数识别并重新实例化
+static __thread SM4_DRBG tls_drbg;
+static __thread unsigned long tls_gen; // 实例化时的 fork 代数加一，0 为未实例化
+static unsigned long fork_gen;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void on_fork_child(void) { fork_gen++; }
+
+static void register_atfork(void) {
+  pthread_atfork(NULL, NULL, on_fork_child);
+}
+
+static int system_entropy(uint8_t *out, size_t len) {
+  while (len > 0) {
+    ssize_t n = getrandom(out, len, 0);
+    if (n <= 0) {
+      return SM4_DRBG_ERROR;
+    }
+    out += n;
+    len -= (size_t)n;
+  }
+  return SM4_DRBG_OK;
+}
+
+int sm4_random_bytes(uint8_t *out, size_t len) {
+  uint8_t entropy[48]; // 32 字节熵输入 + 16 字节 nonce
+  pthread_once(&atfork_once, register_atfork);
+
+  if (tls_gen != fork_gen + 1) {
+    // 个性化串取实例地址，区分同一进程内的各线程
+    const SM4_DRBG *self = &tls_drbg;
+    if (system_entropy(entropy, sizeof(entropy)) != SM4_DRBG_OK ||
+        sm4_drbg_instantiate(&tls_drbg, entropy, 32, entropy + 32, 16,
+                             (const uint8_t *)&self, sizeof(self)) != 0) {
+      return SM4_DRBG_ERROR;
+    }
+    tls_gen = fork_gen + 1;
+  }
+
+  int ret = sm4_drbg_bytes(&tls_drbg, out, len);
+  if (ret == SM4_DRBG_NEED_RESEED) {
+    if (system_entropy(entropy, 32) != SM4_DRBG_OK) {
+      return SM4_DRBG_ERROR;
+    }
+    sm4_drbg_reseed(&tls_drbg, entropy, 32, NULL, 0);
+    ret = sm4_drbg_bytes(&tls_drbg, out, len);
+  }
+  memset(entropy, 0, sizeof(entropy));
+  return ret;
+}
@@ -0,0 +1,51 @@
+#ifndef SM4_DRBG_H
+#define SM4_DRBG_H
+
+#include "sm4.h"
+
+// SM4_CTR_DRBG（GM/T 0105，结构同 NIST SP 800-90A 的 CTR_DRBG，使用派生函数）
+#define SM4_DRBG_SEED_LEN 32               // 种子长度：密钥 16 字节 + V 16 字节
+#define SM4_DRBG_MAX_REQUEST (64 * 1024)   // 单次请求的最大字节数
+#define SM4_DRBG_RESEED_INTERVAL (1 << 20) // 两次重播种之间的最多请求数
+#define SM4_DRBG_BUFFER 4096               // sm4_drbg_bytes 预生成的字节数
+
+// 返回值
+#define SM4_DRBG_OK 0
+#define SM4_DRBG_ERROR -1      // 参数非法或熵源失败
+#define SM4_DRBG_NEED_RESEED 1 // 请求数已到上限，需先重播种
+
+typedef struct {
+  SM4_Key key;
+  uint8_t v[16];
+  uint64_t reseed_counter;
+  uint8_t buf[SM4_DRBG_BUFFER]; // 预生成的输出，供小请求使用
+  size_t buf_pos;               // buf 中已取走的字节数
+} SM4_DRBG;
+
+// 实例化：entropy 至少 16 字节，nonce 与个性化串可以为空
+int sm4_drbg_instantiate(SM4_DRBG *drbg, const uint8_t *entropy,
+                         size_t entropy_len, const uint8_t *nonce,
+                         size_t nonce_len, const uint8_t *pers,
+                         size_t pers_len);
+
+// 重播种：entropy 至少 16 字节，附加输入可以为空。同时丢弃预生成的输出
+int sm4_drbg_reseed(SM4_DRBG *drbg, const uint8_t *entropy,
+                    size_t entropy_len, const uint8_t *adin, size_t adin_len);
+
+// 生成任意长度的随机字节。按 SM4_DRBG_MAX_REQUEST 拆成多次标准请求，
+// 每次请求的计数器块整批交给多块后端加密，请求之间按标准更新密钥与 V
+int sm4_drbg_generate(SM4_DRBG *drbg, uint8_t *out, size_t len,
+                      const uint8_t *adin, size_t adin_len);
+
+// 带缓冲的生成：小请求从预生成的 SM4_DRBG_BUFFER 字节中取，取完再整块
+// 补充，大请求直接走 sm4_drbg_generate。适合频繁生成 nonce 等短数据
+int sm4_drbg_bytes(SM4_DRBG *drbg, uint8_t *out, size_t len);
+
+// 清除内部状态
+void sm4_drbg_clear(SM4_DRBG *drbg);
+
+// 每线程实例：首次使用（以及 fork 之后）从系统熵源实例化，
+// 请求数到上限时自动重播种
+int sm4_random_bytes(uint8_t *out, size_t len);
+
+#endif
@@ -0,0 +1,247 @@
+#include "sm4_engine.h"
+#include "sm4_aesni.h"
+#include "sm4_avx2.h"
+#include "sm4_bitslice.h"
+#include "sm4_gather.h"
+#include "sm4_ttable.h"
+
+#include <cpuid.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 位切片的轮密钥按位广播到所有分组，不支持每个分组使用不同密钥
+static const SM4_ENGINE ENGINES[] = {
+    {"ref", 0, sm4_encrypt_blocks, sm4_decrypt_blocks, sm4_encrypt_multikey,
+     sm4_decrypt_multikey},
+    {"ttable", 0, sm4_encrypt_blocks_ttable, sm4_decrypt_blocks_ttable,
+     sm4_encrypt_multikey_ttable, sm4_decrypt_multikey_ttable},
+    {"ttable1k", 0, sm4_encrypt_blocks_ttable1k, sm4_decrypt_blocks_ttable1k,
+     sm4_encrypt_multikey_ttable1k, sm4_decrypt_multikey_ttable1k},
+    {"sbox", 0, sm4_encrypt_blocks_sbox, sm4_decrypt_blocks_sbox,
+     sm4_encrypt_multikey_sbox, sm4_decrypt_multikey_sbox},
+    {"ttable4k", 0, sm4_encrypt_blocks_ttable4k, sm4_decrypt_blocks_ttable4k,
+     sm4_encrypt_multikey_ttable4k, sm4_decrypt_multikey_ttable4k},
+    {"aesni", SM4_CPU_AESNI | SM4_CPU_SSSE3 | SM4_CPU_SSE41,
+     sm4_encrypt_blocks_aesni, sm4_decrypt_blocks_aesni,
+     sm4_encrypt_multikey_aesni, sm4_decrypt_multikey_aesni},
+    {"gather", SM4_CPU_AVX2, sm4_encrypt_blocks_gather,
+     sm4_decrypt_blocks_gather, sm4_encrypt_multikey_gather,
+     sm4_decrypt_multikey_gather},
+    {"avx2", SM4_CPU_AESNI | SM4_CPU_SSSE3 | SM4_CPU_SSE41 | SM4_CPU_AVX2,
+     sm4_encrypt_blocks_avx2, sm4_decrypt_blocks_avx2,
+     sm4_encrypt_multikey_avx2, sm4_decrypt_multikey_avx2},
+    {"bitslice", SM4_CPU_AVX2, sm4_encrypt_blocks_bs, sm4_decrypt_blocks_bs,
+     NULL, NULL},
+};
+
+#define ENGINE_COUNT (sizeof(ENGINES) / sizeof(ENGINES[0]))
+
+// 校准时各档位使用的块数
+static const size_t CALIBRATE_BLOCKS[SM4_SIZE_CLASSES] = {1, 32, 1024};
+
+static const SM4_ENGINE *selected[SM4_SIZE_CLASSES];
+static pthread_once_t calibrate_once = PTHREAD_ONCE_INIT;
+
+static uint64_t xgetbv0(void) {
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((uint64_t)edx << 32) | eax;
+}
+
+static unsigned probe_features(void) {
+  unsigned eax, ebx, ecx, edx;
+  unsigned features = 0;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return 0;
+  }
+  if (ecx & bit_SSSE3)
+    features |= SM4_CPU_SSSE3;
+  if (ecx & bit_SSE4_1)
+    features |= SM4_CPU_SSE41;
+  if (ecx & bit_AES)
+    features |= SM4_CPU_AESNI;
+
+  // AVX 系列还要求操作系统保存 XMM/YMM 状态
+  int ymm_ok = (ecx & bit_OSXSAVE) && (ecx & bit_AVX) && (xgetbv0() & 6) == 6;
+  if (ymm_ok && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    if (ebx & bit_AVX2)
+      features |= SM4_CPU_AVX2;
+    if (ecx & bit_VAES)
+      features |= SM4_CPU_VAES;
+  }
+  return features;
+}
+
+unsigned sm4_cpu_features(void) {
+  static int probed = 0;
+  static unsigned features;
+  if (!__atomic_load_n(&probed, __ATOMIC_ACQUIRE)) {
+    features = probe_features();
+    __atomic_store_n(&probed, 1, __ATOMIC_RELEASE);
+  }
+  return features;
+}
+
+const SM4_ENGINE *sm4_engine_list(size_t *count) {
+  *count = ENGINE_COUNT;
+  return ENGINES;
+}
+
+int sm4_engine_available(const SM4_ENGINE *engine) {
+  return engine != NULL &&
+         (sm4_cpu_features() & engine->required) == engine->required;
+}
+
+const SM4_ENGINE *sm4_engine_find(const char *name) {
+  for (size_t i = 0; i < ENGINE_COUNT; i++) {
+    if (strcmp(ENGINES[i].name, name) == 0) {
+      return &ENGINES[i];
+    }
+  }
+  return NULL;
+}
+
+SM4_SIZE_CLASS sm4_size_class(size_t nblocks) {
+  if (nblocks <= 1)
+    return SM4_SIZE_SINGLE;
+  if (nblocks < 256)
+    return SM4_SIZE_SMALL;
+  return SM4_SIZE_BULK;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 每个后端在每个档位重复若干次，取三次试验中的最短时间
+static double time_engine(const SM4_ENGINE *engine, size_t nblocks,
+                          uint8_t *buf, const SM4_Key *key) {
+  size_t reps = 2048 / nblocks + 1;
+  double best = 0;
+  engine->encrypt_blocks(buf, buf, nblocks, key); // 预热
+  for (int trial = 0; trial < 3; trial++) {
+    double start = now_sec();
+    for (size_t r = 0; r < reps; r++) {
+      engine->encrypt_blocks(buf, buf, nblocks, key);
+    }
+    double elapsed = now_sec() - start;
+    if (trial == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best / (double)(reps * nblocks);
+}
+
+// 计时结果写入调用方的局部数组，不直接改动共享的 selected
+static void calibrate_into(const SM4_ENGINE *out[SM4_SIZE_CLASSES]) {
+  static const uint8_t key_bytes[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB,
+                                        0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98,
+                                        0x76, 0x54, 0x32, 0x10};
+  SM4_Key key;
+  sm4_keyInit(key_bytes, &key);
+
+  // 环境变量强制指定后端，跳过计时
+  const char *forced = getenv("SM4_ENGINE");
+  const SM4_ENGINE *force = forced ? sm4_engine_find(forced) : NULL;
+  if (force && sm4_engine_available(force)) {
+    for (int c = 0; c < SM4_SIZE_CLASSES; c++) {
+      out[c] = force;
+    }
+    return;
+  }
+
+  uint8_t *buf = calloc(CALIBRATE_BLOCKS[SM4_SIZE_BULK], 16);
+  for (int c = 0; c < SM4_SIZE_CLASSES; c++) {
+    const SM4_ENGINE *best = &ENGINES[0];
+    double best_time = 0;
+    for (size_t i = 0; i < ENGINE_COUNT; i++) {
+      if (!sm4_engine_available(&ENGINES[i]) || buf == NULL) {
+        continue;
+      }
+      double t = time_engine(&ENGINES[i], CALIBRATE_BLOCKS[c], buf, &key);
+      if (best_time == 0 || t < best_time) {
+        best = &ENGINES[i];
+        best_time = t;
+      }
+    }
+    out[c] = best;
+  }
+  free(buf);
+}
+
+// 各档位逐个以 release 发布，与 sm4_engine_get 的 acquire 读配对；重新校准
+// 期间并发的读者看到的是新旧选择之一，都是可用的后端
+static void calibrate_publish(void) {
+  const SM4_ENGINE *next[SM4_SIZE_CLASSES];
+  calibrate_into(next);
+  for (int c = 0; c < SM4_SIZE_CLASSES; c++) {
+    __atomic_store_n(&selected[c], next[c], __ATOMIC_RELEASE);
+  }
+}
+
+// 从未校准过时交给 pthread_once 完成首次校准（与并发的 sm4_engine_get
+// 只计时一次），之后的调用才重新计时
+void sm4_engine_calibrate(void) {
+  if (__atomic_load_n(&selected[SM4_SIZE_CLASSES - 1], __ATOMIC_ACQUIRE) ==
+      NULL) {
+    pthread_once(&calibrate_once, calibrate_publish);
+    return;
+  }
+  calibrate_publish();
+}
+
+const SM4_ENGINE *sm4_engine_get(size_t nblocks) {
+  pthread_once(&calibrate_once, calibrate_publish);
+  return __atomic_load_n(&selected[sm4_size_class(nblocks)], __ATOMIC_ACQUIRE);
+}
+
+const SM4_ENGINE *sm4_engine_get_multikey(size_t nblocks) {
+  const SM4_ENGINE *engine = sm4_engine_get(nblocks);
+  if (engine->encrypt_multikey != NULL) {
+    return engine;
+  }
+  for (size_t i = ENGINE_COUNT; i-- > 0;) {
+    if (ENGINES[i].encrypt_multikey != NULL &&
+        sm4_engine_available(&ENGINES[i])) {
+      return &ENGINES[i];
+    }
+  }
+  return &ENGINES[0];
+}
+
+void sm4_engine_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key) {
+  sm4_engine_get(nblocks)->encrypt_blocks(in, out, nblocks, key);
+}
+
+void sm4_engine_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key) {
+  sm4_engine_get(nblocks)->decrypt_blocks(in, out, nblocks, key);
+}
+
+void sm4_engine_encrypt_multikey(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys) {
+  sm4_engine_get_multikey(nblocks)->encrypt_multikey(in, out, nblocks, keys);
+}
+
+void sm4_engine_decrypt_multikey(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys) {
+  sm4_engine_get_multikey(nblocks)->decrypt_multikey(in, out, nblocks, keys);
+}
+
+void sm4_keyInit_batch(const uint8_t *const *keys, size_t n, SM4_Key *out) {
+  if (sm4_engine_available(sm4_engine_find("avx2"))) {
+    sm4_keyInit_batch_avx2(keys, n, out);
+  } else if (sm4_engine_available(sm4_engine_find("aesni"))) {
+    sm4_keyInit_batch_aesni(keys, n, out);
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      sm4_keyInit(keys[i], &out[i]);
+    }
+  }
+}
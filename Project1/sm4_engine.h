@@ -0,0 +1,77 @@
+#ifndef SM4_ENGINE_H
+#define SM4_ENGINE_H
+
+#include "sm4.h"
+
+// CPU 特性位（cpuid 探测结果，含操作系统对 YMM 状态的支持）
+#define SM4_CPU_SSSE3 (1u << 0)
+#define SM4_CPU_SSE41 (1u << 1)
+#define SM4_CPU_AESNI (1u << 2)
+#define SM4_CPU_AVX2 (1u << 3)
+#define SM4_CPU_VAES (1u << 4)
+
+typedef void (*SM4_BlocksFunc)(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key);
+
+// 多密钥：第 i 个分组使用 keys[i]
+typedef void (*SM4_MultiKeyFunc)(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys);
+
+// SM4 后端虚表
+typedef struct {
+  const char *name;                  // 后端名，可用 SM4_ENGINE 环境变量强制指定
+  unsigned required;                 // 运行所需的 CPU 特性
+  SM4_BlocksFunc encrypt_blocks;     // 多块加密
+  SM4_BlocksFunc decrypt_blocks;     // 多块解密
+  SM4_MultiKeyFunc encrypt_multikey; // 多密钥加密，NULL 表示不支持
+  SM4_MultiKeyFunc decrypt_multikey; // 多密钥解密
+} SM4_ENGINE;
+
+// 按数据量划分的档位，每档独立选择最快的后端
+typedef enum {
+  SM4_SIZE_SINGLE = 0, // 1 块
+  SM4_SIZE_SMALL,      // 2 ~ 255 块
+  SM4_SIZE_BULK,       // 256 块及以上
+  SM4_SIZE_CLASSES
+} SM4_SIZE_CLASS;
+
+// 探测 CPU 特性（结果缓存）
+unsigned sm4_cpu_features(void);
+
+// 所有编译进来的后端（不论当前 CPU 是否支持）
+const SM4_ENGINE *sm4_engine_list(size_t *count);
+
+// 当前 CPU 是否能运行该后端
+int sm4_engine_available(const SM4_ENGINE *engine);
+
+// 按名字查找后端，不存在返回 NULL
+const SM4_ENGINE *sm4_engine_find(const char *name);
+
+// 数据量所属档位
+SM4_SIZE_CLASS sm4_size_class(size_t nblocks);
+
+// 返回处理 nblocks 个分组最快的可用后端；首次调用时自动校准
+const SM4_ENGINE *sm4_engine_get(size_t nblocks);
+
+// 重新计时校准各档位的后端选择
+void sm4_engine_calibrate(void);
+
+// 处理 nblocks 个多密钥分组的后端：档位选中的后端支持多密钥时用它，
+// 否则取列表中最靠后（向量宽度最大）的可用且支持多密钥的后端
+const SM4_ENGINE *sm4_engine_get_multikey(size_t nblocks);
+
+// 便捷接口：按数据量自动选择后端
+void sm4_engine_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key);
+void sm4_engine_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key);
+void sm4_engine_encrypt_multikey(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys);
+void sm4_engine_decrypt_multikey(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys);
+
+// 批量密钥扩展：out[i] 与 sm4_keyInit(keys[i], &out[i]) 的结果相同。
+// 按 CPU 特性选择 AVX2（16/8 路）、AES-NI（4 路）或逐个标量扩展
+void sm4_keyInit_batch(const uint8_t *const *keys, size_t n, SM4_Key *out);
+
+#endif
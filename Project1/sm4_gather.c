@@ -0,0 +1,254 @@
+#include "sm4_gather.h"
+#include "sm4_trace.h"
+#include "sm4_ttable.h"
+
+#include <immintrin.h>
+
+#define MM256_PACK0_EPI32(a, b, c, d)                                          \
+  _mm256_unpacklo_epi64(_mm256_unpacklo_epi32(a, b),                           \
+                        _mm256_unpacklo_epi32(c, d))
+#define MM256_PACK1_EPI32(a, b, c, d)                                          \
+  _mm256_unpackhi_epi64(_mm256_unpacklo_epi32(a, b),                           \
+                        _mm256_unpacklo_epi32(c, d))
+#define MM256_PACK2_EPI32(a, b, c, d)                                          \
+  _mm256_unpacklo_epi64(_mm256_unpackhi_epi32(a, b),                           \
+                        _mm256_unpackhi_epi32(c, d))
+#define MM256_PACK3_EPI32(a, b, c, d)                                          \
+  _mm256_unpackhi_epi64(_mm256_unpackhi_epi32(a, b),                           \
+                        _mm256_unpackhi_epi32(c, d))
+
+#define MM256_XOR2(a, b) _mm256_xor_si256(a, b)
+#define MM256_XOR4(a, b, c, d) MM256_XOR2(MM256_XOR2(a, b), MM256_XOR2(c, d))
+
+// 128 位常量复制到两个半区（vpshufb 只在半区内查表）
+#define MM256_DUP(x) _mm256_broadcastsi128_si256(x)
+
+// 8 个通道各取一个字节作下标查同一张 T 表
+#define GATHER_T(table, idx)                                                   \
+  _mm256_i32gather_epi32((const int *)(table), idx, 4)
+
+// T(x) = Table0[x >> 24] ^ Table1[(x >> 16) & 0xFF] ^ Table2[(x >> 8) & 0xFF]
+//        ^ Table3[x & 0xFF]，8 个通道同时查表
+static inline __m256i SM4_T8(__m256i x) {
+  __m256i mask = _mm256_set1_epi32(0xFF);
+  __m256i t0 = GATHER_T(Table0, _mm256_srli_epi32(x, 24));
+  __m256i t1 =
+      GATHER_T(Table1, _mm256_and_si256(_mm256_srli_epi32(x, 16), mask));
+  __m256i t2 =
+      GATHER_T(Table2, _mm256_and_si256(_mm256_srli_epi32(x, 8), mask));
+  __m256i t3 = GATHER_T(Table3, _mm256_and_si256(x, mask));
+  return MM256_XOR4(t0, t1, t2, t3);
+}
+
+// 装载 8 个分组：低半区为分组 0~3，高半区为分组 4~7（同 sm4_avx2.c）
+static inline void SM4_gather_load8(const uint8_t *in, __m256i X[4]) {
+  __m256i Tmp[4];
+  __m256i vindex = MM256_DUP(
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  for (int j = 0; j < 4; j++) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)in + j);
+    __m128i hi = _mm_loadu_si128((const __m128i *)in + j + 4);
+    Tmp[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+  }
+  X[0] = MM256_PACK0_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  X[1] = MM256_PACK1_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  X[2] = MM256_PACK2_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  X[3] = MM256_PACK3_EPI32(Tmp[0], Tmp[1], Tmp[2], Tmp[3]);
+  for (int j = 0; j < 4; j++) {
+    X[j] = _mm256_shuffle_epi8(X[j], vindex);
+  }
+}
+
+// 反序输出 (X3, X2, X1, X0) 并写回 8 个分组
+static inline void SM4_gather_store8(uint8_t *out, __m256i X[4]) {
+  __m256i Tmp[4];
+  __m256i vindex = MM256_DUP(
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+  for (int j = 0; j < 4; j++) {
+    X[j] = _mm256_shuffle_epi8(X[j], vindex);
+  }
+  Tmp[0] = MM256_PACK0_EPI32(X[3], X[2], X[1], X[0]);
+  Tmp[1] = MM256_PACK1_EPI32(X[3], X[2], X[1], X[0]);
+  Tmp[2] = MM256_PACK2_EPI32(X[3], X[2], X[1], X[0]);
+  Tmp[3] = MM256_PACK3_EPI32(X[3], X[2], X[1], X[0]);
+  for (int j = 0; j < 4; j++) {
+    _mm_storeu_si128((__m128i *)out + j, _mm256_castsi256_si128(Tmp[j]));
+    _mm_storeu_si128((__m128i *)out + j + 4,
+                     _mm256_extracti128_si256(Tmp[j], 1));
+  }
+}
+
+// 轮密钥。perlane 为编译期常量：0 时 rkv 为 rk_x4（__m128i），广播值再复制到
+// 两个半区；1 时 rkv 为每通道独立的 __m256i 轮密钥（多密钥）
+#define GATHER_RK(rkv, i)                                                      \
+  (perlane ? _mm256_load_si256((const __m256i *)(rkv) + (i))                   \
+           : MM256_DUP(_mm_load_si128((const __m128i *)(rkv) + (i))))
+
+// 单轮：结果写回 X0，寄存器角色靠宏参数轮换
+#define GATHER_ROUND(X0, X1, X2, X3, k)                                        \
+  X0 = MM256_XOR2(X0, SM4_T8(MM256_XOR4(X1, X2, X3, k)))
+
+#define GATHER_ROUNDS4(rkv, i)                                                 \
+  GATHER_ROUND(X[0], X[1], X[2], X[3], GATHER_RK(rkv, (i) + 0));               \
+  GATHER_ROUND(X[1], X[2], X[3], X[0], GATHER_RK(rkv, (i) + 1));               \
+  GATHER_ROUND(X[2], X[3], X[0], X[1], GATHER_RK(rkv, (i) + 2));               \
+  GATHER_ROUND(X[3], X[0], X[1], X[2], GATHER_RK(rkv, (i) + 3))
+
+// 两组状态共用同一轮密钥，同一轮内交错推进，两组的 gather 可以同时在途
+#define GATHER_ROUND2(X0, X1, X2, X3, Y0, Y1, Y2, Y3, k)                       \
+  do {                                                                         \
+    __m256i k_ = (k);                                                          \
+    __m256i TmpX = SM4_T8(MM256_XOR4(X1, X2, X3, k_));                         \
+    __m256i TmpY = SM4_T8(MM256_XOR4(Y1, Y2, Y3, k_));                         \
+    X0 = MM256_XOR2(X0, TmpX);                                                 \
+    Y0 = MM256_XOR2(Y0, TmpY);                                                 \
+  } while (0)
+
+#define GATHER_ROUNDS4_2(rkv, i)                                               \
+  GATHER_ROUND2(X[0], X[1], X[2], X[3], Y[0], Y[1], Y[2], Y[3],                \
+                GATHER_RK(rkv, (i) + 0));                                      \
+  GATHER_ROUND2(X[1], X[2], X[3], X[0], Y[1], Y[2], Y[3], Y[0],                \
+                GATHER_RK(rkv, (i) + 1));                                      \
+  GATHER_ROUND2(X[2], X[3], X[0], X[1], Y[2], Y[3], Y[0], Y[1],                \
+                GATHER_RK(rkv, (i) + 2));                                      \
+  GATHER_ROUND2(X[3], X[0], X[1], X[2], Y[3], Y[0], Y[1], Y[2],                \
+                GATHER_RK(rkv, (i) + 3))
+
+// rkv 为轮密钥（见 GATHER_RK），32 轮完全展开
+static inline __attribute__((always_inline)) void
+SM4_gather8(const uint8_t *in, uint8_t *out, const void *rkv, int perlane) {
+  __m256i X[4];
+  SM4_gather_load8(in, X);
+  GATHER_ROUNDS4(rkv, 0);
+  GATHER_ROUNDS4(rkv, 4);
+  GATHER_ROUNDS4(rkv, 8);
+  GATHER_ROUNDS4(rkv, 12);
+  GATHER_ROUNDS4(rkv, 16);
+  GATHER_ROUNDS4(rkv, 20);
+  GATHER_ROUNDS4(rkv, 24);
+  GATHER_ROUNDS4(rkv, 28);
+  SM4_gather_store8(out, X);
+}
+
+static void SM4_gather16(const uint8_t *in, uint8_t *out,
+                         const __m128i *rkv) {
+  const int perlane = 0; // 两组状态共用广播轮密钥
+  __m256i X[4], Y[4];
+  SM4_gather_load8(in, X);
+  SM4_gather_load8(in + 128, Y);
+  GATHER_ROUNDS4_2(rkv, 0);
+  GATHER_ROUNDS4_2(rkv, 4);
+  GATHER_ROUNDS4_2(rkv, 8);
+  GATHER_ROUNDS4_2(rkv, 12);
+  GATHER_ROUNDS4_2(rkv, 16);
+  GATHER_ROUNDS4_2(rkv, 20);
+  GATHER_ROUNDS4_2(rkv, 24);
+  GATHER_ROUNDS4_2(rkv, 28);
+  SM4_gather_store8(out, X);
+  SM4_gather_store8(out + 128, Y);
+}
+
+static void SM4_gather8_bcast(const uint8_t *in, uint8_t *out,
+                              const __m128i *rkv) {
+  SM4_gather8(in, out, rkv, 0);
+}
+
+static void SM4_gather8_mk(const uint8_t *in, uint8_t *out,
+                           const __m256i *rkv) {
+  SM4_gather8(in, out, rkv, 1);
+}
+
+#define RKV(key, enc) ((const __m128i *)(key)->rk_x4[(enc) != 0])
+
+void SM4_GATHER_do8(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                    int enc) {
+  SM4_gather8_bcast(in, out, RKV(sm4_key, enc));
+}
+
+static void SM4_GATHER_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                              const SM4_Key *sm4_key, int enc) {
+  const __m128i *rkv = RKV(sm4_key, enc);
+
+  while (nblocks >= 16) {
+    SM4_gather16(in, out, rkv);
+    in += 256;
+    out += 256;
+    nblocks -= 16;
+  }
+  if (nblocks >= 8) {
+    SM4_gather8_bcast(in, out, rkv);
+    in += 128;
+    out += 128;
+    nblocks -= 8;
+  }
+  // 剩余 0~7 块由标量 T-table 交错内核处理，不依赖 AES-NI
+  if (nblocks > 0) {
+    sm4_ttable_blocks_impl(in, out, nblocks, sm4_key, enc);
+  }
+}
+
+void sm4_encrypt_blocks_gather(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *sm4_key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GATHER, 16 * nblocks, nblocks);
+  SM4_GATHER_blocks(in, out, nblocks, sm4_key, 0);
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_blocks_gather(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *sm4_key) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GATHER, 16 * nblocks, nblocks);
+  SM4_GATHER_blocks(in, out, nblocks, sm4_key, 1);
+  SM4_TRACE_END();
+}
+
+// 8 个密钥的轮密钥转置成逐轮向量，布局与 SM4_gather_load8 一致
+static void SM4_gather_lane_keys(const SM4_Key *const keys[8], int dec,
+                                 __m256i rkv[32]) {
+  for (int i = 0; i < 32; i += 4) {
+    __m256i K[4];
+    for (int j = 0; j < 4; j++) {
+      const uint32_t *lo = dec ? keys[j]->rk_dec : keys[j]->rk;
+      const uint32_t *hi = dec ? keys[j + 4]->rk_dec : keys[j + 4]->rk;
+      K[j] = _mm256_inserti128_si256(
+          _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(lo + i))),
+          _mm_loadu_si128((const __m128i *)(hi + i)), 1);
+    }
+    rkv[i + 0] = MM256_PACK0_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 1] = MM256_PACK1_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 2] = MM256_PACK2_EPI32(K[0], K[1], K[2], K[3]);
+    rkv[i + 3] = MM256_PACK3_EPI32(K[0], K[1], K[2], K[3]);
+  }
+}
+
+static void SM4_GATHER_multikey(const uint8_t *in, uint8_t *out,
+                                size_t nblocks, const SM4_Key *const *keys,
+                                int dec) {
+  __m256i rkv[32];
+
+  while (nblocks >= 8) {
+    SM4_gather_lane_keys(keys, dec, rkv);
+    SM4_gather8_mk(in, out, rkv);
+    in += 128;
+    out += 128;
+    keys += 8;
+    nblocks -= 8;
+  }
+  // 剩余 0~7 块交给 T-table 多密钥实现
+  if (nblocks > 0) {
+    sm4_ttable_multikey_impl(in, out, nblocks, keys, dec);
+  }
+}
+
+void sm4_encrypt_multikey_gather(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GATHER, 16 * nblocks, nblocks);
+  SM4_GATHER_multikey(in, out, nblocks, keys, 0);
+  SM4_TRACE_END();
+}
+
+void sm4_decrypt_multikey_gather(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys) {
+  SM4_TRACE_BEGIN(SM4_TRACE_GATHER, 16 * nblocks, nblocks);
+  SM4_GATHER_multikey(in, out, nblocks, keys, 1);
+  SM4_TRACE_END();
+}
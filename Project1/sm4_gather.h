@@ -0,0 +1,25 @@
+#ifndef SM4_GATHER_H
+#define SM4_GATHER_H
+
+#include "sm4.h"
+
+// 一次处理 8 个分组（读写 128 字节）：状态放在 __m256i 中，S 盒与 L 变换
+// 用 vpgatherdd 查 sm4_ttable.c 的 T 表完成，不使用 AES 单元
+void SM4_GATHER_do8(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
+                    int enc);
+
+// 多块接口：16 块/8 块一组走 gather，剩余 0~7 块交给标量 T-table 实现
+void sm4_encrypt_blocks_gather(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *sm4_key);
+
+void sm4_decrypt_blocks_gather(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *sm4_key);
+
+// 多密钥接口：第 i 个分组使用 keys[i]，8 个分组一组、每个通道独立轮密钥
+void sm4_encrypt_multikey_gather(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys);
+
+void sm4_decrypt_multikey_gather(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys);
+
+#endif
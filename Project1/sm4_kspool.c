@@ -0,0 +1,239 @@
+#include "sm4_kspool.h"
+#include "sm4_ctr.h"
+#include "sm4_engine.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+void sm4_kspool_nonce(const SM4_KSPOOL *pool, uint64_t seq,
+                      uint8_t nonce[12]) {
+  memcpy(nonce, pool->iv, 12);
+  for (int i = 11; i >= 4; i--) {
+    nonce[i] ^= (uint8_t)seq;
+    seq >>= 8;
+  }
+}
+
+// 预生成一批连续的消息，最多 max_msgs 条且不跨越环尾，这样整批计数器块
+// 在环中连续，一次多块调用加密完。返回提交的条数
+static size_t kspool_fill_batch(SM4_KSPOOL *pool, size_t max_msgs) {
+  pthread_mutex_lock(&pool->lock);
+  while (pool->filling && !pool->stop) {
+    pthread_cond_wait(&pool->cond, &pool->lock);
+  }
+  size_t free_slots = pool->nslots - (size_t)(pool->tail - pool->head);
+  size_t start = (size_t)(pool->tail % pool->nslots);
+  size_t n = free_slots < max_msgs ? free_slots : max_msgs;
+  if (n > pool->nslots - start) {
+    n = pool->nslots - start;
+  }
+  if (pool->stop || n == 0) {
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+  }
+  // 填充期间密钥不变（rekey 会等待 filling 清零），槽位 [tail, tail + n)
+  // 不会被消费方读取，因此加密在锁外进行
+  pool->filling = 1;
+  uint64_t seq = pool->tail, gen = pool->gen;
+  pthread_mutex_unlock(&pool->lock);
+
+  uint8_t *slot = pool->ring + start * pool->slot_blocks * 16;
+  for (size_t m = 0; m < n; m++) {
+    uint8_t nonce[12];
+    sm4_kspool_nonce(pool, seq + m, nonce);
+    for (size_t b = 0; b < pool->slot_blocks; b++) {
+      uint8_t *ctr = slot + 16 * (m * pool->slot_blocks + b);
+      memcpy(ctr, nonce, 12);
+      put_be32(ctr + 12, (uint32_t)(1 + b));
+    }
+  }
+  size_t nblocks = n * pool->slot_blocks;
+  sm4_engine_get(nblocks)->encrypt_blocks(slot, slot, nblocks, &pool->key);
+
+  pthread_mutex_lock(&pool->lock);
+  // 期间发生过 rekey 或序号跳变，这批结果作废
+  if (pool->gen != gen) {
+    n = 0;
+  } else {
+    pool->tail = seq + n;
+  }
+  pool->filling = 0;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+  return n;
+}
+
+static void *kspool_worker(void *arg) {
+  SM4_KSPOOL *pool = arg;
+  for (;;) {
+    if (kspool_fill_batch(pool, SM4_KSPOOL_FILL_BATCH) > 0) {
+      continue;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop &&
+           (pool->filling || pool->tail - pool->head >= pool->nslots)) {
+      pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    int stop = pool->stop;
+    pthread_mutex_unlock(&pool->lock);
+    if (stop) {
+      return NULL;
+    }
+  }
+}
+
+int sm4_kspool_init(SM4_KSPOOL *pool, const uint8_t key[16],
+                    const uint8_t iv[12], size_t max_len, size_t nslots,
+                    int background) {
+  memset(pool, 0, sizeof(*pool));
+  // 单条消息不超过 GCM 的上限 2^36 - 32 字节
+  if (nslots == 0 || max_len > ((uint64_t)1 << 36) - 32) {
+    return -1;
+  }
+  pool->max_len = max_len;
+  pool->slot_blocks = 1 + (max_len + 15) / 16;
+  pool->nslots = nslots;
+  if (pool->slot_blocks > SIZE_MAX / 16 / nslots) {
+    return -1;
+  }
+  pool->ring = malloc(nslots * pool->slot_blocks * 16);
+  if (pool->ring == NULL) {
+    return -1;
+  }
+  sm4_keyInit(key, &pool->key);
+  memcpy(pool->iv, iv, 12);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+
+  if (background) {
+    if (pthread_create(&pool->thread, NULL, kspool_worker, pool) != 0) {
+      sm4_kspool_free(pool);
+      return -1;
+    }
+    pool->background = 1;
+  }
+  return 0;
+}
+
+void sm4_kspool_free(SM4_KSPOOL *pool) {
+  if (pool->ring == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+  if (pool->background) {
+    pthread_join(pool->thread, NULL);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->cond);
+  memset(pool->ring, 0, pool->nslots * pool->slot_blocks * 16);
+  free(pool->ring);
+  memset(pool, 0, sizeof(*pool));
+}
+
+void sm4_kspool_rekey(SM4_KSPOOL *pool, const uint8_t key[16],
+                      const uint8_t iv[12]) {
+  pthread_mutex_lock(&pool->lock);
+  while (pool->filling) {
+    pthread_cond_wait(&pool->cond, &pool->lock);
+  }
+  sm4_keyInit(key, &pool->key);
+  memcpy(pool->iv, iv, 12);
+  memset(pool->ring, 0, pool->nslots * pool->slot_blocks * 16);
+  pool->head = 0;
+  pool->tail = 0;
+  pool->gen++;
+  pool->hits = 0;
+  pool->misses = 0;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+size_t sm4_kspool_fill(SM4_KSPOOL *pool, size_t max_msgs) {
+  size_t done = 0;
+  while (done < max_msgs) {
+    size_t want = max_msgs - done;
+    size_t n = kspool_fill_batch(
+        pool, want < SM4_KSPOOL_FILL_BATCH ? want : SM4_KSPOOL_FILL_BATCH);
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+// 未命中：与 GCTR 相同，现场计算 E_K(J0) 与数据的密钥流
+static void kspool_compute(const SM4_KSPOOL *pool, uint64_t seq,
+                           uint8_t ek0[16], const uint8_t *in, uint8_t *out,
+                           size_t len) {
+  uint8_t ctr[16];
+  sm4_kspool_nonce(pool, seq, ctr);
+  put_be32(ctr + 12, 1);
+  sm4_engine_get(1)->encrypt_blocks(ctr, ek0, 1, &pool->key);
+  put_be32(ctr + 12, 2);
+
+  size_t nblocks = len / 16, rem = len % 16;
+  sm4_ctr32_blocks_cached(in, out, nblocks, ctr, &pool->key);
+  if (rem > 0) {
+    uint8_t block[16] = {0};
+    memcpy(block, in + 16 * nblocks, rem);
+    sm4_ctr32_blocks_cached(block, block, 1, ctr, &pool->key);
+    memcpy(out + 16 * nblocks, block, rem);
+  }
+}
+
+int sm4_kspool_xor(SM4_KSPOOL *pool, uint64_t seq, uint8_t ek0[16],
+                   const uint8_t *in, uint8_t *out, size_t len) {
+  pthread_mutex_lock(&pool->lock);
+  int hit = seq >= pool->head && seq < pool->tail && len <= pool->max_len;
+  pthread_mutex_unlock(&pool->lock);
+
+  if (hit) {
+    // head 尚未越过 seq，填充方不会改写这个槽位，可以在锁外读取
+    const uint8_t *ks =
+        pool->ring + (size_t)(seq % pool->nslots) * pool->slot_blocks * 16;
+    memcpy(ek0, ks, 16);
+    ks += 16;
+    for (size_t i = 0; i < len; i++) {
+      out[i] = in[i] ^ ks[i];
+    }
+  } else {
+    kspool_compute(pool, seq, ek0, in, out, len);
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  if (seq >= pool->head) {
+    pool->head = seq + 1;
+    // 跳过了尚未生成的序号：从 seq + 1 重新开始填充
+    if (pool->tail < pool->head) {
+      pool->tail = pool->head;
+      pool->gen++;
+    }
+  }
+  if (hit) {
+    pool->hits++;
+  } else {
+    pool->misses++;
+  }
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+  return hit;
+}
+
+void sm4_kspool_stats(SM4_KSPOOL *pool, SM4_KSPOOL_STATS *st) {
+  pthread_mutex_lock(&pool->lock);
+  st->hits = pool->hits;
+  st->misses = pool->misses;
+  st->ready = (size_t)(pool->tail - pool->head);
+  pthread_mutex_unlock(&pool->lock);
+}
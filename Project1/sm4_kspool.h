@@ -0,0 +1,81 @@
+#ifndef SM4_KSPOOL_H
+#define SM4_KSPOOL_H
+
+#include "sm4.h"
+
+#include <pthread.h>
+
+// 后台线程或 sm4_kspool_fill 每次最多预生成的消息数
+#define SM4_KSPOOL_FILL_BATCH 16
+
+// CTR/GCM 密钥流预生成池：计数器模式的密钥流与数据无关，可以在消息到达前
+// 生成。第 seq 条消息的 nonce 为静态 IV 与 seq 异或（TLS 1.3 的方式，
+// seq 按大端异或进最后 8 字节），计数器块为 nonce || ctr32，ctr32 从 1
+// 开始（即 GCM 的 J0）。每条消息占环中的一个槽位：E_K(J0) 加上
+// max_len 字节数据的密钥流。
+//
+// 只允许一个线程消费（sm4_kspool_xor），填充可以来自后台线程，也可以由
+// 调用方在空闲时调用 sm4_kspool_fill
+typedef struct {
+  SM4_Key key;
+  uint8_t iv[12];     // 静态 IV
+  size_t max_len;     // 预生成覆盖的最大消息长度
+  size_t slot_blocks; // 每个槽位的块数：1 + ceil(max_len / 16)
+  size_t nslots;      // 环的容量（消息数），决定内存上限
+  uint8_t *ring;      // nslots * slot_blocks * 16 字节
+
+  pthread_mutex_t lock; // 保护以下字段
+  pthread_cond_t cond;  // 有空槽、填充结束或停止时广播
+  uint64_t head;        // 下一条待消费消息的序号
+  uint64_t tail;        // 已生成到的序号（不含），[head, tail) 可直接使用
+  uint64_t gen;         // 刷新代数：重新设置密钥或序号跳变时加一
+  int filling;          // 有填充正在进行（同一时刻只有一个）
+  int stop;
+
+  pthread_t thread;
+  int background; // 是否启动了后台填充线程
+
+  uint64_t hits;   // 直接使用预生成密钥流的消息数
+  uint64_t misses; // 未命中（未生成、序号不连续或超过 max_len）的消息数
+} SM4_KSPOOL;
+
+// 统计信息，用于确定池的大小
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  size_t ready; // 当前已生成、尚未消费的消息数
+} SM4_KSPOOL_STATS;
+
+// 创建池：nslots 条消息，每条最多 max_len 字节。background 非 0 时启动
+// 后台线程持续把环填满。参数非法或分配失败返回 -1
+int sm4_kspool_init(SM4_KSPOOL *pool, const uint8_t key[16],
+                    const uint8_t iv[12], size_t max_len, size_t nslots,
+                    int background);
+
+// 停止后台线程，清除并释放预生成的密钥流
+void sm4_kspool_free(SM4_KSPOOL *pool);
+
+// 更换密钥与静态 IV：丢弃并清零所有预生成的密钥流，序号从 0 重新开始，
+// 统计清零。不能与 sm4_kspool_xor 并发调用
+void sm4_kspool_rekey(SM4_KSPOOL *pool, const uint8_t key[16],
+                      const uint8_t iv[12]);
+
+// 在调用线程上预生成，最多 max_msgs 条消息，返回实际生成的条数
+// （环已满时为 0）。可在后台线程存在时调用
+size_t sm4_kspool_fill(SM4_KSPOOL *pool, size_t max_msgs);
+
+// 第 seq 条消息使用的 12 字节 nonce
+void sm4_kspool_nonce(const SM4_KSPOOL *pool, uint64_t seq,
+                      uint8_t nonce[12]);
+
+// 处理第 seq 条消息：ek0 输出 E_K(J0)（GCM 标签掩码），in 与从 inc32(J0)
+// 开始的密钥流异或写入 out（加解密相同，可以原地）。命中时只做异或；
+// 未命中时现场计算。seq 之前未消费的槽位被丢弃，seq 必须大于已处理过的
+// 序号才可能命中。返回 1 表示命中，0 表示未命中
+int sm4_kspool_xor(SM4_KSPOOL *pool, uint64_t seq, uint8_t ek0[16],
+                   const uint8_t *in, uint8_t *out, size_t len);
+
+// 读取统计信息
+void sm4_kspool_stats(SM4_KSPOOL *pool, SM4_KSPOOL_STATS *st);
+
+#endif
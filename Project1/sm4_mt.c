@@ -0,0 +1,380 @@
+#define _GNU_SOURCE
+#include "sm4_mt.h"
+#include "sm4_cbc.h"
+#include "sm4_ctr.h"
+#include "sm4_engine.h"
+#include "sm4_trace.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MT_MAX_THREADS 64
+
+typedef struct MT_JOB MT_JOB;
+
+// 一个任务：按 chunk 字节切片，fn 处理 [off, off + len) 这一段
+struct MT_JOB {
+  void (*fn)(const MT_JOB *job, size_t chunk, size_t off, size_t len);
+  size_t total; // 总字节数
+  size_t chunk; // 分片字节数（16 的倍数）
+  size_t nchunks;
+  const uint8_t *in;
+  uint8_t *out;
+  const SM4_Key *key;
+  int dec;
+  const uint8_t *iv; // CTR 初始计数器
+  int ctr_bits;
+  uint64_t offset;      // CTR 起始偏移
+  const uint8_t *chain; // CBC/CFB：每个分片的链值，16 字节一组
+};
+
+// 每个线程待处理的分片区间 [lo, hi)，打包为 lo << 32 | hi，单独占一条缓存行
+typedef struct {
+  uint64_t range;
+} __attribute__((aligned(64))) MT_SLOT;
+
+static struct {
+  pthread_mutex_t job_lock; // 串行化调用方与重新配置
+  pthread_mutex_t lock;     // 保护以下字段
+  pthread_cond_t start;
+  pthread_cond_t done;
+  int started;
+  int stop;
+  unsigned long gen;  // 每发布一个任务加一
+  const MT_JOB *job;  // 当前任务，NULL 表示没有
+  unsigned active;    // 正在参与当前任务的工作线程数
+  size_t remaining;   // 当前任务未完成的分片数（原子访问）
+  unsigned nthreads;  // 含调用线程
+  size_t min_chunk;
+  int pin;
+  pthread_t workers[MT_MAX_THREADS];
+  MT_SLOT slots[MT_MAX_THREADS];
+} pool = {
+    .job_lock = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static inline uint64_t pack_range(uint32_t lo, uint32_t hi) {
+  return ((uint64_t)lo << 32) | hi;
+}
+
+// 从自己区间的头部取一个分片
+static int range_pop(MT_SLOT *slot, size_t *index) {
+  uint64_t old = __atomic_load_n(&slot->range, __ATOMIC_ACQUIRE);
+  for (;;) {
+    uint32_t lo = old >> 32, hi = (uint32_t)old;
+    if (lo >= hi) {
+      return 0;
+    }
+    if (__atomic_compare_exchange_n(&slot->range, &old, pack_range(lo + 1, hi),
+                                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      *index = lo;
+      return 1;
+    }
+  }
+}
+
+// 从 victim 区间的尾部窃取一半（至少一个）放入自己的区间
+static int range_steal(MT_SLOT *victim, MT_SLOT *self) {
+  uint64_t old = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+  for (;;) {
+    uint32_t lo = old >> 32, hi = (uint32_t)old;
+    if (lo >= hi) {
+      return 0;
+    }
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (__atomic_compare_exchange_n(&victim->range, &old, pack_range(lo, mid),
+                                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      __atomic_store_n(&self->range, pack_range(mid, hi), __ATOMIC_RELEASE);
+      return 1;
+    }
+  }
+}
+
+static void finish_chunk(void) {
+  if (__atomic_sub_fetch(&pool.remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+    pthread_mutex_lock(&pool.lock);
+    pthread_cond_broadcast(&pool.done);
+    pthread_mutex_unlock(&pool.lock);
+  }
+}
+
+// 先处理自己的区间，取空后依次尝试从其他线程窃取，全部为空时返回
+static void run_worker(unsigned id, const MT_JOB *job) {
+  MT_SLOT *self = &pool.slots[id];
+  for (;;) {
+    size_t index;
+    while (range_pop(self, &index)) {
+      size_t off = index * job->chunk;
+      size_t len = job->total - off;
+      if (len > job->chunk) {
+        len = job->chunk;
+      }
+      job->fn(job, index, off, len);
+      finish_chunk();
+    }
+    int stolen = 0;
+    for (unsigned k = 1; k < pool.nthreads && !stolen; k++) {
+      stolen = range_steal(&pool.slots[(id + k) % pool.nthreads], self);
+    }
+    if (!stolen) {
+      return;
+    }
+  }
+}
+
+static void *worker_main(void *arg) {
+  unsigned id = (unsigned)(size_t)arg;
+  unsigned long seen = 0;
+
+  if (pool.pin) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(id % (ncpu > 0 ? ncpu : 1), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  for (;;) {
+    pthread_mutex_lock(&pool.lock);
+    while (!pool.stop && (pool.gen == seen || pool.job == NULL)) {
+      pthread_cond_wait(&pool.start, &pool.lock);
+    }
+    if (pool.stop) {
+      pthread_mutex_unlock(&pool.lock);
+      return NULL;
+    }
+    seen = pool.gen;
+    const MT_JOB *job = pool.job;
+    pool.active++;
+    pthread_mutex_unlock(&pool.lock);
+
+    run_worker(id, job);
+
+    pthread_mutex_lock(&pool.lock);
+    if (--pool.active == 0) {
+      pthread_cond_broadcast(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.lock);
+  }
+}
+
+static void pool_stop(void) {
+  if (!pool.started) {
+    return;
+  }
+  pthread_mutex_lock(&pool.lock);
+  pool.stop = 1;
+  pthread_cond_broadcast(&pool.start);
+  pthread_mutex_unlock(&pool.lock);
+  for (unsigned i = 1; i < pool.nthreads; i++) {
+    pthread_join(pool.workers[i], NULL);
+  }
+  pool.started = 0;
+  pool.stop = 0;
+}
+
+static int pool_start(const SM4_MT_OPTIONS *opt) {
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned n = ncpu > 0 ? (unsigned)ncpu : 1;
+  if (opt != NULL && opt->max_threads > 0) {
+    n = opt->max_threads;
+  }
+  if (n > MT_MAX_THREADS) {
+    n = MT_MAX_THREADS;
+  }
+  size_t min_chunk = (opt != NULL && opt->min_chunk > 0) ? opt->min_chunk
+                                                         : SM4_MT_DEFAULT_CHUNK;
+
+  pool.nthreads = 1;
+  pool.min_chunk = (min_chunk + 15) & ~(size_t)15;
+  pool.pin = opt != NULL && opt->pin;
+  pool.job = NULL;
+  pool.active = 0;
+  pool.started = 1;
+  for (unsigned i = 1; i < n; i++) {
+    if (pthread_create(&pool.workers[i], NULL, worker_main,
+                       (void *)(size_t)i) != 0) {
+      break;
+    }
+    pool.nthreads++;
+  }
+  return pool.nthreads == n ? 0 : -1;
+}
+
+int sm4_mt_configure(const SM4_MT_OPTIONS *opt) {
+  pthread_mutex_lock(&pool.job_lock);
+  pool_stop();
+  int ret = pool_start(opt);
+  pthread_mutex_unlock(&pool.job_lock);
+  return ret;
+}
+
+void sm4_mt_shutdown(void) {
+  pthread_mutex_lock(&pool.job_lock);
+  pool_stop();
+  pthread_mutex_unlock(&pool.job_lock);
+}
+
+unsigned sm4_mt_threads(void) {
+  pthread_mutex_lock(&pool.job_lock);
+  if (!pool.started) {
+    pool_start(NULL);
+  }
+  unsigned n = pool.nthreads;
+  pthread_mutex_unlock(&pool.job_lock);
+  return n;
+}
+
+// 分片并发布任务，调用线程作为 0 号线程参与，等全部分片完成且没有工作线程
+// 仍持有该任务时返回。job->chain 需要分片信息时由 prepare 在发布前填充
+static void mt_run(MT_JOB *job, void (*prepare)(MT_JOB *job, uint8_t *chain)) {
+  SM4_TRACE_BEGIN(SM4_TRACE_MT, job->total, job->total / 16);
+  pthread_mutex_lock(&pool.job_lock);
+  if (!pool.started) {
+    pool_start(NULL);
+  }
+
+  job->chunk = pool.min_chunk;
+  job->nchunks = (job->total + job->chunk - 1) / job->chunk;
+  uint8_t *chain = NULL;
+
+  // 线程数为 1、数据不足两个分片或分配失败时在调用线程直接完成
+  if (job->nchunks >= 2 && pool.nthreads > 1 && job->nchunks <= UINT32_MAX &&
+      (prepare == NULL || (chain = malloc(16 * job->nchunks)) != NULL)) {
+    if (prepare != NULL) {
+      prepare(job, chain);
+    }
+    unsigned n = pool.nthreads;
+    for (unsigned t = 0; t < n; t++) {
+      pool.slots[t].range = pack_range((uint32_t)(job->nchunks * t / n),
+                                       (uint32_t)(job->nchunks * (t + 1) / n));
+    }
+    __atomic_store_n(&pool.remaining, job->nchunks, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&pool.lock);
+    pool.job = job;
+    pool.gen++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_worker(0, job);
+
+    pthread_mutex_lock(&pool.lock);
+    while (__atomic_load_n(&pool.remaining, __ATOMIC_ACQUIRE) > 0 ||
+           pool.active > 0) {
+      pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pool.job = NULL;
+    pthread_mutex_unlock(&pool.lock);
+    free(chain);
+  } else {
+    job->chunk = job->total;
+    job->nchunks = 1;
+    job->chain = job->iv;
+    job->fn(job, 0, 0, job->total);
+  }
+
+  pthread_mutex_unlock(&pool.job_lock);
+  SM4_TRACE_END();
+}
+
+static void ecb_chunk(const MT_JOB *job, size_t chunk, size_t off,
+                      size_t len) {
+  (void)chunk;
+  const SM4_ENGINE *engine = sm4_engine_get(len / 16);
+  if (job->dec) {
+    engine->decrypt_blocks(job->in + off, job->out + off, len / 16, job->key);
+  } else {
+    engine->encrypt_blocks(job->in + off, job->out + off, len / 16, job->key);
+  }
+}
+
+static void ecb_run(const uint8_t *in, uint8_t *out, size_t nblocks,
+                    const SM4_Key *key, int dec) {
+  MT_JOB job = {.fn = ecb_chunk, .total = 16 * nblocks, .in = in, .out = out,
+                .key = key, .dec = dec};
+  if (nblocks > 0) {
+    mt_run(&job, NULL);
+  }
+}
+
+void sm4_mt_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *key) {
+  ecb_run(in, out, nblocks, key, 0);
+}
+
+void sm4_mt_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *key) {
+  ecb_run(in, out, nblocks, key, 1);
+}
+
+static void ctr_chunk(const MT_JOB *job, size_t chunk, size_t off,
+                      size_t len) {
+  (void)chunk;
+  sm4_ctr_range(job->key, job->iv, job->ctr_bits, job->offset + off,
+                job->in + off, job->out + off, len);
+}
+
+void sm4_mt_ctr_range(const SM4_Key *key, const uint8_t iv[16], int ctr_bits,
+                      uint64_t offset, const uint8_t *in, uint8_t *out,
+                      size_t len) {
+  MT_JOB job = {.fn = ctr_chunk, .total = len, .in = in, .out = out,
+                .key = key, .iv = iv, .ctr_bits = ctr_bits, .offset = offset};
+  if (len > 0) {
+    mt_run(&job, NULL);
+  }
+}
+
+// 分片 k 的链值为前一分片的最后一个密文分组，原地解密会覆盖它，需在发布前保存
+static void chain_prepare(MT_JOB *job, uint8_t *chain) {
+  memcpy(chain, job->iv, 16);
+  for (size_t k = 1; k < job->nchunks; k++) {
+    memcpy(chain + 16 * k, job->in + k * job->chunk - 16, 16);
+  }
+  job->chain = chain;
+}
+
+static void cbc_chunk(const MT_JOB *job, size_t chunk, size_t off,
+                      size_t len) {
+  uint8_t iv[16];
+  memcpy(iv, job->chain + 16 * chunk, 16);
+  sm4_cbc_decrypt(job->in + off, job->out + off, len / 16, iv, job->key);
+}
+
+static void cfb_chunk(const MT_JOB *job, size_t chunk, size_t off,
+                      size_t len) {
+  uint8_t iv[16];
+  memcpy(iv, job->chain + 16 * chunk, 16);
+  sm4_cfb_decrypt(job->in + off, job->out + off, len / 16, iv, job->key);
+}
+
+static void chain_run(void (*fn)(const MT_JOB *, size_t, size_t, size_t),
+                      const uint8_t *in, uint8_t *out, size_t nblocks,
+                      uint8_t iv[16], const SM4_Key *key) {
+  if (nblocks == 0) {
+    return;
+  }
+  // 返回的 iv 为最后一个密文分组，同样要在原地解密覆盖之前取出
+  uint8_t last[16];
+  memcpy(last, in + 16 * (nblocks - 1), 16);
+  MT_JOB job = {.fn = fn, .total = 16 * nblocks, .in = in, .out = out,
+                .key = key, .iv = iv};
+  mt_run(&job, chain_prepare);
+  memcpy(iv, last, 16);
+}
+
+void sm4_mt_cbc_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        uint8_t iv[16], const SM4_Key *key) {
+  chain_run(cbc_chunk, in, out, nblocks, iv, key);
+}
+
+void sm4_mt_cfb_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        uint8_t iv[16], const SM4_Key *key) {
+  chain_run(cfb_chunk, in, out, nblocks, iv, key);
+}
@@ -0,0 +1,48 @@
+#ifndef SM4_MT_H
+#define SM4_MT_H
+
+#include "sm4.h"
+
+// 默认最小分片：64 KB，输入输出合计留在 L2 中
+#define SM4_MT_DEFAULT_CHUNK (64 * 1024)
+
+// 线程池配置
+typedef struct {
+  unsigned max_threads; // 线程数（含调用线程），0 表示在线 CPU 数
+  size_t min_chunk;     // 最小分片字节数，0 表示 SM4_MT_DEFAULT_CHUNK
+  int pin;              // 非 0 时把工作线程绑定到各自的 CPU
+} SM4_MT_OPTIONS;
+
+// 按配置（重新）创建线程池，opt 为 NULL 时使用默认值。
+// 不调用时首次使用自动按默认值创建。不能与正在执行的任务并发调用
+int sm4_mt_configure(const SM4_MT_OPTIONS *opt);
+
+// 停止并回收工作线程
+void sm4_mt_shutdown(void);
+
+// 当前线程池的线程数（含调用线程）
+unsigned sm4_mt_threads(void);
+
+// 以下接口把数据切成分片，由调用线程与工作线程共同完成；
+// 空闲线程从其他线程的分片区间尾部窃取一半。数据量不足两个分片时
+// 直接在调用线程完成。同一时刻只执行一个任务，并发调用会排队
+
+// ECB 多块加解密
+void sm4_mt_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *key);
+void sm4_mt_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                           const SM4_Key *key);
+
+// CTR：语义同 sm4_ctr_range，每个分片独立定位计数器
+void sm4_mt_ctr_range(const SM4_Key *key, const uint8_t iv[16], int ctr_bits,
+                      uint64_t offset, const uint8_t *in, uint8_t *out,
+                      size_t len);
+
+// CBC/CFB 解密：语义同 sm4_cbc_decrypt / sm4_cfb_decrypt（支持原地），
+// 各分片的链值在分发前保存
+void sm4_mt_cbc_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        uint8_t iv[16], const SM4_Key *key);
+void sm4_mt_cfb_decrypt(const uint8_t *in, uint8_t *out, size_t nblocks,
+                        uint8_t iv[16], const SM4_Key *key);
+
+#endif
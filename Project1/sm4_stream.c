@@ -0,0 +1,120 @@
+#include "sm4_stream.h"
+#include "sm4_engine.h"
+
+#include <emmintrin.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+// threshold 为 0 表示使用默认值。默认值只在首次使用时由 pthread_once 计算
+// 一次；threshold 会被 sm4_mt 的工作线程等任意线程读取，用 relaxed 原子
+// 读写避免数据竞争
+static size_t threshold;
+static size_t threshold_default;
+static pthread_once_t threshold_once = PTHREAD_ONCE_INIT;
+
+static void init_default_threshold(void) {
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  threshold_default = llc > 0 ? (size_t)llc / 2 : (size_t)4 << 20;
+}
+
+size_t sm4_stream_threshold(void) {
+  size_t t = __atomic_load_n(&threshold, __ATOMIC_RELAXED);
+  if (t != 0) {
+    return t;
+  }
+  pthread_once(&threshold_once, init_default_threshold);
+  return threshold_default;
+}
+
+void sm4_stream_set_threshold(size_t bytes) {
+  __atomic_store_n(&threshold, bytes, __ATOMIC_RELAXED);
+}
+
+// 每块先把下一块的输入预取进 L1，本块加密到 L1 中的中间缓冲区，再用
+// 非临时存储整块写出。out 必须 16 字节对齐
+static void stream_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                          const SM4_Key *key, SM4_BlocksFunc crypt) {
+  uint8_t buf[16 * SM4_STREAM_CHUNK] __attribute__((aligned(64)));
+
+  while (nblocks > 0) {
+    size_t n = nblocks < SM4_STREAM_CHUNK ? nblocks : SM4_STREAM_CHUNK;
+    size_t next = nblocks - n < SM4_STREAM_CHUNK ? nblocks - n
+                                                 : SM4_STREAM_CHUNK;
+    for (size_t off = 0; off < 16 * next; off += 64) {
+      _mm_prefetch((const char *)in + 16 * n + off, _MM_HINT_T0);
+    }
+    crypt(in, buf, n, key);
+    for (size_t i = 0; i < n; i++) {
+      _mm_stream_si128((__m128i *)out + i,
+                       _mm_load_si128((const __m128i *)buf + i));
+    }
+    in += 16 * n;
+    out += 16 * n;
+    nblocks -= n;
+  }
+  // 非临时存储是弱序的，返回前保证对其他线程可见
+  _mm_sfence();
+}
+
+static int use_stream(const uint8_t *out, size_t nblocks) {
+  return nblocks * 16 >= sm4_stream_threshold() &&
+         ((uintptr_t)out & 15) == 0;
+}
+
+void sm4_stream_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key) {
+  if (use_stream(out, nblocks)) {
+    stream_blocks(in, out, nblocks, key,
+                  sm4_engine_get(SM4_STREAM_CHUNK)->encrypt_blocks);
+  } else {
+    sm4_engine_encrypt_blocks(in, out, nblocks, key);
+  }
+}
+
+void sm4_stream_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key) {
+  if (use_stream(out, nblocks)) {
+    stream_blocks(in, out, nblocks, key,
+                  sm4_engine_get(SM4_STREAM_CHUNK)->decrypt_blocks);
+  } else {
+    sm4_engine_decrypt_blocks(in, out, nblocks, key);
+  }
+}
+
+static size_t round_huge(size_t bytes) {
+  return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+void *sm4_stream_alloc(size_t bytes, int huge) {
+  size_t len = round_huge(bytes);
+  void *p = MAP_FAILED;
+  if (len == 0) {
+    return NULL;
+  }
+  if (huge) {
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+  if (p == MAP_FAILED) {
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+             -1, 0);
+    if (p == MAP_FAILED) {
+      return NULL;
+    }
+    // 没有预留大页时，透明大页由内核在缺页时尽量合并
+    if (huge) {
+      madvise(p, len, MADV_HUGEPAGE);
+    }
+  }
+  return p;
+}
+
+void sm4_stream_free(void *p, size_t bytes) {
+  if (p != NULL) {
+    munmap(p, round_huge(bytes));
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef SM4_STREAM_H
+#define SM4_STREAM_H
+
+#include "sm4.h"
+
+// 大缓冲区路径每次加密的块数：4 KB 的中间结果留在 L1 中
+#define SM4_STREAM_CHUNK 256
+
+// 大缓冲区模式：数据量不小于阈值时，输入用软件预取提前装入，输出用非临时
+// 存储（_mm_stream_si128）绕过缓存直接写回内存，T 表和轮密钥不会被挤出。
+// ECB 走 sm4_stream_*_blocks，CTR 在 sm4_ctr.c 中按同一阈值切换；GCTR 之后
+// 还要对密文做 GHASH，不走非临时存储
+
+// 当前阈值（字节）。默认取末级缓存大小的一半，无法获取时为 4 MB
+size_t sm4_stream_threshold(void);
+
+// 设置阈值：0 恢复默认，SIZE_MAX 表示从不使用非临时存储
+void sm4_stream_set_threshold(size_t bytes);
+
+// ECB 多块加解密。nblocks * 16 不小于阈值且 out 按 16 字节对齐时走大缓冲区
+// 路径，否则等同 sm4_engine_encrypt_blocks / sm4_engine_decrypt_blocks
+void sm4_stream_encrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key);
+void sm4_stream_decrypt_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key);
+
+// 分配大缓冲区（mmap，长度向上取整到 2 MB）。huge 非 0 时优先使用
+// MAP_HUGETLB 大页，失败则退回普通页并建议内核使用透明大页，减少 TLB 缺失。
+// 失败返回 NULL
+void *sm4_stream_alloc(size_t bytes, int huge);
+
+// 释放 sm4_stream_alloc 分配的缓冲区，bytes 与分配时相同
+void sm4_stream_free(void *p, size_t bytes);
+
+#endif
@@ -0,0 +1,170 @@
+#include "sm4_trace.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const SITE_NAMES[SM4_TRACE_SITES] = {
+    "ref",         "ttable",      "ttable1k",    "sbox",     "ttable4k",
+    "aesni",       "gather",      "avx2",        "bitslice", "ctr",
+    "cbc",         "xts",         "ccm",         "drbg",     "mt",
+    "gctr",        "ghash",       "ghash_table", "gcm_init", "gcm_aad",
+    "gcm_encrypt", "gcm_decrypt", "gcm_tag",
+};
+
+const char *sm4_trace_site_name(SM4_TRACE_SITE site) {
+  return site < SM4_TRACE_SITES ? SITE_NAMES[site] : "unknown";
+}
+
+uint64_t sm4_trace_percentile(const SM4_TRACE_STATS *stats, double q) {
+  uint64_t target = (uint64_t)(q * stats->sampled + 0.999999), seen = 0;
+  for (int i = 0; i < SM4_TRACE_BUCKETS; i++) {
+    seen += stats->hist[i];
+    if (seen >= target && seen > 0) {
+      return ((uint64_t)2 << i) - 1;
+    }
+  }
+  return 0;
+}
+
+#ifdef SM4_TRACE
+
+__thread SM4_TRACE_THREAD *sm4_trace_self;
+unsigned sm4_trace_sample_mask = 15; // 默认每 16 次调用采样一次
+
+static SM4_TRACE_THREAD *threads; // 所有统计块，只增不删
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t retire_key;
+static pthread_once_t retire_once = PTHREAD_ONCE_INIT;
+
+// 分配失败时所有线程共用的统计块，计数可能互相覆盖，但不影响加解密
+static SM4_TRACE_THREAD fallback;
+
+// 线程退出：统计保留在链表中继续计入快照，统计块交给之后的新线程复用
+static void retire(void *p) {
+  pthread_mutex_lock(&threads_lock);
+  ((SM4_TRACE_THREAD *)p)->retired = 1;
+  pthread_mutex_unlock(&threads_lock);
+}
+
+static void make_retire_key(void) { pthread_key_create(&retire_key, retire); }
+
+SM4_TRACE_THREAD *sm4_trace_attach(void) {
+  pthread_once(&retire_once, make_retire_key);
+  pthread_mutex_lock(&threads_lock);
+  SM4_TRACE_THREAD *t = threads;
+  while (t != NULL && !t->retired) {
+    t = t->next;
+  }
+  if (t != NULL) {
+    t->retired = 0;
+  } else if ((t = aligned_alloc(64, sizeof(*t))) != NULL) {
+    memset(t, 0, sizeof(*t));
+    t->next = threads;
+    threads = t;
+  }
+  pthread_mutex_unlock(&threads_lock);
+
+  if (t == NULL) {
+    t = &fallback;
+  } else {
+    pthread_setspecific(retire_key, t);
+  }
+  sm4_trace_self = t;
+  return t;
+}
+
+int sm4_trace_compiled(void) { return 1; }
+
+void sm4_trace_set_sample_period(unsigned period) {
+  unsigned p = 1;
+  while (p < period && p < (1u << 31)) {
+    p <<= 1;
+  }
+  __atomic_store_n(&sm4_trace_sample_mask, p - 1, __ATOMIC_RELAXED);
+}
+
+static void add_stats(SM4_TRACE_STATS *out, const SM4_TRACE_STATS *s) {
+  out->calls += __atomic_load_n(&s->calls, __ATOMIC_RELAXED);
+  out->bytes += __atomic_load_n(&s->bytes, __ATOMIC_RELAXED);
+  out->blocks += __atomic_load_n(&s->blocks, __ATOMIC_RELAXED);
+  out->sampled += __atomic_load_n(&s->sampled, __ATOMIC_RELAXED);
+  out->cycles += __atomic_load_n(&s->cycles, __ATOMIC_RELAXED);
+  for (int i = 0; i < SM4_TRACE_BUCKETS; i++) {
+    out->hist[i] += __atomic_load_n(&s->hist[i], __ATOMIC_RELAXED);
+  }
+}
+
+void sm4_trace_snapshot(SM4_TRACE_STATS out[SM4_TRACE_SITES]) {
+  memset(out, 0, sizeof(SM4_TRACE_STATS) * SM4_TRACE_SITES);
+  pthread_mutex_lock(&threads_lock);
+  for (SM4_TRACE_THREAD *t = threads; t != NULL; t = t->next) {
+    for (int i = 0; i < SM4_TRACE_SITES; i++) {
+      add_stats(&out[i], &t->site[i]);
+    }
+  }
+  pthread_mutex_unlock(&threads_lock);
+  for (int i = 0; i < SM4_TRACE_SITES; i++) {
+    add_stats(&out[i], &fallback.site[i]);
+  }
+}
+
+#else
+
+int sm4_trace_compiled(void) { return 0; }
+
+void sm4_trace_set_sample_period(unsigned period) { (void)period; }
+
+void sm4_trace_snapshot(SM4_TRACE_STATS out[SM4_TRACE_SITES]) {
+  memset(out, 0, sizeof(SM4_TRACE_STATS) * SM4_TRACE_SITES);
+}
+
+#endif
+
+// 计数器用 _total 后缀；第 b 桶为 [2^b, 2^(b+1)) 个周期，Prometheus 的 le
+// 含上界，因此输出 le = 2^(b+1) - 1。每次输出同样的一组桶，桶计数按累计值输出
+int sm4_trace_dump(FILE *f) {
+  static const char *const COUNTERS[] = {"calls", "bytes", "blocks",
+                                         "sampled_calls", "sampled_cycles"};
+  SM4_TRACE_STATS stats[SM4_TRACE_SITES];
+  int lines = 0;
+  sm4_trace_snapshot(stats);
+
+  for (int c = 0; c < 5; c++) {
+    fprintf(f, "# TYPE sm4_%s_total counter\n", COUNTERS[c]);
+    lines++;
+    for (int i = 0; i < SM4_TRACE_SITES; i++) {
+      const SM4_TRACE_STATS *s = &stats[i];
+      uint64_t v[5] = {s->calls, s->bytes, s->blocks, s->sampled, s->cycles};
+      if (s->calls > 0) {
+        fprintf(f, "sm4_%s_total{site=\"%s\"} %llu\n", COUNTERS[c],
+                SITE_NAMES[i], (unsigned long long)v[c]);
+        lines++;
+      }
+    }
+  }
+
+  fprintf(f, "# TYPE sm4_latency_cycles histogram\n");
+  lines++;
+  for (int i = 0; i < SM4_TRACE_SITES; i++) {
+    const SM4_TRACE_STATS *s = &stats[i];
+    if (s->sampled == 0) {
+      continue;
+    }
+    uint64_t cum = 0;
+    for (int b = 0; b < SM4_TRACE_BUCKETS - 1; b++) {
+      cum += s->hist[b];
+      fprintf(f, "sm4_latency_cycles_bucket{site=\"%s\",le=\"%llu\"} %llu\n",
+              SITE_NAMES[i], (2ULL << b) - 1, (unsigned long long)cum);
+      lines++;
+    }
+    fprintf(f, "sm4_latency_cycles_bucket{site=\"%s\",le=\"+Inf\"} %llu\n",
+            SITE_NAMES[i], (unsigned long long)s->sampled);
+    fprintf(f, "sm4_latency_cycles_sum{site=\"%s\"} %llu\n", SITE_NAMES[i],
+            (unsigned long long)s->cycles);
+    fprintf(f, "sm4_latency_cycles_count{site=\"%s\"} %llu\n", SITE_NAMES[i],
+            (unsigned long long)s->sampled);
+    lines += 3;
+  }
+  return lines;
+}
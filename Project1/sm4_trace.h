@@ -0,0 +1,169 @@
+#ifndef SM4_TRACE_H
+#define SM4_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 热路径插桩：用 -DSM4_TRACE（make TRACE=1）编译时，各后端的多块入口、
+// 工作模式、GCTR、GHASH 与 gcm_sm4_* 在入口和出口处更新本线程的计数器
+// （调用次数、字节数、分组数），每 sample_period 次调用用 rdtsc 计一次
+// 周期数并记入按 2 的幂分桶的延迟直方图；系统有 <sys/sdt.h> 时同时放置
+// USDT 探针 sm4:entry(site, bytes) 与 sm4:exit(site, bytes, cycles)，
+// cycles 在未采样的调用中为 0。未定义 SM4_TRACE 时插桩宏展开为空，
+// 下面的查询接口仍可链接，快照全为 0
+
+// 插桩点，名字见 sm4_trace_site_name
+typedef enum {
+  SM4_TRACE_REF = 0, // 各后端的多块/多密钥入口，名字与 SM4_ENGINE 相同
+  SM4_TRACE_TTABLE,
+  SM4_TRACE_TTABLE1K,
+  SM4_TRACE_SBOX,
+  SM4_TRACE_TTABLE4K,
+  SM4_TRACE_AESNI,
+  SM4_TRACE_GATHER,
+  SM4_TRACE_AVX2,
+  SM4_TRACE_BITSLICE,
+  SM4_TRACE_CTR, // 工作模式
+  SM4_TRACE_CBC,
+  SM4_TRACE_XTS,
+  SM4_TRACE_CCM,
+  SM4_TRACE_DRBG,
+  SM4_TRACE_MT,
+  SM4_TRACE_GCTR, // GCM
+  SM4_TRACE_GHASH,
+  SM4_TRACE_GHASH_TABLE,
+  SM4_TRACE_GCM_INIT,
+  SM4_TRACE_GCM_AAD,
+  SM4_TRACE_GCM_ENCRYPT,
+  SM4_TRACE_GCM_DECRYPT,
+  SM4_TRACE_GCM_TAG,
+  SM4_TRACE_SITES
+} SM4_TRACE_SITE;
+
+// 直方图第 i 桶为 [2^i, 2^(i+1)) 个周期（第 0 桶含 0），最后一桶不设上限
+#define SM4_TRACE_BUCKETS 32
+
+// 一个插桩点的统计；线程各自一份，按缓存行对齐，互不共享缓存行
+typedef struct {
+  uint64_t calls;
+  uint64_t bytes;
+  uint64_t blocks;
+  uint64_t sampled; // 计了周期的调用次数
+  uint64_t cycles;  // 采样调用的周期数之和
+  uint64_t hist[SM4_TRACE_BUCKETS];
+} __attribute__((aligned(64))) SM4_TRACE_STATS;
+
+// 是否编入了插桩
+int sm4_trace_compiled(void);
+
+const char *sm4_trace_site_name(SM4_TRACE_SITE site);
+
+// 每 period 次调用采样一次周期数，向上取整到 2 的幂，1 表示每次都计
+void sm4_trace_set_sample_period(unsigned period);
+
+// 汇总所有线程（含已退出的线程）的统计。计数只增不减，调用方用两次快照的
+// 差值得到区间内的数据
+void sm4_trace_snapshot(SM4_TRACE_STATS out[SM4_TRACE_SITES]);
+
+// 由直方图估计采样周期数的分位数（0 < q <= 1），返回所在桶的上界
+// （含，即 2^(i+1) - 1）
+uint64_t sm4_trace_percentile(const SM4_TRACE_STATS *stats, double q);
+
+// 以 Prometheus 文本格式输出有调用的插桩点，返回写入的行数
+int sm4_trace_dump(FILE *f);
+
+#ifdef SM4_TRACE
+
+#include <x86intrin.h>
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SM4_PROBE_ENTRY(site, bytes) DTRACE_PROBE2(sm4, entry, site, bytes)
+#define SM4_PROBE_EXIT(site, bytes, cycles)                                    \
+  DTRACE_PROBE3(sm4, exit, site, bytes, cycles)
+#endif
+#endif
+#ifndef SM4_PROBE_ENTRY
+#define SM4_PROBE_ENTRY(site, bytes) ((void)0)
+#define SM4_PROBE_EXIT(site, bytes, cycles) ((void)0)
+#endif
+
+// 所有线程的统计块串成链表，线程退出后留给新线程复用
+typedef struct SM4_TRACE_THREAD {
+  SM4_TRACE_STATS site[SM4_TRACE_SITES];
+  struct SM4_TRACE_THREAD *next;
+  int retired;
+} SM4_TRACE_THREAD;
+
+typedef struct {
+  SM4_TRACE_SITE site;
+  size_t bytes;
+  size_t blocks;
+  uint64_t start; // 0 表示本次不采样
+} SM4_TRACE_SPAN;
+
+extern __thread SM4_TRACE_THREAD *sm4_trace_self;
+extern unsigned sm4_trace_sample_mask;
+
+// 为调用线程分配（或复用）统计块
+SM4_TRACE_THREAD *sm4_trace_attach(void);
+
+static inline SM4_TRACE_STATS *sm4_trace_stats(SM4_TRACE_SITE site) {
+  SM4_TRACE_THREAD *t = sm4_trace_self;
+  if (__builtin_expect(t == NULL, 0)) {
+    t = sm4_trace_attach();
+  }
+  return &t->site[site];
+}
+
+// 只有所属线程写、快照线程只读：relaxed 读写即可避免撕裂，不需要 lock 前缀
+static inline void sm4_trace_add(uint64_t *p, uint64_t v) {
+  __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + v,
+                   __ATOMIC_RELAXED);
+}
+
+static inline SM4_TRACE_SPAN sm4_trace_begin(SM4_TRACE_SITE site,
+                                             size_t bytes, size_t blocks) {
+  SM4_TRACE_SPAN span = {site, bytes, blocks, 0};
+  SM4_PROBE_ENTRY(site, bytes);
+  if ((sm4_trace_stats(site)->calls & sm4_trace_sample_mask) == 0) {
+    span.start = __rdtsc();
+  }
+  return span;
+}
+
+static inline void sm4_trace_end(const SM4_TRACE_SPAN *span) {
+  SM4_TRACE_STATS *s = sm4_trace_stats(span->site);
+  uint64_t cycles = 0;
+  if (span->start != 0) {
+    cycles = __rdtsc() - span->start;
+    int bucket = cycles == 0 ? 0 : 63 - __builtin_clzll(cycles);
+    if (bucket >= SM4_TRACE_BUCKETS) {
+      bucket = SM4_TRACE_BUCKETS - 1;
+    }
+    sm4_trace_add(&s->sampled, 1);
+    sm4_trace_add(&s->cycles, cycles);
+    sm4_trace_add(&s->hist[bucket], 1);
+  }
+  sm4_trace_add(&s->calls, 1);
+  sm4_trace_add(&s->bytes, span->bytes);
+  sm4_trace_add(&s->blocks, span->blocks);
+  SM4_PROBE_EXIT(span->site, span->bytes, cycles);
+}
+
+// 用法：函数开头 SM4_TRACE_BEGIN(插桩点, 字节数, 分组数)，返回前
+// SM4_TRACE_END()。每个函数（作用域）只能有一对
+#define SM4_TRACE_BEGIN(site, bytes, blocks)                                   \
+  SM4_TRACE_SPAN sm4_trace_span_ = sm4_trace_begin(site, bytes, blocks)
+#define SM4_TRACE_END() sm4_trace_end(&sm4_trace_span_)
+
+#else
+
+#define SM4_TRACE_BEGIN(site, bytes, blocks) ((void)0)
+#define SM4_TRACE_END() ((void)0)
+
+#endif
+
+#endif
@@ -1,8 +1,10 @@
 #include "sm4_ttable.h"
+#include "sm4_trace.h"
 #include <stdlib.h>
+#include <string.h>
 
-// 4个T表
-static uint32_t Table0[256] = {
+// 4个T表（AVX2 gather 后端共用）
+const uint32_t Table0[256] = {
     0x8ED55B5B, 0xD0924242, 0x4DEAA7A7, 0x06FDFBFB, 0xFCCF3333, 0x65E28787,
     0xC93DF4F4, 0x6BB5DEDE, 0x4E165858, 0x6EB4DADA, 0x44145050, 0xCAC10B0B,
     0x8828A0A0, 0x17F8EFEF, 0x9C2CB0B0, 0x11051414, 0x872BACAC, 0xFB669D9D,
@@ -47,7 +49,7 @@ static uint32_t Table0[256] = {
     0x794C3535, 0xA0208080, 0x9D78E5E5, 0x56EDBBBB, 0x235E7D7D, 0xC63EF8F8,
     0x8BD45F5F, 0xE7C82F2F, 0xDD39E4E4, 0x68492121};
 
-static uint32_t Table1[256] = {
+const uint32_t Table1[256] = {
     0x5B8ED55B, 0x42D09242, 0xA74DEAA7, 0xFB06FDFB, 0x33FCCF33, 0x8765E287,
     0xF4C93DF4, 0xDE6BB5DE, 0x584E1658, 0xDA6EB4DA, 0x50441450, 0x0BCAC10B,
     0xA08828A0, 0xEF17F8EF, 0xB09C2CB0, 0x14110514, 0xAC872BAC, 0x9DFB669D,
@@ -92,7 +94,7 @@ static uint32_t Table1[256] = {
     0x35794C35, 0x80A02080, 0xE59D78E5, 0xBB56EDBB, 0x7D235E7D, 0xF8C63EF8,
     0x5F8BD45F, 0x2FE7C82F, 0xE4DD39E4, 0x21684921};
 
-static uint32_t Table2[256] = {
+const uint32_t Table2[256] = {
     0x5B5B8ED5, 0x4242D092, 0xA7A74DEA, 0xFBFB06FD, 0x3333FCCF, 0x878765E2,
     0xF4F4C93D, 0xDEDE6BB5, 0x58584E16, 0xDADA6EB4, 0x50504414, 0x0B0BCAC1,
     0xA0A08828, 0xEFEF17F8, 0xB0B09C2C, 0x14141105, 0xACAC872B, 0x9D9DFB66,
@@ -137,7 +139,7 @@ static uint32_t Table2[256] = {
     0x3535794C, 0x8080A020, 0xE5E59D78, 0xBBBB56ED, 0x7D7D235E, 0xF8F8C63E,
     0x5F5F8BD4, 0x2F2FE7C8, 0xE4E4DD39, 0x21216849};
 
-static uint32_t Table3[256] = {
+const uint32_t Table3[256] = {
     0xD55B5B8E, 0x924242D0, 0xEAA7A74D, 0xFDFBFB06, 0xCF3333FC, 0xE2878765,
     0x3DF4F4C9, 0xB5DEDE6B, 0x1658584E, 0xB4DADA6E, 0x14505044, 0xC10B0BCA,
     0x28A0A088, 0xF8EFEF17, 0x2CB0B09C, 0x05141411, 0x2BACAC87, 0x669D9DFB,
@@ -182,51 +184,517 @@ static uint32_t Table3[256] = {
     0x4C353579, 0x208080A0, 0x78E5E59D, 0xEDBBBB56, 0x5E7D7D23, 0x3EF8F8C6,
     0xD45F5F8B, 0xC82F2FE7, 0x39E4E4DD, 0x49212168};
 
+// 紧凑布局：4 个 T 表共 4 KB，与应用争用 L1 时可能被挤出。另外三种布局
+// 结果相同，只是表的大小与排列不同，作为独立后端登记，由 SM4_ENGINE 选择：
+//   ttable1k：只查 Table0，其余 3 个字节的结果循环移位得到（1 KB）；
+//   sbox：    8 位 S 盒逐字节代换，再直接计算线性变换 L（256 B）；
+//   ttable4k：4 个表按字节值交错为 256 行 × 16 B，按缓存行对齐（4 KB）
+
+// 8 位 S 盒（与 sm4.c 相同），4 行缓存
+static const uint8_t Sbox8[256] __attribute__((aligned(64))) = {
+    0xD6, 0x90, 0xE9, 0xFE, 0xCC, 0xE1, 0x3D, 0xB7, 0x16, 0xB6, 0x14, 0xC2,
+    0x28, 0xFB, 0x2C, 0x05, 0x2B, 0x67, 0x9A, 0x76, 0x2A, 0xBE, 0x04, 0xC3,
+    0xAA, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99, 0x9C, 0x42, 0x50, 0xF4,
+    0x91, 0xEF, 0x98, 0x7A, 0x33, 0x54, 0x0B, 0x43, 0xED, 0xCF, 0xAC, 0x62,
+    0xE4, 0xB3, 0x1C, 0xA9, 0xC9, 0x08, 0xE8, 0x95, 0x80, 0xDF, 0x94, 0xFA,
+    0x75, 0x8F, 0x3F, 0xA6, 0x47, 0x07, 0xA7, 0xFC, 0xF3, 0x73, 0x17, 0xBA,
+    0x83, 0x59, 0x3C, 0x19, 0xE6, 0x85, 0x4F, 0xA8, 0x68, 0x6B, 0x81, 0xB2,
+    0x71, 0x64, 0xDA, 0x8B, 0xF8, 0xEB, 0x0F, 0x4B, 0x70, 0x56, 0x9D, 0x35,
+    0x1E, 0x24, 0x0E, 0x5E, 0x63, 0x58, 0xD1, 0xA2, 0x25, 0x22, 0x7C, 0x3B,
+    0x01, 0x21, 0x78, 0x87, 0xD4, 0x00, 0x46, 0x57, 0x9F, 0xD3, 0x27, 0x52,
+    0x4C, 0x36, 0x02, 0xE7, 0xA0, 0xC4, 0xC8, 0x9E, 0xEA, 0xBF, 0x8A, 0xD2,
+    0x40, 0xC7, 0x38, 0xB5, 0xA3, 0xF7, 0xF2, 0xCE, 0xF9, 0x61, 0x15, 0xA1,
+    0xE0, 0xAE, 0x5D, 0xA4, 0x9B, 0x34, 0x1A, 0x55, 0xAD, 0x93, 0x32, 0x30,
+    0xF5, 0x8C, 0xB1, 0xE3, 0x1D, 0xF6, 0xE2, 0x2E, 0x82, 0x66, 0xCA, 0x60,
+    0xC0, 0x29, 0x23, 0xAB, 0x0D, 0x53, 0x4E, 0x6F, 0xD5, 0xDB, 0x37, 0x45,
+    0xDE, 0xFD, 0x8E, 0x2F, 0x03, 0xFF, 0x6A, 0x72, 0x6D, 0x6C, 0x5B, 0x51,
+    0x8D, 0x1B, 0xAF, 0x92, 0xBB, 0xDD, 0xBC, 0x7F, 0x11, 0xD9, 0x5C, 0x41,
+    0x1F, 0x10, 0x5A, 0xD8, 0x0A, 0xC1, 0x31, 0x88, 0xA5, 0xCD, 0x7B, 0xBD,
+    0x2D, 0x74, 0xD0, 0x12, 0xB8, 0xE5, 0xB4, 0xB0, 0x89, 0x69, 0x97, 0x4A,
+    0x0C, 0x96, 0x77, 0x7E, 0x65, 0xB9, 0xF1, 0x09, 0xC5, 0x6E, 0xC6, 0x84,
+    0x18, 0xF0, 0x7D, 0xEC, 0x3A, 0xDC, 0x4D, 0x20, 0x79, 0xEE, 0x5F, 0x3E,
+    0xD7, 0xCB, 0x39, 0x48};
+
+// 交错 T 表：Table4K[b] = {Table0[b], Table1[b], Table2[b], Table3[b]}，
+// 一行缓存放 4 个字节值的全部 4 项
+static const uint32_t Table4K[256][4] __attribute__((aligned(64))) = {
+    {0x8ED55B5B, 0x5B8ED55B, 0x5B5B8ED5, 0xD55B5B8E},
+    {0xD0924242, 0x42D09242, 0x4242D092, 0x924242D0},
+    {0x4DEAA7A7, 0xA74DEAA7, 0xA7A74DEA, 0xEAA7A74D},
+    {0x06FDFBFB, 0xFB06FDFB, 0xFBFB06FD, 0xFDFBFB06},
+    {0xFCCF3333, 0x33FCCF33, 0x3333FCCF, 0xCF3333FC},
+    {0x65E28787, 0x8765E287, 0x878765E2, 0xE2878765},
+    {0xC93DF4F4, 0xF4C93DF4, 0xF4F4C93D, 0x3DF4F4C9},
+    {0x6BB5DEDE, 0xDE6BB5DE, 0xDEDE6BB5, 0xB5DEDE6B},
+    {0x4E165858, 0x584E1658, 0x58584E16, 0x1658584E},
+    {0x6EB4DADA, 0xDA6EB4DA, 0xDADA6EB4, 0xB4DADA6E},
+    {0x44145050, 0x50441450, 0x50504414, 0x14505044},
+    {0xCAC10B0B, 0x0BCAC10B, 0x0B0BCAC1, 0xC10B0BCA},
+    {0x8828A0A0, 0xA08828A0, 0xA0A08828, 0x28A0A088},
+    {0x17F8EFEF, 0xEF17F8EF, 0xEFEF17F8, 0xF8EFEF17},
+    {0x9C2CB0B0, 0xB09C2CB0, 0xB0B09C2C, 0x2CB0B09C},
+    {0x11051414, 0x14110514, 0x14141105, 0x05141411},
+    {0x872BACAC, 0xAC872BAC, 0xACAC872B, 0x2BACAC87},
+    {0xFB669D9D, 0x9DFB669D, 0x9D9DFB66, 0x669D9DFB},
+    {0xF2986A6A, 0x6AF2986A, 0x6A6AF298, 0x986A6AF2},
+    {0xAE77D9D9, 0xD9AE77D9, 0xD9D9AE77, 0x77D9D9AE},
+    {0x822AA8A8, 0xA8822AA8, 0xA8A8822A, 0x2AA8A882},
+    {0x46BCFAFA, 0xFA46BCFA, 0xFAFA46BC, 0xBCFAFA46},
+    {0x14041010, 0x10140410, 0x10101404, 0x04101014},
+    {0xCFC00F0F, 0x0FCFC00F, 0x0F0FCFC0, 0xC00F0FCF},
+    {0x02A8AAAA, 0xAA02A8AA, 0xAAAA02A8, 0xA8AAAA02},
+    {0x54451111, 0x11544511, 0x11115445, 0x45111154},
+    {0x5F134C4C, 0x4C5F134C, 0x4C4C5F13, 0x134C4C5F},
+    {0xBE269898, 0x98BE2698, 0x9898BE26, 0x269898BE},
+    {0x6D482525, 0x256D4825, 0x25256D48, 0x4825256D},
+    {0x9E841A1A, 0x1A9E841A, 0x1A1A9E84, 0x841A1A9E},
+    {0x1E061818, 0x181E0618, 0x18181E06, 0x0618181E},
+    {0xFD9B6666, 0x66FD9B66, 0x6666FD9B, 0x9B6666FD},
+    {0xEC9E7272, 0x72EC9E72, 0x7272EC9E, 0x9E7272EC},
+    {0x4A430909, 0x094A4309, 0x09094A43, 0x4309094A},
+    {0x10514141, 0x41105141, 0x41411051, 0x51414110},
+    {0x24F7D3D3, 0xD324F7D3, 0xD3D324F7, 0xF7D3D324},
+    {0xD5934646, 0x46D59346, 0x4646D593, 0x934646D5},
+    {0x53ECBFBF, 0xBF53ECBF, 0xBFBF53EC, 0xECBFBF53},
+    {0xF89A6262, 0x62F89A62, 0x6262F89A, 0x9A6262F8},
+    {0x927BE9E9, 0xE9927BE9, 0xE9E9927B, 0x7BE9E992},
+    {0xFF33CCCC, 0xCCFF33CC, 0xCCCCFF33, 0x33CCCCFF},
+    {0x04555151, 0x51045551, 0x51510455, 0x55515104},
+    {0x270B2C2C, 0x2C270B2C, 0x2C2C270B, 0x0B2C2C27},
+    {0x4F420D0D, 0x0D4F420D, 0x0D0D4F42, 0x420D0D4F},
+    {0x59EEB7B7, 0xB759EEB7, 0xB7B759EE, 0xEEB7B759},
+    {0xF3CC3F3F, 0x3FF3CC3F, 0x3F3FF3CC, 0xCC3F3FF3},
+    {0x1CAEB2B2, 0xB21CAEB2, 0xB2B21CAE, 0xAEB2B21C},
+    {0xEA638989, 0x89EA6389, 0x8989EA63, 0x638989EA},
+    {0x74E79393, 0x9374E793, 0x939374E7, 0xE7939374},
+    {0x7FB1CECE, 0xCE7FB1CE, 0xCECE7FB1, 0xB1CECE7F},
+    {0x6C1C7070, 0x706C1C70, 0x70706C1C, 0x1C70706C},
+    {0x0DABA6A6, 0xA60DABA6, 0xA6A60DAB, 0xABA6A60D},
+    {0xEDCA2727, 0x27EDCA27, 0x2727EDCA, 0xCA2727ED},
+    {0x28082020, 0x20280820, 0x20202808, 0x08202028},
+    {0x48EBA3A3, 0xA348EBA3, 0xA3A348EB, 0xEBA3A348},
+    {0xC1975656, 0x56C19756, 0x5656C197, 0x975656C1},
+    {0x80820202, 0x02808202, 0x02028082, 0x82020280},
+    {0xA3DC7F7F, 0x7FA3DC7F, 0x7F7FA3DC, 0xDC7F7FA3},
+    {0xC4965252, 0x52C49652, 0x5252C496, 0x965252C4},
+    {0x12F9EBEB, 0xEB12F9EB, 0xEBEB12F9, 0xF9EBEB12},
+    {0xA174D5D5, 0xD5A174D5, 0xD5D5A174, 0x74D5D5A1},
+    {0xB38D3E3E, 0x3EB38D3E, 0x3E3EB38D, 0x8D3E3EB3},
+    {0xC33FFCFC, 0xFCC33FFC, 0xFCFCC33F, 0x3FFCFCC3},
+    {0x3EA49A9A, 0x9A3EA49A, 0x9A9A3EA4, 0xA49A9A3E},
+    {0x5B461D1D, 0x1D5B461D, 0x1D1D5B46, 0x461D1D5B},
+    {0x1B071C1C, 0x1C1B071C, 0x1C1C1B07, 0x071C1C1B},
+    {0x3BA59E9E, 0x9E3BA59E, 0x9E9E3BA5, 0xA59E9E3B},
+    {0x0CFFF3F3, 0xF30CFFF3, 0xF3F30CFF, 0xFFF3F30C},
+    {0x3FF0CFCF, 0xCF3FF0CF, 0xCFCF3FF0, 0xF0CFCF3F},
+    {0xBF72CDCD, 0xCDBF72CD, 0xCDCDBF72, 0x72CDCDBF},
+    {0x4B175C5C, 0x5C4B175C, 0x5C5C4B17, 0x175C5C4B},
+    {0x52B8EAEA, 0xEA52B8EA, 0xEAEA52B8, 0xB8EAEA52},
+    {0x8F810E0E, 0x0E8F810E, 0x0E0E8F81, 0x810E0E8F},
+    {0x3D586565, 0x653D5865, 0x65653D58, 0x5865653D},
+    {0xCC3CF0F0, 0xF0CC3CF0, 0xF0F0CC3C, 0x3CF0F0CC},
+    {0x7D196464, 0x647D1964, 0x64647D19, 0x1964647D},
+    {0x7EE59B9B, 0x9B7EE59B, 0x9B9B7EE5, 0xE59B9B7E},
+    {0x91871616, 0x16918716, 0x16169187, 0x87161691},
+    {0x734E3D3D, 0x3D734E3D, 0x3D3D734E, 0x4E3D3D73},
+    {0x08AAA2A2, 0xA208AAA2, 0xA2A208AA, 0xAAA2A208},
+    {0xC869A1A1, 0xA1C869A1, 0xA1A1C869, 0x69A1A1C8},
+    {0xC76AADAD, 0xADC76AAD, 0xADADC76A, 0x6AADADC7},
+    {0x85830606, 0x06858306, 0x06068583, 0x83060685},
+    {0x7AB0CACA, 0xCA7AB0CA, 0xCACA7AB0, 0xB0CACA7A},
+    {0xB570C5C5, 0xC5B570C5, 0xC5C5B570, 0x70C5C5B5},
+    {0xF4659191, 0x91F46591, 0x9191F465, 0x659191F4},
+    {0xB2D96B6B, 0x6BB2D96B, 0x6B6BB2D9, 0xD96B6BB2},
+    {0xA7892E2E, 0x2EA7892E, 0x2E2EA789, 0x892E2EA7},
+    {0x18FBE3E3, 0xE318FBE3, 0xE3E318FB, 0xFBE3E318},
+    {0x47E8AFAF, 0xAF47E8AF, 0xAFAF47E8, 0xE8AFAF47},
+    {0x330F3C3C, 0x3C330F3C, 0x3C3C330F, 0x0F3C3C33},
+    {0x674A2D2D, 0x2D674A2D, 0x2D2D674A, 0x4A2D2D67},
+    {0xB071C1C1, 0xC1B071C1, 0xC1C1B071, 0x71C1C1B0},
+    {0x0E575959, 0x590E5759, 0x59590E57, 0x5759590E},
+    {0xE99F7676, 0x76E99F76, 0x7676E99F, 0x9F7676E9},
+    {0xE135D4D4, 0xD4E135D4, 0xD4D4E135, 0x35D4D4E1},
+    {0x661E7878, 0x78661E78, 0x7878661E, 0x1E787866},
+    {0xB4249090, 0x90B42490, 0x9090B424, 0x249090B4},
+    {0x360E3838, 0x38360E38, 0x3838360E, 0x0E383836},
+    {0x265F7979, 0x79265F79, 0x7979265F, 0x5F797926},
+    {0xEF628D8D, 0x8DEF628D, 0x8D8DEF62, 0x628D8DEF},
+    {0x38596161, 0x61385961, 0x61613859, 0x59616138},
+    {0x95D24747, 0x4795D247, 0x474795D2, 0xD2474795},
+    {0x2AA08A8A, 0x8A2AA08A, 0x8A8A2AA0, 0xA08A8A2A},
+    {0xB1259494, 0x94B12594, 0x9494B125, 0x259494B1},
+    {0xAA228888, 0x88AA2288, 0x8888AA22, 0x228888AA},
+    {0x8C7DF1F1, 0xF18C7DF1, 0xF1F18C7D, 0x7DF1F18C},
+    {0xD73BECEC, 0xECD73BEC, 0xECECD73B, 0x3BECECD7},
+    {0x05010404, 0x04050104, 0x04040501, 0x01040405},
+    {0xA5218484, 0x84A52184, 0x8484A521, 0x218484A5},
+    {0x9879E1E1, 0xE19879E1, 0xE1E19879, 0x79E1E198},
+    {0x9B851E1E, 0x1E9B851E, 0x1E1E9B85, 0x851E1E9B},
+    {0x84D75353, 0x5384D753, 0x535384D7, 0xD7535384},
+    {0x00000000, 0x00000000, 0x00000000, 0x00000000},
+    {0x5E471919, 0x195E4719, 0x19195E47, 0x4719195E},
+    {0x0B565D5D, 0x5D0B565D, 0x5D5D0B56, 0x565D5D0B},
+    {0xE39D7E7E, 0x7EE39D7E, 0x7E7EE39D, 0x9D7E7EE3},
+    {0x9FD04F4F, 0x4F9FD04F, 0x4F4F9FD0, 0xD04F4F9F},
+    {0xBB279C9C, 0x9CBB279C, 0x9C9CBB27, 0x279C9CBB},
+    {0x1A534949, 0x491A5349, 0x49491A53, 0x5349491A},
+    {0x7C4D3131, 0x317C4D31, 0x31317C4D, 0x4D31317C},
+    {0xEE36D8D8, 0xD8EE36D8, 0xD8D8EE36, 0x36D8D8EE},
+    {0x0A020808, 0x080A0208, 0x08080A02, 0x0208080A},
+    {0x7BE49F9F, 0x9F7BE49F, 0x9F9F7BE4, 0xE49F9F7B},
+    {0x20A28282, 0x8220A282, 0x828220A2, 0xA2828220},
+    {0xD4C71313, 0x13D4C713, 0x1313D4C7, 0xC71313D4},
+    {0xE8CB2323, 0x23E8CB23, 0x2323E8CB, 0xCB2323E8},
+    {0xE69C7A7A, 0x7AE69C7A, 0x7A7AE69C, 0x9C7A7AE6},
+    {0x42E9ABAB, 0xAB42E9AB, 0xABAB42E9, 0xE9ABAB42},
+    {0x43BDFEFE, 0xFE43BDFE, 0xFEFE43BD, 0xBDFEFE43},
+    {0xA2882A2A, 0x2AA2882A, 0x2A2AA288, 0x882A2AA2},
+    {0x9AD14B4B, 0x4B9AD14B, 0x4B4B9AD1, 0xD14B4B9A},
+    {0x40410101, 0x01404101, 0x01014041, 0x41010140},
+    {0xDBC41F1F, 0x1FDBC41F, 0x1F1FDBC4, 0xC41F1FDB},
+    {0xD838E0E0, 0xE0D838E0, 0xE0E0D838, 0x38E0E0D8},
+    {0x61B7D6D6, 0xD661B7D6, 0xD6D661B7, 0xB7D6D661},
+    {0x2FA18E8E, 0x8E2FA18E, 0x8E8E2FA1, 0xA18E8E2F},
+    {0x2BF4DFDF, 0xDF2BF4DF, 0xDFDF2BF4, 0xF4DFDF2B},
+    {0x3AF1CBCB, 0xCB3AF1CB, 0xCBCB3AF1, 0xF1CBCB3A},
+    {0xF6CD3B3B, 0x3BF6CD3B, 0x3B3BF6CD, 0xCD3B3BF6},
+    {0x1DFAE7E7, 0xE71DFAE7, 0xE7E71DFA, 0xFAE7E71D},
+    {0xE5608585, 0x85E56085, 0x8585E560, 0x608585E5},
+    {0x41155454, 0x54411554, 0x54544115, 0x15545441},
+    {0x25A38686, 0x8625A386, 0x868625A3, 0xA3868625},
+    {0x60E38383, 0x8360E383, 0x838360E3, 0xE3838360},
+    {0x16ACBABA, 0xBA16ACBA, 0xBABA16AC, 0xACBABA16},
+    {0x295C7575, 0x75295C75, 0x7575295C, 0x5C757529},
+    {0x34A69292, 0x9234A692, 0x929234A6, 0xA6929234},
+    {0xF7996E6E, 0x6EF7996E, 0x6E6EF799, 0x996E6EF7},
+    {0xE434D0D0, 0xD0E434D0, 0xD0D0E434, 0x34D0D0E4},
+    {0x721A6868, 0x68721A68, 0x6868721A, 0x1A686872},
+    {0x01545555, 0x55015455, 0x55550154, 0x54555501},
+    {0x19AFB6B6, 0xB619AFB6, 0xB6B619AF, 0xAFB6B619},
+    {0xDF914E4E, 0x4EDF914E, 0x4E4EDF91, 0x914E4EDF},
+    {0xFA32C8C8, 0xC8FA32C8, 0xC8C8FA32, 0x32C8C8FA},
+    {0xF030C0C0, 0xC0F030C0, 0xC0C0F030, 0x30C0C0F0},
+    {0x21F6D7D7, 0xD721F6D7, 0xD7D721F6, 0xF6D7D721},
+    {0xBC8E3232, 0x32BC8E32, 0x3232BC8E, 0x8E3232BC},
+    {0x75B3C6C6, 0xC675B3C6, 0xC6C675B3, 0xB3C6C675},
+    {0x6FE08F8F, 0x8F6FE08F, 0x8F8F6FE0, 0xE08F8F6F},
+    {0x691D7474, 0x74691D74, 0x7474691D, 0x1D747469},
+    {0x2EF5DBDB, 0xDB2EF5DB, 0xDBDB2EF5, 0xF5DBDB2E},
+    {0x6AE18B8B, 0x8B6AE18B, 0x8B8B6AE1, 0xE18B8B6A},
+    {0x962EB8B8, 0xB8962EB8, 0xB8B8962E, 0x2EB8B896},
+    {0x8A800A0A, 0x0A8A800A, 0x0A0A8A80, 0x800A0A8A},
+    {0xFE679999, 0x99FE6799, 0x9999FE67, 0x679999FE},
+    {0xE2C92B2B, 0x2BE2C92B, 0x2B2BE2C9, 0xC92B2BE2},
+    {0xE0618181, 0x81E06181, 0x8181E061, 0x618181E0},
+    {0xC0C30303, 0x03C0C303, 0x0303C0C3, 0xC30303C0},
+    {0x8D29A4A4, 0xA48D29A4, 0xA4A48D29, 0x29A4A48D},
+    {0xAF238C8C, 0x8CAF238C, 0x8C8CAF23, 0x238C8CAF},
+    {0x07A9AEAE, 0xAE07A9AE, 0xAEAE07A9, 0xA9AEAE07},
+    {0x390D3434, 0x34390D34, 0x3434390D, 0x0D343439},
+    {0x1F524D4D, 0x4D1F524D, 0x4D4D1F52, 0x524D4D1F},
+    {0x764F3939, 0x39764F39, 0x3939764F, 0x4F393976},
+    {0xD36EBDBD, 0xBDD36EBD, 0xBDBDD36E, 0x6EBDBDD3},
+    {0x81D65757, 0x5781D657, 0x575781D6, 0xD6575781},
+    {0xB7D86F6F, 0x6FB7D86F, 0x6F6FB7D8, 0xD86F6FB7},
+    {0xEB37DCDC, 0xDCEB37DC, 0xDCDCEB37, 0x37DCDCEB},
+    {0x51441515, 0x15514415, 0x15155144, 0x44151551},
+    {0xA6DD7B7B, 0x7BA6DD7B, 0x7B7BA6DD, 0xDD7B7BA6},
+    {0x09FEF7F7, 0xF709FEF7, 0xF7F709FE, 0xFEF7F709},
+    {0xB68C3A3A, 0x3AB68C3A, 0x3A3AB68C, 0x8C3A3AB6},
+    {0x932FBCBC, 0xBC932FBC, 0xBCBC932F, 0x2FBCBC93},
+    {0x0F030C0C, 0x0C0F030C, 0x0C0C0F03, 0x030C0C0F},
+    {0x03FCFFFF, 0xFF03FCFF, 0xFFFF03FC, 0xFCFFFF03},
+    {0xC26BA9A9, 0xA9C26BA9, 0xA9A9C26B, 0x6BA9A9C2},
+    {0xBA73C9C9, 0xC9BA73C9, 0xC9C9BA73, 0x73C9C9BA},
+    {0xD96CB5B5, 0xB5D96CB5, 0xB5B5D96C, 0x6CB5B5D9},
+    {0xDC6DB1B1, 0xB1DC6DB1, 0xB1B1DC6D, 0x6DB1B1DC},
+    {0x375A6D6D, 0x6D375A6D, 0x6D6D375A, 0x5A6D6D37},
+    {0x15504545, 0x45155045, 0x45451550, 0x50454515},
+    {0xB98F3636, 0x36B98F36, 0x3636B98F, 0x8F3636B9},
+    {0x771B6C6C, 0x6C771B6C, 0x6C6C771B, 0x1B6C6C77},
+    {0x13ADBEBE, 0xBE13ADBE, 0xBEBE13AD, 0xADBEBE13},
+    {0xDA904A4A, 0x4ADA904A, 0x4A4ADA90, 0x904A4ADA},
+    {0x57B9EEEE, 0xEE57B9EE, 0xEEEE57B9, 0xB9EEEE57},
+    {0xA9DE7777, 0x77A9DE77, 0x7777A9DE, 0xDE7777A9},
+    {0x4CBEF2F2, 0xF24CBEF2, 0xF2F24CBE, 0xBEF2F24C},
+    {0x837EFDFD, 0xFD837EFD, 0xFDFD837E, 0x7EFDFD83},
+    {0x55114444, 0x44551144, 0x44445511, 0x11444455},
+    {0xBDDA6767, 0x67BDDA67, 0x6767BDDA, 0xDA6767BD},
+    {0x2C5D7171, 0x712C5D71, 0x71712C5D, 0x5D71712C},
+    {0x45400505, 0x05454005, 0x05054540, 0x40050545},
+    {0x631F7C7C, 0x7C631F7C, 0x7C7C631F, 0x1F7C7C63},
+    {0x50104040, 0x40501040, 0x40405010, 0x10404050},
+    {0x325B6969, 0x69325B69, 0x6969325B, 0x5B696932},
+    {0xB8DB6363, 0x63B8DB63, 0x6363B8DB, 0xDB6363B8},
+    {0x220A2828, 0x28220A28, 0x2828220A, 0x0A282822},
+    {0xC5C20707, 0x07C5C207, 0x0707C5C2, 0xC20707C5},
+    {0xF531C4C4, 0xC4F531C4, 0xC4C4F531, 0x31C4C4F5},
+    {0xA88A2222, 0x22A88A22, 0x2222A88A, 0x8A2222A8},
+    {0x31A79696, 0x9631A796, 0x969631A7, 0xA7969631},
+    {0xF9CE3737, 0x37F9CE37, 0x3737F9CE, 0xCE3737F9},
+    {0x977AEDED, 0xED977AED, 0xEDED977A, 0x7AEDED97},
+    {0x49BFF6F6, 0xF649BFF6, 0xF6F649BF, 0xBFF6F649},
+    {0x992DB4B4, 0xB4992DB4, 0xB4B4992D, 0x2DB4B499},
+    {0xA475D1D1, 0xD1A475D1, 0xD1D1A475, 0x75D1D1A4},
+    {0x90D34343, 0x4390D343, 0x434390D3, 0xD3434390},
+    {0x5A124848, 0x485A1248, 0x48485A12, 0x1248485A},
+    {0x58BAE2E2, 0xE258BAE2, 0xE2E258BA, 0xBAE2E258},
+    {0x71E69797, 0x9771E697, 0x979771E6, 0xE6979771},
+    {0x64B6D2D2, 0xD264B6D2, 0xD2D264B6, 0xB6D2D264},
+    {0x70B2C2C2, 0xC270B2C2, 0xC2C270B2, 0xB2C2C270},
+    {0xAD8B2626, 0x26AD8B26, 0x2626AD8B, 0x8B2626AD},
+    {0xCD68A5A5, 0xA5CD68A5, 0xA5A5CD68, 0x68A5A5CD},
+    {0xCB955E5E, 0x5ECB955E, 0x5E5ECB95, 0x955E5ECB},
+    {0x624B2929, 0x29624B29, 0x2929624B, 0x4B292962},
+    {0x3C0C3030, 0x303C0C30, 0x30303C0C, 0x0C30303C},
+    {0xCE945A5A, 0x5ACE945A, 0x5A5ACE94, 0x945A5ACE},
+    {0xAB76DDDD, 0xDDAB76DD, 0xDDDDAB76, 0x76DDDDAB},
+    {0x867FF9F9, 0xF9867FF9, 0xF9F9867F, 0x7FF9F986},
+    {0xF1649595, 0x95F16495, 0x9595F164, 0x649595F1},
+    {0x5DBBE6E6, 0xE65DBBE6, 0xE6E65DBB, 0xBBE6E65D},
+    {0x35F2C7C7, 0xC735F2C7, 0xC7C735F2, 0xF2C7C735},
+    {0x2D092424, 0x242D0924, 0x24242D09, 0x0924242D},
+    {0xD1C61717, 0x17D1C617, 0x1717D1C6, 0xC61717D1},
+    {0xD66FB9B9, 0xB9D66FB9, 0xB9B9D66F, 0x6FB9B9D6},
+    {0xDEC51B1B, 0x1BDEC51B, 0x1B1BDEC5, 0xC51B1BDE},
+    {0x94861212, 0x12948612, 0x12129486, 0x86121294},
+    {0x78186060, 0x60781860, 0x60607818, 0x18606078},
+    {0x30F3C3C3, 0xC330F3C3, 0xC3C330F3, 0xF3C3C330},
+    {0x897CF5F5, 0xF5897CF5, 0xF5F5897C, 0x7CF5F589},
+    {0x5CEFB3B3, 0xB35CEFB3, 0xB3B35CEF, 0xEFB3B35C},
+    {0xD23AE8E8, 0xE8D23AE8, 0xE8E8D23A, 0x3AE8E8D2},
+    {0xACDF7373, 0x73ACDF73, 0x7373ACDF, 0xDF7373AC},
+    {0x794C3535, 0x35794C35, 0x3535794C, 0x4C353579},
+    {0xA0208080, 0x80A02080, 0x8080A020, 0x208080A0},
+    {0x9D78E5E5, 0xE59D78E5, 0xE5E59D78, 0x78E5E59D},
+    {0x56EDBBBB, 0xBB56EDBB, 0xBBBB56ED, 0xEDBBBB56},
+    {0x235E7D7D, 0x7D235E7D, 0x7D7D235E, 0x5E7D7D23},
+    {0xC63EF8F8, 0xF8C63EF8, 0xF8F8C63E, 0x3EF8F8C6},
+    {0x8BD45F5F, 0x5F8BD45F, 0x5F5F8BD4, 0xD45F5F8B},
+    {0xE7C82F2F, 0x2FE7C82F, 0x2F2FE7C8, 0xC82F2FE7},
+    {0xDD39E4E4, 0xE4DD39E4, 0xE4E4DD39, 0x39E4E4DD},
+    {0x68492121, 0x21684921, 0x21216849, 0x49212168},
+};
+
 #define rotl32(value, shift) ((value << shift) | value >> (32 - shift))
 
+// 查找表（S盒+线性变换）
+static inline uint32_t TTABLE_T(uint32_t x) {
+  return Table0[(x >> 24) & 0xFF] ^ Table1[(x >> 16) & 0xFF] ^
+         Table2[(x >> 8) & 0xFF] ^ Table3[x & 0xFF];
+}
+
+// Table1~Table3 分别是 Table0 循环右移 8/16/24 位
+static inline uint32_t TTABLE1K_T(uint32_t x) {
+  uint32_t a = Table0[(x >> 24) & 0xFF], b = Table0[(x >> 16) & 0xFF];
+  uint32_t c = Table0[(x >> 8) & 0xFF], d = Table0[x & 0xFF];
+  return a ^ rotl32(b, 24) ^ rotl32(c, 16) ^ rotl32(d, 8);
+}
+
+static inline uint32_t SBOX_T(uint32_t x) {
+  uint32_t b = (uint32_t)Sbox8[x >> 24] << 24 |
+               (uint32_t)Sbox8[(x >> 16) & 0xFF] << 16 |
+               (uint32_t)Sbox8[(x >> 8) & 0xFF] << 8 | Sbox8[x & 0xFF];
+  return b ^ rotl32(b, 2) ^ rotl32(b, 10) ^ rotl32(b, 18) ^ rotl32(b, 24);
+}
+
+static inline uint32_t TTABLE4K_T(uint32_t x) {
+  return Table4K[(x >> 24) & 0xFF][0] ^ Table4K[(x >> 16) & 0xFF][1] ^
+         Table4K[(x >> 8) & 0xFF][2] ^ Table4K[x & 0xFF][3];
+}
+
+// 单轮：结果写回 x0，寄存器角色靠宏参数轮换而不是数据搬移
+#define TTABLE_ROUND(t, x0, x1, x2, x3, k) (x0) ^= t((x1) ^ (x2) ^ (x3) ^ (k))
+
+#define TTABLE_ROUNDS4(t, rk, i)                                               \
+  TTABLE_ROUND(t, x0, x1, x2, x3, (rk)[(i) + 0]);                              \
+  TTABLE_ROUND(t, x1, x2, x3, x0, (rk)[(i) + 1]);                              \
+  TTABLE_ROUND(t, x2, x3, x0, x1, (rk)[(i) + 2]);                              \
+  TTABLE_ROUND(t, x3, x0, x1, x2, (rk)[(i) + 3])
+
+// 大端装载/存储：一次 32 位访问加 bswap，代替逐字节移位拼接
+static inline uint32_t load_be32(const uint8_t *p) {
+  uint32_t w;
+  memcpy(&w, p, 4);
+  return __builtin_bswap32(w);
+}
+
+static inline void store_be32(uint8_t *p, uint32_t w) {
+  w = __builtin_bswap32(w);
+  memcpy(p, &w, 4);
+}
+
+// 以下内核以 T 变换为参数，总是内联，各布局由 TTABLE_VARIANT 各生成一份
+
+// 单块内核，rk 为按使用顺序排列的轮密钥，32 轮完全展开、无方向判断
+static inline __attribute__((always_inline)) void
+SM4_ttable_block(const uint8_t *in, uint8_t *out, const uint32_t *rk,
+                 uint32_t (*t)(uint32_t)) {
+  uint32_t x0 = load_be32(in), x1 = load_be32(in + 4);
+  uint32_t x2 = load_be32(in + 8), x3 = load_be32(in + 12);
+  // 32轮
+  TTABLE_ROUNDS4(t, rk, 0);
+  TTABLE_ROUNDS4(t, rk, 4);
+  TTABLE_ROUNDS4(t, rk, 8);
+  TTABLE_ROUNDS4(t, rk, 12);
+  TTABLE_ROUNDS4(t, rk, 16);
+  TTABLE_ROUNDS4(t, rk, 20);
+  TTABLE_ROUNDS4(t, rk, 24);
+  TTABLE_ROUNDS4(t, rk, 28);
+  //数据装填（反序）
+  store_be32(out, x3);
+  store_be32(out + 4, x2);
+  store_be32(out + 8, x1);
+  store_be32(out + 12, x0);
+}
+
+// n 路交错内核：各块的同一轮放在一起，单块每轮 4 次查表依赖上一轮结果，
+// 交错后不同块的查表互不依赖，可以同时在途。n 为编译期常数，循环全部展开。
+// 第 l 块为 in + 16 * l，使用轮密钥 rk[l]
+static inline __attribute__((always_inline)) void
+SM4_ttable_lanes(const uint8_t *in, uint8_t *out, const uint32_t *const *rk,
+                 int n, uint32_t (*t)(uint32_t)) {
+  uint32_t x0[4], x1[4], x2[4], x3[4];
+  for (int l = 0; l < n; l++) {
+    x0[l] = load_be32(in + 16 * l);
+    x1[l] = load_be32(in + 16 * l + 4);
+    x2[l] = load_be32(in + 16 * l + 8);
+    x3[l] = load_be32(in + 16 * l + 12);
+  }
+  for (int r = 0; r < 32; r += 4) {
+    for (int l = 0; l < n; l++)
+      TTABLE_ROUND(t, x0[l], x1[l], x2[l], x3[l], rk[l][r + 0]);
+    for (int l = 0; l < n; l++)
+      TTABLE_ROUND(t, x1[l], x2[l], x3[l], x0[l], rk[l][r + 1]);
+    for (int l = 0; l < n; l++)
+      TTABLE_ROUND(t, x2[l], x3[l], x0[l], x1[l], rk[l][r + 2]);
+    for (int l = 0; l < n; l++)
+      TTABLE_ROUND(t, x3[l], x0[l], x1[l], x2[l], rk[l][r + 3]);
+  }
+  for (int l = 0; l < n; l++) {
+    store_be32(out + 16 * l, x3[l]);
+    store_be32(out + 16 * l + 4, x2[l]);
+    store_be32(out + 16 * l + 8, x1[l]);
+    store_be32(out + 16 * l + 12, x0[l]);
+  }
+}
+
+typedef void (*TTABLE_X1)(const uint8_t *, uint8_t *, const uint32_t *);
+typedef void (*TTABLE_XN)(const uint8_t *, uint8_t *, const uint32_t *const *);
+
+// 同一组轮密钥的多块：4 块一组交错，余下 2 块、1 块
+static inline __attribute__((always_inline)) void
+SM4_ttable_blocks(const uint8_t *in, uint8_t *out, size_t nblocks,
+                  const uint32_t *rk, TTABLE_XN x4, TTABLE_XN x2,
+                  TTABLE_X1 x1) {
+  const uint32_t *const rks[4] = {rk, rk, rk, rk};
+  size_t i = 0;
+  for (; i + 4 <= nblocks; i += 4) {
+    x4(in + 16 * i, out + 16 * i, rks);
+  }
+  if (i + 2 <= nblocks) {
+    x2(in + 16 * i, out + 16 * i, rks);
+    i += 2;
+  }
+  if (i < nblocks) {
+    x1(in + 16 * i, out + 16 * i, rk);
+  }
+}
+
+// 每块各自的轮密钥（多密钥接口），分组方式同上
+static inline __attribute__((always_inline)) void
+SM4_ttable_multikey(const uint8_t *in, uint8_t *out, size_t nblocks,
+                    const SM4_Key *const *keys, int dec, TTABLE_XN x4,
+                    TTABLE_XN x2, TTABLE_X1 x1) {
+  const uint32_t *rks[4];
+  size_t i = 0;
+  for (; i + 4 <= nblocks; i += 4) {
+    for (int l = 0; l < 4; l++) {
+      rks[l] = dec ? keys[i + l]->rk_dec : keys[i + l]->rk;
+    }
+    x4(in + 16 * i, out + 16 * i, rks);
+  }
+  if (i + 2 <= nblocks) {
+    for (int l = 0; l < 2; l++) {
+      rks[l] = dec ? keys[i + l]->rk_dec : keys[i + l]->rk;
+    }
+    x2(in + 16 * i, out + 16 * i, rks);
+    i += 2;
+  }
+  if (i < nblocks) {
+    x1(in + 16 * i, out + 16 * i, dec ? keys[i]->rk_dec : keys[i]->rk);
+  }
+}
+
+// 一种布局的 4/2/1 块内核（不内联，加解密与多密钥共用）、不计入插桩的
+// sm4_<name>_blocks_impl/sm4_<name>_multikey_impl（dec 为 1 时解密）和
+// 4 个计入插桩的多块入口
+#define TTABLE_VARIANT(name, t, site)                                          \
+  static void name##_x4(const uint8_t *in, uint8_t *out,                       \
+                        const uint32_t *const *rk) {                           \
+    SM4_ttable_lanes(in, out, rk, 4, t);                                       \
+  }                                                                            \
+  static void name##_x2(const uint8_t *in, uint8_t *out,                       \
+                        const uint32_t *const *rk) {                           \
+    SM4_ttable_lanes(in, out, rk, 2, t);                                       \
+  }                                                                            \
+  static void name##_x1(const uint8_t *in, uint8_t *out, const uint32_t *rk) { \
+    SM4_ttable_block(in, out, rk, t);                                          \
+  }                                                                            \
+  void sm4_##name##_blocks_impl(const uint8_t *in, uint8_t *out,               \
+                                size_t nblocks, const SM4_Key *key, int dec) { \
+    SM4_ttable_blocks(in, out, nblocks, dec ? key->rk_dec : key->rk,           \
+                      name##_x4, name##_x2, name##_x1);                        \
+  }                                                                            \
+  void sm4_##name##_multikey_impl(const uint8_t *in, uint8_t *out,             \
+                                  size_t nblocks, const SM4_Key *const *keys,  \
+                                  int dec) {                                   \
+    SM4_ttable_multikey(in, out, nblocks, keys, dec, name##_x4, name##_x2,     \
+                        name##_x1);                                            \
+  }                                                                            \
+  void sm4_encrypt_blocks_##name(const uint8_t *in, uint8_t *out,              \
+                                 size_t nblocks, const SM4_Key *key) {         \
+    SM4_TRACE_BEGIN(site, 16 * nblocks, nblocks);                              \
+    sm4_##name##_blocks_impl(in, out, nblocks, key, 0);                        \
+    SM4_TRACE_END();                                                           \
+  }                                                                            \
+  void sm4_decrypt_blocks_##name(const uint8_t *in, uint8_t *out,              \
+                                 size_t nblocks, const SM4_Key *key) {         \
+    SM4_TRACE_BEGIN(site, 16 * nblocks, nblocks);                              \
+    sm4_##name##_blocks_impl(in, out, nblocks, key, 1);                        \
+    SM4_TRACE_END();                                                           \
+  }                                                                            \
+  void sm4_encrypt_multikey_##name(const uint8_t *in, uint8_t *out,            \
+                                   size_t nblocks,                             \
+                                   const SM4_Key *const *keys) {               \
+    SM4_TRACE_BEGIN(site, 16 * nblocks, nblocks);                              \
+    sm4_##name##_multikey_impl(in, out, nblocks, keys, 0);                     \
+    SM4_TRACE_END();                                                           \
+  }                                                                            \
+  void sm4_decrypt_multikey_##name(const uint8_t *in, uint8_t *out,            \
+                                   size_t nblocks,                             \
+                                   const SM4_Key *const *keys) {               \
+    SM4_TRACE_BEGIN(site, 16 * nblocks, nblocks);                              \
+    sm4_##name##_multikey_impl(in, out, nblocks, keys, 1);                     \
+    SM4_TRACE_END();                                                           \
+  }
+
+TTABLE_VARIANT(ttable, TTABLE_T, SM4_TRACE_TTABLE)
+TTABLE_VARIANT(ttable1k, TTABLE1K_T, SM4_TRACE_TTABLE1K)
+TTABLE_VARIANT(sbox, SBOX_T, SM4_TRACE_SBOX)
+TTABLE_VARIANT(ttable4k, TTABLE4K_T, SM4_TRACE_TTABLE4K)
+
 void sm4_encrypt_ttable(const uint8_t *plaintext, const SM4_Key *sm4_key,
                         uint8_t *ciphertext) {
-  _SM4_do(plaintext, ciphertext, sm4_key, 0);
+  ttable_x1(plaintext, ciphertext, sm4_key->rk);
 }
 
 void sm4_decrypt_ttable(const uint8_t *ciphertext, const SM4_Key *sm4_key,
                         uint8_t *plaintext) {
-  _SM4_do(ciphertext, plaintext, sm4_key, 1);
+  ttable_x1(ciphertext, plaintext, sm4_key->rk_dec);
 }
 
 void _SM4_do(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
              uint8_t enc) {
-  uint32_t x[4];
-  uint32_t tmp, tmp1;
-  //装载数据
-  for (int i = 0; i < 4; i++) {
-    int j = 4 * i;
-    x[i] =
-        (in[j + 0] << 24) | (in[j + 1] << 16) | (in[j + 2] << 8) | (in[j + 3]);
-  }
-  // 32轮循环
-  for (int i = 0; i < 32; i++) {
-    tmp = (enc == 0) ? sm4_key->rk[i] : sm4_key->rk[31 - i];
-    tmp = x[1] ^ x[2] ^ x[3] ^ tmp;
-    //查找表（S盒+线性变换）
-    tmp1 = x[0];
-    tmp1 ^= Table0[(tmp >> 24) & 0xFF];
-    tmp1 ^= Table1[(tmp >> 16) & 0xFF];
-    tmp1 ^= Table2[(tmp >> 8) & 0xFF];
-    tmp1 ^= Table3[(tmp >> 0) & 0xFF];
-
-    x[0] = x[1];
-    x[1] = x[2];
-    x[2] = x[3];
-    x[3] = tmp1;
-  }
-  //数据装填
-  for (int i = 0; i < 4; i++) {
-    uint32_t w = x[3 - i];
-    int j = 4 * i;
-    out[j + 0] = (w >> 24) & 0xFF;
-    out[j + 1] = (w >> 16) & 0xFF;
-    out[j + 2] = (w >> 8) & 0xFF;
-    out[j + 3] = (w >> 0) & 0xFF;
-  }
-}
\ No newline at end of file
+  ttable_x1(in, out, (enc == 0) ? sm4_key->rk : sm4_key->rk_dec);
+}
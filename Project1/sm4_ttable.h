@@ -4,10 +4,62 @@
 #include "sm4.h"
 #include <stdint.h>
 
+// 合并 S 盒与线性变换 L 的 T 表：Table0 对应最高字节，Table3 对应最低字节
+extern const uint32_t Table0[256];
+extern const uint32_t Table1[256];
+extern const uint32_t Table2[256];
+extern const uint32_t Table3[256];
+
 void _SM4_do(const uint8_t *in, uint8_t *out, const SM4_Key *sm4_key,
              uint8_t enc);
 
 void sm4_encrypt_ttable(const uint8_t *in, const SM4_Key *key, uint8_t *out);
 void sm4_decrypt_ttable(const uint8_t *in, const SM4_Key *key, uint8_t *out);
 
+void sm4_encrypt_blocks_ttable(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key);
+void sm4_decrypt_blocks_ttable(const uint8_t *in, uint8_t *out, size_t nblocks,
+                               const SM4_Key *key);
+
+// 多密钥接口：第 i 个分组使用 keys[i]
+void sm4_encrypt_multikey_ttable(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys);
+void sm4_decrypt_multikey_ttable(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *const *keys);
+
+// 同上两组接口的实现（dec 为 1 时解密），不计入插桩，供以 T-table 处理
+// 尾部的其他后端调用。各紧凑布局也有同名的 sm4_<布局>_*_impl
+void sm4_ttable_blocks_impl(const uint8_t *in, uint8_t *out, size_t nblocks,
+                            const SM4_Key *key, int dec);
+void sm4_ttable_multikey_impl(const uint8_t *in, uint8_t *out, size_t nblocks,
+                              const SM4_Key *const *keys, int dec);
+
+// 紧凑查表布局（见 sm4_ttable.c），接口与上面相同
+void sm4_encrypt_blocks_ttable1k(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *key);
+void sm4_decrypt_blocks_ttable1k(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *key);
+void sm4_encrypt_multikey_ttable1k(const uint8_t *in, uint8_t *out,
+                                   size_t nblocks, const SM4_Key *const *keys);
+void sm4_decrypt_multikey_ttable1k(const uint8_t *in, uint8_t *out,
+                                   size_t nblocks, const SM4_Key *const *keys);
+
+void sm4_encrypt_blocks_sbox(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *key);
+void sm4_decrypt_blocks_sbox(const uint8_t *in, uint8_t *out, size_t nblocks,
+                             const SM4_Key *key);
+void sm4_encrypt_multikey_sbox(const uint8_t *in, uint8_t *out,
+                               size_t nblocks, const SM4_Key *const *keys);
+void sm4_decrypt_multikey_sbox(const uint8_t *in, uint8_t *out,
+                               size_t nblocks, const SM4_Key *const *keys);
+
+void sm4_encrypt_blocks_ttable4k(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *key);
+void sm4_decrypt_blocks_ttable4k(const uint8_t *in, uint8_t *out,
+                                 size_t nblocks, const SM4_Key *key);
+void sm4_encrypt_multikey_ttable4k(const uint8_t *in, uint8_t *out,
+                                   size_t nblocks, const SM4_Key *const *keys);
+void sm4_decrypt_multikey_ttable4k(const uint8_t *in, uint8_t *out,
+                                   size_t nblocks, const SM4_Key *const *keys);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "sm4_xts.h"
+#include "sm4_engine.h"
+#include "sm4_trace.h"
+
+#include <emmintrin.h>
+#include <string.h>
+
+static inline __m128i load_block(const uint8_t *p) {
+  return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void store_block(uint8_t *p, __m128i v) {
+  _mm_storeu_si128((__m128i *)p, v);
+}
+
+// 16 字节整体逆序（仅用 SSE2）
+static inline __m128i bswap128(__m128i x) {
+  x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+  x = _mm_shufflelo_epi16(x, 0x1B);
+  x = _mm_shufflehi_epi16(x, 0x1B);
+  return _mm_shuffle_epi32(x, 0x4E);
+}
+
+// IEEE：T 视为小端 128 位整数，T << 1，最高位溢出时低字节异或 0x87。
+// 两个 64 位半区各自左移，两个半区最高位的进位由 srai + shuffle 得到
+static inline __m128i mul_x_ieee(__m128i t) {
+  __m128i carry = _mm_shuffle_epi32(_mm_srai_epi32(t, 31), 0x13);
+  carry = _mm_and_si128(carry, _mm_setr_epi32(0x87, 0, 1, 0));
+  return _mm_xor_si128(_mm_add_epi64(t, t), carry);
+}
+
+// GB：比特序与 GCM 相同。t 事先整体逆序，此时是大端整数 N 的小端表示，
+// 乘 α 即 N >> 1，最低位移出时最高字节异或 0xE1
+static inline __m128i mul_x_gb(__m128i t) {
+  __m128i lsb = _mm_srai_epi32(_mm_slli_epi32(t, 31), 31);
+  __m128i red = _mm_and_si128(_mm_shuffle_epi32(lsb, 0x00),
+                              _mm_setr_epi32(0, 0, 0, 0xE1000000));
+  __m128i hi_bit = _mm_slli_epi64(_mm_srli_si128(t, 8), 63);
+  t = _mm_or_si128(_mm_srli_epi64(t, 1), hi_bit);
+  return _mm_xor_si128(t, red);
+}
+
+// 调整值状态：GB 模式下以逆序形式保存，取用时再转回字节序
+static inline __m128i tweak_init(const SM4_XTS_CTX *ctx, const uint8_t iv[16]) {
+  uint8_t t[16];
+  sm4_engine_get(1)->encrypt_blocks(iv, t, 1, &ctx->key2);
+  return ctx->std == SM4_XTS_GB ? bswap128(load_block(t)) : load_block(t);
+}
+
+static inline __m128i tweak_bytes(const SM4_XTS_CTX *ctx, __m128i t) {
+  return ctx->std == SM4_XTS_GB ? bswap128(t) : t;
+}
+
+static inline __m128i tweak_next(const SM4_XTS_CTX *ctx, __m128i t) {
+  return ctx->std == SM4_XTS_GB ? mul_x_gb(t) : mul_x_ieee(t);
+}
+
+// 处理 nblocks 个完整分组：每批先算出全部调整值并异或，整批加/解密后再异或，
+// *t 更新为下一分组的调整值
+static void xts_blocks(const SM4_XTS_CTX *ctx, const uint8_t *in, uint8_t *out,
+                       size_t nblocks, __m128i *t, int enc) {
+  __m128i tw[SM4_XTS_BATCH];
+  uint8_t buf[16 * SM4_XTS_BATCH];
+  __m128i cur = *t;
+
+  while (nblocks > 0) {
+    size_t n = nblocks < SM4_XTS_BATCH ? nblocks : SM4_XTS_BATCH;
+    for (size_t i = 0; i < n; i++) {
+      tw[i] = tweak_bytes(ctx, cur);
+      cur = tweak_next(ctx, cur);
+      store_block(buf + 16 * i, _mm_xor_si128(load_block(in + 16 * i), tw[i]));
+    }
+    const SM4_ENGINE *engine = sm4_engine_get(n);
+    if (enc) {
+      engine->encrypt_blocks(buf, buf, n, &ctx->key1);
+    } else {
+      engine->decrypt_blocks(buf, buf, n, &ctx->key1);
+    }
+    for (size_t i = 0; i < n; i++) {
+      store_block(out + 16 * i, _mm_xor_si128(load_block(buf + 16 * i), tw[i]));
+    }
+    in += 16 * n;
+    out += 16 * n;
+    nblocks -= n;
+  }
+  *t = cur;
+}
+
+// 单个分组，调整值以字节序给出
+static void xts_one(const SM4_XTS_CTX *ctx, const uint8_t in[16],
+                    uint8_t out[16], __m128i tw, int enc) {
+  uint8_t buf[16];
+  store_block(buf, _mm_xor_si128(load_block(in), tw));
+  if (enc) {
+    sm4_engine_get(1)->encrypt_blocks(buf, buf, 1, &ctx->key1);
+  } else {
+    sm4_engine_get(1)->decrypt_blocks(buf, buf, 1, &ctx->key1);
+  }
+  store_block(out, _mm_xor_si128(load_block(buf), tw));
+}
+
+static int xts_crypt(const SM4_XTS_CTX *ctx, const uint8_t iv[16],
+                     const uint8_t *in, uint8_t *out, size_t len, int enc) {
+  if (len < 16) {
+    return -1;
+  }
+
+  size_t rem = len % 16;
+  size_t nblocks = len / 16 - (rem ? 1 : 0); // 有挪用时最后一个整块单独处理
+  __m128i t = tweak_init(ctx, iv);
+
+  xts_blocks(ctx, in, out, nblocks, &t, enc);
+  if (rem == 0) {
+    return 0;
+  }
+
+  // 密文挪用：倒数第二块用 T_{m-1}、最后拼出的块用 T_m；解密时两者顺序对调
+  const uint8_t *tail_in = in + 16 * nblocks;
+  uint8_t *tail_out = out + 16 * nblocks;
+  __m128i t_prev = tweak_bytes(ctx, t);
+  __m128i t_last = tweak_bytes(ctx, tweak_next(ctx, t));
+  uint8_t cc[16], pp[16];
+
+  xts_one(ctx, tail_in, cc, enc ? t_prev : t_last, enc);
+  memcpy(pp, tail_in + 16, rem);
+  memcpy(pp + rem, cc + rem, 16 - rem);
+  memcpy(tail_out + 16, cc, rem);
+  xts_one(ctx, pp, tail_out, enc ? t_last : t_prev, enc);
+  return 0;
+}
+
+void sm4_xts_init(SM4_XTS_CTX *ctx, const uint8_t key[32], SM4_XTS_STD std) {
+  sm4_keyInit(key, &ctx->key1);
+  sm4_keyInit(key + 16, &ctx->key2);
+  ctx->std = std;
+}
+
+int sm4_xts_encrypt(const SM4_XTS_CTX *ctx, const uint8_t iv[16],
+                    const uint8_t *in, uint8_t *out, size_t len) {
+  SM4_TRACE_BEGIN(SM4_TRACE_XTS, len, (len + 15) / 16);
+  int ret = xts_crypt(ctx, iv, in, out, len, 1);
+  SM4_TRACE_END();
+  return ret;
+}
+
+int sm4_xts_decrypt(const SM4_XTS_CTX *ctx, const uint8_t iv[16],
+                    const uint8_t *in, uint8_t *out, size_t len) {
+  SM4_TRACE_BEGIN(SM4_TRACE_XTS, len, (len + 15) / 16);
+  int ret = xts_crypt(ctx, iv, in, out, len, 0);
+  SM4_TRACE_END();
+  return ret;
+}
+
+static int xts_sectors(const SM4_XTS_CTX *ctx, uint64_t sector,
+                       size_t sector_size, const uint8_t *in, uint8_t *out,
+                       size_t nsectors, int enc) {
+  uint8_t iv[16] = {0};
+  for (size_t i = 0; i < nsectors; i++) {
+    uint64_t s = sector + i;
+    for (int b = 0; b < 8; b++) {
+      iv[b] = (uint8_t)(s >> (8 * b));
+    }
+    if (xts_crypt(ctx, iv, in + i * sector_size, out + i * sector_size,
+                  sector_size, enc) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int sm4_xts_encrypt_sectors(const SM4_XTS_CTX *ctx, uint64_t sector,
+                            size_t sector_size, const uint8_t *in,
+                            uint8_t *out, size_t nsectors) {
+  SM4_TRACE_BEGIN(SM4_TRACE_XTS, sector_size * nsectors,
+                  sector_size * nsectors / 16);
+  int ret = xts_sectors(ctx, sector, sector_size, in, out, nsectors, 1);
+  SM4_TRACE_END();
+  return ret;
+}
+
+int sm4_xts_decrypt_sectors(const SM4_XTS_CTX *ctx, uint64_t sector,
+                            size_t sector_size, const uint8_t *in,
+                            uint8_t *out, size_t nsectors) {
+  SM4_TRACE_BEGIN(SM4_TRACE_XTS, sector_size * nsectors,
+                  sector_size * nsectors / 16);
+  int ret = xts_sectors(ctx, sector, sector_size, in, out, nsectors, 0);
+  SM4_TRACE_END();
+  return ret;
+}
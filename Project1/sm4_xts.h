@@ -0,0 +1,40 @@
+#ifndef SM4_XTS_H
+#define SM4_XTS_H
+
+#include "sm4.h"
+
+// 每批计算的调整值（tweak）个数，整批交给多块后端
+#define SM4_XTS_BATCH 64
+
+// 调整值乘 α 的约定
+typedef enum {
+  SM4_XTS_GB = 0, // GB/T 17964-2021：与 GCM 相同的比特序，右移，约化多项式 0xE1
+  SM4_XTS_IEEE,   // IEEE P1619：小端整数左移，约化多项式 0x87
+} SM4_XTS_STD;
+
+typedef struct {
+  SM4_Key key1; // 数据密钥
+  SM4_Key key2; // 调整值密钥
+  SM4_XTS_STD std;
+} SM4_XTS_CTX;
+
+// key 为 32 字节：前 16 字节为数据密钥，后 16 字节为调整值密钥
+void sm4_xts_init(SM4_XTS_CTX *ctx, const uint8_t key[32], SM4_XTS_STD std);
+
+// 加密/解密一个数据单元（如一个扇区），len 至少 16 字节；
+// 不是 16 的倍数时使用密文挪用（CTS）。len < 16 返回 -1，成功返回 0
+int sm4_xts_encrypt(const SM4_XTS_CTX *ctx, const uint8_t iv[16],
+                    const uint8_t *in, uint8_t *out, size_t len);
+int sm4_xts_decrypt(const SM4_XTS_CTX *ctx, const uint8_t iv[16],
+                    const uint8_t *in, uint8_t *out, size_t len);
+
+// 按扇区批量处理：第 i 个扇区的 iv 为扇区号 sector + i 的 128 位小端表示
+// （与 dm-crypt 的 plain64 相同），每个扇区 sector_size 字节
+int sm4_xts_encrypt_sectors(const SM4_XTS_CTX *ctx, uint64_t sector,
+                            size_t sector_size, const uint8_t *in,
+                            uint8_t *out, size_t nsectors);
+int sm4_xts_decrypt_sectors(const SM4_XTS_CTX *ctx, uint64_t sector,
+                            size_t sector_size, const uint8_t *in,
+                            uint8_t *out, size_t nsectors);
+
+#endif